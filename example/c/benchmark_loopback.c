@@ -0,0 +1,186 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "multibus_capture.h"
+#include "multibus_loopback.h"
+#include "multibus_loopback_devices.h"
+#include "multibus_protocol.h"
+#include "multibus_serial_posix.h"
+#include "multibus_transport.h"
+#include "multibus_transport_protocol.h"
+
+// measures per-message overhead of transport and generated code with the in-process loopback bridge
+
+#define NUM_MODULES 4
+
+#define BH1750_ONE_TIME_L_RES 0x23
+#define BH1750_LUX            500
+
+#define MAX7219_CMD_BRIGHTNESS 10
+
+// static config
+static uint32_t num_iterations = 100000;
+static uint8_t  max7219_chip_select_gpio = 17;
+
+// transport instance
+static uint8_t request_buffer[300];
+static uint8_t response_buffer[300];
+static uint8_t send_queue_storage[1024];
+static uint8_t receive_ring_storage[1024];
+static mb_transport_request_t requests[16];
+static mb_transport_t mb_transport;
+
+// virtual bridge
+static mb_loopback_context_t mb_loopback_context;
+static mb_loopback_bh1750_t  bh1750;
+static mb_loopback_max7219_t max7219;
+
+static uint32_t num_responses;
+static uint32_t num_errors;
+
+// optional capture file
+static const char * capture_path;
+static FILE * capture_file;
+static mb_capture_t capture;
+static uint8_t capture_storage[65536];
+
+static void loopback_callback_handler(void * context, const mb_message_t * message){
+    (void) context;
+    num_responses++;
+    uint8_t status;
+    if (mb_message_get_status(message, &status) && (status != MB_STATUS_OK)){
+        num_errors++;
+    }
+    if ((message->component == MB_COMPONENT_I2C_MASTER) && (message->operation == MB_OPERATION_I2C_MASTER_READ_RESPONSE)){
+        const uint8_t * data = mb_message_i2c_master_read_response_get_data(message);
+        uint16_t measurement = (data[0] << 8) | data[1];
+        if (measurement != ((BH1750_LUX * 12) / 10)){
+            num_errors++;
+        }
+    }
+}
+
+static void capture_flush(void){
+    if (capture_file == NULL) return;
+    (void) mb_capture_flush(&capture, capture_file);
+}
+
+// send request, process loopback bridge while send queue is full
+#define SEND_REQUEST(SEND_CALL) do { while ((SEND_CALL) == false) { (void) mb_loopback_process(&mb_loopback_context); capture_flush(); } } while (0)
+
+int main(int argc, const char **argv) {
+    int i;
+    for (i = 1; i < argc; i++){
+        if ((strcmp(argv[i], "-c") == 0) && ((i + 1) < argc)){
+            capture_path = argv[++i];
+        } else {
+            num_iterations = (uint32_t) atoi(argv[i]);
+        }
+    }
+
+    // setup virtual bridge with BH1750 and chain of MAX7219
+    mb_loopback_init(&mb_loopback_context);
+    mb_loopback_bh1750_init(&bh1750, MB_LOOPBACK_BH1750_ADDRESS_LOW);
+    mb_loopback_bh1750_set_lux(&bh1750, BH1750_LUX);
+    mb_loopback_add_i2c_device(&mb_loopback_context, &bh1750.device);
+    mb_loopback_max7219_init(&max7219, max7219_chip_select_gpio, NUM_MODULES);
+    mb_loopback_add_spi_device(&mb_loopback_context, &max7219.device);
+
+    // setup transport interface
+    const mb_driver_t * driver_impl = mb_loopback_get_driver();
+    mb_transport_create(&mb_transport, driver_impl, &mb_loopback_context,
+                        request_buffer, sizeof(request_buffer),
+                        response_buffer, sizeof(response_buffer));
+    mb_transport_enable_pipelining(&mb_transport, requests, sizeof(requests) / sizeof(mb_transport_request_t),
+                                   send_queue_storage, sizeof(send_queue_storage));
+    mb_transport_enable_receive_ring(&mb_transport, receive_ring_storage, sizeof(receive_ring_storage));
+    mb_transport_register_callback(&mb_transport, &loopback_callback_handler, NULL);
+
+    // record all messages, e.g. for benchmark_replay or capture-decoder.py
+    if (capture_path != NULL){
+        capture_file = fopen(capture_path, "wb");
+        if ((capture_file == NULL) || (mb_capture_write_file_header(capture_file) == false)){
+            printf("Cannot create capture file %s\n", capture_path);
+            return 1;
+        }
+        mb_capture_init(&capture, capture_storage, sizeof(capture_storage));
+        mb_transport_set_time_source(&mb_transport, &mb_serial_posix_get_time_us);
+        mb_transport_enable_capture(&mb_transport, &capture);
+    }
+
+    // config
+    SEND_REQUEST(mb_transport_i2c_master_config_request_send(&mb_transport, 0, MB_I2C_MASTER_CONFIG_REQUEST_CLOCK_SPEED_400_KHZ,
+                                                             false, false));
+    SEND_REQUEST(mb_transport_spi_master_config_request_send(&mb_transport, 0, 8, MB_SPI_MASTER_CONFIG_REQUEST_BIT_ORDER_MSB_FIRST,
+                                                             MB_SPI_MASTER_CONFIG_REQUEST_CPOL_0, MB_SPI_MASTER_CONFIG_REQUEST_CPHA_0,
+                                                             1000000));
+
+    // each iteration: trigger and read BH1750 measurement, set brightness on all MAX7219
+    uint8_t bh1750_mode = BH1750_ONE_TIME_L_RES;
+    uint8_t max7219_data[2 * NUM_MODULES];
+    uint32_t start_us = mb_serial_posix_get_time_us();
+    uint32_t iteration;
+    for (iteration = 0; iteration < num_iterations; iteration++){
+        SEND_REQUEST(mb_transport_i2c_master_write_request_send(&mb_transport, 0, MB_LOOPBACK_BH1750_ADDRESS_LOW, 1, &bh1750_mode));
+        SEND_REQUEST(mb_transport_i2c_master_read_request_send(&mb_transport, 0, MB_LOOPBACK_BH1750_ADDRESS_LOW, 2));
+        uint8_t module;
+        for (module = 0; module < NUM_MODULES; module++){
+            max7219_data[2*module]   = MAX7219_CMD_BRIGHTNESS;
+            max7219_data[2*module+1] = (uint8_t) (iteration & 0x0f);
+        }
+        SEND_REQUEST(mb_transport_spi_master_write_request_send(&mb_transport, 0, max7219_chip_select_gpio, sizeof(max7219_data), max7219_data));
+    }
+    while (mb_transport_get_num_pending_requests(&mb_transport) > 0){
+        (void) mb_loopback_process(&mb_loopback_context);
+        capture_flush();
+    }
+    uint32_t duration_us = mb_serial_posix_get_time_us() - start_us;
+    capture_flush();
+
+    // all modules have latched the last brightness
+    uint8_t module;
+    for (module = 0; module < NUM_MODULES; module++){
+        if (mb_loopback_max7219_get_register(&max7219, module, MAX7219_CMD_BRIGHTNESS) != ((num_iterations - 1) & 0x0f)){
+            num_errors++;
+        }
+    }
+
+    uint32_t num_requests = mb_loopback_context.num_requests;
+    printf("Requests:   %u\n", num_requests);
+    printf("Responses:  %u\n", num_responses);
+    printf("Errors:     %u\n", num_errors);
+    printf("Duration:   %u us\n", duration_us);
+    if (duration_us > 0){
+        printf("Requests/s: %.0f\n", num_requests * 1000000.0 / duration_us);
+        printf("ns/request: %.1f\n", duration_us * 1000.0 / num_requests);
+    }
+    if (capture_file != NULL){
+        printf("Captured:   %s, %u records dropped\n", capture_path, mb_capture_get_num_dropped(&capture));
+        fclose(capture_file);
+    }
+    return (num_errors == 0 && num_responses == num_requests) ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "multibus_protocol.h"
+#include "multibus_replay.h"
+#include "multibus_serial_posix.h"
+#include "multibus_transport.h"
+
+// replays all requests from a capture file through the transport and the replay driver
+
+// static config
+static const char * capture_path;
+static bool         capture_timing;
+static uint32_t     num_iterations = 1;
+
+// capture storage
+static uint8_t trace_storage[1024 * 1024];
+
+// transport instance
+static uint8_t request_buffer[300];
+static uint8_t response_buffer[300];
+static uint8_t send_queue_storage[1024];
+static uint8_t receive_ring_storage[1024];
+static mb_transport_request_t requests[16];
+static mb_transport_t mb_transport;
+static mb_replay_context_t mb_replay_context;
+
+static uint32_t num_responses;
+
+static void replay_callback_handler(void * context, const mb_message_t * message){
+    (void) context;
+    (void) message;
+    num_responses++;
+}
+
+static bool replay_iteration(void){
+    if (mb_replay_init(&mb_replay_context, mb_replay_context.trace_data, mb_replay_context.trace_len) == false) return false;
+    if (capture_timing){
+        mb_replay_set_time_source(&mb_replay_context, &mb_serial_posix_get_time_us);
+    }
+
+    // setup transport interface
+    const mb_driver_t * driver_impl = mb_replay_get_driver();
+    mb_transport_create(&mb_transport, driver_impl, &mb_replay_context,
+                        request_buffer, sizeof(request_buffer),
+                        response_buffer, sizeof(response_buffer));
+    mb_transport_enable_pipelining(&mb_transport, requests, sizeof(requests) / sizeof(mb_transport_request_t),
+                                   send_queue_storage, sizeof(send_queue_storage));
+    mb_transport_enable_receive_ring(&mb_transport, receive_ring_storage, sizeof(receive_ring_storage));
+    mb_transport_register_callback(&mb_transport, &replay_callback_handler, NULL);
+
+    // send recorded requests
+    uint32_t offset = MB_CAPTURE_FILE_HEADER_SIZE;
+    mb_replay_record_t record;
+    bool record_valid = mb_replay_get_record(mb_replay_context.trace_data, mb_replay_context.trace_len, &offset, &record);
+    while (record_valid || (mb_replay_done(&mb_replay_context) == false)){
+        while (record_valid){
+            if (record.type == MB_CAPTURE_TYPE_SENT){
+                if (mb_transport_send(&mb_transport, record.data, record.len) == false) break;
+            }
+            record_valid = mb_replay_get_record(mb_replay_context.trace_data, mb_replay_context.trace_len, &offset, &record);
+        }
+        (void) mb_replay_process(&mb_replay_context);
+    }
+    return true;
+}
+
+int main(int argc, const char **argv) {
+    // get capture path
+    int i;
+    for (i = 1; i < argc; i++){
+        if (strcmp(argv[i], "-t") == 0){
+            capture_timing = true;
+        } else if ((strcmp(argv[i], "-n") == 0) && ((i + 1) < argc)){
+            num_iterations = (uint32_t) atoi(argv[++i]);
+        } else {
+            capture_path = argv[i];
+        }
+    }
+    if (capture_path == NULL){
+        printf("Usage: %s [-t] [-n iterations] <path to capture file>\n", argv[0]);
+        printf("-t: keep original timing\n");
+        exit(10);
+    }
+
+    if (mb_replay_open(&mb_replay_context, capture_path, trace_storage, sizeof(trace_storage)) == false){
+        printf("Cannot load capture %s\n", capture_path);
+        return 10;
+    }
+
+    uint32_t num_requests = 0;
+    uint32_t num_mismatches = 0;
+    uint32_t num_unexpected_bytes = 0;
+    uint32_t start_us = mb_serial_posix_get_time_us();
+    uint32_t iteration;
+    for (iteration = 0; iteration < num_iterations; iteration++){
+        if (replay_iteration() == false) return 10;
+        num_requests         += mb_replay_context.num_requests;
+        num_mismatches       += mb_replay_context.num_mismatches;
+        num_unexpected_bytes += mb_replay_context.num_unexpected_bytes;
+    }
+    uint32_t duration_us = mb_serial_posix_get_time_us() - start_us;
+
+    printf("Requests:         %u\n", num_requests);
+    printf("Responses:        %u\n", num_responses);
+    printf("Mismatches:       %u\n", num_mismatches);
+    printf("Unexpected bytes: %u\n", num_unexpected_bytes);
+    printf("Duration:         %u us\n", duration_us);
+    if (duration_us > 0){
+        printf("Requests/s:       %.0f\n", num_requests * 1000000.0 / duration_us);
+    }
+    return (num_mismatches == 0 && num_unexpected_bytes == 0) ? 0 : 1;
+}
@@ -0,0 +1,259 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "multibus_loopback.h"
+#include "multibus_loopback_devices.h"
+#include "multibus_protocol.h"
+#include "multibus_serial_posix.h"
+#include "multibus_shm.h"
+#include "multibus_transport.h"
+#include "multibus_transport_protocol.h"
+
+// same workload as benchmark_loopback, but the loopback bridge runs in a separate process connected via shared memory
+
+#define NUM_MODULES 4
+
+#define BH1750_ONE_TIME_L_RES 0x23
+#define BH1750_LUX            500
+
+#define MAX7219_CMD_BRIGHTNESS 10
+
+// static config
+static uint32_t num_iterations = 100000;
+static uint8_t  max7219_chip_select_gpio = 17;
+
+// shared memory endpoint, creator in bridge process, peer in client process
+static mb_shm_context_t mb_shm_context;
+
+// wait for peer unless there's work to do
+static void shm_wait(int extra_fd){
+    if (mb_shm_process(&mb_shm_context)) return;
+    if (mb_shm_prepare_wait(&mb_shm_context) == false) return;
+    struct pollfd fds[2];
+    fds[0].fd = mb_shm_get_file_descriptor(&mb_shm_context);
+    fds[0].events = POLLIN;
+    fds[1].fd = extra_fd;
+    fds[1].events = POLLIN;
+    (void) poll(fds, (extra_fd >= 0) ? 2 : 1, 100);
+}
+
+// bridge process
+
+static mb_loopback_context_t mb_loopback_context;
+static mb_loopback_bh1750_t  bh1750;
+static mb_loopback_max7219_t max7219;
+static const mb_driver_t *   bridge_driver;
+static uint8_t               bridge_request[MB_LOOPBACK_MAX_MESSAGE_LEN];
+static uint8_t               bridge_response[MB_LOOPBACK_MAX_MESSAGE_LEN];
+static bool                  bridge_payload_pending;
+
+static void bridge_receive_header(void){
+    bridge_payload_pending = false;
+    bridge_driver->receive_block(&mb_shm_context, bridge_request, MB_HEADER_SIZE);
+}
+
+static void bridge_handle_request(void){
+    uint16_t request_len = MB_HEADER_SIZE + mb_header_get_length(bridge_request);
+    uint16_t response_len = mb_loopback_handle_request(&mb_loopback_context, bridge_request, request_len,
+                                                       bridge_response, sizeof(bridge_response));
+    if (response_len > 0){
+        bridge_driver->send_block(&mb_shm_context, bridge_response, response_len);
+    } else {
+        bridge_receive_header();
+    }
+}
+
+static void bridge_block_received(void * context){
+    (void) context;
+    // header complete, receive payload if any
+    uint16_t payload_len = mb_header_get_length(bridge_request);
+    if ((bridge_payload_pending == false) && (payload_len > 0)){
+        if (payload_len > (sizeof(bridge_request) - MB_HEADER_SIZE)){
+            fprintf(stderr, "Bridge: request too large\n");
+            exit(EXIT_FAILURE);
+        }
+        bridge_payload_pending = true;
+        bridge_driver->receive_block(&mb_shm_context, &bridge_request[MB_HEADER_SIZE], payload_len);
+    } else {
+        bridge_handle_request();
+    }
+}
+
+static void bridge_block_sent(void * context){
+    (void) context;
+    bridge_receive_header();
+}
+
+static int run_bridge(int socket_fd){
+    if (mb_shm_create(&mb_shm_context, MB_SHM_DEFAULT_RING_SIZE) == false){
+        perror("mb_shm_create");
+        return EXIT_FAILURE;
+    }
+    if (mb_shm_share(&mb_shm_context, socket_fd) == false){
+        perror("mb_shm_share");
+        return EXIT_FAILURE;
+    }
+
+    mb_loopback_init(&mb_loopback_context);
+    mb_loopback_bh1750_init(&bh1750, MB_LOOPBACK_BH1750_ADDRESS_LOW);
+    mb_loopback_bh1750_set_lux(&bh1750, BH1750_LUX);
+    mb_loopback_add_i2c_device(&mb_loopback_context, &bh1750.device);
+    mb_loopback_max7219_init(&max7219, max7219_chip_select_gpio, NUM_MODULES);
+    mb_loopback_add_spi_device(&mb_loopback_context, &max7219.device);
+
+    bridge_driver = mb_shm_get_driver();
+    bridge_driver->set_block_received(&mb_shm_context, &bridge_block_received, NULL);
+    bridge_driver->set_block_sent(&mb_shm_context, &bridge_block_sent, NULL);
+    bridge_receive_header();
+
+    // serve requests until client closes socket
+    while (true){
+        shm_wait(socket_fd);
+        uint8_t data;
+        if (recv(socket_fd, &data, 1, MSG_DONTWAIT) == 0) break;
+    }
+    mb_shm_close(&mb_shm_context);
+    return EXIT_SUCCESS;
+}
+
+// client process
+
+static uint8_t request_buffer[300];
+static uint8_t response_buffer[300];
+static uint8_t send_queue_storage[1024];
+static uint8_t receive_ring_storage[1024];
+static mb_transport_request_t requests[16];
+static mb_transport_t mb_transport;
+
+static uint32_t num_responses;
+static uint32_t num_errors;
+
+static void client_callback_handler(void * context, const mb_message_t * message){
+    (void) context;
+    num_responses++;
+    uint8_t status;
+    if (mb_message_get_status(message, &status) && (status != MB_STATUS_OK)){
+        num_errors++;
+    }
+    if ((message->component == MB_COMPONENT_I2C_MASTER) && (message->operation == MB_OPERATION_I2C_MASTER_READ_RESPONSE)){
+        const uint8_t * data = mb_message_i2c_master_read_response_get_data(message);
+        uint16_t measurement = (data[0] << 8) | data[1];
+        if (measurement != ((BH1750_LUX * 12) / 10)){
+            num_errors++;
+        }
+    }
+}
+
+// send request, process shared memory driver while send queue is full
+#define SEND_REQUEST(SEND_CALL) do { while ((SEND_CALL) == false) { shm_wait(-1); } } while (0)
+
+static int run_client(int socket_fd){
+    if (mb_shm_attach(&mb_shm_context, socket_fd) == false){
+        perror("mb_shm_attach");
+        return EXIT_FAILURE;
+    }
+
+    const mb_driver_t * driver_impl = mb_shm_get_driver();
+    mb_transport_create(&mb_transport, driver_impl, &mb_shm_context,
+                        request_buffer, sizeof(request_buffer),
+                        response_buffer, sizeof(response_buffer));
+    mb_transport_enable_pipelining(&mb_transport, requests, sizeof(requests) / sizeof(mb_transport_request_t),
+                                   send_queue_storage, sizeof(send_queue_storage));
+    mb_transport_enable_receive_ring(&mb_transport, receive_ring_storage, sizeof(receive_ring_storage));
+    mb_transport_register_callback(&mb_transport, &client_callback_handler, NULL);
+
+    // config
+    SEND_REQUEST(mb_transport_i2c_master_config_request_send(&mb_transport, 0, MB_I2C_MASTER_CONFIG_REQUEST_CLOCK_SPEED_400_KHZ,
+                                                             false, false));
+    SEND_REQUEST(mb_transport_spi_master_config_request_send(&mb_transport, 0, 8, MB_SPI_MASTER_CONFIG_REQUEST_BIT_ORDER_MSB_FIRST,
+                                                             MB_SPI_MASTER_CONFIG_REQUEST_CPOL_0, MB_SPI_MASTER_CONFIG_REQUEST_CPHA_0,
+                                                             1000000));
+
+    // each iteration: trigger and read BH1750 measurement, set brightness on all MAX7219
+    uint8_t bh1750_mode = BH1750_ONE_TIME_L_RES;
+    uint8_t max7219_data[2 * NUM_MODULES];
+    uint32_t start_us = mb_serial_posix_get_time_us();
+    uint32_t iteration;
+    for (iteration = 0; iteration < num_iterations; iteration++){
+        SEND_REQUEST(mb_transport_i2c_master_write_request_send(&mb_transport, 0, MB_LOOPBACK_BH1750_ADDRESS_LOW, 1, &bh1750_mode));
+        SEND_REQUEST(mb_transport_i2c_master_read_request_send(&mb_transport, 0, MB_LOOPBACK_BH1750_ADDRESS_LOW, 2));
+        uint8_t i;
+        for (i = 0; i < NUM_MODULES; i++){
+            max7219_data[2*i]   = MAX7219_CMD_BRIGHTNESS;
+            max7219_data[2*i+1] = (uint8_t) (iteration & 0x0f);
+        }
+        SEND_REQUEST(mb_transport_spi_master_write_request_send(&mb_transport, 0, max7219_chip_select_gpio, sizeof(max7219_data), max7219_data));
+    }
+    while (mb_transport_get_num_pending_requests(&mb_transport) > 0){
+        shm_wait(-1);
+    }
+    uint32_t duration_us = mb_serial_posix_get_time_us() - start_us;
+
+    uint32_t num_requests = 2 + 3 * num_iterations;
+    printf("Requests:   %u\n", num_requests);
+    printf("Responses:  %u\n", num_responses);
+    printf("Errors:     %u\n", num_errors);
+    printf("Duration:   %u us\n", duration_us);
+    if (duration_us > 0){
+        printf("Requests/s: %.0f\n", num_requests * 1000000.0 / duration_us);
+        printf("ns/request: %.1f\n", duration_us * 1000.0 / num_requests);
+    }
+    mb_shm_close(&mb_shm_context);
+    return (num_errors == 0 && num_responses == num_requests) ? 0 : 1;
+}
+
+int main(int argc, const char **argv) {
+    if (argc > 1){
+        num_iterations = (uint32_t) atoi(argv[1]);
+    }
+
+    // socket pair is used to pass the shared memory and eventfds, and to detect client exit
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) < 0){
+        perror("socketpair");
+        return EXIT_FAILURE;
+    }
+    pid_t pid = fork();
+    if (pid < 0){
+        perror("fork");
+        return EXIT_FAILURE;
+    }
+    if (pid == 0){
+        close(sockets[1]);
+        return run_bridge(sockets[0]);
+    }
+    close(sockets[0]);
+    int result = run_client(sockets[1]);
+    close(sockets[1]);
+    int bridge_status;
+    (void) waitpid(pid, &bridge_status, 0);
+    return result;
+}
@@ -0,0 +1,133 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "multibus_loopback.h"
+#include "multibus_loopback_devices.h"
+#include "multibus_protocol.h"
+
+// simulated bridge with BH1750 light sensor and four MAX7219 modules that accepts one TCP client at a time
+
+#define NUM_MODULES 4
+
+// static config
+static uint16_t bridge_port = 7777;
+static uint32_t lux = 500;
+static uint8_t  max7219_chip_select_gpio = 17;
+
+// virtual bridge
+static mb_loopback_context_t mb_loopback_context;
+static mb_loopback_bh1750_t  bh1750;
+static mb_loopback_max7219_t max7219;
+
+// request reassembly and response
+static uint8_t  request[MB_LOOPBACK_MAX_MESSAGE_LEN];
+static uint16_t request_len;
+static uint8_t  response[MB_LOOPBACK_MAX_MESSAGE_LEN];
+
+static bool write_all(int fd, const uint8_t * data, uint16_t len){
+    while (len > 0){
+        ssize_t bytes_written = write(fd, data, len);
+        if (bytes_written <= 0) return false;
+        data += bytes_written;
+        len  -= (uint16_t) bytes_written;
+    }
+    return true;
+}
+
+static void handle_client(int fd){
+    uint32_t num_requests = 0;
+    request_len = 0;
+    while (true){
+        // read header, then payload
+        uint16_t message_len = MB_HEADER_SIZE;
+        if (request_len >= MB_HEADER_SIZE){
+            message_len += mb_header_get_length(request);
+            if (message_len > sizeof(request)) break;
+        }
+        ssize_t bytes_read = read(fd, &request[request_len], message_len - request_len);
+        if (bytes_read <= 0) break;
+        request_len += (uint16_t) bytes_read;
+        if (request_len < MB_HEADER_SIZE) continue;
+        if (request_len < (MB_HEADER_SIZE + mb_header_get_length(request))) continue;
+
+        uint16_t response_len = mb_loopback_handle_request(&mb_loopback_context, request, request_len,
+                                                           response, sizeof(response));
+        request_len = 0;
+        num_requests++;
+        if (write_all(fd, response, response_len) == false) break;
+    }
+    printf("Client disconnected after %u requests\n", num_requests);
+}
+
+int main(int argc, const char **argv) {
+    if (argc > 1){
+        bridge_port = (uint16_t) atoi(argv[1]);
+    }
+
+    // setup virtual bridge with BH1750 and chain of MAX7219
+    mb_loopback_init(&mb_loopback_context);
+    mb_loopback_bh1750_init(&bh1750, MB_LOOPBACK_BH1750_ADDRESS_LOW);
+    mb_loopback_bh1750_set_lux(&bh1750, lux);
+    mb_loopback_add_i2c_device(&mb_loopback_context, &bh1750.device);
+    mb_loopback_max7219_init(&max7219, max7219_chip_select_gpio, NUM_MODULES);
+    mb_loopback_add_spi_device(&mb_loopback_context, &max7219.device);
+
+    // clients might disconnect while a response is written
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0){
+        perror("socket");
+        return 10;
+    }
+    int value = 1;
+    (void) setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(bridge_port);
+    if ((bind(listen_fd, (struct sockaddr *) &address, sizeof(address)) < 0) || (listen(listen_fd, 1) < 0)){
+        perror("bind");
+        return 10;
+    }
+    printf("Bridge simulator listening on port %u\n", bridge_port);
+
+    while (true){
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        (void) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+        printf("Client connected\n");
+        handle_client(fd);
+        close(fd);
+    }
+}
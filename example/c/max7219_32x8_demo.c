@@ -23,12 +23,13 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
+#include <string.h>
 
 #include "multibus_protocol.h"
 #include "multibus_serial_posix.h"
+#include "multibus_sync.h"
+#include "multibus_sync_protocol.h"
 #include "multibus_transport.h"
-#include "multibus_transport_protocol.h"
 #include "font8x8_basic.h"
 // This defines how many Max7219 modules we have cascaded together, in this case, we have 4 x 8x8 matrices giving a total of 32x8
 #define NUM_MODULES 4
@@ -49,33 +50,19 @@ static uint8_t framebuffer[NUM_MODULES * DISPLAY_HEIGHT];
 // static config
 static const char * multibus_bridge_path;
 static uint32_t     multibus_bridge_baudrate = 115200;
+static uint8_t      max7219_chip_select_gpio = 17;
+static uint32_t     multibus_timeout_ms = 1000;
+
+// write all lines with a single batch request if supported by the bridge
+static bool max7219_use_batch;
+#define MAX7219_WRITE_REQUEST_LEN (MB_HEADER_SIZE + 1 + 2 * NUM_MODULES)
 
 // transport instance
-static uint8_t request_buffer[30];
-static uint8_t response_buffer[20];
+static uint8_t request_buffer[MB_HEADER_SIZE + DISPLAY_HEIGHT * MAX7219_WRITE_REQUEST_LEN];
+static uint8_t response_buffer[64];
 static mb_transport_t mb_transport;
 static mb_serial_posix_context_t mb_serial_posix_context;
-
-// blocking API
-const mb_message_t * test_sync_message;
-
-void test_sync_callback_handler(void * context, const mb_message_t * message){
-    test_sync_message = message;
-}
-
-const mb_message_t * test_sync_wait_for_response(mb_transport_t * transport){
-    test_sync_message = NULL;
-    while (test_sync_message == NULL){
-        bool can_sleep = true;
-        can_sleep &= mb_serial_posix_process_read(&mb_serial_posix_context) == 0;
-        can_sleep &= mb_serial_posix_process_write(&mb_serial_posix_context) == 0;
-        if (can_sleep){
-            // sleep 10 ms if no processing is active
-            usleep(10 * 1000);
-        }
-    }
-    return test_sync_message;
-}
+static mb_sync_t mb_sync;
 
 // minimal framebuffer
 
@@ -112,30 +99,36 @@ static void fb_draw_text(uint16_t offset, const char * text, uint16_t text_len){
     }
 }
 
-static void max7219_write_register_all(mb_transport_t * transport, uint8_t address, uint8_t value){
+static void max7219_write_register_all(mb_sync_t * sync, uint8_t address, uint8_t value){
     uint8_t buf[2 * NUM_MODULES];
     uint16_t i;
     for (i = 0; i< NUM_MODULES;i++) {
         buf[2*i] = address;
         buf[2*i+1] = value;
     }
-    mb_transport_spi_master_write_request_send(transport, 0, sizeof(buf), buf);
-    (void) test_sync_wait_for_response(transport);
+    (void) mb_sync_spi_master_write(sync, 0, max7219_chip_select_gpio, sizeof(buf), buf);
 }
 
-static void max7219_update_framebuffer(mb_transport_t * transport){
+static void max7219_update_framebuffer(mb_sync_t * sync){
     uint8_t buf[2 * NUM_MODULES];
+    uint8_t requests[DISPLAY_HEIGHT * MAX7219_WRITE_REQUEST_LEN];
+    uint16_t requests_len = 0;
     uint16_t i;
     uint16_t j;
     for (i = 0; i<DISPLAY_HEIGHT ; i++){
         for (j = 0; j<NUM_MODULES; j++) {
-            uint8_t value = framebuffer[(i*NUM_MODULES) + j];
             buf[2*j]   = CMD_DIGIT0 + i;
             buf[2*j+1] = framebuffer[(i*NUM_MODULES) + j];
         }
-        printf("\n");
-        mb_transport_spi_master_write_request_send(transport, 0, sizeof(buf), buf);
-        (void) test_sync_wait_for_response(transport);
+        if (max7219_use_batch){
+            requests_len += mb_spi_master_write_request_setup(&requests[requests_len], sizeof(requests) - requests_len, 0,
+                                                              max7219_chip_select_gpio, sizeof(buf), buf);
+        } else {
+            (void) mb_sync_spi_master_write(sync, 0, max7219_chip_select_gpio, sizeof(buf), buf);
+        }
+    }
+    if (max7219_use_batch){
+        (void) mb_sync_batch_execute(sync, 0, requests_len, requests);
     }
 }
 
@@ -156,47 +149,50 @@ int main(int argc, const char **argv) {
     mb_transport_create(&mb_transport, driver_impl, &mb_serial_posix_context,
                         request_buffer, sizeof(request_buffer),
                         response_buffer, sizeof(response_buffer));
-    mb_transport_register_callback(&mb_transport, &test_sync_callback_handler, &mb_transport);
+    mb_sync_init(&mb_sync, &mb_transport, &mb_serial_posix_context, multibus_timeout_ms);
 
-    mb_transport_t * transport = &mb_transport;
+    mb_sync_t * sync = &mb_sync;
 
     // polling / synchronous API
     printf("Config SPI Master\n");
-    mb_transport_spi_master_config_request_send(transport,
-                                                0,
-                                                8,
-                                                MB_SPI_MASTER_CONFIG_REQUEST_BIT_ORDER_MSB_FIRST,
-                                                MB_SPI_MASTER_CONFIG_REQUEST_CPOL_0,
-                                                MB_SPI_MASTER_CONFIG_REQUEST_CPHA_0,
-                                                1000000);
-    (void) test_sync_wait_for_response(transport);
+    if (mb_sync_spi_master_config(sync,
+                                  0,
+                                  8,
+                                  MB_SPI_MASTER_CONFIG_REQUEST_BIT_ORDER_MSB_FIRST,
+                                  MB_SPI_MASTER_CONFIG_REQUEST_CPOL_0,
+                                  MB_SPI_MASTER_CONFIG_REQUEST_CPHA_0,
+                                  1000000) == NULL){
+        printf("Timeout\n");
+        return 10;
+    }
+
+    max7219_use_batch = mb_sync_bridge_supports_component(sync, MB_COMPONENT_BATCH);
+    printf("Batch requests %ssupported\n", max7219_use_batch ? "" : "not ");
 
     // config
-    max7219_write_register_all(transport, CMD_SHUTDOWN, 0);
-    max7219_write_register_all(transport, CMD_DISPLAYTEST, 0);
-    max7219_write_register_all(transport, CMD_SCANLIMIT, 7);  // Use all lines
-    max7219_write_register_all(transport, CMD_DECODEMODE, 0); // No BCD decode, just use bit pattern.
-    max7219_write_register_all(transport, CMD_SHUTDOWN, 1);
-    max7219_write_register_all(transport, CMD_BRIGHTNESS, 8);
+    max7219_write_register_all(sync, CMD_SHUTDOWN, 0);
+    max7219_write_register_all(sync, CMD_DISPLAYTEST, 0);
+    max7219_write_register_all(sync, CMD_SCANLIMIT, 7);  // Use all lines
+    max7219_write_register_all(sync, CMD_DECODEMODE, 0); // No BCD decode, just use bit pattern.
+    max7219_write_register_all(sync, CMD_SHUTDOWN, 1);
+    max7219_write_register_all(sync, CMD_BRIGHTNESS, 8);
 
     uint16_t i;
 
     // simple vertical scroller
     for (i=0; i<16; i++) {
         for (int j=0; j<8; j++) {
-            max7219_write_register_all(transport, CMD_DIGIT0+j, 1 << (i&7));
+            max7219_write_register_all(sync, CMD_DIGIT0+j, 1 << (i&7));
         }
-        mb_transport_bridge_delay_request_send(transport, 0, 20);
-        (void) test_sync_wait_for_response(transport);
+        (void) mb_sync_bridge_delay(sync, 0, 20);
     }
 
     // simple horizontal scroller
     for (i=0; i<16; i++) {
         for (int j=0; j<8; j++) {
-            max7219_write_register_all(transport, CMD_DIGIT0+j, ((i&7) == j) ? 255 : 0);
+            max7219_write_register_all(sync, CMD_DIGIT0+j, ((i&7) == j) ? 255 : 0);
         }
-        mb_transport_bridge_delay_request_send(transport, 0, 20);
-        (void) test_sync_wait_for_response(transport);
+        (void) mb_sync_bridge_delay(sync, 0, 20);
     }
 
     // chess board blinky
@@ -204,15 +200,14 @@ int main(int argc, const char **argv) {
     while (bright < 10) {
         for (i=0; i<8; i++) {
             if (bright & 1) {
-                max7219_write_register_all(transport, CMD_DIGIT0 + i, 170 >> (i%2));
+                max7219_write_register_all(sync, CMD_DIGIT0 + i, 170 >> (i%2));
             } else {
-                max7219_write_register_all(transport, CMD_DIGIT0 + i, (170 >> 1) << (i%2));
+                max7219_write_register_all(sync, CMD_DIGIT0 + i, (170 >> 1) << (i%2));
             }
         }
-        max7219_write_register_all(transport, CMD_BRIGHTNESS, bright % 16);
+        max7219_write_register_all(sync, CMD_BRIGHTNESS, bright % 16);
 
-        mb_transport_bridge_delay_request_send(transport, 0, 250);
-        (void) test_sync_wait_for_response(transport);
+        (void) mb_sync_bridge_delay(sync, 0, 250);
 
         bright++;
     }
@@ -224,9 +219,8 @@ int main(int argc, const char **argv) {
         for (i=0;i< (text_len * 8);i++){
             fb_clear();
             fb_draw_text(i, text, text_len);
-            max7219_update_framebuffer(transport);
-            mb_transport_bridge_delay_request_send(transport, 0, 100);
-            (void) test_sync_wait_for_response(transport);
+            max7219_update_framebuffer(sync);
+            (void) mb_sync_bridge_delay(sync, 0, 100);
         }
     }
 
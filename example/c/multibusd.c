@@ -0,0 +1,614 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "multibus_batch.h"
+#include "multibus_protocol.h"
+#include "multibus_sequencer.h"
+#include "multibus_serial_posix.h"
+#include "multibus_tcp_posix.h"
+#include "multibus_transport.h"
+
+// multibusd: bridge-sharing daemon
+//
+// Owns one or more bridges and accepts clients on a Unix domain socket per bridge. Complete requests of all clients
+// are passed to a pipelined transport in round-robin order, one request per client and round, and each response is
+// routed back to the client that sent the request. Clients use the regular protocol, e.g. via mb_tcp_posix_open_unix.
+//
+// The daemon selects protocol version 1 with the bridge, if supported, so that each request carries a tag chosen by the
+// transport. A response that arrives after its request timed out no longer matches a request of another client.
+// When the last client of a bridge disconnects, the protocol version is requested again, which starts a new session
+// on the bridge and removes the sampler jobs of the clients.
+
+#define MULTIBUSD_MAX_BRIDGES              8
+#define MULTIBUSD_MAX_CLIENTS             64
+#define MULTIBUSD_MAX_MESSAGE_LEN       1024
+// outstanding requests per bridge and per client
+#define MULTIBUSD_MAX_REQUESTS            16
+#define MULTIBUSD_MAX_REQUESTS_PER_CLIENT  4
+// timeout on top of the time the bridge needs to execute a request, e.g. a delay
+#define MULTIBUSD_TIMEOUT_MS            1000
+#define MULTIBUSD_MAX_DURATION_MS    1800000
+
+typedef struct multibusd_bridge multibusd_bridge_t;
+
+typedef struct {
+    bool in_use;
+    // -1 after client has closed the connection, slot is kept until all responses arrived
+    int  fd;
+    multibusd_bridge_t * bridge;
+    uint16_t num_pending;
+    // requests received from client
+    uint8_t  rx_buffer[2 * MULTIBUSD_MAX_MESSAGE_LEN];
+    uint16_t rx_len;
+    // responses to client, space for all outstanding requests is kept free
+    uint8_t  tx_buffer[(MULTIBUSD_MAX_REQUESTS_PER_CLIENT + 1) * MULTIBUSD_MAX_MESSAGE_LEN];
+    uint16_t tx_len;
+} multibusd_client_t;
+
+struct multibusd_bridge {
+    const char * path;
+    const char * socket_path;
+    int listen_fd;
+    // serial port or TCP connection
+    mb_serial_posix_context_t serial;
+    mb_tcp_posix_context_t    tcp;
+    mb_serial_posix_context_t * stream;
+    // pipelined transport
+    mb_transport_t transport;
+    mb_transport_request_t requests[MULTIBUSD_MAX_REQUESTS];
+    uint8_t send_buffer[MULTIBUSD_MAX_MESSAGE_LEN];
+    uint8_t receive_buffer[MULTIBUSD_MAX_MESSAGE_LEN];
+    uint8_t send_queue_storage[4 * MULTIBUSD_MAX_MESSAGE_LEN];
+    uint8_t receive_ring_storage[2 * MULTIBUSD_MAX_MESSAGE_LEN];
+    // requests of clients are passed on after protocol version has been selected
+    bool ready;
+    uint16_t protocol_version;
+    // last client disconnected, start new session
+    bool session_reset_pending;
+    // round-robin position
+    uint16_t next_client;
+};
+
+// static config
+static uint32_t multibusd_baudrate = 115200;
+
+static multibusd_bridge_t bridges[MULTIBUSD_MAX_BRIDGES];
+static uint16_t           num_bridges;
+static multibusd_client_t clients[MULTIBUSD_MAX_CLIENTS];
+static volatile sig_atomic_t multibusd_done;
+
+static void multibusd_signal_handler(int signal){
+    (void) signal;
+    multibusd_done = 1;
+}
+
+static void client_release(multibusd_client_t * client){
+    if ((client->fd < 0) && (client->num_pending == 0)){
+        client->in_use = false;
+    }
+}
+
+static void client_close(multibusd_client_t * client){
+    close(client->fd);
+    client->fd = -1;
+    client->rx_len = 0;
+    client->tx_len = 0;
+    client_release(client);
+    // sampler jobs are not tracked per client, remove them with the last client
+    multibusd_bridge_t * bridge = client->bridge;
+    uint16_t i;
+    for (i = 0; i < MULTIBUSD_MAX_CLIENTS; i++){
+        if (clients[i].in_use && (clients[i].bridge == bridge) && (clients[i].fd >= 0)) return;
+    }
+    bridge->session_reset_pending = true;
+}
+
+static void client_flush(multibusd_client_t * client){
+    if ((client->fd < 0) || (client->tx_len == 0)) return;
+    ssize_t bytes_written = write(client->fd, client->tx_buffer, client->tx_len);
+    if (bytes_written < 0){
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK)){
+            client_close(client);
+        }
+        return;
+    }
+    client->tx_len -= (uint16_t) bytes_written;
+    memmove(client->tx_buffer, &client->tx_buffer[bytes_written], client->tx_len);
+}
+
+// response of bridge for request of client
+static void client_response_handler(void * context, const mb_message_t * message){
+    multibusd_client_t * client = (multibusd_client_t * ) context;
+    client->num_pending--;
+    if (client->fd < 0){
+        client_release(client);
+        return;
+    }
+    uint16_t message_len = MB_HEADER_SIZE + message->payload_len;
+    if ((message_len > MULTIBUSD_MAX_MESSAGE_LEN) || ((client->tx_len + message_len) > sizeof(client->tx_buffer))){
+        printf("%s: dropping response of %u bytes\n", client->bridge->path, message_len);
+        return;
+    }
+    mb_header_setup(&client->tx_buffer[client->tx_len], message->component, message->operation, message->channel,
+                    message->payload_len);
+    memcpy(&client->tx_buffer[client->tx_len + MB_HEADER_SIZE], message->payload_data, message->payload_len);
+    client->tx_len += message_len;
+    client_flush(client);
+}
+
+// event of bridge, e.g. sampler samples: passed to all clients of the bridge, as jobs are not tracked per client
+static void client_send_event(multibusd_client_t * client, const mb_message_t * message){
+    uint16_t message_len = MB_HEADER_SIZE + message->payload_len;
+    // keep space for responses of all outstanding requests, drop event for slow clients
+    uint32_t tx_reserved = client->tx_len + message_len + (uint32_t) client->num_pending * MULTIBUSD_MAX_MESSAGE_LEN;
+    if (tx_reserved > sizeof(client->tx_buffer)){
+        printf("%s: dropping event for client\n", client->bridge->path);
+        return;
+    }
+    mb_header_setup(&client->tx_buffer[client->tx_len], message->component, message->operation, message->channel,
+                    message->payload_len);
+    memcpy(&client->tx_buffer[client->tx_len + MB_HEADER_SIZE], message->payload_data, message->payload_len);
+    client->tx_len += message_len;
+    client_flush(client);
+}
+
+// event, late response after timeout, or unsolicited message
+static void bridge_callback_handler(void * context, const mb_message_t * message){
+    multibusd_bridge_t * bridge = (multibusd_bridge_t *) context;
+    if (mb_message_is_event(message)){
+        uint16_t i;
+        for (i = 0; i < MULTIBUSD_MAX_CLIENTS; i++){
+            multibusd_client_t * client = &clients[i];
+            if ((client->in_use == false) || (client->bridge != bridge) || (client->fd < 0)) continue;
+            client_send_event(client, message);
+        }
+        return;
+    }
+    printf("%s: dropping unexpected message, component %u, operation %u\n", bridge->path, message->component,
+           message->operation);
+}
+
+// response to protocol version request of the daemon
+static void bridge_version_handler(void * context, const mb_message_t * message){
+    multibusd_bridge_t * bridge = (multibusd_bridge_t *) context;
+    if (bridge->ready) return;
+    uint16_t protocol_version = 0;
+    if ((message->operation == MB_OPERATION_BRIDGE_PROTOCOL_VERSION_RESPONSE) && (message->payload_len >= 2) &&
+        (mb_message_bridge_protocol_version_response_get_version(message) >= MB_TRAILER_VERSION)){
+        // bridge uses requested version for all following messages
+        protocol_version = MB_TRAILER_VERSION;
+        mb_transport_set_protocol_version(&bridge->transport, protocol_version);
+    }
+    printf("%s: protocol version %u\n", bridge->path, protocol_version);
+    bridge->protocol_version = protocol_version;
+    bridge->ready = true;
+}
+
+static void bridge_timeout_handler(void * context, const mb_transport_request_t * request){
+    multibusd_bridge_t * bridge = (multibusd_bridge_t *) context;
+    printf("%s: no response for component %u, operation %u\n", bridge->path, request->component, request->operation);
+    if (request->callback_handler == &bridge_version_handler){
+        // bridge without protocol version request, continue with untagged messages
+        if (bridge->ready == false){
+            printf("%s: protocol version 0\n", bridge->path);
+            bridge->ready = true;
+        }
+        return;
+    }
+    // client will notice the timeout on its own
+    multibusd_client_t * client = (multibusd_client_t *) request->callback_context;
+    client->num_pending--;
+    client_release(client);
+}
+
+// get length of complete request at start of receive buffer, 0 if incomplete
+static uint16_t client_get_request_len(multibusd_client_t * client){
+    if (client->rx_len < MB_HEADER_SIZE) return 0;
+    uint16_t request_len = MB_HEADER_SIZE + mb_header_get_length(client->rx_buffer);
+    if (client->rx_len < request_len) return 0;
+    return request_len;
+}
+
+static bool client_can_send(multibusd_client_t * client){
+    if (client->fd < 0) return false;
+    if (client->num_pending >= MULTIBUSD_MAX_REQUESTS_PER_CLIENT) return false;
+    // keep space for responses of all outstanding requests
+    uint32_t tx_reserved = client->tx_len + (uint32_t) (client->num_pending + 1) * MULTIBUSD_MAX_MESSAGE_LEN;
+    if (tx_reserved > sizeof(client->tx_buffer)) return false;
+    return client_get_request_len(client) > 0;
+}
+
+// time the bridge needs to execute a request, in addition to the regular timeout
+static uint32_t bridge_get_request_duration_ms(uint8_t component, uint8_t operation, const uint8_t * payload,
+                                               uint16_t payload_len){
+    uint32_t duration_ms = 0;
+    switch (component){
+        case MB_COMPONENT_BRIDGE:
+            if ((operation == MB_OPERATION_BRIDGE_DELAY_REQUEST) && (payload_len >= 4)){
+                duration_ms = mb_bridge_delay_request_get_timeout_ms(payload);
+            }
+            break;
+        case MB_COMPONENT_SEQUENCER:
+            // total delay of a program is limited during verification
+            duration_ms = MB_SEQUENCER_MAX_TOTAL_DELAY_MS;
+            break;
+        case MB_COMPONENT_BATCH:
+            if (operation == MB_OPERATION_BATCH_EXECUTE_REQUEST){
+                mb_batch_iterator_t iterator;
+                mb_message_t request;
+                mb_batch_iterator_init(&iterator, mb_batch_execute_request_get_requests(payload),
+                                       mb_batch_execute_request_get_requests_len(payload_len));
+                while (mb_batch_iterator_next(&iterator, &request)){
+                    duration_ms += bridge_get_request_duration_ms(request.component, request.operation,
+                                                                  request.payload_data, request.payload_len);
+                    if (duration_ms > MULTIBUSD_MAX_DURATION_MS) break;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+    if (duration_ms > MULTIBUSD_MAX_DURATION_MS){
+        duration_ms = MULTIBUSD_MAX_DURATION_MS;
+    }
+    return duration_ms;
+}
+
+// requests that change the link to the bridge are answered by the daemon and never forwarded, returns true if handled
+static bool client_handle_local_request(multibusd_client_t * client, uint16_t request_len){
+    const uint8_t * request = client->rx_buffer;
+    if (mb_header_get_component(request) != MB_COMPONENT_BRIDGE) return false;
+    uint8_t  channel = mb_header_get_channel(request);
+    uint8_t * response = &client->tx_buffer[client->tx_len];
+    uint16_t response_size = (uint16_t) (sizeof(client->tx_buffer) - client->tx_len);
+    uint16_t response_len;
+    mb_status_t status;
+    switch (mb_header_get_operation(request)){
+        case MB_OPERATION_BRIDGE_FRAMING_REQUEST:
+            // the Unix domain socket is reliable, framing of the bridge link is owned by the daemon
+            status = MB_STATUS_INVALID_ARGUMENTS;
+            if ((request_len > MB_HEADER_SIZE) &&
+                (mb_bridge_framing_request_get_mode(&request[MB_HEADER_SIZE]) == MB_BRIDGE_FRAMING_REQUEST_MODE_NONE)){
+                status = MB_STATUS_OK;
+            }
+            response_len = mb_bridge_framing_response_setup(response, response_size, channel, status);
+            break;
+        case MB_OPERATION_BRIDGE_PROTOCOL_VERSION_REQUEST:
+            // the protocol version of the bridge link is owned by the daemon, clients use untagged messages
+            response_len = mb_bridge_protocol_version_response_setup(response, response_size, channel, 0);
+            break;
+        default:
+            return false;
+    }
+    client->tx_len += response_len;
+    return true;
+}
+
+// select protocol version, starts new session on the bridge if already selected
+static bool bridge_send_version_request(multibusd_bridge_t * bridge, uint16_t protocol_version){
+    uint8_t request[MB_HEADER_SIZE + 2];
+    uint16_t request_len = mb_bridge_protocol_version_request_setup(request, sizeof(request), 0, protocol_version);
+    mb_transport_set_next_request_timeout(&bridge->transport, MULTIBUSD_TIMEOUT_MS);
+    return mb_transport_send_request(&bridge->transport, request, request_len, &bridge_version_handler, bridge);
+}
+
+// fair queueing: pass one request per client and round to the bridge until transport or clients are exhausted
+static void bridge_schedule(multibusd_bridge_t * bridge){
+    if (bridge->ready == false) return;
+    if (bridge->session_reset_pending){
+        // keep protocol version, removes all sampler jobs
+        if (bridge_send_version_request(bridge, bridge->protocol_version) == false) return;
+        bridge->session_reset_pending = false;
+    }
+    mb_transport_cork(&bridge->transport);
+    bool request_sent = true;
+    while (request_sent){
+        request_sent = false;
+        uint16_t i;
+        for (i = 0; i < MULTIBUSD_MAX_CLIENTS; i++){
+            uint16_t index = (bridge->next_client + i) % MULTIBUSD_MAX_CLIENTS;
+            multibusd_client_t * client = &clients[index];
+            if ((client->in_use == false) || (client->bridge != bridge)) continue;
+            if (client_can_send(client) == false) continue;
+            uint16_t request_len = client_get_request_len(client);
+            if (client_handle_local_request(client, request_len)){
+                client->rx_len -= request_len;
+                memmove(client->rx_buffer, &client->rx_buffer[request_len], client->rx_len);
+                client_flush(client);
+                request_sent = true;
+                continue;
+            }
+            uint32_t duration_ms = bridge_get_request_duration_ms(mb_header_get_component(client->rx_buffer),
+                                                                  mb_header_get_operation(client->rx_buffer),
+                                                                  &client->rx_buffer[MB_HEADER_SIZE],
+                                                                  request_len - MB_HEADER_SIZE);
+            mb_transport_set_next_request_timeout(&bridge->transport, MULTIBUSD_TIMEOUT_MS + duration_ms);
+            if (mb_transport_send_request(&bridge->transport, client->rx_buffer, request_len,
+                                          &client_response_handler, client) == false){
+                // transport full, continue with this client next time
+                bridge->next_client = index;
+                mb_transport_uncork(&bridge->transport);
+                return;
+            }
+            client->num_pending++;
+            client->rx_len -= request_len;
+            memmove(client->rx_buffer, &client->rx_buffer[request_len], client->rx_len);
+            bridge->next_client = (index + 1) % MULTIBUSD_MAX_CLIENTS;
+            request_sent = true;
+        }
+    }
+    mb_transport_uncork(&bridge->transport);
+}
+
+static void bridge_accept(multibusd_bridge_t * bridge){
+    int fd = accept(bridge->listen_fd, NULL, NULL);
+    if (fd < 0) return;
+    uint16_t i;
+    for (i = 0; i < MULTIBUSD_MAX_CLIENTS; i++){
+        if (clients[i].in_use == false) break;
+    }
+    if (i == MULTIBUSD_MAX_CLIENTS){
+        printf("%s: too many clients\n", bridge->path);
+        close(fd);
+        return;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    (void) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    multibusd_client_t * client = &clients[i];
+    memset(client, 0, sizeof(multibusd_client_t));
+    client->in_use = true;
+    client->fd = fd;
+    client->bridge = bridge;
+}
+
+static void client_read(multibusd_client_t * client){
+    ssize_t bytes_read = read(client->fd, &client->rx_buffer[client->rx_len], sizeof(client->rx_buffer) - client->rx_len);
+    if (bytes_read < 0){
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK)){
+            client_close(client);
+        }
+        return;
+    }
+    if (bytes_read == 0){
+        client_close(client);
+        return;
+    }
+    client->rx_len += (uint16_t) bytes_read;
+    if ((client->rx_len >= MB_HEADER_SIZE) &&
+        ((MB_HEADER_SIZE + mb_header_get_length(client->rx_buffer)) > MULTIBUSD_MAX_MESSAGE_LEN)){
+        printf("%s: request too large, closing client\n", client->bridge->path);
+        client_close(client);
+    }
+}
+
+static bool bridge_open(multibusd_bridge_t * bridge){
+    // bridge: serial port or host:port
+    const char * port_separator = strrchr(bridge->path, ':');
+    if (port_separator != NULL){
+        char host[256];
+        size_t host_len = (size_t) (port_separator - bridge->path);
+        if (host_len >= sizeof(host)) return false;
+        memcpy(host, bridge->path, host_len);
+        host[host_len] = 0;
+        if (mb_tcp_posix_open(&bridge->tcp, host, (uint16_t) atoi(port_separator + 1)) == false) return false;
+        bridge->stream = mb_tcp_posix_get_stream(&bridge->tcp);
+        mb_transport_create(&bridge->transport, mb_tcp_posix_get_driver(), &bridge->tcp,
+                            bridge->send_buffer, sizeof(bridge->send_buffer),
+                            bridge->receive_buffer, sizeof(bridge->receive_buffer));
+    } else {
+        // readiness probe resets protocol version and framing left by a previous session
+        mb_serial_posix_config_t config;
+        memset(&config, 0, sizeof(config));
+        config.baudrate = multibusd_baudrate;
+        if (mb_serial_posix_open_async(&bridge->serial, bridge->path, &config) == false) return false;
+        mb_serial_posix_context_t * serial = &bridge->serial;
+        if (mb_serial_posix_wait_ready(&serial, 1) == false){
+            mb_serial_posix_close(&bridge->serial);
+            return false;
+        }
+        bridge->stream = &bridge->serial;
+        mb_transport_create(&bridge->transport, mb_serial_posix_get_driver(), &bridge->serial,
+                            bridge->send_buffer, sizeof(bridge->send_buffer),
+                            bridge->receive_buffer, sizeof(bridge->receive_buffer));
+    }
+    mb_transport_enable_pipelining(&bridge->transport, bridge->requests, MULTIBUSD_MAX_REQUESTS,
+                                   bridge->send_queue_storage, sizeof(bridge->send_queue_storage));
+    mb_transport_enable_receive_ring(&bridge->transport, bridge->receive_ring_storage, sizeof(bridge->receive_ring_storage));
+    mb_transport_set_time_source(&bridge->transport, &mb_serial_posix_get_time_us);
+    mb_transport_enable_timeouts(&bridge->transport, MULTIBUSD_TIMEOUT_MS, 0, &bridge_timeout_handler, bridge);
+    mb_transport_register_callback(&bridge->transport, &bridge_callback_handler, bridge);
+
+    // select protocol version with tags, sent untagged as the bridge might still use version 0
+    if (bridge_send_version_request(bridge, MB_TRAILER_VERSION) == false) return false;
+
+    // listen on Unix domain socket, replace stale socket file
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(bridge->socket_path) >= sizeof(address.sun_path)) return false;
+    strcpy(address.sun_path, bridge->socket_path);
+    (void) unlink(bridge->socket_path);
+    bridge->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (bridge->listen_fd < 0) return false;
+    if (bind(bridge->listen_fd, (struct sockaddr *) &address, sizeof(address)) < 0) return false;
+    if (listen(bridge->listen_fd, 16) < 0) return false;
+    int flags = fcntl(bridge->listen_fd, F_GETFL, 0);
+    (void) fcntl(bridge->listen_fd, F_SETFL, flags | O_NONBLOCK);
+    return true;
+}
+
+static void bridge_close(multibusd_bridge_t * bridge){
+    if (bridge->listen_fd >= 0){
+        close(bridge->listen_fd);
+        (void) unlink(bridge->socket_path);
+    }
+    if (bridge->stream != NULL){
+        mb_serial_posix_close(bridge->stream);
+    }
+}
+
+static void multibusd_run(void){
+    struct pollfd fds[2 * MULTIBUSD_MAX_BRIDGES + MULTIBUSD_MAX_CLIENTS];
+    multibusd_client_t * fd_clients[MULTIBUSD_MAX_CLIENTS];
+    while (multibusd_done == 0){
+        // collect file descriptors and next timeout
+        nfds_t num_fds = 0;
+        int timeout_ms = -1;
+        uint16_t i;
+        for (i = 0; i < num_bridges; i++){
+            multibusd_bridge_t * bridge = &bridges[i];
+            fds[num_fds].fd = bridge->listen_fd;
+            fds[num_fds].events = POLLIN;
+            num_fds++;
+            fds[num_fds].fd = mb_serial_posix_get_file_descriptor(bridge->stream);
+            fds[num_fds].events = POLLIN;
+            if (mb_serial_posix_write_active(bridge->stream)){
+                fds[num_fds].events |= POLLOUT;
+            }
+            num_fds++;
+            uint32_t bridge_timeout_ms = mb_transport_get_next_timeout_ms(&bridge->transport);
+            if ((bridge_timeout_ms != MB_TRANSPORT_NO_TIMEOUT) && ((timeout_ms < 0) || (bridge_timeout_ms < (uint32_t) timeout_ms))){
+                timeout_ms = (int) bridge_timeout_ms;
+            }
+        }
+        uint16_t num_fd_clients = 0;
+        for (i = 0; i < MULTIBUSD_MAX_CLIENTS; i++){
+            multibusd_client_t * client = &clients[i];
+            if ((client->in_use == false) || (client->fd < 0)) continue;
+            fds[num_fds].fd = client->fd;
+            fds[num_fds].events = 0;
+            if (client->rx_len < sizeof(client->rx_buffer)){
+                fds[num_fds].events |= POLLIN;
+            }
+            if (client->tx_len > 0){
+                fds[num_fds].events |= POLLOUT;
+            }
+            fd_clients[num_fd_clients++] = client;
+            num_fds++;
+        }
+
+        int res = poll(fds, num_fds, timeout_ms);
+        if ((res < 0) && (errno != EINTR)){
+            perror("poll");
+            return;
+        }
+
+        // bridges
+        for (i = 0; i < num_bridges; i++){
+            multibusd_bridge_t * bridge = &bridges[i];
+            if (fds[2*i].revents & POLLIN){
+                bridge_accept(bridge);
+            }
+            short revents = fds[2*i+1].revents;
+            if (revents & (POLLERR | POLLHUP | POLLNVAL)){
+                printf("%s: connection to bridge lost\n", bridge->path);
+                return;
+            }
+            if (revents & POLLOUT){
+                (void) mb_serial_posix_process_write(bridge->stream);
+            }
+            if (revents & POLLIN){
+                (void) mb_serial_posix_process_read(bridge->stream);
+            }
+            mb_transport_process_timeouts(&bridge->transport);
+        }
+
+        // clients
+        for (i = 0; i < num_fd_clients; i++){
+            multibusd_client_t * client = fd_clients[i];
+            short revents = fds[2 * num_bridges + i].revents;
+            if ((revents & POLLOUT) && (client->fd >= 0)){
+                client_flush(client);
+            }
+            if ((revents & (POLLIN | POLLHUP | POLLERR)) && (client->fd >= 0)){
+                client_read(client);
+            }
+        }
+
+        for (i = 0; i < num_bridges; i++){
+            bridge_schedule(&bridges[i]);
+        }
+    }
+}
+
+static void usage(const char * name){
+    printf("Usage: %s [-b baudrate] <bridge> <socket path> [<bridge> <socket path> ...]\n", name);
+    printf("bridge: serial port, e.g. /dev/ttyUSB0, or host:port of a network bridge\n");
+}
+
+int main(int argc, const char **argv) {
+    int arg = 1;
+    if ((argc > 2) && (strcmp(argv[1], "-b") == 0)){
+        multibusd_baudrate = (uint32_t) atoi(argv[2]);
+        arg = 3;
+    }
+    if (((argc - arg) < 2) || (((argc - arg) & 1) != 0) || (((argc - arg) / 2) > MULTIBUSD_MAX_BRIDGES)){
+        usage(argv[0]);
+        return 10;
+    }
+
+    // clients and TCP bridges might close their connection
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, &multibusd_signal_handler);
+    signal(SIGTERM, &multibusd_signal_handler);
+
+    int result = 0;
+    for (; arg < argc; arg += 2){
+        multibusd_bridge_t * bridge = &bridges[num_bridges++];
+        bridge->path = argv[arg];
+        bridge->socket_path = argv[arg + 1];
+        bridge->listen_fd = -1;
+        if (bridge_open(bridge) == false){
+            printf("Failed to open bridge %s on %s\n", bridge->path, bridge->socket_path);
+            result = 10;
+            break;
+        }
+        printf("Sharing %s on %s\n", bridge->path, bridge->socket_path);
+    }
+
+    if (result == 0){
+        multibusd_run();
+    }
+
+    uint16_t i;
+    for (i = 0; i < MULTIBUSD_MAX_CLIENTS; i++){
+        if (clients[i].in_use && (clients[i].fd >= 0)){
+            close(clients[i].fd);
+        }
+    }
+    for (i = 0; i < num_bridges; i++){
+        bridge_close(&bridges[i]);
+    }
+    return result;
+}
@@ -67,7 +67,7 @@ static void async_callback(void * context, const mb_message_t * message) {
         case APP_W2_GET_PROTOCOL:
             printf("Get protocol version\n");
             app_state = APP_W4_GET_PROTOCOL;
-            mb_transport_bridge_protocol_version_request_send(transport, 0);
+            mb_transport_bridge_protocol_version_request_send(transport, 0, 0);
             break;
         case APP_W4_GET_PROTOCOL:
             printf("Protocol Version: 0x%x\n", mb_message_bridge_protocol_version_response_get_version(message));
@@ -0,0 +1,216 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "multibus_loopback.h"
+#include "multibus_loopback_devices.h"
+#include "multibus_protocol.h"
+#include "multibus_serial_posix.h"
+#include "multibus_transport.h"
+#include "multibus_transport_protocol.h"
+
+// negotiates COBS framing with the in-process loopback bridge and corrupts the responses on purpose.
+// corrupted frames are dropped by the transport and the requests are sent again after a timeout.
+
+#define BH1750_ONE_TIME_L_RES 0x23
+#define BH1750_LUX            500
+
+#define TIMEOUT_MS  5
+#define NUM_RETRIES 3
+
+// static config
+static uint32_t num_iterations = 10000;
+// corrupt one out of corruption_rate bytes
+static uint32_t corruption_rate = 1000;
+
+// transport instance
+static uint8_t request_buffer[300];
+static uint8_t response_buffer[300];
+static uint8_t send_queue_storage[1024];
+static uint8_t receive_ring_storage[1024];
+static mb_transport_request_t requests[8];
+static mb_transport_t mb_transport;
+static mb_transport_stats_t mb_transport_stats;
+
+// virtual bridge
+static mb_loopback_context_t mb_loopback_context;
+static mb_loopback_bh1750_t  bh1750;
+
+// driver wrapper that flips or drops received bytes
+static mb_driver_t corrupting_driver;
+static void (*bytes_received_handler)(void * context, uint16_t num_bytes);
+static void * bytes_received_context;
+static uint8_t * receive_buffer;
+static bool     corruption_enabled;
+static uint32_t num_flipped_bytes;
+static uint32_t num_dropped_bytes;
+
+static bool     framing_ready;
+static uint32_t num_responses;
+static uint32_t num_errors;
+static uint32_t num_timeouts;
+
+static void corrupting_driver_bytes_received(void * context, uint16_t num_bytes){
+    (void) context;
+    uint16_t i = 0;
+    while (corruption_enabled && (i < num_bytes)){
+        if ((uint32_t) (rand() % corruption_rate) != 0){
+            i++;
+            continue;
+        }
+        if (rand() & 1){
+            receive_buffer[i] ^= (uint8_t) (1 + rand() % 255);
+            num_flipped_bytes++;
+            i++;
+        } else {
+            memmove(&receive_buffer[i], &receive_buffer[i + 1], num_bytes - i - 1);
+            num_bytes--;
+            num_dropped_bytes++;
+        }
+    }
+    bytes_received_handler(bytes_received_context, num_bytes);
+}
+
+static void corrupting_driver_set_bytes_received(void * driver_context, void (*bytes_handler)(void * context, uint16_t num_bytes),
+                                                 void * callback_context){
+    bytes_received_handler = bytes_handler;
+    bytes_received_context = callback_context;
+    mb_loopback_get_driver()->set_bytes_received(driver_context, &corrupting_driver_bytes_received, NULL);
+}
+
+static void corrupting_driver_receive_bytes(void * driver_context, uint8_t * buffer, uint16_t max_length){
+    receive_buffer = buffer;
+    mb_loopback_get_driver()->receive_bytes(driver_context, buffer, max_length);
+}
+
+static void timeout_handler(void * context, const mb_transport_request_t * request){
+    (void) context;
+    (void) request;
+    num_timeouts++;
+}
+
+static void callback_handler(void * context, const mb_message_t * message){
+    (void) context;
+    num_responses++;
+    uint8_t status = MB_STATUS_OK;
+    if (mb_message_get_status(message, &status) && (status != MB_STATUS_OK)){
+        num_errors++;
+    }
+    switch (message->component){
+        case MB_COMPONENT_BRIDGE:
+            if ((message->operation == MB_OPERATION_BRIDGE_FRAMING_RESPONSE) && (status == MB_STATUS_OK)){
+                // bridge uses new framing for all following messages
+                mb_transport_set_framing(&mb_transport, MB_BRIDGE_FRAMING_REQUEST_MODE_COBS_CRC16);
+                framing_ready = true;
+            }
+            break;
+        case MB_COMPONENT_I2C_MASTER:
+            if (message->operation == MB_OPERATION_I2C_MASTER_READ_RESPONSE){
+                const uint8_t * data = mb_message_i2c_master_read_response_get_data(message);
+                uint16_t measurement = (data[0] << 8) | data[1];
+                if (measurement != ((BH1750_LUX * 12) / 10)){
+                    num_errors++;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// process loopback bridge and timeouts until condition is met
+#define PROCESS_UNTIL(CONDITION) do { while ((CONDITION) == false) { \
+    if (mb_loopback_process(&mb_loopback_context) == false) { mb_transport_process_timeouts(&mb_transport); } } } while (0)
+
+int main(int argc, const char **argv) {
+    if (argc > 1){
+        num_iterations = (uint32_t) atoi(argv[1]);
+    }
+    if (argc > 2){
+        corruption_rate = (uint32_t) atoi(argv[2]);
+    }
+    if (corruption_rate == 0){
+        corruption_rate = 1;
+    }
+    srand(1);
+
+    // setup virtual bridge with BH1750
+    mb_loopback_init(&mb_loopback_context);
+    mb_loopback_bh1750_init(&bh1750, MB_LOOPBACK_BH1750_ADDRESS_LOW);
+    mb_loopback_bh1750_set_lux(&bh1750, BH1750_LUX);
+    mb_loopback_add_i2c_device(&mb_loopback_context, &bh1750.device);
+
+    // setup transport interface with corrupting driver
+    corrupting_driver = *mb_loopback_get_driver();
+    corrupting_driver.set_bytes_received = &corrupting_driver_set_bytes_received;
+    corrupting_driver.receive_bytes      = &corrupting_driver_receive_bytes;
+    mb_transport_create(&mb_transport, &corrupting_driver, &mb_loopback_context,
+                        request_buffer, sizeof(request_buffer),
+                        response_buffer, sizeof(response_buffer));
+    mb_transport_enable_pipelining(&mb_transport, requests, sizeof(requests) / sizeof(mb_transport_request_t),
+                                   send_queue_storage, sizeof(send_queue_storage));
+    mb_transport_enable_receive_ring(&mb_transport, receive_ring_storage, sizeof(receive_ring_storage));
+    mb_transport_set_time_source(&mb_transport, &mb_serial_posix_get_time_us);
+    mb_transport_enable_timeouts(&mb_transport, TIMEOUT_MS, NUM_RETRIES, &timeout_handler, NULL);
+    mb_transport_enable_stats(&mb_transport, &mb_transport_stats);
+    mb_transport_register_callback(&mb_transport, &callback_handler, NULL);
+
+    // negotiate framing, then start corrupting
+    PROCESS_UNTIL(mb_transport_bridge_framing_request_send(&mb_transport, 0, MB_BRIDGE_FRAMING_REQUEST_MODE_COBS_CRC16));
+    PROCESS_UNTIL(framing_ready || (num_timeouts > 0));
+    if (framing_ready == false){
+        printf("Bridge does not support framing\n");
+        return 1;
+    }
+    corruption_enabled = true;
+
+    // config
+    PROCESS_UNTIL(mb_transport_i2c_master_config_request_send(&mb_transport, 0, MB_I2C_MASTER_CONFIG_REQUEST_CLOCK_SPEED_400_KHZ,
+                                                              false, false));
+
+    // each iteration: trigger and read BH1750 measurement
+    uint8_t bh1750_mode = BH1750_ONE_TIME_L_RES;
+    uint32_t start_us = mb_serial_posix_get_time_us();
+    uint32_t iteration;
+    for (iteration = 0; iteration < num_iterations; iteration++){
+        PROCESS_UNTIL(mb_transport_i2c_master_write_request_send(&mb_transport, 0, MB_LOOPBACK_BH1750_ADDRESS_LOW, 1, &bh1750_mode));
+        PROCESS_UNTIL(mb_transport_i2c_master_read_request_send(&mb_transport, 0, MB_LOOPBACK_BH1750_ADDRESS_LOW, 2));
+    }
+    PROCESS_UNTIL(mb_transport_get_num_pending_requests(&mb_transport) == 0);
+    uint32_t duration_us = mb_serial_posix_get_time_us() - start_us;
+
+    uint32_t num_requests = 2 + 2 * num_iterations;
+    printf("Requests:       %u\n", num_requests);
+    printf("Responses:      %u\n", num_responses);
+    printf("Errors:         %u\n", num_errors);
+    printf("Flipped bytes:  %u\n", num_flipped_bytes);
+    printf("Dropped bytes:  %u\n", num_dropped_bytes);
+    printf("Framing errors: %u\n", mb_transport_stats.framing_errors);
+    printf("Retries:        %u\n", mb_transport_stats.retries);
+    printf("Timeouts:       %u\n", num_timeouts);
+    printf("Duration:       %u us\n", duration_us);
+    return (num_errors == 0 && num_timeouts == 0 && num_responses == num_requests) ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "multibus_protocol.h"
+#include "multibus_runloop.h"
+#include "multibus_serial_posix.h"
+#include "multibus_transport.h"
+#include "multibus_transport_protocol.h"
+
+// reads the lux sensor on all bridges given on the command line using a single mb_runloop
+
+#define MAX_BRIDGES 16
+
+// static config
+static uint32_t     multibus_bridge_baudrate = 115200;
+static uint8_t      i2c_master_channel = 0;
+static uint8_t      i2c_master_clock_speed = MB_I2C_MASTER_CONFIG_REQUEST_CLOCK_SPEED_100_KHZ;
+static uint8_t      i2c_master_pullups_enabled = 1;
+static uint8_t      lux_sensor_address = 0x23;
+static const uint8_t lux_sensor_config = 0x23;
+
+// app state
+typedef enum {
+    APP_W4_I2C_READY,
+    APP_W4_LUX_CONFIGURED,
+    APP_W4_LUX_DELAY,
+    APP_W4_I2C_LUX,
+    APP_DONE,
+} app_state_t;
+
+// bridge instance
+typedef struct {
+    const char * path;
+    uint8_t request_buffer[20];
+    uint8_t response_buffer[20];
+    mb_transport_t mb_transport;
+    mb_serial_posix_context_t mb_serial_posix_context;
+    mb_runloop_source_t source;
+    app_state_t app_state;
+} bridge_t;
+
+static bridge_t bridges[MAX_BRIDGES];
+static uint16_t num_bridges_active;
+static mb_runloop_t mb_runloop;
+
+static void bridge_done(bridge_t * bridge){
+    bridge->app_state = APP_DONE;
+    num_bridges_active--;
+    if (num_bridges_active == 0){
+        mb_runloop_stop(&mb_runloop);
+    }
+}
+
+static void async_callback(void * context, const mb_message_t * message) {
+    bridge_t * bridge = (bridge_t *) context;
+    mb_transport_t * transport = &bridge->mb_transport;
+    const uint8_t * i2c_read_data;
+    switch(bridge->app_state){
+        case APP_W4_I2C_READY:
+            bridge->app_state = APP_W4_LUX_CONFIGURED;
+            mb_transport_i2c_master_write_request_send(transport, i2c_master_channel, lux_sensor_address, 1, &lux_sensor_config);
+            break;
+        case APP_W4_LUX_CONFIGURED:
+            bridge->app_state = APP_W4_LUX_DELAY;
+            mb_transport_bridge_delay_request_send(transport, 0, 30);
+            break;
+        case APP_W4_LUX_DELAY:
+            bridge->app_state = APP_W4_I2C_LUX;
+            mb_transport_i2c_master_read_request_send(transport, i2c_master_channel, lux_sensor_address, 2);
+            break;
+        case APP_W4_I2C_LUX:
+            i2c_read_data = mb_message_i2c_master_read_response_get_data(message);
+            printf("%s: Lux %f\n", bridge->path, (i2c_read_data[0] << 8 | i2c_read_data[1]) / 1.2);
+            bridge_done(bridge);
+            break;
+        default:
+            break;
+    }
+}
+
+static void bridge_closed(void * context){
+    bridge_t * bridge = (bridge_t *) context;
+    printf("%s: closed\n", bridge->path);
+    bridge_done(bridge);
+}
+
+int main(int argc, const char **argv) {
+    // get bridge paths
+    if ((argc < 2) || (argc > (MAX_BRIDGES + 1))){
+        printf("Usage: %s <path to serial port> [<path to serial port> ...]\n", argv[0]);
+        exit(10);
+    }
+
+    if (mb_runloop_init(&mb_runloop) == false) return 10;
+
+    // open all bridges in parallel and wait until they respond
+    mb_serial_posix_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.baudrate = multibus_bridge_baudrate;
+    mb_serial_posix_context_t * serial_contexts[MAX_BRIDGES];
+    int i;
+    for (i = 1; i < argc; i++){
+        bridge_t * bridge = &bridges[i - 1];
+        bridge->path = argv[i];
+        bool ok = mb_serial_posix_open_async(&bridge->mb_serial_posix_context, bridge->path, &config);
+        if (!ok) return 10;
+        serial_contexts[i - 1] = &bridge->mb_serial_posix_context;
+    }
+    if (mb_serial_posix_wait_ready(serial_contexts, (uint16_t) (argc - 1)) == false){
+        printf("Not all bridges responded\n");
+        return 10;
+    }
+
+    for (i = 1; i < argc; i++){
+        bridge_t * bridge = &bridges[i - 1];
+        printf("%s: protocol version 0x%x\n", bridge->path, bridge->mb_serial_posix_context.protocol_version);
+
+        // setup transport interface
+        const mb_driver_t * driver_impl = mb_serial_posix_get_driver();
+        mb_transport_create(&bridge->mb_transport, driver_impl, &bridge->mb_serial_posix_context,
+                            bridge->request_buffer, sizeof(bridge->request_buffer),
+                            bridge->response_buffer, sizeof(bridge->response_buffer));
+        mb_transport_register_callback(&bridge->mb_transport, &async_callback, bridge);
+
+        // add to run loop
+        bool ok = mb_runloop_add_serial(&mb_runloop, &bridge->source, &bridge->mb_serial_posix_context, &bridge->mb_transport);
+        if (!ok) return 10;
+        mb_runloop_register_closed(&bridge->source, &bridge_closed, bridge);
+        num_bridges_active++;
+
+        // get started
+        bridge->app_state = APP_W4_I2C_READY;
+        mb_transport_i2c_master_config_request_send(&bridge->mb_transport, i2c_master_channel, i2c_master_clock_speed,
+                                                    i2c_master_pullups_enabled, i2c_master_pullups_enabled);
+    }
+
+    // now wait for events to arrive
+    mb_runloop_run(&mb_runloop);
+
+    // close down
+    mb_runloop_deinit(&mb_runloop);
+    for (i = 0; i < (argc - 1); i++){
+        mb_serial_posix_close(&bridges[i].mb_serial_posix_context);
+    }
+    return 0;
+}
@@ -0,0 +1,185 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "multibus_loopback.h"
+#include "multibus_loopback_devices.h"
+#include "multibus_protocol.h"
+#include "multibus_sampler.h"
+#include "multibus_sequencer.h"
+#include "multibus_serial_posix.h"
+#include "multibus_transport.h"
+#include "multibus_transport_protocol.h"
+
+// registers a sampler job on the in-process loopback bridge that triggers and reads a BH1750 measurement every
+// 5 ms. samples are received in samples events without any further requests.
+
+#define BH1750_ONE_TIME_L_RES 0x23
+#define BH1750_LUX            500
+
+#define JOB_ID             1
+#define JOB_PERIOD_MS      5
+#define JOB_MAX_LATENCY_MS 50
+
+#define TIMEOUT_MS  100
+#define NUM_RETRIES 3
+
+// static config
+static uint32_t duration_ms = 1000;
+
+// transport instance
+static uint8_t request_buffer[300];
+static uint8_t response_buffer[300];
+static uint8_t send_queue_storage[1024];
+static uint8_t receive_ring_storage[1024];
+static mb_transport_request_t requests[8];
+static mb_transport_t mb_transport;
+
+// virtual bridge
+static mb_loopback_context_t mb_loopback_context;
+static mb_loopback_bh1750_t  bh1750;
+
+static uint32_t num_responses;
+static uint32_t num_events;
+static uint32_t num_samples;
+static uint32_t num_errors;
+static uint32_t num_timeouts;
+static bool     first_sample_received;
+static uint32_t last_timestamp_us;
+static uint32_t max_interval_us;
+
+static void timeout_handler(void * context, const mb_transport_request_t * request){
+    (void) context;
+    (void) request;
+    num_timeouts++;
+}
+
+static void samples_event_handler(const mb_message_t * message){
+    num_events++;
+    mb_sampler_iterator_t iterator;
+    mb_sampler_sample_t sample;
+    mb_sampler_iterator_init(&iterator, mb_message_sampler_samples_event_get_samples(message),
+                             mb_sampler_samples_event_get_samples_len(message->payload_len));
+    while (mb_sampler_iterator_next(&iterator, &sample)){
+        num_samples++;
+        if ((sample.job_id != JOB_ID) || (sample.status != MB_STATUS_OK) || (sample.data_len != 2)){
+            num_errors++;
+            continue;
+        }
+        uint16_t measurement = (sample.data[0] << 8) | sample.data[1];
+        if (measurement != ((BH1750_LUX * 12) / 10)){
+            num_errors++;
+        }
+        if (first_sample_received){
+            uint32_t interval_us = sample.timestamp_us - last_timestamp_us;
+            if (interval_us > max_interval_us){
+                max_interval_us = interval_us;
+            }
+        }
+        first_sample_received = true;
+        last_timestamp_us = sample.timestamp_us;
+    }
+}
+
+static void callback_handler(void * context, const mb_message_t * message){
+    (void) context;
+    if (mb_message_is_event(message)){
+        if ((message->component == MB_COMPONENT_SAMPLER) && (message->operation == MB_OPERATION_SAMPLER_SAMPLES_EVENT)){
+            samples_event_handler(message);
+        }
+        return;
+    }
+    num_responses++;
+    uint8_t status = MB_STATUS_OK;
+    if (mb_message_get_status(message, &status) && (status != MB_STATUS_OK)){
+        num_errors++;
+    }
+}
+
+// process loopback bridge and timeouts until condition is met
+#define PROCESS_UNTIL(CONDITION) do { while ((CONDITION) == false) { \
+    if (mb_loopback_process(&mb_loopback_context) == false) { mb_transport_process_timeouts(&mb_transport); } } } while (0)
+
+static bool time_reached(uint32_t deadline_us){
+    return (int32_t) (mb_serial_posix_get_time_us() - deadline_us) >= 0;
+}
+
+int main(int argc, const char **argv) {
+    if (argc > 1){
+        duration_ms = (uint32_t) atoi(argv[1]);
+    }
+
+    // setup virtual bridge with BH1750, sampler uses the same time source
+    mb_loopback_init(&mb_loopback_context);
+    mb_loopback_set_time_source(&mb_loopback_context, &mb_serial_posix_get_time_us);
+    mb_loopback_bh1750_init(&bh1750, MB_LOOPBACK_BH1750_ADDRESS_LOW);
+    mb_loopback_bh1750_set_lux(&bh1750, BH1750_LUX);
+    mb_loopback_add_i2c_device(&mb_loopback_context, &bh1750.device);
+
+    // setup transport interface
+    mb_transport_create(&mb_transport, mb_loopback_get_driver(), &mb_loopback_context,
+                        request_buffer, sizeof(request_buffer),
+                        response_buffer, sizeof(response_buffer));
+    mb_transport_enable_pipelining(&mb_transport, requests, sizeof(requests) / sizeof(mb_transport_request_t),
+                                   send_queue_storage, sizeof(send_queue_storage));
+    mb_transport_enable_receive_ring(&mb_transport, receive_ring_storage, sizeof(receive_ring_storage));
+    mb_transport_set_time_source(&mb_transport, &mb_serial_posix_get_time_us);
+    mb_transport_enable_timeouts(&mb_transport, TIMEOUT_MS, NUM_RETRIES, &timeout_handler, NULL);
+    mb_transport_register_callback(&mb_transport, &callback_handler, NULL);
+
+    // config
+    PROCESS_UNTIL(mb_transport_i2c_master_config_request_send(&mb_transport, 0, MB_I2C_MASTER_CONFIG_REQUEST_CLOCK_SPEED_400_KHZ,
+                                                              false, false));
+
+    // job: trigger measurement, read and append it to the sample
+    uint8_t program_buffer[MB_SAMPLER_MAX_PROGRAM_LEN];
+    mb_sequencer_program_t program;
+    uint8_t bh1750_mode = BH1750_ONE_TIME_L_RES;
+    mb_sequencer_program_init(&program, program_buffer, sizeof(program_buffer));
+    mb_sequencer_program_i2c_write(&program, MB_LOOPBACK_BH1750_ADDRESS_LOW, 1, &bh1750_mode);
+    mb_sequencer_program_i2c_read(&program, MB_LOOPBACK_BH1750_ADDRESS_LOW, 2);
+    mb_sequencer_program_append(&program, 0, 2);
+    PROCESS_UNTIL(mb_transport_sampler_add_job_request_send(&mb_transport, 0, JOB_ID, JOB_PERIOD_MS, JOB_MAX_LATENCY_MS,
+                                                            mb_sequencer_program_get_len(&program), program_buffer));
+
+    // receive samples, then remove job and wait for the remaining samples
+    uint32_t start_us = mb_serial_posix_get_time_us();
+    PROCESS_UNTIL(time_reached(start_us + duration_ms * 1000));
+    PROCESS_UNTIL(mb_transport_sampler_remove_job_request_send(&mb_transport, 0, JOB_ID));
+    uint32_t stop_us = mb_serial_posix_get_time_us();
+    PROCESS_UNTIL(time_reached(stop_us + JOB_MAX_LATENCY_MS * 1000));
+
+    uint32_t num_requests = 3;
+    uint32_t expected_samples = duration_ms / JOB_PERIOD_MS;
+    printf("Requests:       %u\n", num_requests);
+    printf("Responses:      %u\n", num_responses);
+    printf("Samples:        %u (%u expected)\n", num_samples, expected_samples);
+    printf("Events:         %u\n", num_events);
+    printf("Max interval:   %u us\n", max_interval_us);
+    printf("Errors:         %u\n", num_errors);
+    printf("Timeouts:       %u\n", num_timeouts);
+    return (num_errors == 0 && num_timeouts == 0 && num_responses == num_requests &&
+            (num_samples >= expected_samples / 2) && num_events < num_samples) ? 0 : 1;
+}
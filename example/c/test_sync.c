@@ -23,12 +23,13 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
 
 #include "multibus_protocol.h"
+#include "multibus_sequencer.h"
 #include "multibus_serial_posix.h"
+#include "multibus_sync.h"
+#include "multibus_sync_protocol.h"
 #include "multibus_transport.h"
-#include "multibus_transport_protocol.h"
 
 // static config
 static const char * multibus_bridge_path;
@@ -38,33 +39,25 @@ static uint8_t      i2c_master_clock_speed = MB_I2C_MASTER_CONFIG_REQUEST_CLOCK_
 static uint8_t      i2c_master_pullups_enabled = 1;
 static uint8_t      lux_sensor_address = 0x23;
 static const uint8_t lux_sensor_config = 0x23;
-static bool         run_loop_done;
+static uint32_t     multibus_timeout_ms = 1000;
 
 // transport instance
-static uint8_t request_buffer[20];
-static uint8_t response_buffer[20];
+static uint8_t request_buffer[32];
+static uint8_t response_buffer[32];
 static mb_transport_t mb_transport;
 static mb_serial_posix_context_t mb_serial_posix_context;
-
-// blocking API
-const mb_message_t * test_sync_message;
-
-void test_sync_callback_handler(void * context, const mb_message_t * message){
-    test_sync_message = message;
-}
-
-const mb_message_t * test_sync_wait_for_response(mb_transport_t * transport){
-    test_sync_message = NULL;
-    while (test_sync_message == NULL){
-        bool can_sleep = true;
-        can_sleep &= mb_serial_posix_process_read(&mb_serial_posix_context) == 0;
-        can_sleep &= mb_serial_posix_process_write(&mb_serial_posix_context) == 0;
-        if (can_sleep){
-            // sleep 10 ms if no processing is active
-            usleep(10 * 1000);
-        }
-    }
-    return test_sync_message;
+static mb_sync_t mb_sync;
+
+// configure, wait for measurement, and read lux value in a single request
+static const mb_message_t * read_lux_with_sequencer(mb_sync_t * sync){
+    uint8_t program_buffer[16];
+    mb_sequencer_program_t program;
+    mb_sequencer_program_init(&program, program_buffer, sizeof(program_buffer));
+    mb_sequencer_program_i2c_write(&program, lux_sensor_address, 1, &lux_sensor_config);
+    mb_sequencer_program_delay(&program, 30);
+    mb_sequencer_program_i2c_read(&program, lux_sensor_address, 2);
+    mb_sequencer_program_append(&program, 0, 2);
+    return mb_sync_sequencer_run(sync, i2c_master_channel, mb_sequencer_program_get_len(&program), program_buffer);
 }
 
 int main(int argc, const char **argv) {
@@ -84,35 +77,56 @@ int main(int argc, const char **argv) {
     mb_transport_create(&mb_transport, driver_impl, &mb_serial_posix_context,
                         request_buffer, sizeof(request_buffer),
                         response_buffer, sizeof(response_buffer));
-    mb_transport_register_callback(&mb_transport, &test_sync_callback_handler, &mb_transport);
+    mb_sync_init(&mb_sync, &mb_transport, &mb_serial_posix_context, multibus_timeout_ms);
 
     const mb_message_t * message;
-    mb_transport_t * transport = &mb_transport;
+    mb_sync_t * sync = &mb_sync;
 
-    // synchronous prototype
+    // synchronous API
     printf("Get Protocol Version\n");
-    mb_transport_bridge_protocol_version_request_send(transport, 0);
-    message = test_sync_wait_for_response(transport);
+    message = mb_sync_bridge_protocol_version(sync, 0, 0);
+    if (message == NULL){
+        printf("Timeout\n");
+        return 10;
+    }
     printf("Protocol Version: 0x%x\n", mb_message_bridge_protocol_version_response_get_version(message));
 
     printf("Config I2C Master\n");
-    mb_transport_i2c_master_config_request_send(transport, i2c_master_channel, i2c_master_clock_speed, i2c_master_pullups_enabled, i2c_master_pullups_enabled);
-    (void) test_sync_wait_for_response(transport);
+    (void) mb_sync_i2c_master_config(sync, i2c_master_channel, i2c_master_clock_speed, i2c_master_pullups_enabled, i2c_master_pullups_enabled);
 
     printf("Write configuration\n");
-    mb_transport_i2c_master_write_request_send(transport, i2c_master_channel, lux_sensor_address, 1, &lux_sensor_config);
-    (void) test_sync_wait_for_response(transport);
+    (void) mb_sync_i2c_master_write(sync, i2c_master_channel, lux_sensor_address, 1, &lux_sensor_config);
 
     printf("Delay 30ms\n");
-    mb_transport_bridge_delay_request_send(transport, 0, 30);
-    (void) test_sync_wait_for_response(transport);
+    (void) mb_sync_bridge_delay(sync, 0, 30);
 
     printf("Read LUX\n");
-    mb_transport_i2c_master_read_request_send(transport, i2c_master_channel, lux_sensor_address, 2);
-    message = test_sync_wait_for_response(transport);
+    message = mb_sync_i2c_master_read(sync, i2c_master_channel, lux_sensor_address, 2);
+    if (message == NULL){
+        printf("Timeout\n");
+        return 10;
+    }
     const uint8_t * i2c_read_data = mb_message_i2c_master_read_response_get_data(message);
     printf("Lux: %f\n", (i2c_read_data[0] << 8 | i2c_read_data[1]) / 1.2);
 
+    if (mb_sync_bridge_supports_component(sync, MB_COMPONENT_SEQUENCER)){
+        printf("Read LUX with sequencer\n");
+        message = read_lux_with_sequencer(sync);
+        if (message == NULL){
+            printf("Timeout\n");
+            return 10;
+        }
+        if ((mb_message_sequencer_run_response_get_status(message) != MB_STATUS_OK) ||
+            (mb_sequencer_run_response_get_data_len(message->payload_len) != 2)){
+            printf("Sequencer failed, status 0x%02x\n", mb_message_sequencer_run_response_get_status(message));
+            return 10;
+        }
+        const uint8_t * lux_data = mb_message_sequencer_run_response_get_data(message);
+        printf("Lux: %f\n", (lux_data[0] << 8 | lux_data[1]) / 1.2);
+    } else {
+        printf("Sequencer not supported\n");
+    }
+
     // close down
     mb_serial_posix_close(&mb_serial_posix_context);
     return 0;
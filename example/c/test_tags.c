@@ -0,0 +1,178 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "multibus_loopback.h"
+#include "multibus_loopback_devices.h"
+#include "multibus_protocol.h"
+#include "multibus_serial_posix.h"
+#include "multibus_transport.h"
+#include "multibus_transport_protocol.h"
+
+// selects protocol version 1 with the in-process loopback bridge, which then sends delay responses after all other
+// responses of the same batch. responses are matched to their requests by tag.
+
+#define BH1750_ONE_TIME_L_RES 0x23
+#define BH1750_LUX            500
+
+#define TIMEOUT_MS  100
+#define NUM_RETRIES 3
+
+// static config
+static uint32_t num_iterations = 10000;
+
+// transport instance
+static uint8_t request_buffer[300];
+static uint8_t response_buffer[300];
+static uint8_t send_queue_storage[1024];
+static uint8_t receive_ring_storage[1024];
+static mb_transport_request_t requests[8];
+static mb_transport_t mb_transport;
+
+// virtual bridge
+static mb_loopback_context_t mb_loopback_context;
+static mb_loopback_bh1750_t  bh1750;
+
+static bool     version_ready;
+static uint16_t bridge_protocol_version;
+static bool     read_completed;
+static uint32_t num_responses;
+static uint32_t num_out_of_order;
+static uint32_t num_errors;
+static uint32_t num_timeouts;
+
+static void timeout_handler(void * context, const mb_transport_request_t * request){
+    (void) context;
+    (void) request;
+    num_timeouts++;
+}
+
+static void callback_handler(void * context, const mb_message_t * message){
+    (void) context;
+    num_responses++;
+    uint8_t status = MB_STATUS_OK;
+    if (mb_message_get_status(message, &status) && (status != MB_STATUS_OK)){
+        num_errors++;
+    }
+    switch (message->component){
+        case MB_COMPONENT_BRIDGE:
+            switch (message->operation){
+                case MB_OPERATION_BRIDGE_PROTOCOL_VERSION_RESPONSE:
+                    bridge_protocol_version = mb_message_bridge_protocol_version_response_get_version(message);
+                    if (bridge_protocol_version >= MB_TRAILER_VERSION){
+                        // bridge uses requested version for all following messages
+                        mb_transport_set_protocol_version(&mb_transport, MB_TRAILER_VERSION);
+                    }
+                    version_ready = true;
+                    break;
+                case MB_OPERATION_BRIDGE_DELAY_RESPONSE:
+                    // delay was requested before the read
+                    if (read_completed){
+                        num_out_of_order++;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case MB_COMPONENT_I2C_MASTER:
+            if (message->operation == MB_OPERATION_I2C_MASTER_READ_RESPONSE){
+                const uint8_t * data = mb_message_i2c_master_read_response_get_data(message);
+                uint16_t measurement = (data[0] << 8) | data[1];
+                if (measurement != ((BH1750_LUX * 12) / 10)){
+                    num_errors++;
+                }
+                read_completed = true;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// process loopback bridge and timeouts until condition is met
+#define PROCESS_UNTIL(CONDITION) do { while ((CONDITION) == false) { \
+    if (mb_loopback_process(&mb_loopback_context) == false) { mb_transport_process_timeouts(&mb_transport); } } } while (0)
+
+int main(int argc, const char **argv) {
+    if (argc > 1){
+        num_iterations = (uint32_t) atoi(argv[1]);
+    }
+
+    // setup virtual bridge with BH1750
+    mb_loopback_init(&mb_loopback_context);
+    mb_loopback_bh1750_init(&bh1750, MB_LOOPBACK_BH1750_ADDRESS_LOW);
+    mb_loopback_bh1750_set_lux(&bh1750, BH1750_LUX);
+    mb_loopback_add_i2c_device(&mb_loopback_context, &bh1750.device);
+
+    // setup transport interface
+    mb_transport_create(&mb_transport, mb_loopback_get_driver(), &mb_loopback_context,
+                        request_buffer, sizeof(request_buffer),
+                        response_buffer, sizeof(response_buffer));
+    mb_transport_enable_pipelining(&mb_transport, requests, sizeof(requests) / sizeof(mb_transport_request_t),
+                                   send_queue_storage, sizeof(send_queue_storage));
+    mb_transport_enable_receive_ring(&mb_transport, receive_ring_storage, sizeof(receive_ring_storage));
+    mb_transport_set_time_source(&mb_transport, &mb_serial_posix_get_time_us);
+    mb_transport_enable_timeouts(&mb_transport, TIMEOUT_MS, NUM_RETRIES, &timeout_handler, NULL);
+    mb_transport_register_callback(&mb_transport, &callback_handler, NULL);
+
+    // select protocol version with tags
+    PROCESS_UNTIL(mb_transport_bridge_protocol_version_request_send(&mb_transport, 0, MB_TRAILER_VERSION));
+    PROCESS_UNTIL(version_ready || (num_timeouts > 0));
+    if (bridge_protocol_version < MB_TRAILER_VERSION){
+        printf("Bridge does not support protocol version %u\n", MB_TRAILER_VERSION);
+        return 1;
+    }
+
+    // config
+    PROCESS_UNTIL(mb_transport_i2c_master_config_request_send(&mb_transport, 0, MB_I2C_MASTER_CONFIG_REQUEST_CLOCK_SPEED_400_KHZ,
+                                                              false, false));
+
+    // each iteration: send delay, trigger and read BH1750 measurement in one batch
+    uint8_t bh1750_mode = BH1750_ONE_TIME_L_RES;
+    uint32_t start_us = mb_serial_posix_get_time_us();
+    uint32_t iteration;
+    for (iteration = 0; iteration < num_iterations; iteration++){
+        read_completed = false;
+        mb_transport_cork(&mb_transport);
+        PROCESS_UNTIL(mb_transport_bridge_delay_request_send(&mb_transport, 0, 1));
+        PROCESS_UNTIL(mb_transport_i2c_master_write_request_send(&mb_transport, 0, MB_LOOPBACK_BH1750_ADDRESS_LOW, 1, &bh1750_mode));
+        PROCESS_UNTIL(mb_transport_i2c_master_read_request_send(&mb_transport, 0, MB_LOOPBACK_BH1750_ADDRESS_LOW, 2));
+        mb_transport_uncork(&mb_transport);
+        PROCESS_UNTIL(mb_transport_get_num_pending_requests(&mb_transport) == 0);
+    }
+    uint32_t duration_us = mb_serial_posix_get_time_us() - start_us;
+
+    uint32_t num_requests = 2 + 3 * num_iterations;
+    printf("Requests:       %u\n", num_requests);
+    printf("Responses:      %u\n", num_responses);
+    printf("Out of order:   %u\n", num_out_of_order);
+    printf("Errors:         %u\n", num_errors);
+    printf("Timeouts:       %u\n", num_timeouts);
+    printf("Duration:       %u us\n", duration_us);
+    return (num_errors == 0 && num_timeouts == 0 && num_responses == num_requests &&
+            num_out_of_order == num_iterations) ? 0 : 1;
+}
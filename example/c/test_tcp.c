@@ -0,0 +1,118 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "multibus_protocol.h"
+#include "multibus_tcp_posix.h"
+#include "multibus_sync.h"
+#include "multibus_sync_protocol.h"
+#include "multibus_transport.h"
+
+// same as test_sync, but connects to the bridge via TCP, e.g. to bridge_simulator_tcp, or to multibusd
+
+// static config
+static const char * multibus_bridge_host;
+static uint16_t     multibus_bridge_port = 7777;
+static uint8_t      i2c_master_channel = 0;
+static uint8_t      i2c_master_clock_speed = MB_I2C_MASTER_CONFIG_REQUEST_CLOCK_SPEED_100_KHZ;
+static uint8_t      i2c_master_pullups_enabled = 1;
+static uint8_t      lux_sensor_address = 0x23;
+static const uint8_t lux_sensor_config = 0x23;
+static uint32_t     multibus_timeout_ms = 1000;
+
+// transport instance
+static uint8_t request_buffer[20];
+static uint8_t response_buffer[20];
+static mb_transport_t mb_transport;
+static mb_tcp_posix_context_t mb_tcp_posix_context;
+static mb_sync_t mb_sync;
+
+int main(int argc, const char **argv) {
+    // get bridge address
+    if ((argc != 2) && (argc != 3)){
+        printf("Usage: %s <host> [port] | <socket path>\n", argv[0]);
+        exit(10);
+    }
+    multibus_bridge_host = argv[1];
+    if (argc == 3){
+        multibus_bridge_port = (uint16_t) atoi(argv[2]);
+    }
+
+    // connection might be closed by bridge
+    signal(SIGPIPE, SIG_IGN);
+
+    // connect to bridge, requests are sent once connected
+    bool ok;
+    if (strchr(multibus_bridge_host, '/') != NULL){
+        // Unix domain socket of multibusd
+        ok = mb_tcp_posix_open_unix(&mb_tcp_posix_context, multibus_bridge_host);
+    } else {
+        ok = mb_tcp_posix_open(&mb_tcp_posix_context, multibus_bridge_host, multibus_bridge_port);
+    }
+    if (!ok) return 10;
+
+    // setup transport interface
+    const mb_driver_t * driver_impl = mb_tcp_posix_get_driver();
+    mb_transport_create(&mb_transport, driver_impl, &mb_tcp_posix_context,
+                        request_buffer, sizeof(request_buffer),
+                        response_buffer, sizeof(response_buffer));
+    mb_sync_init(&mb_sync, &mb_transport, mb_tcp_posix_get_stream(&mb_tcp_posix_context), multibus_timeout_ms);
+
+    const mb_message_t * message;
+    mb_sync_t * sync = &mb_sync;
+
+    // synchronous API
+    printf("Get Protocol Version\n");
+    message = mb_sync_bridge_protocol_version(sync, 0, 0);
+    if (message == NULL){
+        printf(mb_tcp_posix_get_state(&mb_tcp_posix_context) == MB_TCP_POSIX_CONNECTED ? "Timeout\n" : "Connect failed\n");
+        return 10;
+    }
+    printf("Protocol Version: 0x%x\n", mb_message_bridge_protocol_version_response_get_version(message));
+
+    printf("Config I2C Master\n");
+    (void) mb_sync_i2c_master_config(sync, i2c_master_channel, i2c_master_clock_speed, i2c_master_pullups_enabled, i2c_master_pullups_enabled);
+
+    printf("Write configuration\n");
+    (void) mb_sync_i2c_master_write(sync, i2c_master_channel, lux_sensor_address, 1, &lux_sensor_config);
+
+    printf("Delay 30ms\n");
+    (void) mb_sync_bridge_delay(sync, 0, 30);
+
+    printf("Read LUX\n");
+    message = mb_sync_i2c_master_read(sync, i2c_master_channel, lux_sensor_address, 2);
+    if (message == NULL){
+        printf("Timeout\n");
+        return 10;
+    }
+    const uint8_t * i2c_read_data = mb_message_i2c_master_read_response_get_data(message);
+    printf("Lux: %f\n", (i2c_read_data[0] << 8 | i2c_read_data[1]) / 1.2);
+
+    // close down
+    mb_tcp_posix_close(&mb_tcp_posix_context);
+    return 0;
+}
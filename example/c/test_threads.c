@@ -0,0 +1,141 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pthread.h>
+
+#include "multibus_protocol.h"
+#include "multibus_serial_posix.h"
+#include "multibus_thread.h"
+#include "multibus_transport.h"
+
+// several application threads query the bridge concurrently via the I/O thread
+
+#define NUM_APP_THREADS 4
+#define NUM_REQUESTS    100
+
+// static config
+static const char * multibus_bridge_path;
+static uint32_t     multibus_bridge_baudrate = 115200;
+static uint32_t     multibus_timeout_ms = 1000;
+
+// transport instance
+static uint8_t request_buffer[300];
+static uint8_t response_buffer[300];
+static uint8_t send_queue_storage[1024];
+static mb_transport_request_t requests[16];
+static mb_transport_t mb_transport;
+static mb_serial_posix_context_t mb_serial_posix_context;
+static mb_thread_t mb_thread;
+
+// app threads
+typedef struct {
+    pthread_t thread;
+    mb_thread_client_t client;
+    uint32_t num_responses;
+    uint32_t num_errors;
+} app_thread_t;
+
+static app_thread_t app_threads[NUM_APP_THREADS];
+
+static void * app_thread_main(void * context){
+    app_thread_t * app_thread = (app_thread_t *) context;
+    mb_thread_client_t * client = &app_thread->client;
+    uint8_t request[MB_HEADER_SIZE + 2];
+    uint16_t request_len = mb_bridge_protocol_version_request_setup(request, sizeof(request), 0, 0);
+    uint32_t num_sent = 0;
+    while (app_thread->num_responses + app_thread->num_errors < NUM_REQUESTS){
+        // keep request queue filled
+        while ((num_sent < NUM_REQUESTS) && mb_thread_client_submit(client, request, request_len, num_sent)){
+            num_sent++;
+        }
+        const mb_thread_completion_t * completion = mb_thread_client_wait_completion(client, multibus_timeout_ms);
+        if (completion == NULL){
+            printf("No response within %u ms\n", multibus_timeout_ms);
+            break;
+        }
+        if ((completion->type == MB_THREAD_COMPLETION_RESPONSE) &&
+            (completion->message.operation == MB_OPERATION_BRIDGE_PROTOCOL_VERSION_RESPONSE)){
+            app_thread->num_responses++;
+        } else {
+            app_thread->num_errors++;
+        }
+        mb_thread_client_release_completion(client);
+    }
+    return NULL;
+}
+
+int main(int argc, const char **argv) {
+    // get bridge path
+    if (argc != 2){
+        printf("Usage: %s <path to serial port>\n", argv[0]);
+        exit(10);
+    }
+    multibus_bridge_path = argv[1];
+
+    // open serial transport
+    bool ok = mb_serial_posix_open(&mb_serial_posix_context, multibus_bridge_path, multibus_bridge_baudrate);
+    if (!ok) return 10;
+
+    // setup transport interface
+    const mb_driver_t * driver_impl = mb_serial_posix_get_driver();
+    mb_transport_create(&mb_transport, driver_impl, &mb_serial_posix_context,
+                        request_buffer, sizeof(request_buffer),
+                        response_buffer, sizeof(response_buffer));
+    mb_transport_enable_pipelining(&mb_transport, requests, sizeof(requests) / sizeof(mb_transport_request_t),
+                                   send_queue_storage, sizeof(send_queue_storage));
+    mb_transport_set_time_source(&mb_transport, &mb_serial_posix_get_time_us);
+    mb_transport_enable_timeouts(&mb_transport, multibus_timeout_ms, 1, &mb_thread_handle_timeout, &mb_thread);
+
+    // start I/O thread
+    if (mb_thread_init(&mb_thread, &mb_transport, &mb_serial_posix_context) == false) return 10;
+    if (mb_thread_start(&mb_thread) == false) return 10;
+
+    // start app threads
+    uint32_t start_us = mb_serial_posix_get_time_us();
+    int i;
+    for (i = 0; i < NUM_APP_THREADS; i++){
+        if (mb_thread_add_client(&mb_thread, &app_threads[i].client, NULL, NULL) == false) return 10;
+        pthread_create(&app_threads[i].thread, NULL, &app_thread_main, &app_threads[i]);
+    }
+
+    // wait for app threads
+    uint32_t num_responses = 0;
+    uint32_t num_errors = 0;
+    for (i = 0; i < NUM_APP_THREADS; i++){
+        pthread_join(app_threads[i].thread, NULL);
+        num_responses += app_threads[i].num_responses;
+        num_errors    += app_threads[i].num_errors;
+    }
+    uint32_t duration_us = mb_serial_posix_get_time_us() - start_us;
+
+    mb_thread_stop(&mb_thread);
+    mb_serial_posix_close(&mb_serial_posix_context);
+
+    printf("Responses: %u\n", num_responses);
+    printf("Errors:    %u\n", num_errors);
+    printf("Duration:  %u us\n", duration_us);
+    return (num_errors == 0 && num_responses == NUM_APP_THREADS * NUM_REQUESTS) ? 0 : 1;
+}
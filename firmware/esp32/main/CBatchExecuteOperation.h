@@ -0,0 +1,85 @@
+/**
+ *
+ * Copyright 2022 Boris Zweimüller
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_MAIN_C_BATCH_EXECUTE_OPERATION_INCLUDED
+#define MULTIBUS_MAIN_C_BATCH_EXECUTE_OPERATION_INCLUDED
+
+#include "IMultiBusOperation.h"
+#include "IMultiBusMessageReaderWriter.h"
+#include "CMultiBusOperationExecutor.h"
+#include <esp_log.h>
+#include <multibus_batch.h>
+#include <multibus_protocol.hpp>
+#include <memory>
+#include <vector>
+
+class CBatchExecuteOperation : public IMultiBusOperation {
+ public:
+  CBatchExecuteOperation(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter,
+                         std::weak_ptr<CMultiBusOperationExecutor> aOperationExecutor)
+  : mMultiBusReaderWriter(std::move(aMultiBusReaderWriter)), mOperationExecutor(std::move(aOperationExecutor)) {}
+
+  ~CBatchExecuteOperation() override = default;
+
+  void execute(const SMultiBusMessage& aMessage) override {
+    ESP_LOGI("Batch", "batch_execute_request\n");
+
+    auto lRequests = mb::batch::execute_request::view(aMessage.mPayload).requests();
+    auto lOperationExecutor = mOperationExecutor.lock();
+    if (!lOperationExecutor || !mb_batch_requests_valid(lRequests.data(), lRequests.size())) {
+      auto lLen = mb::batch::execute_response::setup(sSendBuffer, 0x0, MB_STATUS_INVALID_ARGUMENTS, {});
+      mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
+      return;
+    }
+
+    // execute requests in order, their responses are collected instead of being sent
+    auto lStatus = MB_STATUS_OK;
+    constexpr auto lMaxResponsesLen = sSendBuffer.size() - mb::batch::execute_response::fixed_size;
+    std::vector<uint8_t> lResponses;
+    mb_batch_iterator_t lIterator;
+    mb_message_t lRequest;
+    mb_batch_iterator_init(&lIterator, lRequests.data(), lRequests.size());
+    mMultiBusReaderWriter->setResponseCollector(&lResponses);
+    while (mb_batch_iterator_next(&lIterator, &lRequest)) {
+      auto lResponsesLen = lResponses.size();
+      SMultiBusMessage lMessage{lRequest.component, lRequest.operation, lRequest.channel, lRequest.payload_len,
+                                {lRequest.payload_data, lRequest.payload_data + lRequest.payload_len}};
+      lOperationExecutor->execute(lMessage);
+      if (lResponses.size() > lMaxResponsesLen) {
+        lResponses.resize(lResponsesLen);
+        lStatus = MB_STATUS_BATCH_TRUNCATED;
+        break;
+      }
+    }
+    mMultiBusReaderWriter->setResponseCollector(nullptr);
+
+    auto lLen = mb::batch::execute_response::setup(sSendBuffer, 0x0, lStatus, lResponses);
+    mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
+  }
+
+ private:
+  std::shared_ptr<IMultiBusMessageReaderWriter> mMultiBusReaderWriter{};
+  // executor owns this operation
+  std::weak_ptr<CMultiBusOperationExecutor> mOperationExecutor{};
+};
+
+#endif // MULTIBUS_MAIN_C_BATCH_EXECUTE_OPERATION_INCLUDED
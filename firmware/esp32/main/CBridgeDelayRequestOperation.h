@@ -27,7 +27,7 @@
 #include "IMultiBusMessageReaderWriter.h"
 #include <esp_log.h>
 #include <string>
-#include <multibus_protocol.h>
+#include <multibus_protocol.hpp>
 #include <memory>
 #include <thread>
 
@@ -41,11 +41,12 @@ class CBridgeDelayRequestOperation : public IMultiBusOperation {
   void execute(const SMultiBusMessage& aMessage) override {
     ESP_LOGI("Bridge", "bridge_delay_request\n");
 
-    auto timeoutMs = mb_bridge_delay_request_get_timeout_ms(aMessage.mPayload.data());
+    mb::bridge::delay_request::view lRequest(aMessage.mPayload);
+    auto timeoutMs = lRequest.valid() ? lRequest.timeout_ms() : 0;
     ESP_LOGI("Bridge", "sleeping for %dms\n", (int)timeoutMs);
     std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
 
-    auto lLen = mb_bridge_delay_response_setup(sSendBuffer.data(), sSendBuffer.size(), 0x0);
+    auto lLen = mb::bridge::delay_response::setup(sSendBuffer, 0x0);
 
     mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
   }
@@ -0,0 +1,66 @@
+/**
+ *
+ * Copyright 2022 Boris Zweimüller
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_MAIN_C_BRIDGE_FRAMING_OPERATION_INCLUDED
+#define MULTIBUS_MAIN_C_BRIDGE_FRAMING_OPERATION_INCLUDED
+
+#include "IMultiBusOperation.h"
+#include "IMultiBusMessageReaderWriter.h"
+#include <esp_log.h>
+#include <multibus_protocol.hpp>
+#include <memory>
+
+class CBridgeFramingOperation : public IMultiBusOperation {
+ public:
+  explicit CBridgeFramingOperation(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter)
+  : mMultiBusReaderWriter(std::move(aMultiBusReaderWriter)) {}
+
+  ~CBridgeFramingOperation() override = default;
+
+  void execute(const SMultiBusMessage& aMessage) override {
+    ESP_LOGI("Bridge", "bridge_framing_request\n");
+
+    mb::bridge::framing_request::view lRequest(aMessage.mPayload);
+    auto lStatus = MB_STATUS_INVALID_ARGUMENTS;
+    auto lMode = MB_BRIDGE_FRAMING_REQUEST_MODE_NONE;
+    if (lRequest.valid()) {
+      lMode = lRequest.mode();
+      if (lMode == MB_BRIDGE_FRAMING_REQUEST_MODE_NONE || lMode == MB_BRIDGE_FRAMING_REQUEST_MODE_COBS_CRC16) {
+        lStatus = MB_STATUS_OK;
+      }
+    }
+
+    // response uses the current framing, switch afterwards
+    auto lLen = mb::bridge::framing_response::setup(sSendBuffer, 0x0, lStatus);
+    mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
+
+    if (lStatus == MB_STATUS_OK) {
+      ESP_LOGI("Bridge", "framing mode %d\n", (int)lMode);
+      mMultiBusReaderWriter->setFraming(lMode);
+    }
+  }
+
+ private:
+  std::shared_ptr<IMultiBusMessageReaderWriter> mMultiBusReaderWriter{};
+};
+
+#endif // MULTIBUS_MAIN_C_BRIDGE_FRAMING_OPERATION_INCLUDED
@@ -25,7 +25,7 @@
 
 #include "IMultiBusOperation.h"
 #include "CSerialMultiBusMessageReaderWriter.h"
-#include "multibus_protocol.h"
+#include "multibus_protocol.hpp"
 #include <esp_log.h>
 
 class CBridgeGetFirmwareVersionOperation : public IMultiBusOperation {
@@ -39,7 +39,7 @@ class CBridgeGetFirmwareVersionOperation : public IMultiBusOperation {
     ESP_LOGI("Bridge", "bridge_get_firmware_version\n");
 
     // TODO read current project info from flash image
-    auto lLen = mb_bridge_firmware_version_response_setup(sSendBuffer.data(), sSendBuffer.size(), 0x0, 0x1);
+    auto lLen = mb::bridge::firmware_version_response::setup(sSendBuffer, 0x0, 0x1);
     mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
   }
 
@@ -28,7 +28,7 @@
 #include "CHardwareInfo.h"
 #include <esp_log.h>
 #include <string>
-#include <multibus_protocol.h>
+#include <multibus_protocol.hpp>
 
 class CBridgeGetHWInfoOperation : public IMultiBusOperation {
  public:
@@ -40,9 +40,7 @@ class CBridgeGetHWInfoOperation : public IMultiBusOperation {
   void execute(const SMultiBusMessage &aMessage) override {
     ESP_LOGI("Bridge", "bridge_get_hw_info\n");
 
-    auto lLen = mb_bridge_hardware_info_response_setup(sSendBuffer.data(),
-                                                       sSendBuffer.size(), 0x0,
-                                                       CHardwareInfo::getChipModel().c_str());
+    auto lLen = mb::bridge::hardware_info_response::setup(sSendBuffer, 0x0, CHardwareInfo::getChipModel());
     mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
   }
 
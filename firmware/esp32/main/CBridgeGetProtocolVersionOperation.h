@@ -25,25 +25,47 @@
 
 #include "IMultiBusOperation.h"
 #include "CSerialMultiBusMessageReaderWriter.h"
-#include "multibus_protocol.h"
+#include "CSampler.h"
+#include "multibus_protocol.hpp"
 #include <esp_log.h>
 
 class CBridgeGetProtocolVersionOperation : public IMultiBusOperation {
  public:
-  explicit CBridgeGetProtocolVersionOperation(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter)
-  : mMultiBusReaderWriter(std::move(aMultiBusReaderWriter)) {}
+  CBridgeGetProtocolVersionOperation(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter,
+                                     std::weak_ptr<CSampler> aSampler)
+  : mMultiBusReaderWriter(std::move(aMultiBusReaderWriter)), mSampler(std::move(aSampler)) {}
 
   ~CBridgeGetProtocolVersionOperation() override = default;
 
   void execute(const SMultiBusMessage& aMessage) override {
     ESP_LOGI("Bridge", "bridge_get_protocol_version\n");
 
-    auto lLen = mb_bridge_protocol_version_response_setup(sSendBuffer.data(), sSendBuffer.size(), 0x0, MB_PROTOCOL_VERSION);
+    // response uses the current protocol version, switch afterwards if requested version is supported
+    auto lLen = mb::bridge::protocol_version_response::setup(sSendBuffer, 0x0, MB_PROTOCOL_VERSION);
     mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
+
+    // older hosts don't send a version and use version 0
+    mb::bridge::protocol_version_request::view lRequest(aMessage.mPayload);
+    if (lRequest.valid()) {
+      auto lVersion = lRequest.version();
+      if (lVersion <= MB_PROTOCOL_VERSION) {
+        ESP_LOGI("Bridge", "protocol version %u\n", (unsigned)lVersion);
+        mMultiBusReaderWriter->setProtocolVersion(lVersion);
+      }
+    } else {
+      mMultiBusReaderWriter->setProtocolVersion(0);
+    }
+
+    // new session, stop sampler jobs of previous host
+    auto lSampler = mSampler.lock();
+    if (lSampler) {
+      lSampler->removeAllJobs();
+    }
   }
 
  private:
   std::shared_ptr<IMultiBusMessageReaderWriter> mMultiBusReaderWriter;
+  std::weak_ptr<CSampler> mSampler;
 };
 
 #endif // MULTIBUS_MAIN_C_BRIDGE_GET_PROTOCOL_VERSION_OPERATION_INCLUDED
\ No newline at end of file
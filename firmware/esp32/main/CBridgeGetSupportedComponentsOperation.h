@@ -25,7 +25,7 @@
 
 #include "IMultiBusOperation.h"
 #include "CSerialMultiBusMessageReaderWriter.h"
-#include "multibus_protocol.h"
+#include "multibus_protocol.hpp"
 #include <esp_log.h>
 
 class CBridgeGetSupportedComponentsOperation : public IMultiBusOperation {
@@ -38,10 +38,9 @@ class CBridgeGetSupportedComponentsOperation : public IMultiBusOperation {
   void execute(const SMultiBusMessage& aMessage) override {
     ESP_LOGI("Bridge", "bridge_get_supported_components\n");
 
-    const std::array<uint8_t, 2> lSupportedComponents{MB_COMPONENT_I2C_MASTER, MB_COMPONENT_SPI_MASTER};
-    auto lLen = mb_bridge_supported_components_response_setup(
-            sSendBuffer.data(), sSendBuffer.size(),
-            0x0, 0x2, lSupportedComponents.data());
+    const std::array<uint8_t, 5> lSupportedComponents{MB_COMPONENT_I2C_MASTER, MB_COMPONENT_SPI_MASTER, MB_COMPONENT_BATCH,
+                                                     MB_COMPONENT_SEQUENCER, MB_COMPONENT_SAMPLER};
+    auto lLen = mb::bridge::supported_components_response::setup(sSendBuffer, 0x0, lSupportedComponents);
     mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
   }
 
@@ -29,25 +29,35 @@
 #include "CBridgeGetHWInfoOperation.h"
 #include "CBridgeGetSupportedComponentsOperation.h"
 #include "CBridgeDelayRequestOperation.h"
+#include "CBridgeFramingOperation.h"
 #include "CI2CReadOperation.h"
 #include "CI2CWriteOperation.h"
 #include "CI2CConfigOperation.h"
 #include "CSPIGetNumChannelsOperation.h"
 #include "CSPIConfigOperation.h"
 #include "CSPIMasterWriteOperation.h"
+#include "CBatch.h"
+#include "CBatchExecuteOperation.h"
+#include "CSequencer.h"
+#include "CSequencerRunOperation.h"
+#include "CSampler.h"
+#include "CSamplerAddJobOperation.h"
+#include "CSamplerRemoveJobOperation.h"
 
 std::shared_ptr<IComponent>
-CComponentFactory::createBridgeComponent(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter) {
+CComponentFactory::createBridgeComponent(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter,
+                                         std::weak_ptr<CSampler> aSampler) {
   auto lBridge = std::make_shared<CBridge>();
   // operations
   auto lBridgeGetProtocolVersionOperation = std::make_shared<CBridgeGetProtocolVersionOperation>(
-      aMultiBusReaderWriter);
+      aMultiBusReaderWriter, std::move(aSampler));
   auto lBridgeGetFirmwareVersionOperation = std::make_shared<CBridgeGetFirmwareVersionOperation>(
       aMultiBusReaderWriter);
   auto lBridgeGetHWInfoOperation = std::make_shared<CBridgeGetHWInfoOperation>(aMultiBusReaderWriter);
   auto lBridgeGetSupportedComponentsOperation = std::make_shared<CBridgeGetSupportedComponentsOperation>(
       aMultiBusReaderWriter);
   auto lBridgeDelayRequestOperation = std::make_shared<CBridgeDelayRequestOperation>(aMultiBusReaderWriter);
+  auto lBridgeFramingOperation = std::make_shared<CBridgeFramingOperation>(aMultiBusReaderWriter);
 
   lBridge->registerOperation(MB_OPERATION_BRIDGE_PROTOCOL_VERSION_REQUEST, lBridgeGetProtocolVersionOperation);
   lBridge->registerOperation(MB_OPERATION_BRIDGE_HARDWARE_INFO_REQUEST, lBridgeGetHWInfoOperation);
@@ -55,6 +65,7 @@ CComponentFactory::createBridgeComponent(std::shared_ptr<IMultiBusMessageReaderW
   lBridge->registerOperation(MB_OPERATION_BRIDGE_SUPPORTED_COMPONENTS_REQUEST,
                              lBridgeGetSupportedComponentsOperation);
   lBridge->registerOperation(MB_OPERATION_BRIDGE_DELAY_REQUEST, lBridgeDelayRequestOperation);
+  lBridge->registerOperation(MB_OPERATION_BRIDGE_FRAMING_REQUEST, lBridgeFramingOperation);
 
   return lBridge;
 }
@@ -90,3 +101,41 @@ CComponentFactory::createSPIMasterComponent(std::shared_ptr<IMultiBusMessageRead
   lSpiMaster->registerOperation(MB_OPERATION_SPI_MASTER_WRITE_REQUEST, lSpiWriteOperation);
   return lSpiMaster;
 }
+
+std::shared_ptr<IComponent>
+CComponentFactory::createBatchComponent(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter,
+                                        std::weak_ptr<CMultiBusOperationExecutor> aOperationExecutor) {
+  auto lBatch = std::make_shared<CBatch>();
+
+  // batch operations
+  auto lBatchExecuteOperation = std::make_shared<CBatchExecuteOperation>(aMultiBusReaderWriter, aOperationExecutor);
+
+  lBatch->registerOperation(MB_OPERATION_BATCH_EXECUTE_REQUEST, lBatchExecuteOperation);
+  return lBatch;
+}
+
+std::shared_ptr<IComponent>
+CComponentFactory::createSequencerComponent(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter,
+                                            std::shared_ptr<CSPIMaster> aSpiMaster) {
+  auto lSequencer = std::make_shared<CSequencer>();
+
+  // sequencer operations, SPI devices are configured via SPI master component
+  auto lSequencerRunOperation = std::make_shared<CSequencerRunOperation>(aSpiMaster, aMultiBusReaderWriter);
+
+  lSequencer->registerOperation(MB_OPERATION_SEQUENCER_RUN_REQUEST, lSequencerRunOperation);
+  return lSequencer;
+}
+
+std::shared_ptr<IComponent>
+CComponentFactory::createSamplerComponent(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter,
+                                          std::shared_ptr<CSPIMaster> aSpiMaster) {
+  auto lSampler = std::make_shared<CSampler>(aMultiBusReaderWriter, aSpiMaster);
+
+  // sampler operations, jobs run in sampler thread
+  auto lSamplerAddJobOperation = std::make_shared<CSamplerAddJobOperation>(lSampler, aMultiBusReaderWriter);
+  auto lSamplerRemoveJobOperation = std::make_shared<CSamplerRemoveJobOperation>(lSampler, aMultiBusReaderWriter);
+
+  lSampler->registerOperation(MB_OPERATION_SAMPLER_ADD_JOB_REQUEST, lSamplerAddJobOperation);
+  lSampler->registerOperation(MB_OPERATION_SAMPLER_REMOVE_JOB_REQUEST, lSamplerRemoveJobOperation);
+  return lSampler;
+}
@@ -26,12 +26,22 @@
 #include <memory>
 #include "IComponent.h"
 #include "IMultiBusMessageReaderWriter.h"
+#include "CMultiBusOperationExecutor.h"
+#include "CSPIMaster.h"
+#include "CSampler.h"
 
 class CComponentFactory {
 public:
-    static std::shared_ptr<IComponent> createBridgeComponent(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter);
+    static std::shared_ptr<IComponent> createBridgeComponent(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter,
+                                                             std::weak_ptr<CSampler> aSampler);
     static std::shared_ptr<IComponent> createI2CMasterComponent(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter);
     static std::shared_ptr<IComponent> createSPIMasterComponent(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter);
+    static std::shared_ptr<IComponent> createBatchComponent(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter,
+                                                            std::weak_ptr<CMultiBusOperationExecutor> aOperationExecutor);
+    static std::shared_ptr<IComponent> createSequencerComponent(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter,
+                                                                std::shared_ptr<CSPIMaster> aSpiMaster);
+    static std::shared_ptr<IComponent> createSamplerComponent(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter,
+                                                              std::shared_ptr<CSPIMaster> aSpiMaster);
 };
 
 #endif //MULTIBUS_MAIN_COMPONENT_FACTORY_INCLUDED
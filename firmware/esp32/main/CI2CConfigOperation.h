@@ -28,6 +28,7 @@
 #include <array>
 #include <driver/i2c.h>
 #include <esp_log.h>
+#include <multibus_protocol.hpp>
 #include "CHardwareInfo.h"
 
 class CI2ConfigOperation : public IMultiBusOperation {
@@ -43,6 +44,13 @@ class CI2ConfigOperation : public IMultiBusOperation {
   void execute(const SMultiBusMessage &aMessage) override {
     ESP_LOGI("I2C", "i2c_master_config\n");
 
+    mb::i2c_master::config_request::view lRequest(aMessage.mPayload);
+    if (!lRequest.valid()) {
+      auto lLen = mb::i2c_master::config_response::setup(sSendBuffer, aMessage.mChannel, MB_STATUS_INVALID_ARGUMENTS);
+      mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
+      return;
+    }
+
     esp_err_t lRet = ESP_OK;
     if (isPortConfigured(aMessage.mChannel)) {
       ESP_LOGI("I2C", "Reset I2C driver for channel: %d", aMessage.mChannel);
@@ -56,8 +64,8 @@ class CI2ConfigOperation : public IMultiBusOperation {
           .mode = I2C_MODE_MASTER,
           .sda_io_num = I2C_MASTER_SDA_IO, // todo choose fixed pins for given i2c port number
           .scl_io_num = I2C_MASTER_SCL_IO, // todo choose fixed pins for given i2c port number
-          .sda_pullup_en = static_cast<bool>(mb_i2c_master_config_request_get_enable_sda_pullup(aMessage.mPayload.data())),
-          .scl_pullup_en = static_cast<bool>(mb_i2c_master_config_request_get_enable_scl_pullup(aMessage.mPayload.data())),
+          .sda_pullup_en = lRequest.enable_sda_pullup(),
+          .scl_pullup_en = lRequest.enable_scl_pullup(),
           .master = {.clk_speed = I2C_CLK_SPEED_100_KHZ},
           // Optional, you can use I2C_SCLK_SRC_FLAG_* flags to choose i2c source clock here
           .clk_flags = 0,
@@ -76,10 +84,10 @@ class CI2ConfigOperation : public IMultiBusOperation {
     // TODO use constants for state
     if (lRet == ESP_OK) {
       mConfiguredI2cPorts[aMessage.mChannel] = true;
-      lLen = mb_i2c_master_config_response_setup(sSendBuffer.data(), sSendBuffer.size(), aMessage.mChannel,MB_STATUS_OK);
+      lLen = mb::i2c_master::config_response::setup(sSendBuffer, aMessage.mChannel, MB_STATUS_OK);
     } else {
       ESP_LOGE("I2C", "I2C configure error: %d", lRet);
-      lLen = mb_i2c_master_config_response_setup(sSendBuffer.data(), sSendBuffer.size(), aMessage.mChannel, MB_STATUS_UNKNOWN_ERROR);
+      lLen = mb::i2c_master::config_response::setup(sSendBuffer, aMessage.mChannel, MB_STATUS_UNKNOWN_ERROR);
     }
 
     mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
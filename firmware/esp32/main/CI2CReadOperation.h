@@ -28,7 +28,7 @@
 #include <array>
 #include <driver/i2c.h>
 #include <esp_log.h>
-
+#include <multibus_protocol.hpp>
 
 class CI2ReadOperation : public IMultiBusOperation {
  public:
@@ -40,17 +40,23 @@ class CI2ReadOperation : public IMultiBusOperation {
   void execute(const SMultiBusMessage& aMessage) override {
     ESP_LOGI("I2C", "i2c_master_read\n");
 
-    // payload format: [2B slave][data]
+    mb::i2c_master::read_request::view lRequest(aMessage.mPayload);
+    if (!lRequest.valid()) {
+      auto lLen = mb::i2c_master::read_response::setup(sSendBuffer, aMessage.mChannel, MB_STATUS_INVALID_ARGUMENTS, 0, {});
+      mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
+      return;
+    }
+
     int lAckEnable = 0x1; // todo move to protocol into read operation
 
-    const int lNumBytesToRead = mb_i2c_master_read_request_get_num_bytes(aMessage.mPayload.data());
+    const int lNumBytesToRead = lRequest.num_bytes();
     std::array<uint8_t, 1024> lReadBytes{}; // todo max read len
 
     i2c_cmd_handle_t cmd = i2c_cmd_link_create();
     i2c_master_start(cmd);
     // setup address and write mode
     // todo only supported 7bit address here -> correctly read out address for 10bit
-    uint16_t lSlaveAddress = mb_i2c_master_read_request_get_address(aMessage.mPayload.data());
+    uint16_t lSlaveAddress = lRequest.address();
     i2c_master_write_byte(cmd, lSlaveAddress << 1 | I2C_MASTER_READ, lAckEnable);
 
     // all but the last are ACK'ed
@@ -67,11 +73,10 @@ class CI2ReadOperation : public IMultiBusOperation {
     ESP_LOGI("I2C", "I2C Read Result: 0x%X\n", lRet);
     i2c_cmd_link_delete(cmd);
 
-    auto lLen = mb_i2c_master_read_response_setup(sSendBuffer.data(), sSendBuffer.size(),
-                                      aMessage.mChannel,
-                                      (lRet == ESP_OK) ? MB_STATUS_OK : MB_STATUS_UNKNOWN_ERROR,
-                                      lSlaveAddress,
-                                      lNumBytesToRead, lReadBytes.data());
+    auto lLen = mb::i2c_master::read_response::setup(sSendBuffer, aMessage.mChannel,
+                                                     (lRet == ESP_OK) ? MB_STATUS_OK : MB_STATUS_UNKNOWN_ERROR,
+                                                     lSlaveAddress,
+                                                     {lReadBytes.begin(), lReadBytes.begin() + lNumBytesToRead});
 
     mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
   }
@@ -27,6 +27,7 @@
 #include "IMultiBusMessageReaderWriter.h"
 #include <driver/i2c.h>
 #include <esp_log.h>
+#include <multibus_protocol.hpp>
 
 class CI2CWriteOperation : public IMultiBusOperation {
  public:
@@ -38,6 +39,13 @@ class CI2CWriteOperation : public IMultiBusOperation {
   void execute(const SMultiBusMessage& aMessage) override {
     ESP_LOGI("I2C", "i2c_master_write\n");
 
+    mb::i2c_master::write_request::view lRequest(aMessage.mPayload);
+    if (!lRequest.valid()) {
+      auto lLen = mb::i2c_master::write_response::setup(sSendBuffer, aMessage.mChannel, MB_STATUS_INVALID_ARGUMENTS, 0);
+      mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
+      return;
+    }
+
     int lAckEnable = 0x1; // todo move to protocol into read operation
 
     i2c_cmd_handle_t cmd = i2c_cmd_link_create();
@@ -45,14 +53,11 @@ class CI2CWriteOperation : public IMultiBusOperation {
 
     // setup address and write mode
     // todo only supported 7bit address here -> correctly read out address for 10bit
-    uint16_t lSlaveAddress = mb_i2c_master_write_request_get_address(aMessage.mPayload.data());
+    uint16_t lSlaveAddress = lRequest.address();
     i2c_master_write_byte(cmd, lSlaveAddress << 1 | I2C_MASTER_WRITE, lAckEnable);
 
-    auto lData = mb_i2c_master_write_request_get_data(aMessage.mPayload.data());
-    const auto lDataLen = mb_i2c_master_write_request_get_data_len(aMessage.mLength);
-
-    for (int i = 0; i < lDataLen; i++) {
-      i2c_master_write_byte(cmd, lData[i], lAckEnable);
+    for (auto lByte : lRequest.data()) {
+      i2c_master_write_byte(cmd, lByte, lAckEnable);
     }
 
     i2c_master_stop(cmd);
@@ -63,8 +68,7 @@ class CI2CWriteOperation : public IMultiBusOperation {
 
     // status + slave address
     const auto lStatus = (lRet == ESP_OK) ? MB_STATUS_OK : MB_STATUS_UNKNOWN_ERROR; // todo different errors (timeout, ..)
-    auto lLen = mb_i2c_master_write_response_setup(sSendBuffer.data(), sSendBuffer.size(),
-                                       aMessage.mChannel, lStatus, lSlaveAddress);
+    auto lLen = mb::i2c_master::write_response::setup(sSendBuffer, aMessage.mChannel, lStatus, lSlaveAddress);
 
     mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
   }
@@ -27,6 +27,7 @@
 #include "IMultiBusMessageReaderWriter.h"
 #include "driver/spi_master.h"
 #include <esp_log.h>
+#include <multibus_protocol.hpp>
 #include "CHardwareInfo.h"
 #include "CSPIMaster.h"
 
@@ -49,13 +50,14 @@ class CSPIConfigOperation : public IMultiBusOperation {
   void execute(const SMultiBusMessage &aMessage) override {
     ESP_LOGI("SPI-MASTER", "spi_master_config\n");
 
+    mb::spi_master::config_request::view lRequest(aMessage.mPayload);
     spi_host_device_t lSpiHost = CHardwareInfo::getSpiHostDeviceForMultibusChannelNumber(aMessage.mChannel);
-    if (lSpiHost == SPI_HOST_MAX) {
+    if (lSpiHost == SPI_HOST_MAX || !lRequest.valid()) {
       // invalid channel -> return error
       ESP_LOGE("SPI-MASTER", "SPI configure error: Received invalid channel configuration");
-      auto lLen = mb_spi_master_config_response_setup(sSendBuffer.data(), sSendBuffer.size(), aMessage.mChannel,
-                                                      MB_STATUS_INVALID_ARGUMENTS);
+      auto lLen = mb::spi_master::config_response::setup(sSendBuffer, aMessage.mChannel, MB_STATUS_INVALID_ARGUMENTS);
       mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
+      return;
     }
 
     // if spi port is already configure -> return error
@@ -88,9 +90,9 @@ class CSPIConfigOperation : public IMultiBusOperation {
       // spi initialization failed - return error
       ESP_LOGE("SPI-MASTER", "SPI initialization error: %d", lRet);
 
-      auto lLen = mb_spi_master_config_response_setup(sSendBuffer.data(), sSendBuffer.size(), aMessage.mChannel,
-                                                      MB_STATUS_UNKNOWN_ERROR);
+      auto lLen = mb::spi_master::config_response::setup(sSendBuffer, aMessage.mChannel, MB_STATUS_UNKNOWN_ERROR);
       mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
+      return;
     }
     ESP_LOGI("SPI-MASTER", "SPI Master: %d configured successfully.", lSpiHost);
 
@@ -102,7 +104,7 @@ class CSPIConfigOperation : public IMultiBusOperation {
         .duty_cycle_pos = 0,
         .cs_ena_pretrans = 0,
         .cs_ena_posttrans = 0,
-        .clock_speed_hz = (int)mb_spi_master_config_request_get_baud_rate(aMessage.mPayload.data()),
+        .clock_speed_hz = (int)lRequest.baud_rate(),
         .input_delay_ns = 0,
         .spics_io_num = SPI_MASTER_CS_IO, // TODO support different CS per host
         .flags = SPI_DEVICE_HALFDUPLEX,
@@ -115,9 +117,9 @@ class CSPIConfigOperation : public IMultiBusOperation {
     if (auto lRet = spi_bus_add_device(lSpiHost, &lDeviceConfig, &lDeviceHandle) != ESP_OK) {
       ESP_LOGE("SPI-MASTER", "SPI configure slave error: %d", lRet);
 
-      auto lLen = mb_spi_master_config_response_setup(sSendBuffer.data(), sSendBuffer.size(), aMessage.mChannel,
-                                                      MB_STATUS_UNKNOWN_ERROR);
+      auto lLen = mb::spi_master::config_response::setup(sSendBuffer, aMessage.mChannel, MB_STATUS_UNKNOWN_ERROR);
       mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
+      return;
     }
 
     ESP_LOGI("SPI-MASTER", "SPI Slave attached successfully.");
@@ -126,8 +128,7 @@ class CSPIConfigOperation : public IMultiBusOperation {
 
 
     // everything ok
-    auto lLen = mb_spi_master_config_response_setup(
-        sSendBuffer.data(), sSendBuffer.size(), aMessage.mChannel, MB_STATUS_OK);
+    auto lLen = mb::spi_master::config_response::setup(sSendBuffer, aMessage.mChannel, MB_STATUS_OK);
     mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
   }
 
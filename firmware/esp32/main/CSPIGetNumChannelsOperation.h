@@ -27,6 +27,7 @@
 #include "IMultiBusMessageReaderWriter.h"
 #include "driver/spi_master.h"
 #include <esp_log.h>
+#include <multibus_protocol.hpp>
 #include "CHardwareInfo.h"
 #include "CSPIMaster.h"
 
@@ -41,9 +42,7 @@ public:
     void execute(const SMultiBusMessage &aMessage) override {
         ESP_LOGI("SPI", "spi_get_num_channels\n");
 
-        auto lLen = mb_spi_master_get_num_channels_response_setup(
-                sSendBuffer.data(),sSendBuffer.size(), 0x0,
-                CHardwareInfo::getNumSpiPorts());
+        auto lLen = mb::spi_master::get_num_channels_response::setup(sSendBuffer, 0x0, CHardwareInfo::getNumSpiPorts());
         mMultiBusReaderWriter->writeMultibusMessageBuffer(
                 {sSendBuffer.begin(), sSendBuffer.begin() + lLen});
     }
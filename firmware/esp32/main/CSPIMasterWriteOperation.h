@@ -26,6 +26,7 @@
 #include "IMultiBusOperation.h"
 #include "IMultiBusMessageReaderWriter.h"
 #include <esp_log.h>
+#include <multibus_protocol.hpp>
 #include "driver/spi_master.h"
 
 class CSPIMasterWriteOperation : public IMultiBusOperation {
@@ -40,13 +41,14 @@ class CSPIMasterWriteOperation : public IMultiBusOperation {
   void execute(const SMultiBusMessage& aMessage) override {
     ESP_LOGD("SPI-MASTER", "spi_master_write\n");
 
+    mb::spi_master::write_request::view lRequest(aMessage.mPayload);
     spi_host_device_t lSpiHost = CHardwareInfo::getSpiHostDeviceForMultibusChannelNumber(aMessage.mChannel);
-    if (lSpiHost == SPI_HOST_MAX) {
+    if (lSpiHost == SPI_HOST_MAX || !lRequest.valid()) {
       // invalid channel -> return error
       ESP_LOGE("SPI-MASTER", "SPI configure error: Received invalid channel configuration");
-      auto lLen = mb_spi_master_config_response_setup(sSendBuffer.data(), sSendBuffer.size(), aMessage.mChannel,
-                                                      MB_STATUS_INVALID_ARGUMENTS);
+      auto lLen = mb::spi_master::write_response::setup(sSendBuffer, aMessage.mChannel, MB_STATUS_INVALID_ARGUMENTS);
       mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
+      return;
     }
 
     // if spi port not configured -> error
@@ -54,28 +56,27 @@ class CSPIMasterWriteOperation : public IMultiBusOperation {
     if (lSpiDeviceHandle == nullptr) {
       ESP_LOGE("SPI-MASTER", "SPI not configured for host: %d", lSpiHost);
 
-      auto lLen = mb_spi_master_config_response_setup(sSendBuffer.data(), sSendBuffer.size(), aMessage.mChannel,
-                                                      MB_STATUS_UNKNOWN_ERROR); // TODO status
+      auto lLen = mb::spi_master::write_response::setup(sSendBuffer, aMessage.mChannel, MB_STATUS_UNKNOWN_ERROR); // TODO status
       mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
+      return;
     }
 
     spi_transaction_t lTransaction = {
         .flags = 0,
-        .length = 8 * (size_t)mb_spi_master_write_request_get_data_len(aMessage.mLength),
-        .tx_buffer = mb_spi_master_write_request_get_data(aMessage.mPayload.data())
+        .length = 8 * lRequest.data().size(),
+        .tx_buffer = lRequest.data().data()
     };
 
     if (auto lRet = spi_device_polling_transmit(lSpiDeviceHandle, &lTransaction) != ESP_OK) {
       ESP_LOGE("SPI-MASTER", "SPI write/transmit error: %d", lRet);
 
-      auto lLen = mb_spi_master_config_response_setup(sSendBuffer.data(), sSendBuffer.size(), aMessage.mChannel,
-                                                      MB_STATUS_UNKNOWN_ERROR); // TODO status
+      auto lLen = mb::spi_master::write_response::setup(sSendBuffer, aMessage.mChannel, MB_STATUS_UNKNOWN_ERROR); // TODO status
       mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
+      return;
     }
 
     ESP_LOGD("SPI-MASTER", "SPI Write ok");
-    auto lLen = mb_spi_master_config_response_setup(
-        sSendBuffer.data(), sSendBuffer.size(), aMessage.mChannel, MB_STATUS_OK);
+    auto lLen = mb::spi_master::write_response::setup(sSendBuffer, aMessage.mChannel, MB_STATUS_OK);
     mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
   }
 
@@ -0,0 +1,90 @@
+/**
+ *
+ * Copyright 2022 Boris Zweimüller
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CSampler.h"
+#include <algorithm>
+#include <chrono>
+
+CSampler::CSampler(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter,
+                   std::shared_ptr<CSPIMaster> aSpiMaster) :
+    mMultiBusReaderWriter(std::move(aMultiBusReaderWriter)), mSpiMaster(std::move(aSpiMaster)) {
+  mb_sampler_init(&mSampler, &CSequencerBus::sBus, &CSampler::getBusContext, this);
+  mThread = std::thread(&CSampler::run, this);
+}
+
+CSampler::~CSampler() {
+  {
+    std::lock_guard<std::mutex> lLock(mMutex);
+    mStop = true;
+  }
+  mCondition.notify_one();
+  mThread.join();
+}
+
+std::mutex& CSampler::getMutex() {
+  return mMutex;
+}
+
+mb_status_t CSampler::addJob(uint8_t aJobId, uint8_t aChannel, uint16_t aPeriodMs, uint16_t aMaxLatencyMs,
+                             std::span<const uint8_t> aProgram) {
+  auto lStatus = mb_sampler_add_job(&mSampler, aJobId, aChannel, aPeriodMs, aMaxLatencyMs, aProgram.data(),
+                                    aProgram.size(), getTimeUs());
+  // first sample is due now
+  mCondition.notify_one();
+  return lStatus;
+}
+
+mb_status_t CSampler::removeJob(uint8_t aJobId) {
+  return mb_sampler_remove_job(&mSampler, aJobId);
+}
+
+void CSampler::removeAllJobs() {
+  mb_sampler_remove_all_jobs(&mSampler);
+}
+
+void CSampler::run() {
+  std::unique_lock<std::mutex> lLock(mMutex);
+  while (!mStop) {
+    auto lNowUs = getTimeUs();
+    auto lEventLen = mb_sampler_process(&mSampler, lNowUs, mEventBuffer.data(), mEventBuffer.size());
+    if (lEventLen > 0) {
+      mMultiBusReaderWriter->writeMultibusEventBuffer({mEventBuffer.begin(), mEventBuffer.begin() + lEventLen});
+      continue;
+    }
+    // wake up regularly, timeout is UINT32_MAX without jobs
+    auto lTimeoutUs = std::min(mb_sampler_get_timeout_us(&mSampler, lNowUs), MAX_WAIT_US);
+    mCondition.wait_for(lLock, std::chrono::microseconds(lTimeoutUs));
+  }
+}
+
+uint32_t CSampler::getTimeUs() {
+  // truncated to 32 bit, sampler handles wrap-around
+  auto lNow = std::chrono::steady_clock::now().time_since_epoch();
+  return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(lNow).count());
+}
+
+void* CSampler::getBusContext(void* aContext, uint8_t aChannel) {
+  // SPI devices may be configured after the job has been added
+  auto* lSampler = static_cast<CSampler*>(aContext);
+  lSampler->mBusContext = CSequencerBus::getContextForChannel(aChannel, *lSampler->mSpiMaster);
+  return &lSampler->mBusContext;
+}
@@ -0,0 +1,72 @@
+/**
+ *
+ * Copyright 2022 Boris Zweimüller
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_MAIN_SAMPLER_INCLUDED
+#define MULTIBUS_MAIN_SAMPLER_INCLUDED
+
+#include "multibus_protocol.h"
+#include "CComponent.h"
+#include "CSequencerBus.h"
+#include "CSPIMaster.h"
+#include "IMultiBusMessageReaderWriter.h"
+#include <multibus_sampler.h>
+#include <array>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+
+// runs sampler jobs in its own thread and sends samples events
+class CSampler : public CComponent<mb_operation_sampler_t> {
+ public:
+  CSampler(std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter, std::shared_ptr<CSPIMaster> aSpiMaster);
+  ~CSampler() override;
+
+  // jobs share buses and serial with requests, hold while executing requests
+  std::mutex& getMutex();
+
+  // called with mutex held
+  mb_status_t addJob(uint8_t aJobId, uint8_t aChannel, uint16_t aPeriodMs, uint16_t aMaxLatencyMs,
+                     std::span<const uint8_t> aProgram);
+  mb_status_t removeJob(uint8_t aJobId);
+  void removeAllJobs();
+
+ private:
+  static constexpr uint32_t MAX_WAIT_US = 1000000;
+
+  void run();
+  static uint32_t getTimeUs();
+  static void* getBusContext(void* aContext, uint8_t aChannel);
+
+  std::shared_ptr<IMultiBusMessageReaderWriter> mMultiBusReaderWriter;
+  std::shared_ptr<CSPIMaster> mSpiMaster;
+  mb_sampler_t mSampler{};
+  CSequencerBus::SContext mBusContext{};
+  std::array<uint8_t, MB_HEADER_SIZE + MB_SAMPLER_MAX_SAMPLES_LEN> mEventBuffer{};
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  bool mStop{false};
+  std::thread mThread;
+};
+
+#endif //MULTIBUS_MAIN_SAMPLER_INCLUDED
@@ -0,0 +1,63 @@
+/**
+ *
+ * Copyright 2022 Boris Zweimüller
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_MAIN_C_SAMPLER_REMOVE_JOB_OPERATION_INCLUDED
+#define MULTIBUS_MAIN_C_SAMPLER_REMOVE_JOB_OPERATION_INCLUDED
+
+#include "IMultiBusOperation.h"
+#include "IMultiBusMessageReaderWriter.h"
+#include "CSampler.h"
+#include <esp_log.h>
+#include <multibus_protocol.hpp>
+#include <memory>
+
+class CSamplerRemoveJobOperation : public IMultiBusOperation {
+ public:
+  CSamplerRemoveJobOperation(std::weak_ptr<CSampler> aSampler,
+                             std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter)
+  : mSampler(std::move(aSampler)), mMultiBusReaderWriter(std::move(aMultiBusReaderWriter)) {}
+
+  ~CSamplerRemoveJobOperation() override = default;
+
+  void execute(const SMultiBusMessage& aMessage) override {
+    ESP_LOGI("Sampler", "sampler_remove_job_request\n");
+
+    mb::sampler::remove_job_request::view lRequest(aMessage.mPayload);
+    uint8_t lJobId = 0;
+    auto lStatus = MB_STATUS_INVALID_ARGUMENTS;
+    auto lSampler = mSampler.lock();
+    if (lSampler && lRequest.valid()) {
+      lJobId = lRequest.job_id();
+      lStatus = lSampler->removeJob(lJobId);
+    }
+    ESP_LOGI("Sampler", "Remove job %u, status 0x%X\n", lJobId, lStatus);
+
+    auto lLen = mb::sampler::remove_job_response::setup(sSendBuffer, aMessage.mChannel, lStatus, lJobId);
+    mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lLen});
+  }
+
+ private:
+  std::weak_ptr<CSampler> mSampler;
+  std::shared_ptr<IMultiBusMessageReaderWriter> mMultiBusReaderWriter{};
+};
+
+#endif // MULTIBUS_MAIN_C_SAMPLER_REMOVE_JOB_OPERATION_INCLUDED
@@ -0,0 +1,112 @@
+/**
+ *
+ * Copyright 2022 Boris Zweimüller
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_MAIN_C_SEQUENCER_BUS_INCLUDED
+#define MULTIBUS_MAIN_C_SEQUENCER_BUS_INCLUDED
+
+#include "CHardwareInfo.h"
+#include "CSPIMaster.h"
+#include <driver/i2c.h>
+#include "driver/spi_master.h"
+#include <esp_log.h>
+#include <multibus_sequencer.h>
+#include <memory>
+#include <thread>
+
+// bus access for sequencer programs, used by sequencer run requests and sampler jobs
+class CSequencerBus {
+ public:
+  struct SContext {
+    i2c_port_t mI2CPort;
+    spi_device_handle_t mSpiDeviceHandle;
+  };
+
+  // channel selects I2C port and SPI host
+  static SContext getContextForChannel(uint8_t aChannel, CSPIMaster& aSpiMaster) {
+    SContext lContext{static_cast<i2c_port_t>(aChannel), nullptr};
+    spi_host_device_t lSpiHost = CHardwareInfo::getSpiHostDeviceForMultibusChannelNumber(aChannel);
+    if (lSpiHost != SPI_HOST_MAX) {
+      lContext.mSpiDeviceHandle = aSpiMaster.getDeviceHandleForHost(lSpiHost);
+    }
+    return lContext;
+  }
+
+ private:
+  // todo only supported 7bit address here, as for I2C master requests
+  static bool i2cWrite(void* aContext, uint16_t aAddress, const uint8_t* aData, uint16_t aLen) {
+    auto* lBusContext = static_cast<SContext*>(aContext);
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, aAddress << 1 | I2C_MASTER_WRITE, true);
+    for (int i = 0; i < aLen; i++) {
+      i2c_master_write_byte(cmd, aData[i], true);
+    }
+    i2c_master_stop(cmd);
+    esp_err_t lRet = i2c_master_cmd_begin(lBusContext->mI2CPort, cmd, 1000 / portTICK_PERIOD_MS);
+    i2c_cmd_link_delete(cmd);
+    return lRet == ESP_OK;
+  }
+
+  static bool i2cRead(void* aContext, uint16_t aAddress, uint8_t* aData, uint16_t aLen) {
+    auto* lBusContext = static_cast<SContext*>(aContext);
+    if (aLen == 0) {
+      return i2cWrite(aContext, aAddress, nullptr, 0);
+    }
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, aAddress << 1 | I2C_MASTER_READ, true);
+    // all but the last are ACK'ed
+    if (aLen > 1) {
+      i2c_master_read(cmd, aData, aLen - 1, I2C_MASTER_ACK);
+    }
+    i2c_master_read_byte(cmd, &aData[aLen - 1], I2C_MASTER_NACK);
+    i2c_master_stop(cmd);
+    esp_err_t lRet = i2c_master_cmd_begin(lBusContext->mI2CPort, cmd, 1000 / portTICK_PERIOD_MS);
+    i2c_cmd_link_delete(cmd);
+    return lRet == ESP_OK;
+  }
+
+  // chip select is configured with the SPI device
+  static bool spiTransfer(void* aContext, uint8_t aChipSelectGpio, const uint8_t* aTxData, uint8_t* aRxData, uint16_t aLen) {
+    (void) aChipSelectGpio;
+    auto* lBusContext = static_cast<SContext*>(aContext);
+    if (lBusContext->mSpiDeviceHandle == nullptr) {
+      ESP_LOGE("Sequencer", "SPI not configured for channel");
+      return false;
+    }
+    spi_transaction_t lTransaction = {};
+    lTransaction.length = 8 * (size_t) aLen;
+    lTransaction.tx_buffer = aTxData;
+    lTransaction.rx_buffer = aRxData;
+    return spi_device_polling_transmit(lBusContext->mSpiDeviceHandle, &lTransaction) == ESP_OK;
+  }
+
+  static void delayMs(void* aContext, uint32_t aMs) {
+    (void) aContext;
+    std::this_thread::sleep_for(std::chrono::milliseconds(aMs));
+  }
+
+ public:
+  static constexpr mb_sequencer_bus_t sBus{i2cWrite, i2cRead, spiTransfer, delayMs};
+};
+
+#endif // MULTIBUS_MAIN_C_SEQUENCER_BUS_INCLUDED
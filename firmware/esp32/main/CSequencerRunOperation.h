@@ -0,0 +1,66 @@
+/**
+ *
+ * Copyright 2022 Boris Zweimüller
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_MAIN_C_SEQUENCER_RUN_OPERATION_INCLUDED
+#define MULTIBUS_MAIN_C_SEQUENCER_RUN_OPERATION_INCLUDED
+
+#include "IMultiBusOperation.h"
+#include "IMultiBusMessageReaderWriter.h"
+#include "CSequencerBus.h"
+#include "CSPIMaster.h"
+#include <esp_log.h>
+#include <multibus_protocol.hpp>
+#include <multibus_sequencer.h>
+#include <memory>
+
+class CSequencerRunOperation : public IMultiBusOperation {
+ public:
+  CSequencerRunOperation(std::shared_ptr<CSPIMaster> aSpiMaster,
+                         std::shared_ptr<IMultiBusMessageReaderWriter> aMultiBusReaderWriter)
+  : mSpiMaster(std::move(aSpiMaster)), mMultiBusReaderWriter(std::move(aMultiBusReaderWriter)) {}
+
+  ~CSequencerRunOperation() override = default;
+
+  void execute(const SMultiBusMessage& aMessage) override {
+    ESP_LOGI("Sequencer", "sequencer_run_request\n");
+
+    auto lBusContext = CSequencerBus::getContextForChannel(aMessage.mChannel, *mSpiMaster);
+
+    // program is executed synchronously, data is appended directly into response
+    constexpr auto lFixedLen = mb::sequencer::run_response::fixed_size;
+    static_assert(sSendBuffer.size() > lFixedLen);
+    auto lProgram = mb::sequencer::run_request::view(aMessage.mPayload).program();
+    uint16_t lDataLen = 0;
+    auto lStatus = mb_sequencer_run(&CSequencerBus::sBus, &lBusContext, lProgram.data(), lProgram.size(),
+                                    sSendBuffer.data() + lFixedLen, sSendBuffer.size() - lFixedLen, &lDataLen);
+    ESP_LOGI("Sequencer", "Sequencer Result: 0x%X, %u bytes of data\n", lStatus, lDataLen);
+
+    (void) mb::sequencer::run_response::setup_fixed(sSendBuffer, aMessage.mChannel, lStatus, lDataLen);
+    mMultiBusReaderWriter->writeMultibusMessageBuffer({sSendBuffer.begin(), sSendBuffer.begin() + lFixedLen + lDataLen});
+  }
+
+ private:
+  std::shared_ptr<CSPIMaster> mSpiMaster;
+  std::shared_ptr<IMultiBusMessageReaderWriter> mMultiBusReaderWriter{};
+};
+
+#endif // MULTIBUS_MAIN_C_SEQUENCER_RUN_OPERATION_INCLUDED
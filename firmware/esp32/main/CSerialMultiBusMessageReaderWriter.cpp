@@ -22,13 +22,46 @@
 
 #include "multibus_protocol.h"
 #include "CSerialMultiBusMessageReaderWriter.h"
+#include <esp_log.h>
+#include <algorithm>
 #include <array>
 
 CSerialMultiBusMessageReaderWriter::CSerialMultiBusMessageReaderWriter(std::shared_ptr<ISerial> aSerial) :
     mSerial(std::move(aSerial)) {}
 
 SMultiBusMessage CSerialMultiBusMessageReaderWriter::readMultiBusMessage() const {
+  SMultiBusMessage lMessage;
+  if (mFramingMode != MB_BRIDGE_FRAMING_REQUEST_MODE_NONE) {
+    lMessage = readFramedMultiBusMessage();
+  } else {
+    lMessage = readUnframedMultiBusMessage();
+  }
+  if (hasTrailer(lMessage)) {
+    stripTrailer(lMessage);
+  }
+  return lMessage;
+}
+
+bool CSerialMultiBusMessageReaderWriter::hasTrailer(const SMultiBusMessage& aMessage) const {
+  // protocol version request is accepted with and without trailer, as the host does not know the current version
+  if (aMessage.mSubsystem == MB_COMPONENT_BRIDGE && aMessage.mOpcode == MB_OPERATION_BRIDGE_PROTOCOL_VERSION_REQUEST) {
+    return aMessage.mPayload.size() == MB_TRAILER_SIZE || aMessage.mPayload.size() == 2 + MB_TRAILER_SIZE;
+  }
+  return mProtocolVersion >= MB_TRAILER_VERSION;
+}
 
+void CSerialMultiBusMessageReaderWriter::stripTrailer(SMultiBusMessage& aMessage) const {
+  if (aMessage.mPayload.size() < MB_TRAILER_SIZE) {
+    ESP_LOGW("Bridge", "message without trailer");
+    mTag = 0;
+    return;
+  }
+  mTag = mb_trailer_get_tag(aMessage.mPayload.data() + aMessage.mPayload.size() - MB_TRAILER_SIZE);
+  aMessage.mPayload.resize(aMessage.mPayload.size() - MB_TRAILER_SIZE);
+  aMessage.mLength -= MB_TRAILER_SIZE;
+}
+
+SMultiBusMessage CSerialMultiBusMessageReaderWriter::readUnframedMultiBusMessage() const {
   SMultiBusMessage lMessage;
 
   // read and fill header
@@ -49,6 +82,64 @@ SMultiBusMessage CSerialMultiBusMessageReaderWriter::readMultiBusMessage() const
   return lMessage;
 }
 
+SMultiBusMessage CSerialMultiBusMessageReaderWriter::readFramedMultiBusMessage() const {
+
+  // read until a valid frame is complete, corrupted frames are dropped at the next delimiter
+  mb_framing_decoder_t lDecoder;
+  mb_framing_decoder_init(&lDecoder, mReceiveFrame.data(), mReceiveFrame.size());
+  uint16_t lMessageLen = 0;
+  while (lMessageLen == 0) {
+    lMessageLen = mb_framing_decoder_put(&lDecoder, mSerial->readByte());
+  }
+  if (lDecoder.num_errors > 0) {
+    ESP_LOGW("Bridge", "dropped %u invalid frames", (unsigned) lDecoder.num_errors);
+  }
+
+  SMultiBusMessage lMessage;
+  lMessage.mSubsystem = mb_header_get_component(mReceiveFrame.data());
+  lMessage.mOpcode = mb_header_get_operation(mReceiveFrame.data());
+  lMessage.mChannel = mb_header_get_channel(mReceiveFrame.data());
+  lMessage.mLength = mb_header_get_length(mReceiveFrame.data());
+  lMessage.mPayload.assign(mReceiveFrame.begin() + MB_HEADER_SIZE, mReceiveFrame.begin() + lMessageLen);
+  return lMessage;
+}
+
 void CSerialMultiBusMessageReaderWriter::writeMultibusMessageBuffer(const std::span<uint8_t>& aData) const {
-  mSerial->writeBytes(aData);
+  if (mResponseCollector != nullptr) {
+    mResponseCollector->insert(mResponseCollector->end(), aData.begin(), aData.end());
+    return;
+  }
+  // echo tag of current request
+  writeMessage(aData, mTag);
+}
+
+void CSerialMultiBusMessageReaderWriter::writeMultibusEventBuffer(const std::span<uint8_t>& aData) const {
+  writeMessage(aData, 0);
+}
+
+void CSerialMultiBusMessageReaderWriter::writeMessage(const std::span<uint8_t>& aData, uint8_t aTag) const {
+  std::span<uint8_t> lMessage = aData;
+  if (mProtocolVersion >= MB_TRAILER_VERSION) {
+    std::copy(aData.begin(), aData.end(), mSendMessage.begin());
+    auto lMessageLen = mb_message_append_trailer(mSendMessage.data(), aData.size(), aTag);
+    lMessage = {mSendMessage.begin(), mSendMessage.begin() + lMessageLen};
+  }
+  if (mFramingMode != MB_BRIDGE_FRAMING_REQUEST_MODE_NONE) {
+    auto lFrameLen = mb_framing_encode(lMessage.data(), lMessage.size(), mSendFrame.data(), mSendFrame.size());
+    mSerial->writeBytes({mSendFrame.begin(), mSendFrame.begin() + lFrameLen});
+    return;
+  }
+  mSerial->writeBytes(lMessage);
+}
+
+void CSerialMultiBusMessageReaderWriter::setFraming(mb_bridge_framing_request_mode_t aMode) {
+  mFramingMode = aMode;
+}
+
+void CSerialMultiBusMessageReaderWriter::setProtocolVersion(uint16_t aVersion) {
+  mProtocolVersion = aVersion;
+}
+
+void CSerialMultiBusMessageReaderWriter::setResponseCollector(std::vector<uint8_t>* aCollector) {
+  mResponseCollector = aCollector;
 }
@@ -25,6 +25,8 @@
 
 #include "IMultiBusMessageReaderWriter.h"
 #include "ISerial.h"
+#include "multibus_framing.h"
+#include <array>
 #include <memory>
 
 class CSerialMultiBusMessageReaderWriter : public IMultiBusMessageReaderWriter {
@@ -36,8 +38,31 @@ class CSerialMultiBusMessageReaderWriter : public IMultiBusMessageReaderWriter {
 
   void writeMultibusMessageBuffer(const std::span<uint8_t>& aData) const override;
 
+  void writeMultibusEventBuffer(const std::span<uint8_t>& aData) const override;
+
+  void setFraming(mb_bridge_framing_request_mode_t aMode) override;
+
+  void setProtocolVersion(uint16_t aVersion) override;
+
+  void setResponseCollector(std::vector<uint8_t>* aCollector) override;
+
  private:
+  static constexpr uint16_t MAX_MESSAGE_LEN = 1024;
+
+  [[nodiscard]] SMultiBusMessage readUnframedMultiBusMessage() const;
+  [[nodiscard]] SMultiBusMessage readFramedMultiBusMessage() const;
+  [[nodiscard]] bool hasTrailer(const SMultiBusMessage& aMessage) const;
+  void stripTrailer(SMultiBusMessage& aMessage) const;
+  void writeMessage(const std::span<uint8_t>& aData, uint8_t aTag) const;
+
   std::shared_ptr<ISerial> mSerial;
+  mb_bridge_framing_request_mode_t mFramingMode{MB_BRIDGE_FRAMING_REQUEST_MODE_NONE};
+  uint16_t mProtocolVersion{0};
+  mutable uint8_t mTag{0};
+  std::vector<uint8_t>* mResponseCollector{nullptr};
+  mutable std::array<uint8_t, MB_FRAMING_MAX_FRAME_LEN(MAX_MESSAGE_LEN + MB_TRAILER_SIZE)> mReceiveFrame{};
+  mutable std::array<uint8_t, MB_FRAMING_MAX_FRAME_LEN(MAX_MESSAGE_LEN + MB_TRAILER_SIZE)> mSendFrame{};
+  mutable std::array<uint8_t, MAX_MESSAGE_LEN + MB_TRAILER_SIZE> mSendMessage{};
 };
 
 #endif // MULTIBUS_MAIN_C_SERIAL_MULTIBUS_MESSAGES_READER_WRITER_INCLUDED
\ No newline at end of file
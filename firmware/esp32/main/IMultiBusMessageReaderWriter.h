@@ -24,7 +24,9 @@
 #define MULTIBUS_MAIN_I_SERIAL_MULTIBUS_MESSAGES_READER_WRITER_INCLUDED
 
 #include "SMultiBusMessage.h"
+#include <multibus_protocol.h>
 #include <span>
+#include <vector>
 
 class IMultiBusMessageReaderWriter {
  public:
@@ -33,6 +35,18 @@ class IMultiBusMessageReaderWriter {
   [[nodiscard]] virtual SMultiBusMessage readMultiBusMessage() const = 0;
 
   virtual void writeMultibusMessageBuffer(const std::span<uint8_t>& aData) const = 0;
+
+  // events are sent with tag 0 and bypass the response collector
+  virtual void writeMultibusEventBuffer(const std::span<uint8_t>& aData) const = 0;
+
+  // used for all messages after the current one
+  virtual void setFraming(mb_bridge_framing_request_mode_t aMode) = 0;
+
+  // used for all messages after the current one, responses echo the tag of the last request
+  virtual void setProtocolVersion(uint16_t aVersion) = 0;
+
+  // while set, messages are appended to the collector instead of being sent, e.g. for batch requests
+  virtual void setResponseCollector(std::vector<uint8_t>* aCollector) = 0;
 };
 
 #endif // MULTIBUS_MAIN_I_SERIAL_MULTIBUS_MESSAGES_READER_WRITER_INCLUDED
\ No newline at end of file
@@ -25,6 +25,8 @@
 #include "CMultiBusOperationExecutor.h"
 #include "CComponentFactory.h"
 #include "CUartSerial.h"
+#include "CSampler.h"
+#include <mutex>
 
 #define MULTIBUS_UART_NUM UART_NUM_1
 
@@ -37,10 +39,6 @@ void app_main(void) {
     auto lMessageReaderWriter = std::make_shared<CSerialMultiBusMessageReaderWriter>(lUart);
     auto lOperationExecutor = std::make_shared<CMultiBusOperationExecutor>();
 
-    /* BRIDGE */
-    auto lBridge = CComponentFactory::createBridgeComponent(lMessageReaderWriter);
-    lOperationExecutor->registerComponent(MB_COMPONENT_BRIDGE, lBridge);
-
     /* I2C MASTER */
     auto lI2CMaster = CComponentFactory::createI2CMasterComponent(lMessageReaderWriter);
     lOperationExecutor->registerComponent(MB_COMPONENT_I2C_MASTER, lI2CMaster);
@@ -49,11 +47,33 @@ void app_main(void) {
     auto lSPIMaster = CComponentFactory::createSPIMasterComponent(lMessageReaderWriter);
     lOperationExecutor->registerComponent(MB_COMPONENT_SPI_MASTER, lSPIMaster);
 
+    /* BATCH */
+    auto lBatch = CComponentFactory::createBatchComponent(lMessageReaderWriter, lOperationExecutor);
+    lOperationExecutor->registerComponent(MB_COMPONENT_BATCH, lBatch);
+
+    /* SEQUENCER */
+    auto lSequencer = CComponentFactory::createSequencerComponent(lMessageReaderWriter,
+                                                                  std::static_pointer_cast<CSPIMaster>(lSPIMaster));
+    lOperationExecutor->registerComponent(MB_COMPONENT_SEQUENCER, lSequencer);
+
+    /* SAMPLER */
+    auto lSampler = CComponentFactory::createSamplerComponent(lMessageReaderWriter,
+                                                              std::static_pointer_cast<CSPIMaster>(lSPIMaster));
+    lOperationExecutor->registerComponent(MB_COMPONENT_SAMPLER, lSampler);
+    auto& lSamplerMutex = std::static_pointer_cast<CSampler>(lSampler)->getMutex();
+
+    /* BRIDGE, a protocol version request removes all sampler jobs */
+    auto lBridge = CComponentFactory::createBridgeComponent(lMessageReaderWriter,
+                                                            std::static_pointer_cast<CSampler>(lSampler));
+    lOperationExecutor->registerComponent(MB_COMPONENT_BRIDGE, lBridge);
+
     while (true) {
         auto lMessage = lMessageReaderWriter->readMultiBusMessage();
         ESP_LOGD("Bridge", "---------------------------------------------------");
         ESP_LOGD("Bridge", "Received:");
 //        lMessage.print();
+        // sampler jobs are paused while the request is executed
+        std::lock_guard<std::mutex> lLock(lSamplerMutex);
         lOperationExecutor->execute(lMessage);
     }
 }
@@ -33,7 +33,11 @@
 #include "pico/unique_id.h"
 
 #include "usb_serial.h"
+#include "multibus_batch.h"
+#include "multibus_framing.h"
 #include "multibus_protocol.h"
+#include "multibus_sampler.h"
+#include "multibus_sequencer.h"
 
 #define FIRMWARE_VERSION 0
 
@@ -53,16 +57,45 @@ static void cdc_task(void);
 char usb_serial[PICO_UNIQUE_BOARD_ID_SIZE_BYTES * 2 + 1];
 
 static const uint8_t cdc_itf = 0;
+static bool cdc_dtr;
 
-static uint8_t cdc_request[MAX_MESSSAGE_LEN];
+// holds complete frame in framing mode
+static uint8_t cdc_request[MB_FRAMING_MAX_FRAME_LEN(MAX_MESSSAGE_LEN + MB_TRAILER_SIZE)];
 static uint32_t cdc_request_len;
 static uint32_t cdc_bytes_to_read;
 
-static uint8_t cdc_response[MAX_MESSSAGE_LEN];
+// responses are set up with MAX_MESSSAGE_LEN, trailer is appended
+static uint8_t cdc_response[MAX_MESSSAGE_LEN + MB_TRAILER_SIZE];
 static uint32_t cdc_response_len;
 static uint32_t cdc_response_offset;
 
-static const uint8_t supported_components[] = {MB_COMPONENT_I2C_MASTER, MB_COMPONENT_SPI_MASTER};
+// link framing, new mode is used after the framing response has been sent
+static mb_bridge_framing_request_mode_t cdc_framing_mode;
+static mb_bridge_framing_request_mode_t cdc_framing_mode_pending;
+static mb_framing_decoder_t cdc_framing_decoder;
+static uint8_t cdc_frame[MB_FRAMING_MAX_FRAME_LEN(MAX_MESSSAGE_LEN + MB_TRAILER_SIZE)];
+static const uint8_t * cdc_tx_data;
+static uint32_t cdc_tx_len;
+
+// protocol version, new version is used after the protocol version response has been sent
+static uint16_t cdc_protocol_version;
+static uint16_t cdc_protocol_version_pending;
+static uint8_t cdc_request_tag;
+
+// since MB_TRAILER_VERSION, one delay request is completed while other requests are processed
+static bool cdc_delay_pending;
+static uint8_t cdc_delay_tag;
+static absolute_time_t cdc_delay_timeout;
+
+static const uint8_t supported_components[] = {MB_COMPONENT_I2C_MASTER, MB_COMPONENT_SPI_MASTER, MB_COMPONENT_BATCH,
+                                               MB_COMPONENT_SEQUENCER, MB_COMPONENT_SAMPLER};
+
+// batch requests are executed synchronously, responses are collected from batch buffer
+static bool cdc_batch_active;
+static uint8_t cdc_batch_response[MAX_MESSSAGE_LEN];
+
+// jobs are run from cdc_task between requests, all channels use the default I2C and SPI instance
+static mb_sampler_t mb_sampler;
 
 //------------- utils -------------//
 static uint32_t mb_min(uint32_t a, uint32_t b) {
@@ -106,41 +139,78 @@ void printf_hexdump(const void *data, int size) {
 //--------------------------------------------------------------------+
 // MultiBus Component Bridge
 //--------------------------------------------------------------------+
-static bool mb_component_bridge_handle_request(const uint8_t * payload_data, uint16_t payload_len) {
-    (void) payload_data;
-    (void) payload_len;
+static uint16_t mb_component_bridge_handle_request(uint8_t operation, const uint8_t * payload_data, uint16_t payload_len,
+                                                   uint8_t * response, uint16_t response_size) {
+    uint16_t response_len;
     char hardware_info[30];
-    switch (mb_header_get_operation(cdc_request)) {
+    mb_bridge_framing_request_mode_t framing_mode;
+    mb_status_t status;
+    switch (operation) {
         case MB_OPERATION_BRIDGE_PROTOCOL_VERSION_REQUEST:
-            cdc_response_len = mb_bridge_protocol_version_response_setup(cdc_response, sizeof(cdc_response), 0,
-                                                                         MB_PROTOCOL_VERSION);
+            // requested version is ignored if not supported, older hosts don't send a version and use version 0
+            if (payload_len >= 2) {
+                uint16_t protocol_version = mb_bridge_protocol_version_request_get_version(payload_data);
+                if (protocol_version <= MB_PROTOCOL_VERSION) {
+                    printf("Bridge: Protocol version %u\n", protocol_version);
+                    cdc_protocol_version_pending = protocol_version;
+                }
+            } else {
+                cdc_protocol_version_pending = 0;
+            }
+            // new session, stop sampler jobs of previous host
+            mb_sampler_remove_all_jobs(&mb_sampler);
+            response_len = mb_bridge_protocol_version_response_setup(response, response_size, 0,
+                                                                     MB_PROTOCOL_VERSION);
             break;
         case MB_OPERATION_BRIDGE_HARDWARE_INFO_REQUEST:
             hardware_info[0] = '\0';
             strcpy(hardware_info, "Pico ");
             pico_get_unique_board_id_string(&hardware_info[strlen(hardware_info)],  2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1);
-            cdc_response_len = mb_bridge_hardware_info_response_setup(cdc_response, sizeof(cdc_response), 0, hardware_info);
+            response_len = mb_bridge_hardware_info_response_setup(response, response_size, 0, hardware_info);
             break;
         case MB_OPERATION_BRIDGE_FIRMWARE_VERSION_REQUEST:
-            cdc_response_len = mb_bridge_firmware_version_response_setup(cdc_response, sizeof(cdc_response), 0,
-                                                                         FIRMWARE_VERSION);
+            response_len = mb_bridge_firmware_version_response_setup(response, response_size, 0,
+                                                                     FIRMWARE_VERSION);
             break;
         case MB_OPERATION_BRIDGE_SUPPORTED_COMPONENTS_REQUEST:
-            cdc_response_len = mb_bridge_supported_components_response_setup(cdc_response, sizeof(cdc_response), 0,
-                                                                             sizeof(supported_components),
-                                                                             supported_components);
+            response_len = mb_bridge_supported_components_response_setup(response, response_size, 0,
+                                                                         sizeof(supported_components),
+                                                                         supported_components);
             break;
         case MB_OPERATION_BRIDGE_DELAY_REQUEST:
-            printf("Bridge: Delay %" PRIu32 " ms\n", mb_bridge_delay_request_get_timeout_ms(&cdc_request[MB_HEADER_SIZE]));
-            sleep_ms(mb_bridge_delay_request_get_timeout_ms(&cdc_request[MB_HEADER_SIZE]));
-            cdc_response_len = mb_bridge_delay_response_setup(cdc_response, sizeof(cdc_response), 0);
+            printf("Bridge: Delay %" PRIu32 " ms\n", mb_bridge_delay_request_get_timeout_ms(payload_data));
+            if ((cdc_protocol_version >= MB_TRAILER_VERSION) && (cdc_delay_pending == false) && (cdc_batch_active == false)) {
+                // response is sent from cdc_task after timeout
+                cdc_delay_pending = true;
+                cdc_delay_tag = cdc_request_tag;
+                cdc_delay_timeout = make_timeout_time_ms(mb_bridge_delay_request_get_timeout_ms(payload_data));
+                return 0;
+            }
+            sleep_ms(mb_bridge_delay_request_get_timeout_ms(payload_data));
+            response_len = mb_bridge_delay_response_setup(response, response_size, 0);
+            break;
+        case MB_OPERATION_BRIDGE_FRAMING_REQUEST:
+            status = MB_STATUS_INVALID_ARGUMENTS;
+            if (payload_len >= 1) {
+                framing_mode = mb_bridge_framing_request_get_mode(payload_data);
+                switch (framing_mode) {
+                    case MB_BRIDGE_FRAMING_REQUEST_MODE_NONE:
+                    case MB_BRIDGE_FRAMING_REQUEST_MODE_COBS_CRC16:
+                        printf("Bridge: Framing mode %u\n", framing_mode);
+                        cdc_framing_mode_pending = framing_mode;
+                        status = MB_STATUS_OK;
+                        break;
+                    default:
+                        break;
+                }
+            }
+            response_len = mb_bridge_framing_response_setup(response, response_size, 0, status);
             break;
         default:
-            printf("Bridge operation 0x%02x not implemented yet, ignore\n", mb_header_get_operation(cdc_request));
-            return false;
+            printf("Bridge operation 0x%02x not implemented yet, ignore\n", operation);
+            return 0;
     }
-    cdc_protocol_state = CDC_SEND_RESPONSE;
-    return true;
+    return response_len;
 }
 
 //--------------------------------------------------------------------+
@@ -155,13 +225,15 @@ static bool mb_component_bridge_handle_request(const uint8_t * payload_data, uin
 static bool mb_i2c_master_configured;
 static uint8_t i2c_master_read_buffer[I2C_MASTER_MAX_READ_LEN];
 
-static bool mb_component_i2c_master_handle_request(const uint8_t * payload_data, uint16_t payload_len) {
+static uint16_t mb_component_i2c_master_handle_request(uint8_t operation, const uint8_t * payload_data, uint16_t payload_len,
+                                                       uint8_t * response, uint16_t response_size) {
+    uint16_t response_len;
     uint32_t mb_i2c_master_speed;
     mb_status_t status = MB_STATUS_OK;
     uint16_t i2c_address;
     uint16_t i2c_operation_len;
     int res;
-    switch (mb_header_get_operation(cdc_request)) {
+    switch (operation) {
         case MB_OPERATION_I2C_MASTER_CONFIG_REQUEST:
             // check parameters
             switch (mb_i2c_master_config_request_get_clock_speed(payload_data)){
@@ -196,7 +268,7 @@ static bool mb_component_i2c_master_handle_request(const uint8_t * payload_data,
                 }
                 printf("I2C Master Config: speed %u, SDA: GPIO %u, SCL: GPIO %u\n", mb_i2c_master_speed, PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN);
             }
-            cdc_response_len = mb_i2c_master_config_response_setup(cdc_response, sizeof(cdc_response), 0, status);
+            response_len = mb_i2c_master_config_response_setup(response, response_size, 0, status);
             break;
         case MB_OPERATION_I2C_MASTER_READ_REQUEST:
             i2c_address = mb_i2c_master_read_request_get_address(payload_data);
@@ -211,7 +283,7 @@ static bool mb_component_i2c_master_handle_request(const uint8_t * payload_data,
                     status = MB_STATUS_I2C_MASTER_SLAVE_NOT_CONNECTED;
                 }
             }
-            cdc_response_len = mb_i2c_master_read_response_setup(cdc_response, sizeof(cdc_response), 0, status, i2c_address, i2c_operation_len, i2c_master_read_buffer);
+            response_len = mb_i2c_master_read_response_setup(response, response_size, 0, status, i2c_address, i2c_operation_len, i2c_master_read_buffer);
             break;
         case MB_OPERATION_I2C_MASTER_WRITE_REQUEST:
             i2c_address = mb_i2c_master_write_request_get_address(payload_data);
@@ -220,14 +292,13 @@ static bool mb_component_i2c_master_handle_request(const uint8_t * payload_data,
             if (res != i2c_operation_len){
                 status = MB_STATUS_I2C_MASTER_SLAVE_NOT_CONNECTED;
             }
-            cdc_response_len = mb_i2c_master_write_response_setup(cdc_response, sizeof(cdc_response), 0, status, i2c_address);
+            response_len = mb_i2c_master_write_response_setup(response, response_size, 0, status, i2c_address);
             break;
         default:
-            printf("I2C Master operation 0x%02x not implemented yet, ignore\n", mb_header_get_operation(cdc_request));
-            return false;
+            printf("I2C Master operation 0x%02x not implemented yet, ignore\n", operation);
+            return 0;
     }
-    cdc_protocol_state = CDC_SEND_RESPONSE;
-    return true;
+    return response_len;
 }
 
 
@@ -263,7 +334,9 @@ static void mb_spi_master_set_gpio_function(int function) {
     gpio_set_function(PICO_DEFAULT_SPI_RX_PIN, function);
 }
 
-static bool mb_component_spi_master_handle_request(const uint8_t * payload_data, uint16_t payload_len) {
+static uint16_t mb_component_spi_master_handle_request(uint8_t operation, const uint8_t * payload_data, uint16_t payload_len,
+                                                       uint8_t * response, uint16_t response_size) {
+    uint16_t response_len;
     mb_status_t status = MB_STATUS_OK;
     uint16_t spi_operation_len;
     // config params
@@ -274,7 +347,7 @@ static bool mb_component_spi_master_handle_request(const uint8_t * payload_data,
     spi_cpha_t cpha;
 
     int res;
-    switch (mb_header_get_operation(cdc_request)) {
+    switch (operation) {
         case MB_OPERATION_SPI_MASTER_CONFIG_REQUEST:
             // check parameters
             switch (mb_spi_master_config_request_get_bit_order(payload_data)){
@@ -331,7 +404,7 @@ static bool mb_component_spi_master_handle_request(const uint8_t * payload_data,
                 printf("SPI Master Config: speed %u, data bits: %u, bit order %s first, CPOL %u, CPHA %u\n",
                        mb_spi_master_speed, data_bits, bit_order == SPI_MSB_FIRST ? "MSB" : "LSB", cpol, cpha);
             }
-            cdc_response_len = mb_spi_master_config_response_setup(cdc_response, sizeof(cdc_response), 0, status);
+            response_len = mb_spi_master_config_response_setup(response, response_size, 0, status);
             break;
         case MB_OPERATION_SPI_MASTER_READ_REQUEST:
             spi_operation_len = mb_spi_master_read_request_get_num_bytes(payload_data);
@@ -342,14 +415,14 @@ static bool mb_component_spi_master_handle_request(const uint8_t * payload_data,
             mb_spi_master_cs_select();
             (void) spi_read_blocking(spi_default, 0x00, spi_master_read_buffer, spi_operation_len);
             mb_spi_master_cs_deselect();
-            cdc_response_len = mb_spi_master_read_response_setup(cdc_response, sizeof(cdc_response), 0, status, spi_operation_len, spi_master_read_buffer);
+            response_len = mb_spi_master_read_response_setup(response, response_size, 0, status, spi_operation_len, spi_master_read_buffer);
             break;
         case MB_OPERATION_SPI_MASTER_WRITE_REQUEST:
             spi_operation_len = mb_spi_master_write_request_get_data_len(payload_len);
             mb_spi_master_cs_select();
             (void) spi_write_blocking(spi_default, mb_spi_master_write_request_get_data(payload_data), spi_operation_len);
             mb_spi_master_cs_deselect();
-            cdc_response_len = mb_spi_master_write_response_setup(cdc_response, sizeof(cdc_response), 0, status);
+            response_len = mb_spi_master_write_response_setup(response, response_size, 0, status);
             break;
         case MB_OPERATION_SPI_MASTER_TRANSFER_REQUEST:
             spi_operation_len = mb_spi_master_read_request_get_num_bytes(payload_data);
@@ -361,16 +434,171 @@ static bool mb_component_spi_master_handle_request(const uint8_t * payload_data,
             spi_write_read_blocking(spi_default, mb_spi_master_transfer_request_get_data(payload_data),
                                     spi_master_read_buffer,spi_operation_len);
             mb_spi_master_cs_deselect();
-            cdc_response_len = mb_spi_master_write_response_setup(cdc_response, sizeof(cdc_response), 0, status);
+            response_len = mb_spi_master_write_response_setup(response, response_size, 0, status);
             break;
         default:
-            printf("I2C Master operation 0x%02x not implemented yet, ignore\n", mb_header_get_operation(cdc_request));
-            return false;
+            printf("I2C Master operation 0x%02x not implemented yet, ignore\n", operation);
+            return 0;
     }
-    cdc_protocol_state = CDC_SEND_RESPONSE;
+    return response_len;
+}
+
+static uint16_t mb_handle_request(uint8_t component, uint8_t operation, const uint8_t * payload_data, uint16_t payload_len,
+                                  uint8_t * response, uint16_t response_size);
+
+//--------------------------------------------------------------------+
+// MultiBus Component Batch
+//--------------------------------------------------------------------+
+
+static uint16_t mb_component_batch_handle_request(uint8_t operation, const uint8_t * payload_data, uint16_t payload_len,
+                                                  uint8_t * response, uint16_t response_size) {
+    if (operation != MB_OPERATION_BATCH_EXECUTE_REQUEST) {
+        printf("Batch operation 0x%02x not implemented yet, ignore\n", operation);
+        return 0;
+    }
+    const uint8_t * requests = mb_batch_execute_request_get_requests(payload_data);
+    uint16_t requests_len = mb_batch_execute_request_get_requests_len(payload_len);
+    if (mb_batch_requests_valid(requests, requests_len) == false) {
+        return mb_batch_execute_response_setup(response, response_size, 0, MB_STATUS_INVALID_ARGUMENTS, 0, NULL);
+    }
+
+    // execute requests in order, responses are set up in batch buffer and appended if they fit
+    mb_status_t status = MB_STATUS_OK;
+    uint16_t fixed_len = mb_batch_execute_response_setup_fixed(response, response_size, 0, status, 0);
+    uint16_t responses_len = 0;
+    mb_batch_iterator_t iterator;
+    mb_message_t request;
+    mb_batch_iterator_init(&iterator, requests, requests_len);
+    cdc_batch_active = true;
+    while (mb_batch_iterator_next(&iterator, &request)) {
+        uint16_t request_response_len = mb_handle_request(request.component, request.operation, request.payload_data,
+                                                          request.payload_len, cdc_batch_response, sizeof(cdc_batch_response));
+        if ((fixed_len + responses_len + request_response_len) > response_size) {
+            status = MB_STATUS_BATCH_TRUNCATED;
+            break;
+        }
+        memcpy(&response[fixed_len + responses_len], cdc_batch_response, request_response_len);
+        responses_len += request_response_len;
+    }
+    cdc_batch_active = false;
+    printf("Batch: %u bytes of responses, status %u\n", responses_len, status);
+    (void) mb_batch_execute_response_setup_fixed(response, response_size, 0, status, responses_len);
+    return fixed_len + responses_len;
+}
+
+//--------------------------------------------------------------------+
+// MultiBus Component Sequencer
+//--------------------------------------------------------------------+
+
+static bool mb_sequencer_i2c_write(void * context, uint16_t address, const uint8_t * data, uint16_t len) {
+    (void) context;
+    return i2c_write_blocking(i2c_default, address, data, len, false) == len;
+}
+
+static bool mb_sequencer_i2c_read(void * context, uint16_t address, uint8_t * data, uint16_t len) {
+    (void) context;
+    return i2c_read_blocking(i2c_default, address, data, len, false) == len;
+}
+
+// only the default chip select is supported, as for SPI master requests
+static bool mb_sequencer_spi_transfer(void * context, uint8_t chip_select_gpio, const uint8_t * tx_data, uint8_t * rx_data, uint16_t len) {
+    (void) context;
+    (void) chip_select_gpio;
+    mb_spi_master_cs_select();
+    if (tx_data == NULL) {
+        (void) spi_read_blocking(spi_default, 0x00, rx_data, len);
+    } else if (rx_data == NULL) {
+        (void) spi_write_blocking(spi_default, tx_data, len);
+    } else {
+        (void) spi_write_read_blocking(spi_default, tx_data, rx_data, len);
+    }
+    mb_spi_master_cs_deselect();
     return true;
 }
 
+static void mb_sequencer_delay_ms(void * context, uint32_t ms) {
+    (void) context;
+    sleep_ms(ms);
+}
+
+static const mb_sequencer_bus_t mb_sequencer_bus = {
+    .i2c_write    = mb_sequencer_i2c_write,
+    .i2c_read     = mb_sequencer_i2c_read,
+    .spi_transfer = mb_sequencer_spi_transfer,
+    .delay_ms     = mb_sequencer_delay_ms,
+};
+
+static uint16_t mb_component_sequencer_handle_request(uint8_t operation, const uint8_t * payload_data, uint16_t payload_len,
+                                                      uint8_t * response, uint16_t response_size) {
+    if (operation != MB_OPERATION_SEQUENCER_RUN_REQUEST) {
+        printf("Sequencer operation 0x%02x not implemented yet, ignore\n", operation);
+        return 0;
+    }
+    // program is executed synchronously, data is appended directly into response
+    uint16_t fixed_len = mb_sequencer_run_response_setup_fixed(response, response_size, 0, MB_STATUS_OK, 0);
+    uint16_t data_len;
+    mb_status_t status = mb_sequencer_run(&mb_sequencer_bus, NULL, mb_sequencer_run_request_get_program(payload_data),
+                                          mb_sequencer_run_request_get_program_len(payload_len),
+                                          &response[fixed_len], response_size - fixed_len, &data_len);
+    printf("Sequencer: %u bytes of data, status %u\n", data_len, status);
+    (void) mb_sequencer_run_response_setup_fixed(response, response_size, 0, status, data_len);
+    return fixed_len + data_len;
+}
+
+//--------------------------------------------------------------------+
+// MultiBus Component Sampler
+//--------------------------------------------------------------------+
+
+static uint16_t mb_component_sampler_handle_request(uint8_t operation, const uint8_t * payload_data, uint16_t payload_len,
+                                                    uint8_t * response, uint16_t response_size) {
+    mb_status_t status;
+    uint8_t job_id;
+    switch (operation) {
+        case MB_OPERATION_SAMPLER_ADD_JOB_REQUEST:
+            job_id = mb_sampler_add_job_request_get_job_id(payload_data);
+            status = mb_sampler_add_job(&mb_sampler, job_id, 0,
+                                        mb_sampler_add_job_request_get_period_ms(payload_data),
+                                        mb_sampler_add_job_request_get_max_latency_ms(payload_data),
+                                        mb_sampler_add_job_request_get_program(payload_data),
+                                        mb_sampler_add_job_request_get_program_len(payload_len), time_us_32());
+            printf("Sampler: add job %u, status %u\n", job_id, status);
+            return mb_sampler_add_job_response_setup(response, response_size, 0, status, job_id);
+        case MB_OPERATION_SAMPLER_REMOVE_JOB_REQUEST:
+            job_id = mb_sampler_remove_job_request_get_job_id(payload_data);
+            status = mb_sampler_remove_job(&mb_sampler, job_id);
+            printf("Sampler: remove job %u, status %u\n", job_id, status);
+            return mb_sampler_remove_job_response_setup(response, response_size, 0, status, job_id);
+        default:
+            printf("Sampler operation 0x%02x not implemented yet, ignore\n", operation);
+            return 0;
+    }
+}
+
+//--------------------------------------------------------------------+
+// MultiBus Request Dispatch
+//--------------------------------------------------------------------+
+
+static uint16_t mb_handle_request(uint8_t component, uint8_t operation, const uint8_t * payload_data, uint16_t payload_len,
+                                  uint8_t * response, uint16_t response_size) {
+    switch (component) {
+        case MB_COMPONENT_BRIDGE:
+            return mb_component_bridge_handle_request(operation, payload_data, payload_len, response, response_size);
+        case MB_COMPONENT_I2C_MASTER:
+            return mb_component_i2c_master_handle_request(operation, payload_data, payload_len, response, response_size);
+        case MB_COMPONENT_SPI_MASTER:
+            return mb_component_spi_master_handle_request(operation, payload_data, payload_len, response, response_size);
+        case MB_COMPONENT_BATCH:
+            return mb_component_batch_handle_request(operation, payload_data, payload_len, response, response_size);
+        case MB_COMPONENT_SEQUENCER:
+            return mb_component_sequencer_handle_request(operation, payload_data, payload_len, response, response_size);
+        case MB_COMPONENT_SAMPLER:
+            return mb_component_sampler_handle_request(operation, payload_data, payload_len, response, response_size);
+        default:
+            printf("Request for unknown component 0x%02x, ignore\n", component);
+            return 0;
+    }
+}
+
 //--------------------------------------------------------------------+
 // USB CDC
 //--------------------------------------------------------------------+
@@ -380,6 +608,59 @@ static void cdc_reset_rx_state(void){
     cdc_request_len = 0;
 }
 
+// protocol version request is accepted with and without trailer, as the host does not know the current version
+static bool cdc_request_has_trailer(const uint8_t * request, uint16_t payload_len) {
+    if ((mb_header_get_component(request) == MB_COMPONENT_BRIDGE) &&
+        (mb_header_get_operation(request) == MB_OPERATION_BRIDGE_PROTOCOL_VERSION_REQUEST)) {
+        return (payload_len == MB_TRAILER_SIZE) || (payload_len == (2 + MB_TRAILER_SIZE));
+    }
+    return cdc_protocol_version >= MB_TRAILER_VERSION;
+}
+
+// host opened or closed the port: default protocol version and framing, drop partial request and pending delay
+static void cdc_reset_session(void) {
+    cdc_protocol_version = 0;
+    cdc_protocol_version_pending = 0;
+    cdc_request_tag = 0;
+    cdc_framing_mode = MB_BRIDGE_FRAMING_REQUEST_MODE_NONE;
+    cdc_framing_mode_pending = MB_BRIDGE_FRAMING_REQUEST_MODE_NONE;
+    mb_framing_decoder_init(&cdc_framing_decoder, cdc_request, sizeof(cdc_request));
+    cdc_delay_pending = false;
+    tud_cdc_n_read_flush(cdc_itf);
+    cdc_reset_rx_state();
+    mb_sampler_remove_all_jobs(&mb_sampler);
+}
+
+static void cdc_prepare_response(uint8_t tag) {
+    if (cdc_protocol_version >= MB_TRAILER_VERSION) {
+        cdc_response_len = mb_message_append_trailer(cdc_response, cdc_response_len, tag);
+    }
+    printf("Response: ");
+    printf_hexdump(cdc_response, cdc_response_len);
+    cdc_response_offset = 0;
+    if (cdc_framing_mode != MB_BRIDGE_FRAMING_REQUEST_MODE_NONE) {
+        cdc_tx_data = cdc_frame;
+        cdc_tx_len = mb_framing_encode(cdc_response, cdc_response_len, cdc_frame, sizeof(cdc_frame));
+    } else {
+        cdc_tx_data = cdc_response;
+        cdc_tx_len = cdc_response_len;
+    }
+    cdc_protocol_state = CDC_SEND_RESPONSE;
+}
+
+static void cdc_read_frame(void) {
+    while (tud_cdc_n_available(cdc_itf)) {
+        int32_t c = tud_cdc_n_read_char(cdc_itf);
+        if (c < 0) break;
+        uint16_t request_len = mb_framing_decoder_put(&cdc_framing_decoder, (uint8_t) c);
+        if (request_len > 0) {
+            cdc_request_len = request_len;
+            cdc_protocol_state = CDC_PROCESS_REQUEST;
+            break;
+        }
+    }
+}
+
 static void cdc_read(void) {
     if (tud_cdc_n_available(cdc_itf)) {
         uint32_t count = tud_cdc_n_read(cdc_itf, &cdc_request[cdc_request_len], cdc_bytes_to_read);
@@ -391,12 +672,36 @@ static void cdc_read(void) {
 static void cdc_task(void) {
     uint16_t payload_len;
     const uint8_t * payload_data;
-    bool valid_request;
     switch (cdc_protocol_state) {
         case CDC_W4_HEADER:
+            // send pending delay response between requests
+            if (cdc_delay_pending && (cdc_request_len == 0) && time_reached(cdc_delay_timeout)) {
+                cdc_delay_pending = false;
+                cdc_response_len = mb_bridge_delay_response_setup(cdc_response, MAX_MESSSAGE_LEN, 0);
+                cdc_prepare_response(cdc_delay_tag);
+                break;
+            }
+            // run sampler jobs and send samples event between requests, events use tag 0
+            if (cdc_request_len == 0) {
+                cdc_response_len = mb_sampler_process(&mb_sampler, time_us_32(), cdc_response, MAX_MESSSAGE_LEN);
+                if (cdc_response_len > 0) {
+                    cdc_prepare_response(0);
+                    break;
+                }
+            }
+            if (cdc_framing_mode != MB_BRIDGE_FRAMING_REQUEST_MODE_NONE) {
+                cdc_read_frame();
+                break;
+            }
             cdc_read();
             if (cdc_bytes_to_read == 0) {
                 cdc_bytes_to_read = mb_header_get_length(cdc_request);
+                // drop header with invalid length
+                if (cdc_bytes_to_read > (MAX_MESSSAGE_LEN + MB_TRAILER_SIZE - MB_HEADER_SIZE)) {
+                    printf("Invalid length %" PRIu32 ", drop header\n", cdc_bytes_to_read);
+                    cdc_reset_rx_state();
+                    break;
+                }
                 cdc_protocol_state = CDC_W4_PAYLOAD;
             }
             break;
@@ -411,39 +716,34 @@ static void cdc_task(void) {
             printf_hexdump(cdc_request, cdc_request_len);
             payload_data = &cdc_request[MB_HEADER_SIZE];
             payload_len = cdc_request_len - MB_HEADER_SIZE;
-            cdc_response_offset = 0;
-            switch (mb_header_get_component(cdc_request)) {
-                case MB_COMPONENT_BRIDGE:
-                    valid_request = mb_component_bridge_handle_request(payload_data, payload_len);
-                    break;
-                case MB_COMPONENT_I2C_MASTER:
-                    valid_request = mb_component_i2c_master_handle_request(payload_data, payload_len);
-                    break;
-                case MB_COMPONENT_SPI_MASTER:
-                    valid_request = mb_component_spi_master_handle_request(payload_data, payload_len);
-                    break;
-                default:
-                    printf("Request for unknown component 0x%02x, ignore\n", mb_header_get_component(cdc_request));
-                    valid_request = false;
+            // strip trailer
+            if (cdc_request_has_trailer(cdc_request, payload_len)) {
+                if (payload_len < MB_TRAILER_SIZE) {
+                    cdc_reset_rx_state();
                     break;
+                }
+                payload_len -= MB_TRAILER_SIZE;
+                cdc_request_tag = mb_trailer_get_tag(&payload_data[payload_len]);
             }
-            if (valid_request == false){
+            cdc_response_len = mb_handle_request(mb_header_get_component(cdc_request), mb_header_get_operation(cdc_request),
+                                                 payload_data, payload_len, cdc_response, MAX_MESSSAGE_LEN);
+            // no response for ignored or deferred requests
+            if (cdc_response_len == 0){
                 cdc_reset_rx_state();
                 break;
             }
-            if (cdc_protocol_state == CDC_SEND_RESPONSE) {
-                printf("Response: ");
-                printf_hexdump(cdc_response, cdc_response_len);
-            }
+            cdc_prepare_response(cdc_request_tag);
             break;
         case CDC_SEND_RESPONSE:
-            if (cdc_response_len - cdc_response_offset > 0) {
+            if (cdc_tx_len - cdc_response_offset > 0) {
                 uint32_t write_available = tud_cdc_n_write_available(cdc_itf);
-                uint32_t bytes_to_write = mb_min(write_available, cdc_response_len - cdc_response_offset);
-                tud_cdc_n_write(cdc_itf, &cdc_response[cdc_response_offset], bytes_to_write);
+                uint32_t bytes_to_write = mb_min(write_available, cdc_tx_len - cdc_response_offset);
+                tud_cdc_n_write(cdc_itf, &cdc_tx_data[cdc_response_offset], bytes_to_write);
                 tud_cdc_n_write_flush(cdc_itf);
                 cdc_response_offset += bytes_to_write;
             } else {
+                cdc_framing_mode = cdc_framing_mode_pending;
+                cdc_protocol_version = cdc_protocol_version_pending;
                 cdc_reset_rx_state();
             }
             break;
@@ -452,6 +752,16 @@ static void cdc_task(void) {
     }
 }
 
+// Invoked when cdc line state changed, e.g. connected/disconnected
+void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts) {
+    (void) rts;
+    // port opened or closed, stop sampler jobs of the previous host and use defaults for the next one
+    if ((itf == cdc_itf) && (dtr != cdc_dtr)) {
+        cdc_dtr = dtr;
+        cdc_reset_session();
+    }
+}
+
 /*------------- MAIN -------------*/
 int main(void) {
     board_init();
@@ -461,6 +771,8 @@ int main(void) {
     tud_init(0);
 
     cdc_reset_rx_state();
+    mb_framing_decoder_init(&cdc_framing_decoder, cdc_request, sizeof(cdc_request));
+    mb_sampler_init(&mb_sampler, &mb_sequencer_bus, NULL, NULL);
 
     printf("MultiBus Bridge started, %s\n", usb_serial);
 
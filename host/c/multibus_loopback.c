@@ -0,0 +1,692 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "multibus_batch.h"
+#include "multibus_loopback.h"
+#include "multibus_protocol.h"
+#include "multibus_sampler.h"
+#include "multibus_sequencer.h"
+
+#define LOOPBACK_FIRMWARE_VERSION 0
+#define LOOPBACK_SPI_MASTER_NUM_CHANNELS 1
+
+static const uint8_t supported_components[] = {MB_COMPONENT_I2C_MASTER, MB_COMPONENT_SPI_MASTER, MB_COMPONENT_BATCH,
+                                               MB_COMPONENT_SEQUENCER, MB_COMPONENT_SAMPLER};
+
+// shared buffer for data read from devices
+static uint8_t loopback_read_buffer[MB_LOOPBACK_MAX_MESSAGE_LEN];
+
+// shared buffer for response before encoding
+static uint8_t loopback_framing_buffer[MB_LOOPBACK_MAX_MESSAGE_LEN];
+
+// shared buffer for response of single request in batch
+static uint8_t loopback_batch_buffer[MB_LOOPBACK_MAX_MESSAGE_LEN];
+
+// shared buffer for samples event before encoding
+static uint8_t loopback_event_buffer[MB_HEADER_SIZE + MB_SAMPLER_MAX_SAMPLES_LEN + MB_TRAILER_SIZE];
+
+static mb_loopback_i2c_device_t * mb_loopback_get_i2c_device(mb_loopback_context_t * mb_loopback_context, uint16_t address){
+    mb_loopback_i2c_device_t * device;
+    for (device = mb_loopback_context->i2c_devices; device != NULL; device = device->next){
+        if (device->address == address) return device;
+    }
+    return NULL;
+}
+
+static mb_loopback_spi_device_t * mb_loopback_get_spi_device(mb_loopback_context_t * mb_loopback_context, uint8_t chip_select_gpio){
+    mb_loopback_spi_device_t * device;
+    for (device = mb_loopback_context->spi_devices; device != NULL; device = device->next){
+        if (device->chip_select_gpio == chip_select_gpio) return device;
+    }
+    return NULL;
+}
+
+static uint16_t mb_loopback_bridge_handle_request(mb_loopback_context_t * mb_loopback_context, uint8_t operation, uint8_t channel,
+                                                  const uint8_t * payload_data, uint16_t payload_len,
+                                                  uint8_t * response, uint16_t response_size){
+    (void) mb_loopback_context;
+    (void) payload_data;
+    (void) payload_len;
+    switch (operation){
+        case MB_OPERATION_BRIDGE_PROTOCOL_VERSION_REQUEST:
+            return mb_bridge_protocol_version_response_setup(response, response_size, channel, MB_PROTOCOL_VERSION);
+        case MB_OPERATION_BRIDGE_HARDWARE_INFO_REQUEST:
+            return mb_bridge_hardware_info_response_setup(response, response_size, channel, "Loopback");
+        case MB_OPERATION_BRIDGE_FIRMWARE_VERSION_REQUEST:
+            return mb_bridge_firmware_version_response_setup(response, response_size, channel, LOOPBACK_FIRMWARE_VERSION);
+        case MB_OPERATION_BRIDGE_SUPPORTED_COMPONENTS_REQUEST:
+            return mb_bridge_supported_components_response_setup(response, response_size, channel,
+                                                                 sizeof(supported_components), supported_components);
+        case MB_OPERATION_BRIDGE_DELAY_REQUEST:
+            // no delay in loopback
+            return mb_bridge_delay_response_setup(response, response_size, channel);
+        default:
+            return 0;
+    }
+}
+
+static uint16_t mb_loopback_i2c_master_handle_request(mb_loopback_context_t * mb_loopback_context, uint8_t operation, uint8_t channel,
+                                                      const uint8_t * payload_data, uint16_t payload_len,
+                                                      uint8_t * response, uint16_t response_size){
+    mb_status_t status = MB_STATUS_OK;
+    mb_loopback_i2c_device_t * device;
+    uint16_t i2c_address;
+    uint16_t i2c_operation_len;
+    switch (operation){
+        case MB_OPERATION_I2C_MASTER_CONFIG_REQUEST:
+            switch (mb_i2c_master_config_request_get_clock_speed(payload_data)){
+                case MB_I2C_MASTER_CONFIG_REQUEST_CLOCK_SPEED_100_KHZ:
+                case MB_I2C_MASTER_CONFIG_REQUEST_CLOCK_SPEED_400_KHZ:
+                    mb_loopback_context->i2c_master_configured = true;
+                    break;
+                default:
+                    status = MB_STATUS_INVALID_ARGUMENTS;
+                    break;
+            }
+            return mb_i2c_master_config_response_setup(response, response_size, channel, status);
+        case MB_OPERATION_I2C_MASTER_READ_REQUEST:
+            i2c_address = mb_i2c_master_read_request_get_address(payload_data);
+            i2c_operation_len = mb_i2c_master_read_request_get_num_bytes(payload_data);
+            device = mb_loopback_get_i2c_device(mb_loopback_context, i2c_address);
+            if (mb_loopback_context->i2c_master_configured == false){
+                status = MB_STATUS_I2C_MASTER_NOT_READY;
+            } else if ((device == NULL) || (device->read(device, loopback_read_buffer, i2c_operation_len) == false)){
+                status = MB_STATUS_I2C_MASTER_SLAVE_NOT_CONNECTED;
+            }
+            if (status != MB_STATUS_OK){
+                i2c_operation_len = 0;
+            }
+            return mb_i2c_master_read_response_setup(response, response_size, channel, status, i2c_address,
+                                                     i2c_operation_len, loopback_read_buffer);
+        case MB_OPERATION_I2C_MASTER_WRITE_REQUEST:
+            i2c_address = mb_i2c_master_write_request_get_address(payload_data);
+            i2c_operation_len = mb_i2c_master_write_request_get_data_len(payload_len);
+            device = mb_loopback_get_i2c_device(mb_loopback_context, i2c_address);
+            if (mb_loopback_context->i2c_master_configured == false){
+                status = MB_STATUS_I2C_MASTER_NOT_READY;
+            } else if ((device == NULL) ||
+                       (device->write(device, mb_i2c_master_write_request_get_data(payload_data), i2c_operation_len) == false)){
+                status = MB_STATUS_I2C_MASTER_SLAVE_NOT_CONNECTED;
+            }
+            return mb_i2c_master_write_response_setup(response, response_size, channel, status, i2c_address);
+        default:
+            return 0;
+    }
+}
+
+static uint16_t mb_loopback_spi_master_handle_request(mb_loopback_context_t * mb_loopback_context, uint8_t operation, uint8_t channel,
+                                                      const uint8_t * payload_data, uint16_t payload_len,
+                                                      uint8_t * response, uint16_t response_size){
+    mb_status_t status = MB_STATUS_OK;
+    mb_loopback_spi_device_t * device;
+    uint16_t spi_operation_len;
+    switch (operation){
+        case MB_OPERATION_SPI_MASTER_GET_NUM_CHANNELS_REQUEST:
+            return mb_spi_master_get_num_channels_response_setup(response, response_size, channel, LOOPBACK_SPI_MASTER_NUM_CHANNELS);
+        case MB_OPERATION_SPI_MASTER_CONFIG_REQUEST:
+            if ((mb_spi_master_config_request_get_bit_order(payload_data) > MB_SPI_MASTER_CONFIG_REQUEST_BIT_ORDER_MSB_FIRST) ||
+                (mb_spi_master_config_request_get_cpol(payload_data) > MB_SPI_MASTER_CONFIG_REQUEST_CPOL_1) ||
+                (mb_spi_master_config_request_get_cpha(payload_data) > MB_SPI_MASTER_CONFIG_REQUEST_CPHA_1)){
+                status = MB_STATUS_INVALID_ARGUMENTS;
+            } else {
+                mb_loopback_context->spi_master_configured = true;
+            }
+            return mb_spi_master_config_response_setup(response, response_size, channel, status);
+        case MB_OPERATION_SPI_MASTER_WRITE_REQUEST:
+            spi_operation_len = mb_spi_master_write_request_get_data_len(payload_len);
+            device = mb_loopback_get_spi_device(mb_loopback_context, mb_spi_master_write_request_get_chip_select_gpio(payload_data));
+            if (device != NULL){
+                device->transfer(device, mb_spi_master_write_request_get_data(payload_data), NULL, spi_operation_len);
+            }
+            return mb_spi_master_write_response_setup(response, response_size, channel, status);
+        case MB_OPERATION_SPI_MASTER_READ_REQUEST:
+            spi_operation_len = mb_spi_master_read_request_get_num_bytes(payload_data);
+            if (spi_operation_len > sizeof(loopback_read_buffer)){
+                return mb_spi_master_read_response_setup(response, response_size, channel, MB_STATUS_INVALID_ARGUMENTS, 0, loopback_read_buffer);
+            }
+            // MISO idles high
+            memset(loopback_read_buffer, 0xff, spi_operation_len);
+            device = mb_loopback_get_spi_device(mb_loopback_context, mb_spi_master_read_request_get_chip_select_gpio(payload_data));
+            if (device != NULL){
+                device->transfer(device, NULL, loopback_read_buffer, spi_operation_len);
+            }
+            return mb_spi_master_read_response_setup(response, response_size, channel, status, spi_operation_len, loopback_read_buffer);
+        case MB_OPERATION_SPI_MASTER_TRANSFER_REQUEST:
+            spi_operation_len = mb_spi_master_transfer_request_get_data_len(payload_len);
+            memset(loopback_read_buffer, 0xff, spi_operation_len);
+            device = mb_loopback_get_spi_device(mb_loopback_context, mb_spi_master_transfer_request_get_chip_select_gpio(payload_data));
+            if (device != NULL){
+                device->transfer(device, mb_spi_master_transfer_request_get_data(payload_data), loopback_read_buffer, spi_operation_len);
+            }
+            return mb_spi_master_transfer_response_setup(response, response_size, channel, status, spi_operation_len, loopback_read_buffer);
+        default:
+            return 0;
+    }
+}
+
+static bool mb_loopback_sequencer_i2c_write(void * context, uint16_t address, const uint8_t * data, uint16_t len){
+    mb_loopback_context_t * mb_loopback_context = (mb_loopback_context_t *) context;
+    mb_loopback_i2c_device_t * device = mb_loopback_get_i2c_device(mb_loopback_context, address);
+    if ((mb_loopback_context->i2c_master_configured == false) || (device == NULL)) return false;
+    return device->write(device, data, len);
+}
+
+static bool mb_loopback_sequencer_i2c_read(void * context, uint16_t address, uint8_t * data, uint16_t len){
+    mb_loopback_context_t * mb_loopback_context = (mb_loopback_context_t *) context;
+    mb_loopback_i2c_device_t * device = mb_loopback_get_i2c_device(mb_loopback_context, address);
+    if ((mb_loopback_context->i2c_master_configured == false) || (device == NULL)) return false;
+    return device->read(device, data, len);
+}
+
+static bool mb_loopback_sequencer_spi_transfer(void * context, uint8_t chip_select_gpio, const uint8_t * tx_data, uint8_t * rx_data, uint16_t len){
+    mb_loopback_context_t * mb_loopback_context = (mb_loopback_context_t *) context;
+    mb_loopback_spi_device_t * device = mb_loopback_get_spi_device(mb_loopback_context, chip_select_gpio);
+    if (rx_data != NULL){
+        // MISO idles high
+        memset(rx_data, 0xff, len);
+    }
+    if (device != NULL){
+        device->transfer(device, tx_data, rx_data, len);
+    }
+    return true;
+}
+
+// no delay in loopback
+static const mb_sequencer_bus_t mb_loopback_sequencer_bus = {
+    .i2c_write    = mb_loopback_sequencer_i2c_write,
+    .i2c_read     = mb_loopback_sequencer_i2c_read,
+    .spi_transfer = mb_loopback_sequencer_spi_transfer,
+    .delay_ms     = NULL,
+};
+
+static uint16_t mb_loopback_sequencer_handle_request(mb_loopback_context_t * mb_loopback_context, uint8_t operation, uint8_t channel,
+                                                     const uint8_t * payload_data, uint16_t payload_len,
+                                                     uint8_t * response, uint16_t response_size){
+    if (operation != MB_OPERATION_SEQUENCER_RUN_REQUEST) return 0;
+    // run program with data appended directly into response
+    uint16_t fixed_len = mb_sequencer_run_response_setup_fixed(response, response_size, channel, MB_STATUS_OK, 0);
+    uint16_t data_len;
+    mb_status_t status = mb_sequencer_run(&mb_loopback_sequencer_bus, mb_loopback_context,
+                                          mb_sequencer_run_request_get_program(payload_data),
+                                          mb_sequencer_run_request_get_program_len(payload_len),
+                                          &response[fixed_len], response_size - fixed_len, &data_len);
+    (void) mb_sequencer_run_response_setup_fixed(response, response_size, channel, status, data_len);
+    return fixed_len + data_len;
+}
+
+// all channels use the virtual devices
+static void * mb_loopback_sampler_get_bus_context(void * context, uint8_t channel){
+    (void) channel;
+    return context;
+}
+
+static uint16_t mb_loopback_sampler_handle_request(mb_loopback_context_t * mb_loopback_context, uint8_t operation, uint8_t channel,
+                                                   const uint8_t * payload_data, uint16_t payload_len,
+                                                   uint8_t * response, uint16_t response_size){
+    uint32_t now_us = (mb_loopback_context->get_time_us != NULL) ? mb_loopback_context->get_time_us() : 0;
+    mb_status_t status;
+    uint8_t job_id;
+    switch (operation){
+        case MB_OPERATION_SAMPLER_ADD_JOB_REQUEST:
+            job_id = mb_sampler_add_job_request_get_job_id(payload_data);
+            status = mb_sampler_add_job(&mb_loopback_context->sampler, job_id, channel,
+                                        mb_sampler_add_job_request_get_period_ms(payload_data),
+                                        mb_sampler_add_job_request_get_max_latency_ms(payload_data),
+                                        mb_sampler_add_job_request_get_program(payload_data),
+                                        mb_sampler_add_job_request_get_program_len(payload_len), now_us);
+            return mb_sampler_add_job_response_setup(response, response_size, channel, status, job_id);
+        case MB_OPERATION_SAMPLER_REMOVE_JOB_REQUEST:
+            job_id = mb_sampler_remove_job_request_get_job_id(payload_data);
+            status = mb_sampler_remove_job(&mb_loopback_context->sampler, job_id);
+            return mb_sampler_remove_job_response_setup(response, response_size, channel, status, job_id);
+        default:
+            return 0;
+    }
+}
+
+static uint16_t mb_loopback_handle_framing_request(mb_loopback_context_t * mb_loopback_context, uint8_t channel,
+                                                   const uint8_t * payload_data, uint16_t payload_len,
+                                                   uint8_t * response, uint16_t response_size){
+    if (payload_len < 1){
+        return mb_bridge_framing_response_setup(response, response_size, channel, MB_STATUS_INVALID_ARGUMENTS);
+    }
+    mb_bridge_framing_request_mode_t mode = mb_bridge_framing_request_get_mode(payload_data);
+    switch (mode){
+        case MB_BRIDGE_FRAMING_REQUEST_MODE_NONE:
+        case MB_BRIDGE_FRAMING_REQUEST_MODE_COBS_CRC16:
+            break;
+        default:
+            return mb_bridge_framing_response_setup(response, response_size, channel, MB_STATUS_INVALID_ARGUMENTS);
+    }
+    uint16_t response_len = mb_bridge_framing_response_setup(response, response_size, channel, MB_STATUS_OK);
+    // response is encoded with current framing, switch afterwards
+    mb_loopback_context->framing_mode = mode;
+    return response_len;
+}
+
+static uint16_t mb_loopback_batch_handle_request(mb_loopback_context_t * mb_loopback_context, uint8_t operation, uint8_t channel,
+                                                 const uint8_t * payload_data, uint16_t payload_len,
+                                                 uint8_t * response, uint16_t response_size);
+
+static uint16_t mb_loopback_dispatch_request(mb_loopback_context_t * mb_loopback_context, uint8_t component, uint8_t operation,
+                                             uint8_t channel, const uint8_t * payload_data, uint16_t payload_len,
+                                             uint8_t * response, uint16_t response_size){
+    switch (component){
+        case MB_COMPONENT_BRIDGE:
+            return mb_loopback_bridge_handle_request(mb_loopback_context, operation, channel, payload_data, payload_len, response, response_size);
+        case MB_COMPONENT_I2C_MASTER:
+            return mb_loopback_i2c_master_handle_request(mb_loopback_context, operation, channel, payload_data, payload_len, response, response_size);
+        case MB_COMPONENT_SPI_MASTER:
+            return mb_loopback_spi_master_handle_request(mb_loopback_context, operation, channel, payload_data, payload_len, response, response_size);
+        case MB_COMPONENT_BATCH:
+            return mb_loopback_batch_handle_request(mb_loopback_context, operation, channel, payload_data, payload_len, response, response_size);
+        case MB_COMPONENT_SEQUENCER:
+            return mb_loopback_sequencer_handle_request(mb_loopback_context, operation, channel, payload_data, payload_len, response, response_size);
+        case MB_COMPONENT_SAMPLER:
+            return mb_loopback_sampler_handle_request(mb_loopback_context, operation, channel, payload_data, payload_len, response, response_size);
+        default:
+            return 0;
+    }
+}
+
+static uint16_t mb_loopback_batch_handle_request(mb_loopback_context_t * mb_loopback_context, uint8_t operation, uint8_t channel,
+                                                 const uint8_t * payload_data, uint16_t payload_len,
+                                                 uint8_t * response, uint16_t response_size){
+    if (operation != MB_OPERATION_BATCH_EXECUTE_REQUEST) return 0;
+    const uint8_t * requests     = mb_batch_execute_request_get_requests(payload_data);
+    uint16_t        requests_len = mb_batch_execute_request_get_requests_len(payload_len);
+    if (mb_batch_requests_valid(requests, requests_len) == false){
+        return mb_batch_execute_response_setup(response, response_size, channel, MB_STATUS_INVALID_ARGUMENTS, 0, NULL);
+    }
+
+    // execute requests in order, responses are set up in batch buffer and appended if they fit
+    mb_status_t status = MB_STATUS_OK;
+    uint16_t fixed_len = mb_batch_execute_response_setup_fixed(response, response_size, channel, status, 0);
+    uint16_t responses_len = 0;
+    mb_batch_iterator_t iterator;
+    mb_message_t request;
+    mb_batch_iterator_init(&iterator, requests, requests_len);
+    while (mb_batch_iterator_next(&iterator, &request)){
+        uint16_t sub_response_len = mb_loopback_dispatch_request(mb_loopback_context, request.component, request.operation,
+                                                                 request.channel, request.payload_data, request.payload_len,
+                                                                 loopback_batch_buffer, sizeof(loopback_batch_buffer));
+        if ((fixed_len + responses_len + sub_response_len) > response_size){
+            status = MB_STATUS_BATCH_TRUNCATED;
+            break;
+        }
+        memcpy(&response[fixed_len + responses_len], loopback_batch_buffer, sub_response_len);
+        responses_len += sub_response_len;
+    }
+    (void) mb_batch_execute_response_setup_fixed(response, response_size, channel, status, responses_len);
+    return fixed_len + responses_len;
+}
+
+static uint16_t mb_loopback_process_request(mb_loopback_context_t * mb_loopback_context, const uint8_t * request, uint16_t request_len,
+                                            uint8_t * response, uint16_t response_size, bool handle_link_requests){
+    assert(request_len >= MB_HEADER_SIZE);
+    uint8_t         component    = mb_header_get_component(request);
+    uint8_t         operation    = mb_header_get_operation(request);
+    uint8_t         channel      = mb_header_get_channel(request);
+    const uint8_t * payload_data = &request[MB_HEADER_SIZE];
+    uint16_t        payload_len  = request_len - MB_HEADER_SIZE;
+
+    // strip trailer, response echoes tag
+    uint16_t trailer_size = (mb_loopback_context->protocol_version >= MB_TRAILER_VERSION) ? MB_TRAILER_SIZE : 0;
+    uint8_t  tag = 0;
+    if (trailer_size > 0){
+        if ((payload_len < trailer_size) || (response_size < trailer_size)) return 0;
+        payload_len   -= trailer_size;
+        response_size -= trailer_size;
+        tag = mb_trailer_get_tag(&payload_data[payload_len]);
+    }
+
+    uint16_t response_len;
+    if (handle_link_requests && (component == MB_COMPONENT_BRIDGE) && (operation == MB_OPERATION_BRIDGE_FRAMING_REQUEST)){
+        response_len = mb_loopback_handle_framing_request(mb_loopback_context, channel, payload_data, payload_len, response, response_size);
+    } else {
+        response_len = mb_loopback_dispatch_request(mb_loopback_context, component, operation, channel, payload_data, payload_len,
+                                                    response, response_size);
+    }
+    if (response_len == 0) return 0;
+    if (trailer_size > 0){
+        response_len = mb_message_append_trailer(response, response_len, tag);
+    }
+
+    // response uses current protocol version, switch afterwards if requested version is supported
+    if ((component == MB_COMPONENT_BRIDGE) && (operation == MB_OPERATION_BRIDGE_PROTOCOL_VERSION_REQUEST) && (payload_len >= 2)){
+        uint16_t protocol_version = mb_bridge_protocol_version_request_get_version(payload_data);
+        if (protocol_version <= MB_PROTOCOL_VERSION){
+            mb_loopback_context->protocol_version = protocol_version;
+        }
+    }
+    // new session, stop sampler jobs of previous host
+    if ((component == MB_COMPONENT_BRIDGE) && (operation == MB_OPERATION_BRIDGE_PROTOCOL_VERSION_REQUEST)){
+        mb_sampler_remove_all_jobs(&mb_loopback_context->sampler);
+    }
+    return response_len;
+}
+
+uint16_t mb_loopback_handle_request(mb_loopback_context_t * mb_loopback_context, const uint8_t * request, uint16_t request_len,
+                                    uint8_t * response, uint16_t response_size){
+    return mb_loopback_process_request(mb_loopback_context, request, request_len, response, response_size, false);
+}
+
+void mb_loopback_init(mb_loopback_context_t * mb_loopback_context){
+    assert(mb_loopback_context != NULL);
+    memset(mb_loopback_context, 0, sizeof(mb_loopback_context_t));
+    mb_loopback_context->framing_mode = MB_BRIDGE_FRAMING_REQUEST_MODE_NONE;
+    mb_framing_decoder_init(&mb_loopback_context->framing_decoder, mb_loopback_context->request,
+                            sizeof(mb_loopback_context->request));
+    mb_sampler_init(&mb_loopback_context->sampler, &mb_loopback_sequencer_bus, &mb_loopback_sampler_get_bus_context,
+                    mb_loopback_context);
+}
+
+void mb_loopback_set_time_source(mb_loopback_context_t * mb_loopback_context, uint32_t (*get_time_us)(void)){
+    mb_loopback_context->get_time_us = get_time_us;
+}
+
+void mb_loopback_add_i2c_device(mb_loopback_context_t * mb_loopback_context, mb_loopback_i2c_device_t * device){
+    device->next = mb_loopback_context->i2c_devices;
+    mb_loopback_context->i2c_devices = device;
+}
+
+void mb_loopback_add_spi_device(mb_loopback_context_t * mb_loopback_context, mb_loopback_spi_device_t * device){
+    device->next = mb_loopback_context->spi_devices;
+    mb_loopback_context->spi_devices = device;
+}
+
+// Driver interface
+
+static void mb_loopback_driver_set_block_received(void * driver_context, void (*block_handler)(void * context), void * callback_context){
+    mb_loopback_context_t * mb_loopback_context = (mb_loopback_context_t *) driver_context;
+    mb_loopback_context->block_received_callback = block_handler;
+    mb_loopback_context->block_received_context = callback_context;
+}
+
+static void mb_loopback_driver_set_block_sent(void * driver_context, void (*block_handler)(void * context), void * callback_context){
+    mb_loopback_context_t * mb_loopback_context = (mb_loopback_context_t *) driver_context;
+    mb_loopback_context->block_sent_callback = block_handler;
+    mb_loopback_context->block_sent_context = callback_context;
+}
+
+static void mb_loopback_driver_set_bytes_received(void * driver_context, void (*bytes_handler)(void * context, uint16_t num_bytes), void * callback_context){
+    mb_loopback_context_t * mb_loopback_context = (mb_loopback_context_t *) driver_context;
+    mb_loopback_context->bytes_received_callback = bytes_handler;
+    mb_loopback_context->bytes_received_context = callback_context;
+}
+
+static void mb_loopback_driver_receive_block(void * driver_context, uint8_t *buffer, uint16_t length){
+    mb_loopback_context_t * mb_loopback_context = (mb_loopback_context_t *) driver_context;
+    mb_loopback_context->rx_buffer = buffer;
+    mb_loopback_context->rx_len = length;
+    mb_loopback_context->rx_stream = false;
+}
+
+static void mb_loopback_driver_receive_bytes(void * driver_context, uint8_t *buffer, uint16_t max_length){
+    mb_loopback_context_t * mb_loopback_context = (mb_loopback_context_t *) driver_context;
+    mb_loopback_context->rx_buffer = buffer;
+    mb_loopback_context->rx_len = max_length;
+    mb_loopback_context->rx_stream = true;
+}
+
+static void mb_loopback_request_complete(mb_loopback_context_t * mb_loopback_context){
+    mb_loopback_context->num_requests++;
+
+    // compact response buffer
+    if (mb_loopback_context->response_read == mb_loopback_context->response_write){
+        mb_loopback_context->response_read  = 0;
+        mb_loopback_context->response_write = 0;
+    }
+
+    uint16_t response_size = MB_LOOPBACK_RESPONSE_BUFFER_SIZE - mb_loopback_context->response_write;
+    if (response_size < MB_FRAMING_MAX_FRAME_LEN(MB_LOOPBACK_MAX_MESSAGE_LEN)){
+        mb_loopback_context->num_dropped_responses++;
+        return;
+    }
+
+    // in framing mode, set up response in framing buffer and encode it into the response buffer
+    mb_bridge_framing_request_mode_t framing_mode = mb_loopback_context->framing_mode;
+    uint8_t * response = &mb_loopback_context->response_buffer[mb_loopback_context->response_write];
+    if (framing_mode != MB_BRIDGE_FRAMING_REQUEST_MODE_NONE){
+        response      = loopback_framing_buffer;
+        response_size = sizeof(loopback_framing_buffer);
+    }
+
+    // tagged delay responses are sent after all other responses for the current data, see below
+    bool defer_response = (mb_loopback_context->protocol_version >= MB_TRAILER_VERSION) &&
+                          (mb_header_get_component(mb_loopback_context->request) == MB_COMPONENT_BRIDGE) &&
+                          (mb_header_get_operation(mb_loopback_context->request) == MB_OPERATION_BRIDGE_DELAY_REQUEST);
+
+    uint16_t response_len = mb_loopback_process_request(mb_loopback_context,
+                                                        mb_loopback_context->request, mb_loopback_context->request_len,
+                                                        response, response_size, true);
+    if (response_len == 0){
+        mb_loopback_context->num_ignored_requests++;
+        return;
+    }
+    if (framing_mode != MB_BRIDGE_FRAMING_REQUEST_MODE_NONE){
+        response_len = mb_framing_encode(response, response_len,
+                                         &mb_loopback_context->response_buffer[mb_loopback_context->response_write],
+                                         MB_LOOPBACK_RESPONSE_BUFFER_SIZE - mb_loopback_context->response_write);
+    }
+    if (defer_response && ((mb_loopback_context->deferred_len + response_len) <= sizeof(mb_loopback_context->deferred_responses))){
+        memcpy(&mb_loopback_context->deferred_responses[mb_loopback_context->deferred_len],
+               &mb_loopback_context->response_buffer[mb_loopback_context->response_write], response_len);
+        mb_loopback_context->deferred_len += response_len;
+        return;
+    }
+    mb_loopback_context->response_write += response_len;
+}
+
+static void mb_loopback_flush_deferred_responses(mb_loopback_context_t * mb_loopback_context){
+    if (mb_loopback_context->deferred_len == 0) return;
+    if ((mb_loopback_context->response_write + mb_loopback_context->deferred_len) > MB_LOOPBACK_RESPONSE_BUFFER_SIZE){
+        mb_loopback_context->num_dropped_responses++;
+    } else {
+        memcpy(&mb_loopback_context->response_buffer[mb_loopback_context->response_write],
+               mb_loopback_context->deferred_responses, mb_loopback_context->deferred_len);
+        mb_loopback_context->response_write += mb_loopback_context->deferred_len;
+    }
+    mb_loopback_context->deferred_len = 0;
+}
+
+static uint16_t mb_loopback_handle_frames(mb_loopback_context_t * mb_loopback_context, const uint8_t * data, uint16_t len){
+    uint16_t i;
+    // framing can be changed by a request
+    for (i = 0; (i < len) && (mb_loopback_context->framing_mode != MB_BRIDGE_FRAMING_REQUEST_MODE_NONE); i++){
+        uint16_t request_len = mb_framing_decoder_put(&mb_loopback_context->framing_decoder, data[i]);
+        if (request_len == 0) continue;
+        mb_loopback_context->request_len = request_len;
+        mb_loopback_request_complete(mb_loopback_context);
+        mb_loopback_context->request_len = 0;
+    }
+    return i;
+}
+
+static void mb_loopback_handle_data(mb_loopback_context_t * mb_loopback_context, const uint8_t * data, uint16_t len){
+    while (len > 0){
+        if (mb_loopback_context->framing_mode != MB_BRIDGE_FRAMING_REQUEST_MODE_NONE){
+            uint16_t bytes_consumed = mb_loopback_handle_frames(mb_loopback_context, data, len);
+            data += bytes_consumed;
+            len  -= bytes_consumed;
+            continue;
+        }
+
+        // skip payload of requests that are too long
+        if (mb_loopback_context->request_skip > 0){
+            uint16_t bytes_to_skip = mb_loopback_context->request_skip;
+            if (bytes_to_skip > len){
+                bytes_to_skip = len;
+            }
+            mb_loopback_context->request_skip -= bytes_to_skip;
+            data += bytes_to_skip;
+            len  -= bytes_to_skip;
+            if (mb_loopback_context->request_skip == 0){
+                mb_loopback_context->num_ignored_requests++;
+            }
+            continue;
+        }
+
+        // collect header, then payload
+        uint16_t request_len = MB_HEADER_SIZE;
+        if (mb_loopback_context->request_len >= MB_HEADER_SIZE){
+            request_len += mb_header_get_length(mb_loopback_context->request);
+        }
+        uint16_t bytes_to_copy = request_len - mb_loopback_context->request_len;
+        if (bytes_to_copy > len){
+            bytes_to_copy = len;
+        }
+        memcpy(&mb_loopback_context->request[mb_loopback_context->request_len], data, bytes_to_copy);
+        mb_loopback_context->request_len += bytes_to_copy;
+        data += bytes_to_copy;
+        len  -= bytes_to_copy;
+
+        if (mb_loopback_context->request_len == MB_HEADER_SIZE){
+            uint16_t payload_len = mb_header_get_length(mb_loopback_context->request);
+            if ((MB_HEADER_SIZE + payload_len) > MB_LOOPBACK_MAX_MESSAGE_LEN){
+                mb_loopback_context->request_skip = payload_len;
+                mb_loopback_context->request_len  = 0;
+                continue;
+            }
+            if (payload_len > 0) continue;
+        }
+        if (mb_loopback_context->request_len < MB_HEADER_SIZE) continue;
+        if (mb_loopback_context->request_len < (MB_HEADER_SIZE + mb_header_get_length(mb_loopback_context->request))) continue;
+
+        mb_loopback_request_complete(mb_loopback_context);
+        mb_loopback_context->request_len = 0;
+    }
+}
+
+static void mb_loopback_driver_send_blocks(void * driver_context, const mb_driver_block_t * blocks, uint8_t num_blocks){
+    mb_loopback_context_t * mb_loopback_context = (mb_loopback_context_t *) driver_context;
+    uint8_t i;
+    for (i = 0; i < num_blocks; i++){
+        mb_loopback_handle_data(mb_loopback_context, blocks[i].data, blocks[i].len);
+    }
+    // complete delay requests out of order
+    mb_loopback_flush_deferred_responses(mb_loopback_context);
+    // report send complete in mb_loopback_process
+    mb_loopback_context->tx_done = true;
+}
+
+static void mb_loopback_driver_send_block(void * driver_context, const uint8_t *buffer, uint16_t length){
+    mb_driver_block_t block;
+    block.data = buffer;
+    block.len  = length;
+    mb_loopback_driver_send_blocks(driver_context, &block, 1);
+}
+
+// send samples events with tag 0, as they are not a response to a request
+static void mb_loopback_process_sampler(mb_loopback_context_t * mb_loopback_context){
+    uint32_t now_us = mb_loopback_context->get_time_us();
+    while (true){
+        uint16_t event_len = mb_sampler_process(&mb_loopback_context->sampler, now_us, loopback_event_buffer,
+                                                sizeof(loopback_event_buffer) - MB_TRAILER_SIZE);
+        if (event_len == 0) break;
+        if (mb_loopback_context->protocol_version >= MB_TRAILER_VERSION){
+            event_len = mb_message_append_trailer(loopback_event_buffer, event_len, 0);
+        }
+
+        // compact response buffer
+        if (mb_loopback_context->response_read == mb_loopback_context->response_write){
+            mb_loopback_context->response_read  = 0;
+            mb_loopback_context->response_write = 0;
+        }
+        uint16_t response_size = MB_LOOPBACK_RESPONSE_BUFFER_SIZE - mb_loopback_context->response_write;
+        if (response_size < MB_FRAMING_MAX_FRAME_LEN(event_len)){
+            mb_loopback_context->num_dropped_responses++;
+            continue;
+        }
+        uint8_t * response = &mb_loopback_context->response_buffer[mb_loopback_context->response_write];
+        if (mb_loopback_context->framing_mode != MB_BRIDGE_FRAMING_REQUEST_MODE_NONE){
+            event_len = mb_framing_encode(loopback_event_buffer, event_len, response, response_size);
+        } else {
+            memcpy(response, loopback_event_buffer, event_len);
+        }
+        mb_loopback_context->response_write += event_len;
+    }
+}
+
+bool mb_loopback_process(mb_loopback_context_t * mb_loopback_context){
+    bool work_done = false;
+
+    if (mb_loopback_context->get_time_us != NULL){
+        mb_loopback_process_sampler(mb_loopback_context);
+    }
+
+    if (mb_loopback_context->tx_done){
+        mb_loopback_context->tx_done = false;
+        work_done = true;
+        if (mb_loopback_context->block_sent_callback != NULL){
+            mb_loopback_context->block_sent_callback(mb_loopback_context->block_sent_context);
+        }
+    }
+
+    uint16_t bytes_delivered = 0;
+    while ((mb_loopback_context->rx_len > 0) && (mb_loopback_context->response_read < mb_loopback_context->response_write)){
+        uint16_t bytes_to_copy = mb_loopback_context->response_write - mb_loopback_context->response_read;
+        if (bytes_to_copy > mb_loopback_context->rx_len){
+            bytes_to_copy = mb_loopback_context->rx_len;
+        }
+        memcpy(mb_loopback_context->rx_buffer, &mb_loopback_context->response_buffer[mb_loopback_context->response_read], bytes_to_copy);
+        mb_loopback_context->rx_buffer     += bytes_to_copy;
+        mb_loopback_context->rx_len        -= bytes_to_copy;
+        mb_loopback_context->response_read += bytes_to_copy;
+        bytes_delivered += bytes_to_copy;
+        // block mode: report complete block, callback provides next buffer
+        if ((mb_loopback_context->rx_stream == false) && (mb_loopback_context->rx_len == 0)){
+            work_done = true;
+            if (mb_loopback_context->block_received_callback != NULL){
+                mb_loopback_context->block_received_callback(mb_loopback_context->block_received_context);
+            }
+        }
+    }
+
+    // stream mode: report all bytes
+    if (mb_loopback_context->rx_stream && (bytes_delivered > 0)){
+        work_done = true;
+        mb_loopback_context->rx_len = 0;
+        if (mb_loopback_context->bytes_received_callback != NULL){
+            mb_loopback_context->bytes_received_callback(mb_loopback_context->bytes_received_context, bytes_delivered);
+        }
+    }
+
+    return work_done;
+}
+
+static const mb_driver_t mb_loopback_driver_interface = {
+        .set_block_received = &mb_loopback_driver_set_block_received,
+        .set_block_sent     = &mb_loopback_driver_set_block_sent,
+        .receive_block      = &mb_loopback_driver_receive_block,
+        .send_block         = &mb_loopback_driver_send_block,
+        .set_bytes_received = &mb_loopback_driver_set_bytes_received,
+        .receive_bytes      = &mb_loopback_driver_receive_bytes,
+        .send_blocks        = &mb_loopback_driver_send_blocks
+};
+
+const mb_driver_t * mb_loopback_get_driver(void){
+    return &mb_loopback_driver_interface;
+}
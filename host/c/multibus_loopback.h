@@ -0,0 +1,159 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_LOOPBACK_H
+#define MULTIBUS_LOOPBACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "multibus_driver.h"
+#include "multibus_framing.h"
+#include "multibus_protocol.h"
+#include "multibus_sampler.h"
+
+/**
+ * MultiBus Loopback Driver
+ *
+ * Runs a bridge implementation inside the host process. Requests are parsed with the generated protocol functions
+ * and forwarded to virtual I2C and SPI devices, see multibus_loopback_devices.h. Responses are delivered from
+ * mb_loopback_process without any system calls, e.g. to measure the overhead of mb_transport.
+ * Delay requests are answered immediately. Framing requests are handled by the driver, not by
+ * mb_loopback_handle_request, as they change how requests and responses are transferred.
+ * After protocol version MB_TRAILER_VERSION has been selected, responses echo the request tag and delay responses
+ * are sent after the responses to all other requests passed to the same send call, i.e. out of order.
+ * Sampler jobs are run from mb_loopback_process if a time source has been set.
+ */
+
+#define MB_LOOPBACK_MAX_MESSAGE_LEN   1024
+#define MB_LOOPBACK_RESPONSE_BUFFER_SIZE 4096
+
+typedef struct mb_loopback_i2c_device {
+    struct mb_loopback_i2c_device * next;
+    uint16_t address;
+    // return false if device does not acknowledge
+    bool (*write)(struct mb_loopback_i2c_device * device, const uint8_t * data, uint16_t len);
+    bool (*read)(struct mb_loopback_i2c_device * device, uint8_t * data, uint16_t len);
+} mb_loopback_i2c_device_t;
+
+typedef struct mb_loopback_spi_device {
+    struct mb_loopback_spi_device * next;
+    uint8_t chip_select_gpio;
+    // full-duplex transfer with chip select active, tx_data or rx_data can be NULL
+    void (*transfer)(struct mb_loopback_spi_device * device, const uint8_t * tx_data, uint8_t * rx_data, uint16_t len);
+} mb_loopback_spi_device_t;
+
+typedef struct {
+    // virtual bridge
+    mb_loopback_i2c_device_t * i2c_devices;
+    mb_loopback_spi_device_t * spi_devices;
+    bool      i2c_master_configured;
+    bool      spi_master_configured;
+    // request reassembly, holds complete frame in framing mode
+    uint8_t   request[MB_FRAMING_MAX_FRAME_LEN(MB_LOOPBACK_MAX_MESSAGE_LEN)];
+    uint16_t  request_len;
+    uint16_t  request_skip;
+    // link framing
+    mb_bridge_framing_request_mode_t framing_mode;
+    mb_framing_decoder_t framing_decoder;
+    // selected protocol version
+    uint16_t  protocol_version;
+    // responses sent after all other responses of current send call
+    uint8_t   deferred_responses[64];
+    uint16_t  deferred_len;
+    // sampler jobs, run with time source
+    mb_sampler_t sampler;
+    uint32_t (*get_time_us)(void);
+    // pending responses
+    uint8_t   response_buffer[MB_LOOPBACK_RESPONSE_BUFFER_SIZE];
+    uint16_t  response_read;
+    uint16_t  response_write;
+    // driver interface
+    void (*block_received_callback)(void *context);
+    void *block_received_context;
+    void (*block_sent_callback)(void *context);
+    void *block_sent_context;
+    void (*bytes_received_callback)(void *context, uint16_t num_bytes);
+    void *bytes_received_context;
+    uint8_t * rx_buffer;
+    uint16_t  rx_len;
+    bool      rx_stream;
+    bool      tx_done;
+    // stats
+    uint32_t  num_requests;
+    uint32_t  num_ignored_requests;
+    uint32_t  num_dropped_responses;
+} mb_loopback_context_t;
+
+/**
+ * @brief Init loopback bridge without devices
+ * @param mb_loopback_context
+ */
+void mb_loopback_init(mb_loopback_context_t * mb_loopback_context);
+
+/**
+ * @brief Set time source for sampler jobs
+ * @param mb_loopback_context
+ * @param get_time_us time source, NULL to not run sampler jobs
+ */
+void mb_loopback_set_time_source(mb_loopback_context_t * mb_loopback_context, uint32_t (*get_time_us)(void));
+
+/**
+ * @brief Add virtual I2C device
+ * @param mb_loopback_context
+ * @param device
+ */
+void mb_loopback_add_i2c_device(mb_loopback_context_t * mb_loopback_context, mb_loopback_i2c_device_t * device);
+
+/**
+ * @brief Add virtual SPI device
+ * @param mb_loopback_context
+ * @param device
+ */
+void mb_loopback_add_spi_device(mb_loopback_context_t * mb_loopback_context, mb_loopback_spi_device_t * device);
+
+/**
+ * @brief Handle single request and setup response
+ * @param mb_loopback_context
+ * @param request including header
+ * @param request_len
+ * @param response buffer
+ * @param response_size
+ * @return response len, 0 if request is ignored
+ */
+uint16_t mb_loopback_handle_request(mb_loopback_context_t * mb_loopback_context, const uint8_t * request, uint16_t request_len,
+                                    uint8_t * response, uint16_t response_size);
+
+/**
+ * @brief Deliver responses and send complete events
+ * @param mb_loopback_context
+ * @return true if any events have been emitted
+ */
+bool mb_loopback_process(mb_loopback_context_t * mb_loopback_context);
+
+/**
+ * Provide driver implementation
+ * @return mb_driver_t implementation
+ */
+const mb_driver_t * mb_loopback_get_driver(void);
+
+#endif //MULTIBUS_LOOPBACK_H
@@ -0,0 +1,161 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "multibus_loopback_devices.h"
+
+// BH1750 ambient light sensor
+
+#define BH1750_CMD_POWER_DOWN           0x00
+#define BH1750_CMD_POWER_ON             0x01
+#define BH1750_CMD_RESET                0x07
+#define BH1750_CMD_CONTINUOUS_H_RES     0x10
+#define BH1750_CMD_CONTINUOUS_H_RES_2   0x11
+#define BH1750_CMD_CONTINUOUS_L_RES     0x13
+#define BH1750_CMD_ONE_TIME_H_RES       0x20
+#define BH1750_CMD_ONE_TIME_H_RES_2     0x21
+#define BH1750_CMD_ONE_TIME_L_RES       0x23
+
+static void mb_loopback_bh1750_measure(mb_loopback_bh1750_t * bh1750){
+    // counts = lux * 1.2
+    uint32_t measurement = (bh1750->lux * 12) / 10;
+    if (measurement > 0xffff){
+        measurement = 0xffff;
+    }
+    bh1750->measurement = (uint16_t) measurement;
+}
+
+static bool mb_loopback_bh1750_write(mb_loopback_i2c_device_t * device, const uint8_t * data, uint16_t len){
+    mb_loopback_bh1750_t * bh1750 = (mb_loopback_bh1750_t *) device;
+    uint16_t i;
+    for (i = 0; i < len; i++){
+        uint8_t command = data[i];
+        switch (command){
+            case BH1750_CMD_POWER_DOWN:
+                bh1750->powered = false;
+                break;
+            case BH1750_CMD_POWER_ON:
+                bh1750->powered = true;
+                break;
+            case BH1750_CMD_RESET:
+                // only valid in power on mode
+                if (bh1750->powered){
+                    bh1750->measurement = 0;
+                }
+                break;
+            case BH1750_CMD_CONTINUOUS_H_RES:
+            case BH1750_CMD_CONTINUOUS_H_RES_2:
+            case BH1750_CMD_CONTINUOUS_L_RES:
+            case BH1750_CMD_ONE_TIME_H_RES:
+            case BH1750_CMD_ONE_TIME_H_RES_2:
+            case BH1750_CMD_ONE_TIME_L_RES:
+                // measurement completes instantly
+                bh1750->powered = true;
+                bh1750->mode = command;
+                mb_loopback_bh1750_measure(bh1750);
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+static bool mb_loopback_bh1750_read(mb_loopback_i2c_device_t * device, uint8_t * data, uint16_t len){
+    mb_loopback_bh1750_t * bh1750 = (mb_loopback_bh1750_t *) device;
+    // continuous modes update measurement
+    switch (bh1750->mode){
+        case BH1750_CMD_CONTINUOUS_H_RES:
+        case BH1750_CMD_CONTINUOUS_H_RES_2:
+        case BH1750_CMD_CONTINUOUS_L_RES:
+            if (bh1750->powered){
+                mb_loopback_bh1750_measure(bh1750);
+            }
+            break;
+        default:
+            break;
+    }
+    // big endian measurement, then bus idles high
+    memset(data, 0xff, len);
+    if (len > 0){
+        data[0] = (uint8_t) (bh1750->measurement >> 8);
+    }
+    if (len > 1){
+        data[1] = (uint8_t) bh1750->measurement;
+    }
+    return true;
+}
+
+void mb_loopback_bh1750_init(mb_loopback_bh1750_t * bh1750, uint16_t address){
+    assert(bh1750 != NULL);
+    memset(bh1750, 0, sizeof(mb_loopback_bh1750_t));
+    bh1750->device.address = address;
+    bh1750->device.write = &mb_loopback_bh1750_write;
+    bh1750->device.read = &mb_loopback_bh1750_read;
+}
+
+void mb_loopback_bh1750_set_lux(mb_loopback_bh1750_t * bh1750, uint32_t lux){
+    bh1750->lux = lux;
+}
+
+// Chain of cascaded MAX7219 LED drivers
+
+static void mb_loopback_max7219_transfer(mb_loopback_spi_device_t * device, const uint8_t * tx_data, uint8_t * rx_data, uint16_t len){
+    mb_loopback_max7219_t * max7219 = (mb_loopback_max7219_t *) device;
+    // DOUT is connected to the next module, not to MISO
+    (void) rx_data;
+    if (tx_data == NULL) return;
+
+    // shift data through the chain, only the last bytes stay in the shift registers
+    uint16_t chain_len = 2 * max7219->num_modules;
+    if (len >= chain_len){
+        memcpy(max7219->shift_register, &tx_data[len - chain_len], chain_len);
+    } else {
+        memmove(max7219->shift_register, &max7219->shift_register[len], chain_len - len);
+        memcpy(&max7219->shift_register[chain_len - len], tx_data, len);
+    }
+
+    // chip select high: latch register address and data in each module
+    uint8_t module;
+    for (module = 0; module < max7219->num_modules; module++){
+        uint16_t pos = chain_len - 2 * (module + 1);
+        uint8_t address = max7219->shift_register[pos] & 0x0f;
+        max7219->registers[module][address] = max7219->shift_register[pos + 1];
+    }
+    max7219->num_updates++;
+}
+
+void mb_loopback_max7219_init(mb_loopback_max7219_t * max7219, uint8_t chip_select_gpio, uint8_t num_modules){
+    assert(max7219 != NULL);
+    assert((num_modules > 0) && (num_modules <= MB_LOOPBACK_MAX7219_MAX_MODULES));
+    memset(max7219, 0, sizeof(mb_loopback_max7219_t));
+    max7219->device.chip_select_gpio = chip_select_gpio;
+    max7219->device.transfer = &mb_loopback_max7219_transfer;
+    max7219->num_modules = num_modules;
+}
+
+uint8_t mb_loopback_max7219_get_register(const mb_loopback_max7219_t * max7219, uint8_t module, uint8_t address){
+    assert(module < max7219->num_modules);
+    return max7219->registers[module][address & 0x0f];
+}
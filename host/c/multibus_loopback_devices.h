@@ -0,0 +1,97 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_LOOPBACK_DEVICES_H
+#define MULTIBUS_LOOPBACK_DEVICES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "multibus_loopback.h"
+
+/**
+ * MultiBus Loopback Devices
+ *
+ * Virtual devices for the loopback driver. Each device embeds its mb_loopback_i2c_device_t or mb_loopback_spi_device_t
+ * as first member and can be registered with mb_loopback_add_i2c_device or mb_loopback_add_spi_device.
+ */
+
+// BH1750 ambient light sensor
+
+#define MB_LOOPBACK_BH1750_ADDRESS_LOW  0x23
+#define MB_LOOPBACK_BH1750_ADDRESS_HIGH 0x5C
+
+typedef struct {
+    mb_loopback_i2c_device_t device;
+    bool     powered;
+    uint8_t  mode;
+    uint16_t measurement;
+    uint32_t lux;
+} mb_loopback_bh1750_t;
+
+/**
+ * @brief Init BH1750 sensor, powered down
+ * @param bh1750
+ * @param address
+ */
+void mb_loopback_bh1750_init(mb_loopback_bh1750_t * bh1750, uint16_t address);
+
+/**
+ * @brief Set ambient light returned by the next measurement
+ * @param bh1750
+ * @param lux
+ */
+void mb_loopback_bh1750_set_lux(mb_loopback_bh1750_t * bh1750, uint32_t lux);
+
+// Chain of cascaded MAX7219 LED drivers
+
+#define MB_LOOPBACK_MAX7219_MAX_MODULES 8
+#define MB_LOOPBACK_MAX7219_NUM_REGISTERS 16
+
+typedef struct {
+    mb_loopback_spi_device_t device;
+    uint8_t num_modules;
+    // shift registers of all modules, first byte is in the module at the end of the chain
+    uint8_t shift_register[2 * MB_LOOPBACK_MAX7219_MAX_MODULES];
+    // module 0 is connected to MOSI
+    uint8_t registers[MB_LOOPBACK_MAX7219_MAX_MODULES][MB_LOOPBACK_MAX7219_NUM_REGISTERS];
+    uint32_t num_updates;
+} mb_loopback_max7219_t;
+
+/**
+ * @brief Init chain of MAX7219 with all registers cleared
+ * @param max7219
+ * @param chip_select_gpio
+ * @param num_modules, max MB_LOOPBACK_MAX7219_MAX_MODULES
+ */
+void mb_loopback_max7219_init(mb_loopback_max7219_t * max7219, uint8_t chip_select_gpio, uint8_t num_modules);
+
+/**
+ * @brief Get register of single module
+ * @param max7219
+ * @param module, 0 is connected to MOSI
+ * @param address
+ * @return value
+ */
+uint8_t mb_loopback_max7219_get_register(const mb_loopback_max7219_t * max7219, uint8_t module, uint8_t address);
+
+#endif //MULTIBUS_LOOPBACK_DEVICES_H
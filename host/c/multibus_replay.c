@@ -0,0 +1,280 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "multibus_replay.h"
+
+bool mb_replay_get_record(const uint8_t * trace_data, uint32_t trace_len, uint32_t * offset, mb_replay_record_t * record){
+    uint32_t pos = *offset;
+    if ((pos + MB_CAPTURE_RECORD_HEADER_SIZE) > trace_len) return false;
+    const uint8_t * record_header = &trace_data[pos];
+    uint16_t len = (record_header[5] << 8) | record_header[6];
+    if ((pos + MB_CAPTURE_RECORD_HEADER_SIZE + len) > trace_len) return false;
+    record->timestamp_us = ((uint32_t) record_header[0] << 24) | ((uint32_t) record_header[1] << 16) |
+                           ((uint32_t) record_header[2] << 8)  |  (uint32_t) record_header[3];
+    record->type = (mb_capture_type_t) record_header[4];
+    record->data = &record_header[MB_CAPTURE_RECORD_HEADER_SIZE];
+    record->len  = len;
+    *offset = pos + MB_CAPTURE_RECORD_HEADER_SIZE + len;
+    return true;
+}
+
+// move offset to next record of given type, records of other types are skipped for good
+static bool mb_replay_seek_record(mb_replay_context_t * mb_replay_context, uint32_t * offset, mb_capture_type_t type,
+                                  mb_replay_record_t * record){
+    uint32_t next_offset = *offset;
+    while (mb_replay_get_record(mb_replay_context->trace_data, mb_replay_context->trace_len, &next_offset, record)){
+        if (record->type == type) return true;
+        *offset = next_offset;
+    }
+    *offset = mb_replay_context->trace_len;
+    return false;
+}
+
+bool mb_replay_init(mb_replay_context_t * mb_replay_context, const uint8_t * trace_data, uint32_t trace_len){
+    assert(mb_replay_context != NULL);
+    memset(mb_replay_context, 0, sizeof(mb_replay_context_t));
+    if (trace_len < MB_CAPTURE_FILE_HEADER_SIZE) return false;
+    if (memcmp(trace_data, "MBCP", 4) != 0) return false;
+    if (trace_data[4] != MB_CAPTURE_FORMAT_VERSION) return false;
+    mb_replay_context->trace_data     = trace_data;
+    mb_replay_context->trace_len      = trace_len;
+    mb_replay_context->send_offset    = MB_CAPTURE_FILE_HEADER_SIZE;
+    mb_replay_context->receive_offset = MB_CAPTURE_FILE_HEADER_SIZE;
+    return true;
+}
+
+bool mb_replay_open(mb_replay_context_t * mb_replay_context, const char * path, uint8_t * trace_storage, uint32_t trace_storage_size){
+    FILE * file = fopen(path, "rb");
+    if (file == NULL) return false;
+    size_t trace_len = fread(trace_storage, 1, trace_storage_size, file);
+    // capture needs to fit into storage
+    bool complete = feof(file) != 0;
+    fclose(file);
+    if (complete == false) return false;
+    return mb_replay_init(mb_replay_context, trace_storage, (uint32_t) trace_len);
+}
+
+void mb_replay_set_time_source(mb_replay_context_t * mb_replay_context, uint32_t (*get_time_us)(void)){
+    mb_replay_context->get_time_us = get_time_us;
+}
+
+// Driver interface
+
+static void mb_replay_driver_set_block_received(void * driver_context, void (*block_handler)(void * context), void * callback_context){
+    mb_replay_context_t * mb_replay_context = (mb_replay_context_t *) driver_context;
+    mb_replay_context->block_received_callback = block_handler;
+    mb_replay_context->block_received_context = callback_context;
+}
+
+static void mb_replay_driver_set_block_sent(void * driver_context, void (*block_handler)(void * context), void * callback_context){
+    mb_replay_context_t * mb_replay_context = (mb_replay_context_t *) driver_context;
+    mb_replay_context->block_sent_callback = block_handler;
+    mb_replay_context->block_sent_context = callback_context;
+}
+
+static void mb_replay_driver_set_bytes_received(void * driver_context, void (*bytes_handler)(void * context, uint16_t num_bytes), void * callback_context){
+    mb_replay_context_t * mb_replay_context = (mb_replay_context_t *) driver_context;
+    mb_replay_context->bytes_received_callback = bytes_handler;
+    mb_replay_context->bytes_received_context = callback_context;
+}
+
+static void mb_replay_driver_receive_block(void * driver_context, uint8_t *buffer, uint16_t length){
+    mb_replay_context_t * mb_replay_context = (mb_replay_context_t *) driver_context;
+    mb_replay_context->rx_buffer = buffer;
+    mb_replay_context->rx_len = length;
+    mb_replay_context->rx_stream = false;
+}
+
+static void mb_replay_driver_receive_bytes(void * driver_context, uint8_t *buffer, uint16_t max_length){
+    mb_replay_context_t * mb_replay_context = (mb_replay_context_t *) driver_context;
+    mb_replay_context->rx_buffer = buffer;
+    mb_replay_context->rx_len = max_length;
+    mb_replay_context->rx_stream = true;
+}
+
+static void mb_replay_check_data(mb_replay_context_t * mb_replay_context, const uint8_t * data, uint16_t len){
+    while (len > 0){
+        // get next request
+        if (mb_replay_context->expected_valid == false){
+            if (mb_replay_seek_record(mb_replay_context, &mb_replay_context->send_offset, MB_CAPTURE_TYPE_SENT,
+                                      &mb_replay_context->expected) == false){
+                mb_replay_context->num_unexpected_bytes += len;
+                return;
+            }
+            mb_replay_context->expected_offset   = mb_replay_context->send_offset;
+            mb_replay_context->send_offset      += MB_CAPTURE_RECORD_HEADER_SIZE + mb_replay_context->expected.len;
+            mb_replay_context->expected_pos      = 0;
+            mb_replay_context->expected_mismatch = false;
+            mb_replay_context->expected_valid    = true;
+        }
+
+        // compare with request
+        uint16_t bytes_to_check = mb_replay_context->expected.len - mb_replay_context->expected_pos;
+        if (bytes_to_check > len){
+            bytes_to_check = len;
+        }
+        if (memcmp(data, &mb_replay_context->expected.data[mb_replay_context->expected_pos], bytes_to_check) != 0){
+            mb_replay_context->expected_mismatch = true;
+        }
+        mb_replay_context->expected_pos += bytes_to_check;
+        data += bytes_to_check;
+        len  -= bytes_to_check;
+
+        // request complete
+        if (mb_replay_context->expected_pos == mb_replay_context->expected.len){
+            mb_replay_context->expected_valid = false;
+            mb_replay_context->num_requests++;
+            if (mb_replay_context->expected_mismatch){
+                mb_replay_context->num_mismatches++;
+            }
+            mb_replay_context->last_request_timestamp_us = mb_replay_context->expected.timestamp_us;
+            if (mb_replay_context->get_time_us != NULL){
+                mb_replay_context->last_request_sent_us = mb_replay_context->get_time_us();
+            }
+        }
+    }
+}
+
+static void mb_replay_driver_send_blocks(void * driver_context, const mb_driver_block_t * blocks, uint8_t num_blocks){
+    mb_replay_context_t * mb_replay_context = (mb_replay_context_t *) driver_context;
+    uint8_t i;
+    for (i = 0; i < num_blocks; i++){
+        mb_replay_check_data(mb_replay_context, blocks[i].data, blocks[i].len);
+    }
+    // report send complete in mb_replay_process
+    mb_replay_context->tx_done = true;
+}
+
+static void mb_replay_driver_send_block(void * driver_context, const uint8_t *buffer, uint16_t length){
+    mb_driver_block_t block;
+    block.data = buffer;
+    block.len  = length;
+    mb_replay_driver_send_blocks(driver_context, &block, 1);
+}
+
+// get next response that can be delivered
+static bool mb_replay_response_ready(mb_replay_context_t * mb_replay_context){
+    if (mb_replay_context->response_valid) return true;
+
+    mb_replay_record_t response;
+    if (mb_replay_seek_record(mb_replay_context, &mb_replay_context->receive_offset, MB_CAPTURE_TYPE_RECEIVED,
+                              &response) == false) return false;
+
+    // all requests before response need to be sent
+    uint32_t request_offset;
+    if (mb_replay_context->expected_valid){
+        request_offset = mb_replay_context->expected_offset;
+    } else {
+        mb_replay_record_t request;
+        (void) mb_replay_seek_record(mb_replay_context, &mb_replay_context->send_offset, MB_CAPTURE_TYPE_SENT, &request);
+        request_offset = mb_replay_context->send_offset;
+    }
+    if (request_offset < mb_replay_context->receive_offset) return false;
+
+    // keep original delay
+    if (mb_replay_context->get_time_us != NULL){
+        int32_t delay_us = (int32_t) (response.timestamp_us - mb_replay_context->last_request_timestamp_us);
+        int32_t elapsed_us = (int32_t) (mb_replay_context->get_time_us() - mb_replay_context->last_request_sent_us);
+        if (elapsed_us < delay_us) return false;
+    }
+
+    mb_replay_context->response       = response;
+    mb_replay_context->response_pos   = 0;
+    mb_replay_context->response_valid = true;
+    mb_replay_context->receive_offset += MB_CAPTURE_RECORD_HEADER_SIZE + response.len;
+    return true;
+}
+
+bool mb_replay_process(mb_replay_context_t * mb_replay_context){
+    bool work_done = false;
+
+    if (mb_replay_context->tx_done){
+        mb_replay_context->tx_done = false;
+        work_done = true;
+        if (mb_replay_context->block_sent_callback != NULL){
+            mb_replay_context->block_sent_callback(mb_replay_context->block_sent_context);
+        }
+    }
+
+    uint16_t bytes_delivered = 0;
+    while ((mb_replay_context->rx_len > 0) && mb_replay_response_ready(mb_replay_context)){
+        uint16_t bytes_to_copy = mb_replay_context->response.len - mb_replay_context->response_pos;
+        if (bytes_to_copy > mb_replay_context->rx_len){
+            bytes_to_copy = mb_replay_context->rx_len;
+        }
+        memcpy(mb_replay_context->rx_buffer, &mb_replay_context->response.data[mb_replay_context->response_pos], bytes_to_copy);
+        mb_replay_context->rx_buffer    += bytes_to_copy;
+        mb_replay_context->rx_len       -= bytes_to_copy;
+        mb_replay_context->response_pos += bytes_to_copy;
+        bytes_delivered += bytes_to_copy;
+        if (mb_replay_context->response_pos == mb_replay_context->response.len){
+            mb_replay_context->response_valid = false;
+            mb_replay_context->num_responses++;
+        }
+        // block mode: report complete block, callback provides next buffer
+        if ((mb_replay_context->rx_stream == false) && (mb_replay_context->rx_len == 0)){
+            work_done = true;
+            if (mb_replay_context->block_received_callback != NULL){
+                mb_replay_context->block_received_callback(mb_replay_context->block_received_context);
+            }
+        }
+    }
+
+    // stream mode: report all bytes
+    if (mb_replay_context->rx_stream && (bytes_delivered > 0)){
+        work_done = true;
+        mb_replay_context->rx_len = 0;
+        if (mb_replay_context->bytes_received_callback != NULL){
+            mb_replay_context->bytes_received_callback(mb_replay_context->bytes_received_context, bytes_delivered);
+        }
+    }
+
+    return work_done;
+}
+
+bool mb_replay_done(mb_replay_context_t * mb_replay_context){
+    mb_replay_record_t record;
+    if (mb_replay_context->tx_done) return false;
+    if (mb_replay_context->expected_valid) return false;
+    if (mb_replay_context->response_valid) return false;
+    if (mb_replay_seek_record(mb_replay_context, &mb_replay_context->send_offset, MB_CAPTURE_TYPE_SENT, &record)) return false;
+    if (mb_replay_seek_record(mb_replay_context, &mb_replay_context->receive_offset, MB_CAPTURE_TYPE_RECEIVED, &record)) return false;
+    return true;
+}
+
+static const mb_driver_t mb_replay_driver_interface = {
+        .set_block_received = &mb_replay_driver_set_block_received,
+        .set_block_sent     = &mb_replay_driver_set_block_sent,
+        .receive_block      = &mb_replay_driver_receive_block,
+        .send_block         = &mb_replay_driver_send_block,
+        .set_bytes_received = &mb_replay_driver_set_bytes_received,
+        .receive_bytes      = &mb_replay_driver_receive_bytes,
+        .send_blocks        = &mb_replay_driver_send_blocks
+};
+
+const mb_driver_t * mb_replay_get_driver(void){
+    return &mb_replay_driver_interface;
+}
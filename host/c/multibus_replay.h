@@ -0,0 +1,142 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_REPLAY_H
+#define MULTIBUS_REPLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "multibus_capture.h"
+#include "multibus_driver.h"
+
+/**
+ * MultiBus Replay Driver
+ *
+ * Replays a capture file recorded with multibus_capture: sent data is checked against the recorded requests and the
+ * recorded responses are delivered after all requests that precede them in the capture have been sent.
+ * Without time source, responses are delivered as fast as possible. With time source, the original delay between
+ * the last request and the response is kept.
+ */
+
+typedef struct {
+    uint32_t          timestamp_us;
+    mb_capture_type_t type;
+    const uint8_t   * data;
+    uint16_t          len;
+} mb_replay_record_t;
+
+typedef struct {
+    // capture
+    const uint8_t * trace_data;
+    uint32_t        trace_len;
+    // next request to check, offsets only move forward
+    uint32_t           send_offset;
+    uint32_t           expected_offset;
+    mb_replay_record_t expected;
+    uint16_t           expected_pos;
+    bool               expected_valid;
+    bool               expected_mismatch;
+    // next response to deliver
+    uint32_t           receive_offset;
+    mb_replay_record_t response;
+    uint16_t           response_pos;
+    bool               response_valid;
+    // original timing
+    uint32_t (*get_time_us)(void);
+    uint32_t  last_request_timestamp_us;
+    uint32_t  last_request_sent_us;
+    // driver interface
+    void (*block_received_callback)(void *context);
+    void *block_received_context;
+    void (*block_sent_callback)(void *context);
+    void *block_sent_context;
+    void (*bytes_received_callback)(void *context, uint16_t num_bytes);
+    void *bytes_received_context;
+    uint8_t * rx_buffer;
+    uint16_t  rx_len;
+    bool      rx_stream;
+    bool      tx_done;
+    // results
+    uint32_t  num_requests;
+    uint32_t  num_responses;
+    uint32_t  num_mismatches;
+    uint32_t  num_unexpected_bytes;
+} mb_replay_context_t;
+
+/**
+ * @brief Get record from capture
+ * @param trace_data
+ * @param trace_len
+ * @param offset of record, updated to next record
+ * @param record
+ * @return true if record available
+ */
+bool mb_replay_get_record(const uint8_t * trace_data, uint32_t trace_len, uint32_t * offset, mb_replay_record_t * record);
+
+/**
+ * @brief Init replay with capture in memory
+ * @param mb_replay_context
+ * @param trace_data complete capture file including file header
+ * @param trace_len
+ * @return true if capture is valid
+ */
+bool mb_replay_init(mb_replay_context_t * mb_replay_context, const uint8_t * trace_data, uint32_t trace_len);
+
+/**
+ * @brief Load capture file into provided storage and init replay
+ * @param mb_replay_context
+ * @param path
+ * @param trace_storage
+ * @param trace_storage_size
+ * @return true if successful
+ */
+bool mb_replay_open(mb_replay_context_t * mb_replay_context, const char * path, uint8_t * trace_storage, uint32_t trace_storage_size);
+
+/**
+ * @brief Keep original delay between requests and responses
+ * @param mb_replay_context
+ * @param get_time_us time source, NULL to deliver responses without delay
+ */
+void mb_replay_set_time_source(mb_replay_context_t * mb_replay_context, uint32_t (*get_time_us)(void));
+
+/**
+ * @brief Deliver responses and send complete events
+ * @param mb_replay_context
+ * @return true if any events have been emitted
+ */
+bool mb_replay_process(mb_replay_context_t * mb_replay_context);
+
+/**
+ * @brief Check if all requests have been sent and all responses have been delivered
+ * @param mb_replay_context
+ * @return true if done
+ */
+bool mb_replay_done(mb_replay_context_t * mb_replay_context);
+
+/**
+ * Provide driver implementation
+ * @return mb_driver_t implementation
+ */
+const mb_driver_t * mb_replay_get_driver(void);
+
+#endif //MULTIBUS_REPLAY_H
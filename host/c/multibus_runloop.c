@@ -0,0 +1,188 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "multibus_runloop.h"
+
+static bool mb_runloop_update_events(mb_runloop_source_t * source, bool write_enabled){
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLET;
+    if (write_enabled){
+        event.events |= EPOLLOUT;
+    }
+    event.data.ptr = source;
+    int fd = mb_serial_posix_get_file_descriptor(source->mb_serial_posix_context);
+    if (epoll_ctl(source->runloop->epoll_fd, EPOLL_CTL_MOD, fd, &event) < 0) return false;
+    source->write_enabled = write_enabled;
+    return true;
+}
+
+// called by mb_serial_posix when it needs to write data
+static void mb_runloop_write_started(void * context){
+    mb_runloop_source_t * source = (mb_runloop_source_t *) context;
+    if (source->write_enabled) return;
+    // modifying the interest list reports EPOLLOUT if the fd is writable
+    (void) mb_runloop_update_events(source, true);
+}
+
+bool mb_runloop_init(mb_runloop_t * mb_runloop){
+    assert(mb_runloop != NULL);
+    memset(mb_runloop, 0, sizeof(mb_runloop_t));
+    mb_runloop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    return mb_runloop->epoll_fd >= 0;
+}
+
+void mb_runloop_deinit(mb_runloop_t * mb_runloop){
+    while (mb_runloop->sources != NULL){
+        mb_runloop_remove_serial(mb_runloop, mb_runloop->sources);
+    }
+    if (mb_runloop->epoll_fd >= 0){
+        close(mb_runloop->epoll_fd);
+        mb_runloop->epoll_fd = -1;
+    }
+}
+
+bool mb_runloop_add_serial(mb_runloop_t * mb_runloop, mb_runloop_source_t * source,
+                           mb_serial_posix_context_t * mb_serial_posix_context, mb_transport_t * transport){
+    assert(source != NULL);
+    assert(mb_serial_posix_context != NULL);
+    memset(source, 0, sizeof(mb_runloop_source_t));
+    source->runloop = mb_runloop;
+    source->mb_serial_posix_context = mb_serial_posix_context;
+    source->transport = transport;
+
+    // request EPOLLOUT if a write has been started already
+    source->write_enabled = mb_serial_posix_write_active(mb_serial_posix_context);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLET;
+    if (source->write_enabled){
+        event.events |= EPOLLOUT;
+    }
+    event.data.ptr = source;
+    int fd = mb_serial_posix_get_file_descriptor(mb_serial_posix_context);
+    if (epoll_ctl(mb_runloop->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) return false;
+
+    mb_serial_posix_register_write_started(mb_serial_posix_context, &mb_runloop_write_started, source);
+    source->next = mb_runloop->sources;
+    mb_runloop->sources = source;
+    mb_runloop->num_sources++;
+    return true;
+}
+
+void mb_runloop_register_closed(mb_runloop_source_t * source, void (*closed_callback)(void * context), void * closed_context){
+    source->closed_callback = closed_callback;
+    source->closed_context  = closed_context;
+}
+
+void mb_runloop_remove_serial(mb_runloop_t * mb_runloop, mb_runloop_source_t * source){
+    mb_runloop_source_t ** it;
+    for (it = &mb_runloop->sources; *it != NULL; it = &(*it)->next){
+        if (*it != source) continue;
+        *it = source->next;
+        mb_runloop->num_sources--;
+        mb_serial_posix_register_write_started(source->mb_serial_posix_context, NULL, NULL);
+        int fd = mb_serial_posix_get_file_descriptor(source->mb_serial_posix_context);
+        if (fd >= 0){
+            (void) epoll_ctl(mb_runloop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        }
+        source->runloop = NULL;
+        return;
+    }
+}
+
+static void mb_runloop_handle_events(mb_runloop_t * mb_runloop, mb_runloop_source_t * source, uint32_t events){
+    mb_serial_posix_context_t * mb_serial_posix_context = source->mb_serial_posix_context;
+
+    // edge-triggered: read until no data is left
+    if ((events & EPOLLIN) != 0){
+        while (mb_serial_posix_process_read(mb_serial_posix_context) > 0){
+        }
+    }
+    // callbacks might have removed the source
+    if (source->runloop != mb_runloop) return;
+
+    // edge-triggered: write until fd is full, callbacks might start the next write
+    if ((events & EPOLLOUT) != 0){
+        while (mb_serial_posix_write_active(mb_serial_posix_context)){
+            if (mb_serial_posix_process_write(mb_serial_posix_context) == 0) break;
+        }
+    }
+    if (source->runloop != mb_runloop) return;
+    if (source->write_enabled && (mb_serial_posix_write_active(mb_serial_posix_context) == false)){
+        (void) mb_runloop_update_events(source, false);
+    }
+
+    if ((events & (EPOLLHUP | EPOLLERR)) != 0){
+        mb_runloop_remove_serial(mb_runloop, source);
+        if (source->closed_callback != NULL){
+            source->closed_callback(source->closed_context);
+        }
+    }
+}
+
+int mb_runloop_process(mb_runloop_t * mb_runloop, int timeout_ms){
+    // wait until earliest transport timeout
+    mb_runloop_source_t * source;
+    for (source = mb_runloop->sources; source != NULL; source = source->next){
+        if (source->transport == NULL) continue;
+        uint32_t transport_timeout_ms = mb_transport_get_next_timeout_ms(source->transport);
+        if (transport_timeout_ms == MB_TRANSPORT_NO_TIMEOUT) continue;
+        if ((timeout_ms < 0) || (transport_timeout_ms < (uint32_t) timeout_ms)){
+            timeout_ms = (int) transport_timeout_ms;
+        }
+    }
+
+    struct epoll_event events[MB_RUNLOOP_MAX_EVENTS];
+    int num_events = epoll_wait(mb_runloop->epoll_fd, events, MB_RUNLOOP_MAX_EVENTS, timeout_ms);
+    if (num_events < 0){
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    int i;
+    for (i = 0; i < num_events; i++){
+        mb_runloop_handle_events(mb_runloop, (mb_runloop_source_t *) events[i].data.ptr, events[i].events);
+    }
+
+    for (source = mb_runloop->sources; source != NULL; source = source->next){
+        if (source->transport == NULL) continue;
+        mb_transport_process_timeouts(source->transport);
+    }
+    return num_events;
+}
+
+void mb_runloop_run(mb_runloop_t * mb_runloop){
+    mb_runloop->done = false;
+    while ((mb_runloop->done == false) && (mb_runloop->num_sources > 0)){
+        if (mb_runloop_process(mb_runloop, -1) < 0) break;
+    }
+}
+
+void mb_runloop_stop(mb_runloop_t * mb_runloop){
+    mb_runloop->done = true;
+}
@@ -0,0 +1,123 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_RUNLOOP_H
+#define MULTIBUS_RUNLOOP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "multibus_serial_posix.h"
+#include "multibus_transport.h"
+
+/**
+ * MultiBus Run Loop for Linux
+ *
+ * Drives many POSIX serial contexts from a single thread using edge-triggered epoll. Each bridge is registered with
+ * a mb_runloop_source_t. EPOLLOUT is only requested while mb_serial_posix_write_active reports pending data.
+ * If a transport is provided, its request timeouts are processed as well.
+ * As reads are edge-triggered, a receive buffer needs to be provided at all times, as done by mb_transport.
+ */
+
+// max number of events handled per epoll_wait
+#define MB_RUNLOOP_MAX_EVENTS 64
+
+typedef struct mb_runloop_source {
+    struct mb_runloop_source * next;
+    struct mb_runloop * runloop;
+    mb_serial_posix_context_t * mb_serial_posix_context;
+    mb_transport_t * transport;
+    // EPOLLOUT requested
+    bool write_enabled;
+    // called after hang-up or error, source has been removed
+    void (*closed_callback)(void * context);
+    void *closed_context;
+} mb_runloop_source_t;
+
+typedef struct mb_runloop {
+    int epoll_fd;
+    mb_runloop_source_t * sources;
+    uint16_t num_sources;
+    bool done;
+} mb_runloop_t;
+
+/**
+ * @brief Init run loop
+ * @param mb_runloop
+ * @return true if successful
+ */
+bool mb_runloop_init(mb_runloop_t * mb_runloop);
+
+/**
+ * @brief Remove all sources and free epoll instance
+ * @param mb_runloop
+ */
+void mb_runloop_deinit(mb_runloop_t * mb_runloop);
+
+/**
+ * @brief Add serial context of an open bridge
+ * @note registers write started callback with serial context
+ * @param mb_runloop
+ * @param source storage, needs to stay valid until removed
+ * @param mb_serial_posix_context
+ * @param transport using the serial context for timeout handling, or NULL
+ * @return true if successful
+ */
+bool mb_runloop_add_serial(mb_runloop_t * mb_runloop, mb_runloop_source_t * source,
+                           mb_serial_posix_context_t * mb_serial_posix_context, mb_transport_t * transport);
+
+/**
+ * @brief Register callback for hang-up or error on the serial port, e.g. to close and re-open it
+ * @param source
+ * @param closed_callback
+ * @param closed_context
+ */
+void mb_runloop_register_closed(mb_runloop_source_t * source, void (*closed_callback)(void * context), void * closed_context);
+
+/**
+ * @brief Remove serial context
+ * @param mb_runloop
+ * @param source
+ */
+void mb_runloop_remove_serial(mb_runloop_t * mb_runloop, mb_runloop_source_t * source);
+
+/**
+ * @brief Wait for events and dispatch them once
+ * @param mb_runloop
+ * @param timeout_ms max time to wait, -1 waits until next event or transport timeout
+ * @return number of sources with events, -1 on error
+ */
+int mb_runloop_process(mb_runloop_t * mb_runloop, int timeout_ms);
+
+/**
+ * @brief Process events until mb_runloop_stop is called or no source is left
+ * @param mb_runloop
+ */
+void mb_runloop_run(mb_runloop_t * mb_runloop);
+
+/**
+ * @brief Stop mb_runloop_run after current iteration
+ * @param mb_runloop
+ */
+void mb_runloop_stop(mb_runloop_t * mb_runloop);
+
+#endif //MULTIBUS_RUNLOOP_H
@@ -24,22 +24,78 @@
  * MultiBus Serial Transport for POSIX systems
  */
 
+#include <assert.h>
 #include <errno.h>
 #include <fcntl.h>    /* File control definitions */
+#include <poll.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>   /* UNIX standard function definitions */
+#include <sys/uio.h>
 
 #ifdef __APPLE__
 #include <sys/ioctl.h>
 #include <IOKit/serial/ioss.h>
 #endif
 
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#endif
+
 #include "multibus_serial_posix.h"
+#include "multibus_framing.h"
 #include "multibus_protocol.h"
 
 bool mb_serial_posix_open(mb_serial_posix_context_t *mb_serial_posix_context, const char *dev_path, uint32_t baudrate) {
+    mb_serial_posix_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.baudrate = baudrate;
+    return mb_serial_posix_open_with_config(mb_serial_posix_context, dev_path, &config);
+}
+
+#ifndef __APPLE__
+// get POSIX speed constant, returns false for non-standard baud rates
+static bool mb_serial_posix_get_speed(uint32_t baudrate, speed_t * speed){
+    switch(baudrate) {
+        case    9600: *speed = B9600;    break;
+        case   19200: *speed = B19200;   break;
+        case   38400: *speed = B38400;   break;
+        case 57600:  *speed = B57600;  break;
+        case 115200: *speed = B115200; break;
+#ifdef B230400
+        case 230400: *speed = B230400; break;
+#endif
+#ifdef B460800
+        case 460800: *speed = B460800; break;
+#endif
+#ifdef B921600
+        case 921600: *speed = B921600; break;
+#endif
+#ifdef B1000000
+        case 1000000: *speed = B1000000; break;
+#endif
+#ifdef B2000000
+        case 2000000: *speed = B2000000; break;
+#endif
+#ifdef B3000000
+        case 3000000: *speed = B3000000; break;
+#endif
+#ifdef B4000000
+        case 4000000: *speed = B4000000; break;
+#endif
+        default:
+            return false;
+    }
+    return true;
+}
+#endif
+
+static bool mb_serial_posix_open_port(mb_serial_posix_context_t *mb_serial_posix_context, const char *dev_path,
+                                      const mb_serial_posix_config_t * config) {
+    uint32_t baudrate = config->baudrate;
 
     // open serial port
     int flags = O_RDWR | O_NOCTTY | O_NONBLOCK;
@@ -52,6 +108,7 @@ bool mb_serial_posix_open(mb_serial_posix_context_t *mb_serial_posix_context, co
 
     if (tcgetattr(fd, &mb_serial_posix_context->termios) < 0) {
         perror("Couldn't get term attributes");
+        close(fd);
         return false;
     }
     cfmakeraw(&mb_serial_posix_context->termios);   // make raw
@@ -63,6 +120,13 @@ bool mb_serial_posix_open(mb_serial_posix_context_t *mb_serial_posix_context, co
     mb_serial_posix_context->termios.c_cflag |= CREAD | CLOCAL;  // turn on READ & ignore ctrl lines
     mb_serial_posix_context->termios.c_iflag &= ~(IXON | IXOFF | IXANY); // turn off s/w flow ctrl
 
+    // RTS/CTS flow control
+    if (config->flow_control){
+        mb_serial_posix_context->termios.c_cflag |= CRTSCTS;
+    } else {
+        mb_serial_posix_context->termios.c_cflag &= ~CRTSCTS;
+    }
+
     // configure blocking read
     // see: http://unixwiz.net/techtips/termios-vmin-vtime.html
     mb_serial_posix_context->termios.c_cc[VMIN]  = 1;
@@ -70,33 +134,23 @@ bool mb_serial_posix_open(mb_serial_posix_context_t *mb_serial_posix_context, co
 
     if(tcsetattr(fd, TCSANOW, &mb_serial_posix_context->termios) < 0) {
         perror("Couldn't set term attributes");
+        close(fd);
         return false;
     }
 
 #ifndef __APPLE__
 
-    speed_t brate = baudrate; // let you override switch below if needed
-    switch(baudrate) {
-        case    9600: brate=B9600;    break;
-        case   19200: brate=B19200;   break;
-        case   38400: brate=B38400;   break;
-        case 57600:  brate=B57600;  break;
-        case 115200: brate=B115200; break;
-#ifdef B230400
-        case 230400: brate=B230400; break;
-#endif
-#ifdef B460800
-        case 460800: brate=B460800; break;
-#endif
-#ifdef B921600
-        case 921600: brate=B921600; break;
-#endif
-#ifdef B1000000
-        case 1000000: brate=B1000000; break;
+    speed_t brate;
+    bool custom_baudrate = mb_serial_posix_get_speed(baudrate, &brate) == false;
+    if (custom_baudrate){
+#ifdef __linux__
+        // set after tcsetattr via termios2 below
+        brate = B38400;
+#else
+        printf("can't set baudrate %u\n", baudrate);
+        close(fd);
+        return false;
 #endif
-        default:
-            printf("can't set baudrate %dn", baudrate );
-            return -1;
     }
     cfsetospeed(&mb_serial_posix_context->termios, brate);
     cfsetispeed(&mb_serial_posix_context->termios, brate);
@@ -107,9 +161,29 @@ bool mb_serial_posix_open(mb_serial_posix_context_t *mb_serial_posix_context, co
 
     if( tcsetattr(fd, TCSADRAIN, &mb_serial_posix_context->termios) < 0) {
         perror("Couldn't set term attributes");
+        close(fd);
         return false;
     }
 
+#ifdef __linux__
+    if (custom_baudrate){
+        if (mb_serial_posix_set_custom_baudrate(fd, baudrate) == false){
+            printf("can't set baudrate %u - %s(%d)\n", baudrate, strerror(errno), errno);
+            close(fd);
+            return false;
+        }
+    }
+
+    // disable receive timer of the serial driver, e.g. 16 ms for FTDI adapters
+    if (config->low_latency){
+        struct serial_struct serial;
+        if (ioctl(fd, TIOCGSERIAL, &serial) == 0){
+            serial.flags |= ASYNC_LOW_LATENCY;
+            (void) ioctl(fd, TIOCSSERIAL, &serial);
+        }
+    }
+#endif
+
 #ifdef __APPLE__
     // From https://developer.apple.com/library/content/samplecode/SerialPortSample/Listings/SerialPortSample_SerialPortSample_c.html
 
@@ -121,12 +195,27 @@ bool mb_serial_posix_open(mb_serial_posix_context_t *mb_serial_posix_context, co
     speed_t speed = baudrate;
     if (ioctl(fd, IOSSIOSPEED, &speed) == -1) {
         printf("btstack_uart_posix_set_baudrate: error calling ioctl(..., IOSSIOSPEED, %u) - %s(%d).\n", baudrate, strerror(errno), errno);
+        close(fd);
         return false;
     }
+
+    // receive latency in microseconds
+    if (config->low_latency){
+        unsigned long latency_us = 1;
+        (void) ioctl(fd, IOSSDATALAT, &latency_us);
+    }
 #endif
 
     // store fd in context
     mb_serial_posix_context->fd = fd;
+    mb_serial_posix_context->rx_staging_len = 0;
+    mb_serial_posix_context->probe_state = MB_SERIAL_POSIX_PROBE_READY;
+    return true;
+}
+
+bool mb_serial_posix_open_with_config(mb_serial_posix_context_t *mb_serial_posix_context, const char *dev_path,
+                                      const mb_serial_posix_config_t * config) {
+    if (mb_serial_posix_open_port(mb_serial_posix_context, dev_path, config) == false) return false;
 
     // wait a bit - at least cheap FTDI232 clones might send the first byte out incorrectly
     usleep(100000);
@@ -134,10 +223,147 @@ bool mb_serial_posix_open(mb_serial_posix_context_t *mb_serial_posix_context, co
     return true;
 }
 
+// Readiness probe: protocol version request is sent until the bridge responds
+
+// bridge might still use COBS framing from previous session: switch back with framed request, tag 0 for version 1.
+// The frame is sent as payload of an unframed framing request, which starts with mode NONE (0x00) and is a
+// complete message for a bridge without framing. For a framed bridge, the 0x00 terminates the header as garbage.
+static void mb_serial_posix_probe_reset_framing(mb_serial_posix_context_t * mb_serial_posix_context){
+    uint8_t request[MB_HEADER_SIZE + 1 + MB_TRAILER_SIZE];
+    uint8_t message[MB_HEADER_SIZE + 1 + MB_FRAMING_MAX_FRAME_LEN(sizeof(request))];
+    uint16_t request_len = mb_bridge_framing_request_setup(request, sizeof(request), 0, MB_BRIDGE_FRAMING_REQUEST_MODE_NONE);
+    request_len = mb_message_append_trailer(request, request_len, 0);
+    uint8_t * payload = &message[MB_HEADER_SIZE];
+    payload[0] = MB_FRAMING_DELIMITER;
+    uint16_t payload_len = 1 + mb_framing_encode(request, request_len, &payload[1], sizeof(message) - MB_HEADER_SIZE - 1);
+    mb_header_setup(message, MB_COMPONENT_BRIDGE, (uint8_t) MB_OPERATION_BRIDGE_FRAMING_REQUEST, 0, payload_len);
+    (void) write(mb_serial_posix_context->fd, message, MB_HEADER_SIZE + payload_len);
+}
+
+static void mb_serial_posix_probe_send(mb_serial_posix_context_t * mb_serial_posix_context){
+    // after half of the attempts, assume framing has not been reset
+    if (mb_serial_posix_context->probe_attempts_left == (MB_SERIAL_POSIX_PROBE_ATTEMPTS / 2)){
+        mb_serial_posix_probe_reset_framing(mb_serial_posix_context);
+    }
+    uint8_t request[MB_HEADER_SIZE + 2];
+    uint16_t request_len = mb_bridge_protocol_version_request_setup(request, sizeof(request), 0, 0);
+    (void) write(mb_serial_posix_context->fd, request, request_len);
+    mb_serial_posix_context->probe_attempts_left--;
+    mb_serial_posix_context->probe_deadline_us = mb_serial_posix_get_time_us() + MB_SERIAL_POSIX_PROBE_RETRY_MS * 1000;
+}
+
+// look for response in staging buffer, bytes after the response are kept for the transport
+// a bridge still using protocol version MB_TRAILER_VERSION from a previous session appends a tag to the response
+static bool mb_serial_posix_probe_find_response(mb_serial_posix_context_t * mb_serial_posix_context){
+    uint8_t response[MB_HEADER_SIZE + 4];
+    uint16_t response_len = mb_bridge_protocol_version_response_setup(response, sizeof(response), 0, 0);
+    uint16_t max_response_len = response_len + MB_TRAILER_SIZE;
+    uint8_t * staging = mb_serial_posix_context->rx_staging;
+    uint16_t staging_len = mb_serial_posix_context->rx_staging_len;
+    uint16_t pos;
+    for (pos = 0; (pos + response_len) <= staging_len; pos++){
+        if (mb_header_get_component(&staging[pos]) != MB_COMPONENT_BRIDGE) continue;
+        if (mb_header_get_operation(&staging[pos]) != MB_OPERATION_BRIDGE_PROTOCOL_VERSION_RESPONSE) continue;
+        uint16_t message_len = MB_HEADER_SIZE + mb_header_get_length(&staging[pos]);
+        if ((message_len != response_len) && (message_len != max_response_len)) continue;
+        if ((pos + message_len) > staging_len) continue;
+        mb_serial_posix_context->protocol_version =
+                mb_bridge_protocol_version_response_get_version(&staging[pos + MB_HEADER_SIZE]);
+        mb_serial_posix_context->rx_staging_pos = pos + message_len;
+        mb_serial_posix_context->rx_staging_len = staging_len - (pos + message_len);
+        return true;
+    }
+    // keep a possible partial response
+    if (staging_len == MB_SERIAL_POSIX_RX_STAGING_SIZE){
+        memmove(staging, &staging[staging_len - max_response_len], max_response_len);
+        mb_serial_posix_context->rx_staging_len = max_response_len;
+    }
+    return false;
+}
+
+bool mb_serial_posix_open_async(mb_serial_posix_context_t *mb_serial_posix_context, const char *dev_path,
+                                const mb_serial_posix_config_t * config) {
+    if (mb_serial_posix_open_port(mb_serial_posix_context, dev_path, config) == false) return false;
+
+    mb_serial_posix_context->probe_state = MB_SERIAL_POSIX_PROBE_ACTIVE;
+    mb_serial_posix_context->probe_attempts_left = MB_SERIAL_POSIX_PROBE_ATTEMPTS;
+    mb_serial_posix_probe_send(mb_serial_posix_context);
+    return true;
+}
+
+mb_serial_posix_probe_state_t mb_serial_posix_process_probe(mb_serial_posix_context_t * mb_serial_posix_context){
+    if (mb_serial_posix_context->probe_state != MB_SERIAL_POSIX_PROBE_ACTIVE) return mb_serial_posix_context->probe_state;
+
+    // collect all available data in staging buffer
+    while (mb_serial_posix_context->rx_staging_len < MB_SERIAL_POSIX_RX_STAGING_SIZE){
+        ssize_t bytes_read = read(mb_serial_posix_context->fd,
+                                  &mb_serial_posix_context->rx_staging[mb_serial_posix_context->rx_staging_len],
+                                  MB_SERIAL_POSIX_RX_STAGING_SIZE - mb_serial_posix_context->rx_staging_len);
+        if (bytes_read <= 0) break;
+        mb_serial_posix_context->rx_staging_len += (uint16_t) bytes_read;
+        if (mb_serial_posix_probe_find_response(mb_serial_posix_context)){
+            mb_serial_posix_context->probe_state = MB_SERIAL_POSIX_PROBE_READY;
+            return MB_SERIAL_POSIX_PROBE_READY;
+        }
+    }
+
+    // retry after timeout
+    if ((int32_t) (mb_serial_posix_get_time_us() - mb_serial_posix_context->probe_deadline_us) >= 0){
+        if (mb_serial_posix_context->probe_attempts_left == 0){
+            mb_serial_posix_context->probe_state = MB_SERIAL_POSIX_PROBE_FAILED;
+        } else {
+            mb_serial_posix_probe_send(mb_serial_posix_context);
+        }
+    }
+    return mb_serial_posix_context->probe_state;
+}
+
+uint32_t mb_serial_posix_get_probe_timeout_ms(mb_serial_posix_context_t * mb_serial_posix_context){
+    if (mb_serial_posix_context->probe_state != MB_SERIAL_POSIX_PROBE_ACTIVE) return MB_TRANSPORT_NO_TIMEOUT;
+    int32_t remaining_us = (int32_t) (mb_serial_posix_context->probe_deadline_us - mb_serial_posix_get_time_us());
+    if (remaining_us <= 0) return 0;
+    return ((uint32_t) remaining_us + 999) / 1000;
+}
+
+bool mb_serial_posix_wait_ready(mb_serial_posix_context_t ** mb_serial_posix_contexts, uint16_t num_contexts){
+    assert(num_contexts <= MB_SERIAL_POSIX_WAIT_READY_MAX);
+    struct pollfd fds[MB_SERIAL_POSIX_WAIT_READY_MAX];
+    while (true){
+        // collect bridges that are still probing
+        nfds_t num_fds = 0;
+        int timeout_ms = -1;
+        bool all_ready = true;
+        uint16_t i;
+        for (i = 0; i < num_contexts; i++){
+            mb_serial_posix_context_t * mb_serial_posix_context = mb_serial_posix_contexts[i];
+            switch (mb_serial_posix_process_probe(mb_serial_posix_context)){
+                case MB_SERIAL_POSIX_PROBE_READY:
+                    continue;
+                case MB_SERIAL_POSIX_PROBE_FAILED:
+                    all_ready = false;
+                    continue;
+                default:
+                    break;
+            }
+            fds[num_fds].fd = mb_serial_posix_context->fd;
+            fds[num_fds].events = POLLIN;
+            num_fds++;
+            int probe_timeout_ms = (int) mb_serial_posix_get_probe_timeout_ms(mb_serial_posix_context);
+            if ((timeout_ms < 0) || (probe_timeout_ms < timeout_ms)){
+                timeout_ms = probe_timeout_ms;
+            }
+        }
+        if (num_fds == 0) return all_ready;
+        int res = poll(fds, num_fds, timeout_ms);
+        if ((res < 0) && (errno != EINTR)) return false;
+    }
+}
+
 void mb_serial_posix_close(mb_serial_posix_context_t * mb_serial_posix_context) {
     if (mb_serial_posix_context->fd >= 0){
         close (mb_serial_posix_context->fd);
         mb_serial_posix_context->fd = -1;
+        mb_serial_posix_context->rx_staging_len = 0;
     }
 }
 
@@ -161,6 +387,12 @@ void mb_serial_posix_driver_set_block_sent(void * driver_context, void (*block_h
     mb_serial_posix_context->block_sent_context = callback_context;
 }
 
+void mb_serial_posix_driver_set_bytes_received(void * driver_context, void (*bytes_handler)(void * context, uint16_t num_bytes), void * callback_context){
+    mb_serial_posix_context_t * mb_serial_posix_context = (mb_serial_posix_context_t *) driver_context;
+    mb_serial_posix_context->bytes_received_callback = bytes_handler;
+    mb_serial_posix_context->bytes_received_context = callback_context;
+}
+
 void mb_serial_posix_register_write_started(mb_serial_posix_context_t * mb_serial_posix_context,
                                             void (*write_started_callback)(void * context), void * write_started_context){
     mb_serial_posix_context->write_started_callback = write_started_callback;
@@ -171,37 +403,97 @@ void mb_serial_posix_driver_receive_block(void * driver_context, uint8_t *buffer
     mb_serial_posix_context_t * mb_serial_posix_context = (mb_serial_posix_context_t *) driver_context;
     mb_serial_posix_context->rx_buffer = buffer;
     mb_serial_posix_context->rx_len = length;
+    mb_serial_posix_context->rx_stream = false;
 }
 
-void mb_serial_posix_driver_send_block(void * driver_context, const uint8_t *buffer, uint16_t length){
+void mb_serial_posix_driver_receive_bytes(void * driver_context, uint8_t *buffer, uint16_t max_length){
+    mb_serial_posix_context_t * mb_serial_posix_context = (mb_serial_posix_context_t *) driver_context;
+    mb_serial_posix_context->rx_buffer = buffer;
+    mb_serial_posix_context->rx_len = max_length;
+    mb_serial_posix_context->rx_stream = true;
+}
+
+void mb_serial_posix_driver_send_blocks(void * driver_context, const mb_driver_block_t * blocks, uint8_t num_blocks){
     mb_serial_posix_context_t * mb_serial_posix_context = (mb_serial_posix_context_t *) driver_context;
-    mb_serial_posix_context->tx_buffer = buffer;
-    mb_serial_posix_context->tx_len = length;
+    uint8_t i;
+    mb_serial_posix_context->tx_len = 0;
+    for (i = 0; i < num_blocks; i++){
+        mb_serial_posix_context->tx_iov[i].iov_base = (void *) blocks[i].data;
+        mb_serial_posix_context->tx_iov[i].iov_len  = blocks[i].len;
+        mb_serial_posix_context->tx_len += blocks[i].len;
+    }
+    mb_serial_posix_context->tx_iov_index = 0;
+    mb_serial_posix_context->tx_iov_count = num_blocks;
     if (mb_serial_posix_context->write_started_callback != NULL){
         (*mb_serial_posix_context->write_started_callback)(mb_serial_posix_context->write_started_context);
     }
 }
 
+void mb_serial_posix_driver_send_block(void * driver_context, const uint8_t *buffer, uint16_t length){
+    mb_driver_block_t block;
+    block.data = buffer;
+    block.len  = length;
+    mb_serial_posix_driver_send_blocks(driver_context, &block, 1);
+}
+
 uint16_t mb_serial_posix_process_read(mb_serial_posix_context_t * mb_serial_posix_context) {
     if (mb_serial_posix_context->rx_len  == 0) {
         return 0;
     }
 
-    // read up to bytes_to_read data in
-    ssize_t bytes_read = read(mb_serial_posix_context->fd, mb_serial_posix_context->rx_buffer, mb_serial_posix_context->rx_len);
-    if (bytes_read <= 0) {
-        return 0;
+    if (mb_serial_posix_context->rx_staging_len == 0){
+        // read directly into large buffers, e.g. receive ring
+        if (mb_serial_posix_context->rx_stream || (mb_serial_posix_context->rx_len >= MB_SERIAL_POSIX_RX_STAGING_SIZE)){
+            ssize_t bytes_read = read(mb_serial_posix_context->fd, mb_serial_posix_context->rx_buffer, mb_serial_posix_context->rx_len);
+            if (bytes_read <= 0) {
+                return 0;
+            }
+            mb_serial_posix_handle_read(mb_serial_posix_context, (uint16_t) bytes_read);
+            return (uint16_t) bytes_read;
+        }
+
+        // read all available data into staging buffer
+        ssize_t bytes_read = read(mb_serial_posix_context->fd, mb_serial_posix_context->rx_staging, MB_SERIAL_POSIX_RX_STAGING_SIZE);
+        if (bytes_read <= 0) {
+            return 0;
+        }
+        mb_serial_posix_context->rx_staging_pos = 0;
+        mb_serial_posix_context->rx_staging_len = (uint16_t) bytes_read;
+    }
+
+    // serve receive requests from staging buffer, callbacks provide the next buffer
+    uint16_t bytes_delivered = 0;
+    while ((mb_serial_posix_context->rx_len > 0) && (mb_serial_posix_context->rx_staging_len > 0)){
+        uint16_t bytes_to_copy = mb_serial_posix_context->rx_len;
+        if (bytes_to_copy > mb_serial_posix_context->rx_staging_len){
+            bytes_to_copy = mb_serial_posix_context->rx_staging_len;
+        }
+        memcpy(mb_serial_posix_context->rx_buffer, &mb_serial_posix_context->rx_staging[mb_serial_posix_context->rx_staging_pos], bytes_to_copy);
+        mb_serial_posix_context->rx_staging_pos += bytes_to_copy;
+        mb_serial_posix_context->rx_staging_len -= bytes_to_copy;
+        bytes_delivered += bytes_to_copy;
+        mb_serial_posix_handle_read(mb_serial_posix_context, bytes_to_copy);
+    }
+    return bytes_delivered;
+}
+
+void mb_serial_posix_handle_read(mb_serial_posix_context_t * mb_serial_posix_context, uint16_t bytes_read) {
+    // stream mode: report all bytes read
+    if (mb_serial_posix_context->rx_stream){
+        mb_serial_posix_context->rx_len = 0;
+        if (mb_serial_posix_context->bytes_received_callback != NULL){
+            mb_serial_posix_context->bytes_received_callback(mb_serial_posix_context->bytes_received_context, bytes_read);
+        }
+        return;
     }
 
     mb_serial_posix_context->rx_len    -= bytes_read;
     mb_serial_posix_context->rx_buffer += bytes_read;
-    if (mb_serial_posix_context->rx_len > 0) return (uint16_t) bytes_read;
+    if (mb_serial_posix_context->rx_len > 0) return;
 
     if (mb_serial_posix_context->block_received_callback != NULL){
         mb_serial_posix_context->block_received_callback(mb_serial_posix_context->block_received_context);
     }
-
-    return bytes_read;
 }
 
 uint16_t mb_serial_posix_process_write(mb_serial_posix_context_t * mb_serial_posix_context) {
@@ -210,32 +502,58 @@ uint16_t mb_serial_posix_process_write(mb_serial_posix_context_t * mb_serial_pos
         return 0;
     }
 
-    // write up to write_bytes_len to fd
-    ssize_t bytes_written = write(mb_serial_posix_context->fd, mb_serial_posix_context->tx_buffer, mb_serial_posix_context->tx_len);
+    // write remaining blocks to fd
+    struct iovec * tx_iov = &mb_serial_posix_context->tx_iov[mb_serial_posix_context->tx_iov_index];
+    int tx_iov_count = mb_serial_posix_context->tx_iov_count - mb_serial_posix_context->tx_iov_index;
+    ssize_t bytes_written = writev(mb_serial_posix_context->fd, tx_iov, tx_iov_count);
     if (bytes_written <= 0) {
         return 0;
     }
 
-    mb_serial_posix_context->tx_len    -= bytes_written;
-    mb_serial_posix_context->tx_buffer += bytes_written;
+    mb_serial_posix_handle_write(mb_serial_posix_context, (uint16_t) bytes_written);
+    return (uint16_t) bytes_written;
+}
+
+void mb_serial_posix_handle_write(mb_serial_posix_context_t * mb_serial_posix_context, uint16_t bytes_written) {
+    // skip over written blocks
+    struct iovec * tx_iov = &mb_serial_posix_context->tx_iov[mb_serial_posix_context->tx_iov_index];
+    mb_serial_posix_context->tx_len -= bytes_written;
+    size_t bytes_to_skip = bytes_written;
+    while (bytes_to_skip > 0){
+        if (bytes_to_skip < tx_iov->iov_len){
+            tx_iov->iov_base = (uint8_t *) tx_iov->iov_base + bytes_to_skip;
+            tx_iov->iov_len -= bytes_to_skip;
+            break;
+        }
+        bytes_to_skip -= tx_iov->iov_len;
+        tx_iov++;
+        mb_serial_posix_context->tx_iov_index++;
+    }
     if (mb_serial_posix_context->tx_len > 0) {
-        return (uint16_t) bytes_written;
+        return;
     }
 
     if (mb_serial_posix_context->block_sent_callback != NULL){
         mb_serial_posix_context->block_sent_callback(mb_serial_posix_context->block_sent_context);
     }
-
-    return bytes_written;
 }
 
 static const mb_driver_t mb_serial_posix_driver_interface = {
         .set_block_received = &mb_serial_posix_driver_set_block_received,
         .set_block_sent     = &mb_serial_posix_driver_set_block_sent,
         .receive_block      = &mb_serial_posix_driver_receive_block,
-        .send_block         = &mb_serial_posix_driver_send_block
+        .send_block         = &mb_serial_posix_driver_send_block,
+        .set_bytes_received = &mb_serial_posix_driver_set_bytes_received,
+        .receive_bytes      = &mb_serial_posix_driver_receive_bytes,
+        .send_blocks        = &mb_serial_posix_driver_send_blocks
 };
 
 const mb_driver_t * mb_serial_posix_get_driver(void){
     return &mb_serial_posix_driver_interface;
 }
+
+uint32_t mb_serial_posix_get_time_us(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t) ((uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000);
+}
@@ -26,6 +26,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <termios.h>  /* POSIX terminal control definitions */
+#include <sys/uio.h>
 
 #include "multibus_transport.h"
 #include "multibus_driver.h"
@@ -34,6 +35,30 @@
  * MultiBus Serial Transport for POSIX systems
  */
 
+// bytes read at once by mb_serial_posix_process_read, which satisfies the following receive requests from memory
+#ifndef MB_SERIAL_POSIX_RX_STAGING_SIZE
+#define MB_SERIAL_POSIX_RX_STAGING_SIZE 1024
+#endif
+
+// readiness probe of mb_serial_posix_open_async: interval between protocol version requests and max number of requests
+#ifndef MB_SERIAL_POSIX_PROBE_RETRY_MS
+#define MB_SERIAL_POSIX_PROBE_RETRY_MS 20
+#endif
+#ifndef MB_SERIAL_POSIX_PROBE_ATTEMPTS
+#define MB_SERIAL_POSIX_PROBE_ATTEMPTS 10
+#endif
+
+// max number of bridges passed to mb_serial_posix_wait_ready
+#ifndef MB_SERIAL_POSIX_WAIT_READY_MAX
+#define MB_SERIAL_POSIX_WAIT_READY_MAX 64
+#endif
+
+typedef enum {
+    MB_SERIAL_POSIX_PROBE_READY,
+    MB_SERIAL_POSIX_PROBE_ACTIVE,
+    MB_SERIAL_POSIX_PROBE_FAILED,
+} mb_serial_posix_probe_state_t;
+
 typedef struct {
     // on macOS 12.1, CTS/RTS control flags are always read back as zero.
     // To work around this, we cache our terios settings
@@ -44,15 +69,39 @@ typedef struct {
     void *block_received_context;
     void (*block_sent_callback)(void *context);
     void *block_sent_context;
+    void (*bytes_received_callback)(void *context, uint16_t num_bytes);
+    void *bytes_received_context;
     // event loop integration
     void (*write_started_callback)(void * context);
     void *write_started_context;
-    const uint8_t * tx_buffer;
+    struct iovec tx_iov[MB_DRIVER_MAX_BLOCKS];
+    uint8_t   tx_iov_index;
+    uint8_t   tx_iov_count;
     uint16_t  tx_len;
     uint8_t * rx_buffer;
     uint16_t  rx_len;
+    // rx_buffer provided by receive_bytes, report any number of bytes
+    bool      rx_stream;
+    // bytes read ahead of small receive requests
+    uint8_t   rx_staging[MB_SERIAL_POSIX_RX_STAGING_SIZE];
+    uint16_t  rx_staging_pos;
+    uint16_t  rx_staging_len;
+    // readiness probe
+    mb_serial_posix_probe_state_t probe_state;
+    uint8_t   probe_attempts_left;
+    uint32_t  probe_deadline_us;
+    uint16_t  protocol_version;
 } mb_serial_posix_context_t;
 
+typedef struct {
+    // non-standard baud rates are supported on Linux and macOS
+    uint32_t baudrate;
+    // RTS/CTS hardware flow control
+    bool     flow_control;
+    // disable receive timer of USB-serial adapters (ASYNC_LOW_LATENCY on Linux, IOSSDATALAT on macOS)
+    bool     low_latency;
+} mb_serial_posix_config_t;
+
 /**
  * @brief Open serial port as MultiBus transport
  * @param mb_serial_posix_context
@@ -62,6 +111,55 @@ typedef struct {
  */
 bool mb_serial_posix_open(mb_serial_posix_context_t * mb_serial_posix_context, const char *dev_path, uint32_t baudrate);
 
+/**
+ * @brief Open serial port as MultiBus transport with flow control and low-latency options
+ * @param mb_serial_posix_context
+ * @param dev_path
+ * @param config
+ * @return true if successful
+ */
+bool mb_serial_posix_open_with_config(mb_serial_posix_context_t * mb_serial_posix_context, const char *dev_path,
+                                      const mb_serial_posix_config_t * config);
+
+/**
+ * @brief Open serial port without settle delay and start readiness probe
+ * @note Instead of waiting 100 ms after open, a protocol version request is sent every MB_SERIAL_POSIX_PROBE_RETRY_MS
+ *       until the bridge responds. Call mb_serial_posix_process_probe when the file descriptor becomes readable and
+ *       after mb_serial_posix_get_probe_timeout_ms, or use mb_serial_posix_wait_ready. The transport must not be
+ *       used before the bridge is ready.
+ * @note If half of the attempts fail, a request to disable framing is sent once, in case the bridge still uses framing
+ *       from a previous session. It holds a COBS framed request as payload of an unframed one, so bridges with and
+ *       without framing process it as a single framing request.
+ * @param mb_serial_posix_context
+ * @param dev_path
+ * @param config
+ * @return true if port has been opened
+ */
+bool mb_serial_posix_open_async(mb_serial_posix_context_t * mb_serial_posix_context, const char *dev_path,
+                                const mb_serial_posix_config_t * config);
+
+/**
+ * @brief Read probe response and send next probe after timeout
+ * @param mb_serial_posix_context
+ * @return probe state, protocol_version is valid when ready
+ */
+mb_serial_posix_probe_state_t mb_serial_posix_process_probe(mb_serial_posix_context_t * mb_serial_posix_context);
+
+/**
+ * @brief Get time until next probe
+ * @param mb_serial_posix_context
+ * @return timeout in ms, or MB_TRANSPORT_NO_TIMEOUT if probe is not active
+ */
+uint32_t mb_serial_posix_get_probe_timeout_ms(mb_serial_posix_context_t * mb_serial_posix_context);
+
+/**
+ * @brief Wait until all bridges opened with mb_serial_posix_open_async have responded or failed
+ * @param mb_serial_posix_contexts
+ * @param num_contexts max MB_SERIAL_POSIX_WAIT_READY_MAX
+ * @return true if all bridges are ready
+ */
+bool mb_serial_posix_wait_ready(mb_serial_posix_context_t ** mb_serial_posix_contexts, uint16_t num_contexts);
+
 /**
  * @brief Close serial port
  * @param mb_serial_posix_context
@@ -95,6 +193,8 @@ bool mb_serial_posix_write_active(mb_serial_posix_context_t * mb_serial_posix_co
 
 /**
  * @brief Process incoming data
+ * @note Small receive requests, e.g. for header and payload, are served from a staging buffer filled with all
+ *       available data by a single read. Call again until it returns 0 to process all staged data.
  * @param mb_serial_posix_context
  * @return number_bytes_read
  */
@@ -107,10 +207,43 @@ uint16_t mb_serial_posix_process_read(mb_serial_posix_context_t * mb_serial_posi
  */
 uint16_t mb_serial_posix_process_write(mb_serial_posix_context_t * mb_serial_posix_context);
 
+// Alternative I/O backends that read into rx_buffer or write tx_iov themselves
+
+/**
+ * @brief Update receive state and emit callbacks after bytes have been read into rx_buffer
+ * @param mb_serial_posix_context
+ * @param bytes_read > 0, max rx_len
+ */
+void mb_serial_posix_handle_read(mb_serial_posix_context_t * mb_serial_posix_context, uint16_t bytes_read);
+
+/**
+ * @brief Update send state and emit callbacks after bytes from tx_iov starting at tx_iov_index have been written
+ * @param mb_serial_posix_context
+ * @param bytes_written > 0, max tx_len
+ */
+void mb_serial_posix_handle_write(mb_serial_posix_context_t * mb_serial_posix_context, uint16_t bytes_written);
+
 /**
  * Provide driver implementation
  * @return mb_driver_t implementation
  */
 const mb_driver_t * mb_serial_posix_get_driver(void);
 
+#ifdef __linux__
+/**
+ * @brief Set non-standard baud rate via termios2, used by mb_serial_posix_open
+ * @note implemented in multibus_serial_posix_termios2.c, as asm/termbits.h conflicts with termios.h
+ * @param fd
+ * @param baudrate
+ * @return true if successful
+ */
+bool mb_serial_posix_set_custom_baudrate(int fd, uint32_t baudrate);
+#endif
+
+/**
+ * Time source for mb_transport based on monotonic clock
+ * @return time in microseconds
+ */
+uint32_t mb_serial_posix_get_time_us(void);
+
 #endif //C_TEST_MULTIBUS_SERIAL_POSIX_H
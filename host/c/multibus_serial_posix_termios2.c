@@ -0,0 +1,52 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * MultiBus Serial Transport for POSIX systems - non-standard baud rates on Linux
+ *
+ * asm/termbits.h conflicts with termios.h, so termios2 is used in its own compilation unit.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <asm/ioctls.h>
+#include <asm/termbits.h>
+
+// sys/ioctl.h conflicts with asm/termbits.h
+extern int ioctl(int fd, unsigned long request, ...);
+
+bool mb_serial_posix_set_custom_baudrate(int fd, uint32_t baudrate);
+
+bool mb_serial_posix_set_custom_baudrate(int fd, uint32_t baudrate){
+    struct termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio) < 0) return false;
+    tio.c_cflag &= ~CBAUD;
+    tio.c_cflag |= BOTHER;
+    tio.c_ospeed = baudrate;
+#ifdef IBSHIFT
+    tio.c_cflag &= ~(CBAUD << IBSHIFT);
+    tio.c_cflag |= BOTHER << IBSHIFT;
+#endif
+    tio.c_ispeed = baudrate;
+    return ioctl(fd, TCSETS2, &tio) == 0;
+}
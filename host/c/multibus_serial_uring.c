@@ -0,0 +1,280 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+
+#include "multibus_serial_uring.h"
+
+// user data: source pointer, lowest bit set for writes
+#define URING_USER_DATA_WRITE 1
+
+static int mb_serial_uring_find_buffer(mb_serial_uring_t * mb_serial_uring, const uint8_t * data, uint16_t len){
+    unsigned i;
+    for (i = 0; i < mb_serial_uring->num_buffers; i++){
+        const uint8_t * start = (const uint8_t *) mb_serial_uring->buffers[i].iov_base;
+        const uint8_t * end   = start + mb_serial_uring->buffers[i].iov_len;
+        if ((data >= start) && ((data + len) <= end)) return (int) i;
+    }
+    return -1;
+}
+
+// queue read and write for source if needed, returns false if submission queue is full
+static bool mb_serial_uring_prepare(mb_serial_uring_t * mb_serial_uring, mb_serial_uring_source_t * source){
+    mb_serial_posix_context_t * mb_serial_posix_context = source->mb_serial_posix_context;
+    struct io_uring_sqe * sqe;
+    int fd = mb_serial_posix_get_file_descriptor(mb_serial_posix_context);
+
+    if ((source->read_pending == false) && (mb_serial_posix_context->rx_len > 0)){
+        sqe = io_uring_get_sqe(&mb_serial_uring->ring);
+        if (sqe == NULL) return false;
+        int buffer_index = mb_serial_uring_find_buffer(mb_serial_uring, mb_serial_posix_context->rx_buffer,
+                                                       mb_serial_posix_context->rx_len);
+        if (buffer_index >= 0){
+            io_uring_prep_read_fixed(sqe, fd, mb_serial_posix_context->rx_buffer, mb_serial_posix_context->rx_len,
+                                     (uint64_t) -1, buffer_index);
+        } else {
+            io_uring_prep_read(sqe, fd, mb_serial_posix_context->rx_buffer, mb_serial_posix_context->rx_len,
+                               (uint64_t) -1);
+        }
+        io_uring_sqe_set_data64(sqe, (uint64_t) (uintptr_t) source);
+        source->read_pending = true;
+    }
+
+    if ((source->write_pending == false) && mb_serial_posix_write_active(mb_serial_posix_context)){
+        sqe = io_uring_get_sqe(&mb_serial_uring->ring);
+        if (sqe == NULL) return false;
+        uint8_t tx_iov_index = mb_serial_posix_context->tx_iov_index;
+        io_uring_prep_writev(sqe, fd, &mb_serial_posix_context->tx_iov[tx_iov_index],
+                             mb_serial_posix_context->tx_iov_count - tx_iov_index, (uint64_t) -1);
+        io_uring_sqe_set_data64(sqe, ((uint64_t) (uintptr_t) source) | URING_USER_DATA_WRITE);
+        source->write_pending = true;
+    }
+    return true;
+}
+
+static void mb_serial_uring_closed(mb_serial_uring_t * mb_serial_uring, mb_serial_uring_source_t * source){
+    if (source->removed) return;
+    mb_serial_uring_remove_serial(mb_serial_uring, source);
+    if (source->closed_callback != NULL){
+        source->closed_callback(source->closed_context);
+    }
+}
+
+static void mb_serial_uring_handle_completion(mb_serial_uring_t * mb_serial_uring, const struct io_uring_cqe * cqe){
+    uint64_t user_data = io_uring_cqe_get_data64(cqe);
+    // ignore completions of cancel requests
+    if (user_data == 0) return;
+    mb_serial_uring_source_t * source = (mb_serial_uring_source_t *) (uintptr_t) (user_data & ~(uint64_t) URING_USER_DATA_WRITE);
+    bool write = (user_data & URING_USER_DATA_WRITE) != 0;
+    int res = cqe->res;
+
+    if (write){
+        source->write_pending = false;
+    } else {
+        source->read_pending = false;
+    }
+    if (source->removed) return;
+
+    // try again with next submission
+    if ((res == -EAGAIN) || (res == -EINTR)) return;
+
+    // end of file or error
+    if ((res < 0) || ((res == 0) && (write == false))){
+        mb_serial_uring_closed(mb_serial_uring, source);
+        return;
+    }
+
+    if (write){
+        mb_serial_posix_handle_write(source->mb_serial_posix_context, (uint16_t) res);
+    } else {
+        mb_serial_posix_handle_read(source->mb_serial_posix_context, (uint16_t) res);
+    }
+}
+
+static unsigned mb_serial_uring_handle_completions(mb_serial_uring_t * mb_serial_uring){
+    struct io_uring_cqe * cqe;
+    unsigned num_completions = 0;
+    while (io_uring_peek_cqe(&mb_serial_uring->ring, &cqe) == 0){
+        // copy completion as callbacks might queue new submissions
+        struct io_uring_cqe completion = *cqe;
+        io_uring_cqe_seen(&mb_serial_uring->ring, cqe);
+        mb_serial_uring_handle_completion(mb_serial_uring, &completion);
+        num_completions++;
+    }
+    return num_completions;
+}
+
+bool mb_serial_uring_init(mb_serial_uring_t * mb_serial_uring, unsigned num_entries,
+                          const struct iovec * buffers, unsigned num_buffers){
+    assert(mb_serial_uring != NULL);
+    memset(mb_serial_uring, 0, sizeof(mb_serial_uring_t));
+    if (io_uring_queue_init(num_entries, &mb_serial_uring->ring, 0) < 0) return false;
+    if (num_buffers > 0){
+        if (io_uring_register_buffers(&mb_serial_uring->ring, buffers, num_buffers) < 0){
+            io_uring_queue_exit(&mb_serial_uring->ring);
+            return false;
+        }
+        mb_serial_uring->buffers = buffers;
+        mb_serial_uring->num_buffers = num_buffers;
+    }
+    return true;
+}
+
+void mb_serial_uring_deinit(mb_serial_uring_t * mb_serial_uring){
+    while (mb_serial_uring->sources != NULL){
+        mb_serial_uring_remove_serial(mb_serial_uring, mb_serial_uring->sources);
+    }
+    io_uring_queue_exit(&mb_serial_uring->ring);
+}
+
+void mb_serial_uring_add_serial(mb_serial_uring_t * mb_serial_uring, mb_serial_uring_source_t * source,
+                                mb_serial_posix_context_t * mb_serial_posix_context, mb_transport_t * transport){
+    assert(source != NULL);
+    assert(mb_serial_posix_context != NULL);
+    memset(source, 0, sizeof(mb_serial_uring_source_t));
+    source->uring = mb_serial_uring;
+    source->mb_serial_posix_context = mb_serial_posix_context;
+    source->transport = transport;
+    source->next = mb_serial_uring->sources;
+    mb_serial_uring->sources = source;
+    mb_serial_uring->num_sources++;
+    // a read on a non-blocking fd completes with -EAGAIN right away, use blocking I/O in the io_uring workers instead
+    int fd = mb_serial_posix_get_file_descriptor(mb_serial_posix_context);
+    int flags = fcntl(fd, F_GETFL, 0);
+    (void) fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+    // with VMIN 0, a blocking tty read completes without data, which would be handled as end of file
+    struct termios termios;
+    if ((tcgetattr(fd, &termios) == 0) && (termios.c_cc[VMIN] == 0)){
+        source->termios_vmin  = termios.c_cc[VMIN];
+        source->termios_vtime = termios.c_cc[VTIME];
+        termios.c_cc[VMIN]  = 1;
+        termios.c_cc[VTIME] = 0;
+        source->termios_changed = tcsetattr(fd, TCSANOW, &termios) == 0;
+    }
+}
+
+void mb_serial_uring_register_closed(mb_serial_uring_source_t * source, void (*closed_callback)(void * context),
+                                     void * closed_context){
+    source->closed_callback = closed_callback;
+    source->closed_context  = closed_context;
+}
+
+void mb_serial_uring_remove_serial(mb_serial_uring_t * mb_serial_uring, mb_serial_uring_source_t * source){
+    mb_serial_uring_source_t ** it;
+    for (it = &mb_serial_uring->sources; *it != NULL; it = &(*it)->next){
+        if (*it != source) continue;
+        *it = source->next;
+        mb_serial_uring->num_sources--;
+        source->removed = true;
+        break;
+    }
+
+    // cancel submissions in flight and wait until they are completed, as they refer to source and its buffers
+    struct io_uring_sqe * sqe;
+    if (source->read_pending){
+        sqe = io_uring_get_sqe(&mb_serial_uring->ring);
+        if (sqe != NULL){
+            io_uring_prep_cancel64(sqe, (uint64_t) (uintptr_t) source, 0);
+            io_uring_sqe_set_data64(sqe, 0);
+        }
+    }
+    if (source->write_pending){
+        sqe = io_uring_get_sqe(&mb_serial_uring->ring);
+        if (sqe != NULL){
+            io_uring_prep_cancel64(sqe, ((uint64_t) (uintptr_t) source) | URING_USER_DATA_WRITE, 0);
+            io_uring_sqe_set_data64(sqe, 0);
+        }
+    }
+    (void) io_uring_submit(&mb_serial_uring->ring);
+    while (source->read_pending || source->write_pending){
+        struct io_uring_cqe * cqe;
+        if (io_uring_wait_cqe(&mb_serial_uring->ring, &cqe) < 0) break;
+        struct io_uring_cqe completion = *cqe;
+        io_uring_cqe_seen(&mb_serial_uring->ring, cqe);
+        mb_serial_uring_handle_completion(mb_serial_uring, &completion);
+    }
+    source->uring = NULL;
+    // restore non-blocking mode for mb_serial_posix_process_read/write
+    int fd = mb_serial_posix_get_file_descriptor(source->mb_serial_posix_context);
+    int flags = fcntl(fd, F_GETFL, 0);
+    (void) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    struct termios termios;
+    if (source->termios_changed && (tcgetattr(fd, &termios) == 0)){
+        termios.c_cc[VMIN]  = source->termios_vmin;
+        termios.c_cc[VTIME] = source->termios_vtime;
+        (void) tcsetattr(fd, TCSANOW, &termios);
+        source->termios_changed = false;
+    }
+}
+
+int mb_serial_uring_process(mb_serial_uring_t * mb_serial_uring, int timeout_ms){
+    // queue reads and writes of all sources, limit wait to earliest transport timeout
+    mb_serial_uring_source_t * source;
+    for (source = mb_serial_uring->sources; source != NULL; source = source->next){
+        if (mb_serial_uring_prepare(mb_serial_uring, source) == false){
+            // submission queue full, submit and continue
+            if (io_uring_submit(&mb_serial_uring->ring) < 0) return -1;
+            (void) mb_serial_uring_prepare(mb_serial_uring, source);
+        }
+        if (source->transport == NULL) continue;
+        uint32_t transport_timeout_ms = mb_transport_get_next_timeout_ms(source->transport);
+        if (transport_timeout_ms == MB_TRANSPORT_NO_TIMEOUT) continue;
+        if ((timeout_ms < 0) || (transport_timeout_ms < (uint32_t) timeout_ms)){
+            timeout_ms = (int) transport_timeout_ms;
+        }
+    }
+
+    // submit all and wait with a single io_uring_enter
+    struct io_uring_cqe * cqe;
+    int res;
+    if (timeout_ms < 0){
+        res = io_uring_submit_and_wait_timeout(&mb_serial_uring->ring, &cqe, 1, NULL, NULL);
+    } else {
+        struct __kernel_timespec ts;
+        ts.tv_sec  = timeout_ms / 1000;
+        ts.tv_nsec = (long long) (timeout_ms % 1000) * 1000000;
+        res = io_uring_submit_and_wait_timeout(&mb_serial_uring->ring, &cqe, 1, &ts, NULL);
+    }
+    if ((res < 0) && (res != -ETIME) && (res != -EINTR)) return -1;
+
+    unsigned num_completions = mb_serial_uring_handle_completions(mb_serial_uring);
+
+    for (source = mb_serial_uring->sources; source != NULL; source = source->next){
+        if (source->transport == NULL) continue;
+        mb_transport_process_timeouts(source->transport);
+    }
+    return (int) num_completions;
+}
+
+void mb_serial_uring_run(mb_serial_uring_t * mb_serial_uring){
+    mb_serial_uring->done = false;
+    while ((mb_serial_uring->done == false) && (mb_serial_uring->num_sources > 0)){
+        if (mb_serial_uring_process(mb_serial_uring, -1) < 0) break;
+    }
+}
+
+void mb_serial_uring_stop(mb_serial_uring_t * mb_serial_uring){
+    mb_serial_uring->done = true;
+}
@@ -0,0 +1,137 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_SERIAL_URING_H
+#define MULTIBUS_SERIAL_URING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+
+#include <liburing.h>
+
+#include "multibus_serial_posix.h"
+#include "multibus_transport.h"
+
+/**
+ * MultiBus io_uring backend for POSIX serial ports and sockets on Linux
+ *
+ * Replaces mb_serial_posix_process_read/process_write: for all registered serial contexts, reads into rx_buffer and
+ * writes of tx_iov are queued as io_uring submissions and submitted together with a single io_uring_enter.
+ * Reads use registered buffers if rx_buffer is located within one of the buffers provided to mb_serial_uring_init,
+ * e.g. the transport response buffer or receive ring storage.
+ * If a transport is provided, its request timeouts are processed as well.
+ */
+
+typedef struct mb_serial_uring_source {
+    struct mb_serial_uring_source * next;
+    struct mb_serial_uring * uring;
+    mb_serial_posix_context_t * mb_serial_posix_context;
+    mb_transport_t * transport;
+    // submissions in flight
+    bool read_pending;
+    bool write_pending;
+    bool removed;
+    // VMIN/VTIME of tty before it was added, restored on remove
+    bool  termios_changed;
+    cc_t  termios_vmin;
+    cc_t  termios_vtime;
+    // called after end of file or error, source has been removed
+    void (*closed_callback)(void * context);
+    void *closed_context;
+} mb_serial_uring_source_t;
+
+typedef struct mb_serial_uring {
+    struct io_uring ring;
+    const struct iovec * buffers;
+    unsigned num_buffers;
+    mb_serial_uring_source_t * sources;
+    uint16_t num_sources;
+    bool done;
+} mb_serial_uring_t;
+
+/**
+ * @brief Init io_uring backend
+ * @param mb_serial_uring
+ * @param num_entries of submission queue, at least two per serial context
+ * @param buffers to register for reads, can be NULL. Need to stay valid until deinit
+ * @param num_buffers
+ * @return true if successful
+ */
+bool mb_serial_uring_init(mb_serial_uring_t * mb_serial_uring, unsigned num_entries,
+                          const struct iovec * buffers, unsigned num_buffers);
+
+/**
+ * @brief Remove all sources and free io_uring
+ * @param mb_serial_uring
+ */
+void mb_serial_uring_deinit(mb_serial_uring_t * mb_serial_uring);
+
+/**
+ * @brief Add serial context of an open bridge
+ * @note switches file descriptor to blocking mode until removed
+ * @param mb_serial_uring
+ * @param source storage, needs to stay valid until removed
+ * @param mb_serial_posix_context
+ * @param transport using the serial context for timeout handling, or NULL
+ */
+void mb_serial_uring_add_serial(mb_serial_uring_t * mb_serial_uring, mb_serial_uring_source_t * source,
+                                mb_serial_posix_context_t * mb_serial_posix_context, mb_transport_t * transport);
+
+/**
+ * @brief Register callback for end of file or error, e.g. to close and re-open the serial port
+ * @param source
+ * @param closed_callback
+ * @param closed_context
+ */
+void mb_serial_uring_register_closed(mb_serial_uring_source_t * source, void (*closed_callback)(void * context),
+                                     void * closed_context);
+
+/**
+ * @brief Remove serial context, cancels and waits for submissions in flight
+ * @note switches file descriptor back to non-blocking mode
+ * @param mb_serial_uring
+ * @param source
+ */
+void mb_serial_uring_remove_serial(mb_serial_uring_t * mb_serial_uring, mb_serial_uring_source_t * source);
+
+/**
+ * @brief Submit pending reads and writes of all sources, wait for completions and dispatch them
+ * @param mb_serial_uring
+ * @param timeout_ms max time to wait, -1 waits until next completion or transport timeout
+ * @return number of completions, -1 on error
+ */
+int mb_serial_uring_process(mb_serial_uring_t * mb_serial_uring, int timeout_ms);
+
+/**
+ * @brief Process completions until mb_serial_uring_stop is called or no source is left
+ * @param mb_serial_uring
+ */
+void mb_serial_uring_run(mb_serial_uring_t * mb_serial_uring);
+
+/**
+ * @brief Stop mb_serial_uring_run after current iteration
+ * @param mb_serial_uring
+ */
+void mb_serial_uring_stop(mb_serial_uring_t * mb_serial_uring);
+
+#endif //MULTIBUS_SERIAL_URING_H
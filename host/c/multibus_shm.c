@@ -0,0 +1,383 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "multibus_shm.h"
+
+#define MB_SHM_MAGIC 0x4d425348
+#define MB_SHM_NUM_FDS 3
+// ring data starts after region header, aligned to cache line
+#define MB_SHM_DATA_OFFSET ((sizeof(mb_shm_region_t) + 63) & ~((size_t) 63))
+
+static uint8_t * mb_shm_ring_data(mb_shm_context_t * mb_shm_context, uint8_t ring_index){
+    return ((uint8_t *) mb_shm_context->region) + MB_SHM_DATA_OFFSET + ring_index * mb_shm_context->region->ring_size;
+}
+
+static void mb_shm_signal_peer(mb_shm_context_t * mb_shm_context){
+    uint64_t value = 1;
+    (void) write(mb_shm_context->eventfds[1 - mb_shm_context->role], &value, sizeof(value));
+}
+
+static uint16_t mb_shm_ring_write(mb_shm_context_t * mb_shm_context, const uint8_t * data, uint16_t len){
+    mb_shm_ring_t * ring = &mb_shm_context->region->rings[mb_shm_context->role];
+    uint8_t * ring_data = mb_shm_ring_data(mb_shm_context, mb_shm_context->role);
+    uint32_t ring_size = mb_shm_context->region->ring_size;
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t bytes_free = ring_size - (tail - head);
+    uint16_t bytes_to_copy = (len < bytes_free) ? len : (uint16_t) bytes_free;
+    if (bytes_to_copy == 0) return 0;
+
+    // copy up to end of ring, then wrap around
+    uint32_t pos = tail & (ring_size - 1);
+    uint32_t first_len = ring_size - pos;
+    if (first_len > bytes_to_copy){
+        first_len = bytes_to_copy;
+    }
+    memcpy(&ring_data[pos], data, first_len);
+    memcpy(ring_data, &data[first_len], bytes_to_copy - first_len);
+    atomic_store_explicit(&ring->tail, tail + bytes_to_copy, memory_order_release);
+
+    if (atomic_exchange(&ring->reader_waiting, 0) != 0){
+        mb_shm_signal_peer(mb_shm_context);
+    }
+    return bytes_to_copy;
+}
+
+static uint16_t mb_shm_ring_read(mb_shm_context_t * mb_shm_context, uint8_t * data, uint16_t len){
+    uint8_t ring_index = 1 - mb_shm_context->role;
+    mb_shm_ring_t * ring = &mb_shm_context->region->rings[ring_index];
+    uint8_t * ring_data = mb_shm_ring_data(mb_shm_context, ring_index);
+    uint32_t ring_size = mb_shm_context->region->ring_size;
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t bytes_available = tail - head;
+    uint16_t bytes_to_copy = (len < bytes_available) ? len : (uint16_t) bytes_available;
+    if (bytes_to_copy == 0) return 0;
+
+    uint32_t pos = head & (ring_size - 1);
+    uint32_t first_len = ring_size - pos;
+    if (first_len > bytes_to_copy){
+        first_len = bytes_to_copy;
+    }
+    memcpy(data, &ring_data[pos], first_len);
+    memcpy(&data[first_len], ring_data, bytes_to_copy - first_len);
+    atomic_store_explicit(&ring->head, head + bytes_to_copy, memory_order_release);
+
+    if (atomic_exchange(&ring->writer_waiting, 0) != 0){
+        mb_shm_signal_peer(mb_shm_context);
+    }
+    return bytes_to_copy;
+}
+
+static bool mb_shm_map(mb_shm_context_t * mb_shm_context, size_t region_size){
+    void * region = mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, mb_shm_context->memfd, 0);
+    if (region == MAP_FAILED) return false;
+    mb_shm_context->region = (mb_shm_region_t *) region;
+    mb_shm_context->region_size = region_size;
+    return true;
+}
+
+static void mb_shm_reset(mb_shm_context_t * mb_shm_context){
+    memset(mb_shm_context, 0, sizeof(mb_shm_context_t));
+    mb_shm_context->memfd = -1;
+    mb_shm_context->eventfds[0] = -1;
+    mb_shm_context->eventfds[1] = -1;
+}
+
+bool mb_shm_create(mb_shm_context_t * mb_shm_context, uint32_t ring_size){
+    assert(mb_shm_context != NULL);
+    assert((ring_size > 0) && ((ring_size & (ring_size - 1)) == 0));
+    mb_shm_reset(mb_shm_context);
+
+    size_t region_size = MB_SHM_DATA_OFFSET + 2 * (size_t) ring_size;
+    mb_shm_context->memfd = memfd_create("multibus", MFD_CLOEXEC);
+    mb_shm_context->eventfds[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    mb_shm_context->eventfds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((mb_shm_context->memfd < 0) || (mb_shm_context->eventfds[0] < 0) || (mb_shm_context->eventfds[1] < 0) ||
+        (ftruncate(mb_shm_context->memfd, (off_t) region_size) < 0) || (mb_shm_map(mb_shm_context, region_size) == false)){
+        mb_shm_close(mb_shm_context);
+        return false;
+    }
+
+    // memfd is zero-initialized
+    mb_shm_context->region->ring_size = ring_size;
+    mb_shm_context->region->magic = MB_SHM_MAGIC;
+    mb_shm_context->role = 0;
+    return true;
+}
+
+bool mb_shm_share(mb_shm_context_t * mb_shm_context, int socket_fd){
+    int fds[MB_SHM_NUM_FDS] = { mb_shm_context->memfd, mb_shm_context->eventfds[0], mb_shm_context->eventfds[1] };
+    union {
+        struct cmsghdr header;
+        uint8_t buffer[CMSG_SPACE(sizeof(fds))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    uint8_t payload = 0;
+    struct iovec iov = { .iov_base = &payload, .iov_len = 1 };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+    struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    return sendmsg(socket_fd, &msg, 0) == 1;
+}
+
+// close all file descriptors of a message that is not used
+static void mb_shm_close_received_fds(struct msghdr * msg){
+    struct cmsghdr * cmsg;
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)){
+        if ((cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS)) continue;
+        size_t num_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        size_t i;
+        for (i = 0; i < num_fds; i++){
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            close(fd);
+        }
+    }
+}
+
+bool mb_shm_attach(mb_shm_context_t * mb_shm_context, int socket_fd){
+    assert(mb_shm_context != NULL);
+    mb_shm_reset(mb_shm_context);
+
+    int fds[MB_SHM_NUM_FDS];
+    union {
+        struct cmsghdr header;
+        uint8_t buffer[CMSG_SPACE(sizeof(fds))];
+    } control;
+    uint8_t payload;
+    struct iovec iov = { .iov_base = &payload, .iov_len = 1 };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+    if (recvmsg(socket_fd, &msg, MSG_CMSG_CLOEXEC) != 1) return false;
+    struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+    if ((cmsg == NULL) || (cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS) ||
+        (cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) || ((msg.msg_flags & MSG_CTRUNC) != 0)){
+        mb_shm_close_received_fds(&msg);
+        return false;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    mb_shm_context->memfd = fds[0];
+    mb_shm_context->eventfds[0] = fds[1];
+    mb_shm_context->eventfds[1] = fds[2];
+
+    // map and validate region
+    struct stat memfd_stat;
+    if ((fstat(mb_shm_context->memfd, &memfd_stat) < 0) || ((size_t) memfd_stat.st_size < MB_SHM_DATA_OFFSET) ||
+        (mb_shm_map(mb_shm_context, (size_t) memfd_stat.st_size) == false)){
+        mb_shm_close(mb_shm_context);
+        return false;
+    }
+    uint32_t ring_size = mb_shm_context->region->ring_size;
+    if ((mb_shm_context->region->magic != MB_SHM_MAGIC) ||
+        (ring_size == 0) || ((ring_size & (ring_size - 1)) != 0) ||
+        ((MB_SHM_DATA_OFFSET + 2 * (size_t) ring_size) > mb_shm_context->region_size)){
+        mb_shm_close(mb_shm_context);
+        return false;
+    }
+    mb_shm_context->role = 1;
+    return true;
+}
+
+void mb_shm_close(mb_shm_context_t * mb_shm_context){
+    if (mb_shm_context->region != NULL){
+        munmap(mb_shm_context->region, mb_shm_context->region_size);
+        mb_shm_context->region = NULL;
+    }
+    if (mb_shm_context->memfd >= 0){
+        close(mb_shm_context->memfd);
+        mb_shm_context->memfd = -1;
+    }
+    uint8_t i;
+    for (i = 0; i < 2; i++){
+        if (mb_shm_context->eventfds[i] >= 0){
+            close(mb_shm_context->eventfds[i]);
+            mb_shm_context->eventfds[i] = -1;
+        }
+    }
+}
+
+int mb_shm_get_file_descriptor(mb_shm_context_t * mb_shm_context){
+    return mb_shm_context->eventfds[mb_shm_context->role];
+}
+
+bool mb_shm_prepare_wait(mb_shm_context_t * mb_shm_context){
+    if (mb_shm_context->tx_done) return false;
+    mb_shm_ring_t * tx_ring = &mb_shm_context->region->rings[mb_shm_context->role];
+    mb_shm_ring_t * rx_ring = &mb_shm_context->region->rings[1 - mb_shm_context->role];
+
+    // ask peer for wakeup, then check again to not miss an update
+    if (mb_shm_context->tx_active){
+        atomic_store(&tx_ring->writer_waiting, 1);
+        if ((atomic_load(&tx_ring->tail) - atomic_load(&tx_ring->head)) < mb_shm_context->region->ring_size) return false;
+    }
+    if (mb_shm_context->rx_len > 0){
+        atomic_store(&rx_ring->reader_waiting, 1);
+        if (atomic_load(&rx_ring->tail) != atomic_load(&rx_ring->head)) return false;
+    }
+    return true;
+}
+
+// write as much of the pending blocks as possible
+static void mb_shm_write_blocks(mb_shm_context_t * mb_shm_context){
+    while (mb_shm_context->tx_block_index < mb_shm_context->tx_block_count){
+        const mb_driver_block_t * block = &mb_shm_context->tx_blocks[mb_shm_context->tx_block_index];
+        uint16_t bytes_to_write = block->len - mb_shm_context->tx_pos;
+        uint16_t bytes_written = mb_shm_ring_write(mb_shm_context, &block->data[mb_shm_context->tx_pos], bytes_to_write);
+        mb_shm_context->tx_pos += bytes_written;
+        if (bytes_written < bytes_to_write) return;
+        mb_shm_context->tx_block_index++;
+        mb_shm_context->tx_pos = 0;
+    }
+    // report send complete in mb_shm_process
+    mb_shm_context->tx_active = false;
+    mb_shm_context->tx_done = true;
+}
+
+bool mb_shm_process(mb_shm_context_t * mb_shm_context){
+    bool work_done = false;
+
+    // clear wakeup
+    uint64_t value;
+    (void) read(mb_shm_context->eventfds[mb_shm_context->role], &value, sizeof(value));
+
+    if (mb_shm_context->tx_active){
+        mb_shm_write_blocks(mb_shm_context);
+    }
+    if (mb_shm_context->tx_done){
+        mb_shm_context->tx_done = false;
+        work_done = true;
+        if (mb_shm_context->block_sent_callback != NULL){
+            mb_shm_context->block_sent_callback(mb_shm_context->block_sent_context);
+        }
+    }
+
+    // deliver received data, callbacks provide next buffer
+    while (mb_shm_context->rx_len > 0){
+        uint16_t bytes_read = mb_shm_ring_read(mb_shm_context, mb_shm_context->rx_buffer, mb_shm_context->rx_len);
+        if (bytes_read == 0) break;
+        work_done = true;
+        if (mb_shm_context->rx_stream){
+            mb_shm_context->rx_len = 0;
+            if (mb_shm_context->bytes_received_callback != NULL){
+                mb_shm_context->bytes_received_callback(mb_shm_context->bytes_received_context, bytes_read);
+            }
+            continue;
+        }
+        mb_shm_context->rx_buffer += bytes_read;
+        mb_shm_context->rx_len    -= bytes_read;
+        if ((mb_shm_context->rx_len == 0) && (mb_shm_context->block_received_callback != NULL)){
+            mb_shm_context->block_received_callback(mb_shm_context->block_received_context);
+        }
+    }
+
+    return work_done;
+}
+
+// Driver interface
+
+static void mb_shm_driver_set_block_received(void * driver_context, void (*block_handler)(void * context), void * callback_context){
+    mb_shm_context_t * mb_shm_context = (mb_shm_context_t *) driver_context;
+    mb_shm_context->block_received_callback = block_handler;
+    mb_shm_context->block_received_context = callback_context;
+}
+
+static void mb_shm_driver_set_block_sent(void * driver_context, void (*block_handler)(void * context), void * callback_context){
+    mb_shm_context_t * mb_shm_context = (mb_shm_context_t *) driver_context;
+    mb_shm_context->block_sent_callback = block_handler;
+    mb_shm_context->block_sent_context = callback_context;
+}
+
+static void mb_shm_driver_set_bytes_received(void * driver_context, void (*bytes_handler)(void * context, uint16_t num_bytes), void * callback_context){
+    mb_shm_context_t * mb_shm_context = (mb_shm_context_t *) driver_context;
+    mb_shm_context->bytes_received_callback = bytes_handler;
+    mb_shm_context->bytes_received_context = callback_context;
+}
+
+static void mb_shm_driver_receive_block(void * driver_context, uint8_t *buffer, uint16_t length){
+    mb_shm_context_t * mb_shm_context = (mb_shm_context_t *) driver_context;
+    mb_shm_context->rx_buffer = buffer;
+    mb_shm_context->rx_len = length;
+    mb_shm_context->rx_stream = false;
+}
+
+static void mb_shm_driver_receive_bytes(void * driver_context, uint8_t *buffer, uint16_t max_length){
+    mb_shm_context_t * mb_shm_context = (mb_shm_context_t *) driver_context;
+    mb_shm_context->rx_buffer = buffer;
+    mb_shm_context->rx_len = max_length;
+    mb_shm_context->rx_stream = true;
+}
+
+static void mb_shm_driver_send_blocks(void * driver_context, const mb_driver_block_t * blocks, uint8_t num_blocks){
+    mb_shm_context_t * mb_shm_context = (mb_shm_context_t *) driver_context;
+    assert(num_blocks <= MB_DRIVER_MAX_BLOCKS);
+    memcpy(mb_shm_context->tx_blocks, blocks, num_blocks * sizeof(mb_driver_block_t));
+    mb_shm_context->tx_block_index = 0;
+    mb_shm_context->tx_block_count = num_blocks;
+    mb_shm_context->tx_pos = 0;
+    mb_shm_context->tx_active = true;
+    // copy into ring right away
+    mb_shm_write_blocks(mb_shm_context);
+}
+
+static void mb_shm_driver_send_block(void * driver_context, const uint8_t *buffer, uint16_t length){
+    mb_driver_block_t block;
+    block.data = buffer;
+    block.len  = length;
+    mb_shm_driver_send_blocks(driver_context, &block, 1);
+}
+
+static const mb_driver_t mb_shm_driver_interface = {
+        .set_block_received = &mb_shm_driver_set_block_received,
+        .set_block_sent     = &mb_shm_driver_set_block_sent,
+        .receive_block      = &mb_shm_driver_receive_block,
+        .send_block         = &mb_shm_driver_send_block,
+        .set_bytes_received = &mb_shm_driver_set_bytes_received,
+        .receive_bytes      = &mb_shm_driver_receive_bytes,
+        .send_blocks        = &mb_shm_driver_send_blocks
+};
+
+const mb_driver_t * mb_shm_get_driver(void){
+    return &mb_shm_driver_interface;
+}
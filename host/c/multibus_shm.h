@@ -0,0 +1,147 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_SHM_H
+#define MULTIBUS_SHM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "multibus_driver.h"
+
+/**
+ * MultiBus Shared Memory Driver for Linux
+ *
+ * Connects two co-located processes, e.g. an application and the process that owns the bridge, via a pair of
+ * single-producer / single-consumer byte rings in a memfd-backed shared memory region. Each endpoint has an eventfd
+ * that the peer only signals if the endpoint waits for data or ring space, so busy connections do not need any
+ * system calls. The creator shares the memfd and both eventfds with the peer over a Unix domain socket.
+ *
+ * Event loop integration: call mb_shm_prepare_wait before waiting. If it returns true, wait for the file descriptor
+ * to become readable. Then, call mb_shm_process to move data and to emit the driver callbacks.
+ */
+
+#ifndef MB_SHM_DEFAULT_RING_SIZE
+#define MB_SHM_DEFAULT_RING_SIZE 65536
+#endif
+
+// single-producer / single-consumer byte ring control in shared memory
+typedef struct {
+    atomic_uint head;
+    atomic_uint tail;
+    atomic_uint reader_waiting;
+    atomic_uint writer_waiting;
+} mb_shm_ring_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t ring_size;
+    // ring 0: creator to peer, ring 1: peer to creator
+    mb_shm_ring_t rings[2];
+} mb_shm_region_t;
+
+typedef struct {
+    // shared memory
+    int memfd;
+    mb_shm_region_t * region;
+    size_t region_size;
+    // eventfds: 0 wakes creator, 1 wakes peer
+    int eventfds[2];
+    // role of this endpoint: 0 for creator, 1 for peer
+    uint8_t role;
+    // driver interface
+    void (*block_received_callback)(void *context);
+    void *block_received_context;
+    void (*block_sent_callback)(void *context);
+    void *block_sent_context;
+    void (*bytes_received_callback)(void *context, uint16_t num_bytes);
+    void *bytes_received_context;
+    mb_driver_block_t tx_blocks[MB_DRIVER_MAX_BLOCKS];
+    uint8_t   tx_block_index;
+    uint8_t   tx_block_count;
+    uint16_t  tx_pos;
+    bool      tx_active;
+    bool      tx_done;
+    uint8_t * rx_buffer;
+    uint16_t  rx_len;
+    bool      rx_stream;
+} mb_shm_context_t;
+
+/**
+ * @brief Create shared memory region and eventfds
+ * @param mb_shm_context
+ * @param ring_size for each direction, power of two
+ * @return true if successful
+ */
+bool mb_shm_create(mb_shm_context_t * mb_shm_context, uint32_t ring_size);
+
+/**
+ * @brief Send memfd and eventfds to peer
+ * @param mb_shm_context of creator
+ * @param socket_fd connected Unix domain socket
+ * @return true if successful
+ */
+bool mb_shm_share(mb_shm_context_t * mb_shm_context, int socket_fd);
+
+/**
+ * @brief Receive memfd and eventfds from creator and map shared memory
+ * @param mb_shm_context
+ * @param socket_fd connected Unix domain socket
+ * @return true if successful
+ */
+bool mb_shm_attach(mb_shm_context_t * mb_shm_context, int socket_fd);
+
+/**
+ * @brief Unmap shared memory and close file descriptors
+ * @param mb_shm_context
+ */
+void mb_shm_close(mb_shm_context_t * mb_shm_context);
+
+/**
+ * @brief Get eventfd for use with event loop
+ * @param mb_shm_context
+ * @return file descriptor that becomes readable if the peer has provided data or ring space
+ */
+int mb_shm_get_file_descriptor(mb_shm_context_t * mb_shm_context);
+
+/**
+ * @brief Announce that endpoint is about to wait for its file descriptor
+ * @param mb_shm_context
+ * @return false if mb_shm_process has work to do right away
+ */
+bool mb_shm_prepare_wait(mb_shm_context_t * mb_shm_context);
+
+/**
+ * @brief Move data between rings and buffers and emit callbacks
+ * @param mb_shm_context
+ * @return true if any events have been emitted
+ */
+bool mb_shm_process(mb_shm_context_t * mb_shm_context);
+
+/**
+ * Provide driver implementation
+ * @return mb_driver_t implementation
+ */
+const mb_driver_t * mb_shm_get_driver(void);
+
+#endif //MULTIBUS_SHM_H
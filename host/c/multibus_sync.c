@@ -0,0 +1,104 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+
+#include "multibus_sync.h"
+#include "multibus_sync_protocol.h"
+
+static void mb_sync_callback_handler(void * context, const mb_message_t * message){
+    mb_sync_t * mb_sync = (mb_sync_t *) context;
+    // ignore events and responses to earlier requests
+    if (mb_message_is_event(message)) return;
+    if (message->component != mb_sync->response_component) return;
+    if (message->operation != mb_sync->response_operation) return;
+    if (mb_transport_get_receive_tag(mb_sync->transport) != mb_sync->response_tag) return;
+    if (message->payload_len > MB_SYNC_MAX_PAYLOAD_LEN) return;
+    // message is only valid during callback
+    memcpy(mb_sync->response_payload, message->payload_data, message->payload_len);
+    mb_sync->response_message = *message;
+    mb_sync->response_message.payload_data = mb_sync->response_payload;
+    mb_sync->response = &mb_sync->response_message;
+}
+
+void mb_sync_init(mb_sync_t * mb_sync, mb_transport_t * transport, mb_serial_posix_context_t * mb_serial_posix_context,
+                  uint32_t timeout_ms){
+    assert(mb_sync != NULL);
+    assert(transport != NULL);
+    assert(mb_serial_posix_context != NULL);
+    mb_sync->transport = transport;
+    mb_sync->mb_serial_posix_context = mb_serial_posix_context;
+    mb_sync->timeout_ms = timeout_ms;
+    mb_sync->response = NULL;
+    mb_transport_register_callback(transport, &mb_sync_callback_handler, mb_sync);
+}
+
+const mb_message_t * mb_sync_wait_for_response(mb_sync_t * mb_sync, uint8_t component, uint8_t operation){
+    mb_serial_posix_context_t * mb_serial_posix_context = mb_sync->mb_serial_posix_context;
+    uint32_t start_us = mb_serial_posix_get_time_us();
+    mb_sync->response_component = component;
+    mb_sync->response_operation = operation;
+    mb_sync->response_tag = mb_transport_get_request_tag(mb_sync->transport);
+    mb_sync->response = NULL;
+    while (true){
+        // process all available data
+        (void) mb_serial_posix_process_write(mb_serial_posix_context);
+        while (mb_sync->response == NULL){
+            if (mb_serial_posix_process_read(mb_serial_posix_context) == 0) break;
+        }
+        mb_transport_process_timeouts(mb_sync->transport);
+        if (mb_sync->response != NULL) break;
+
+        // get remaining time
+        uint32_t elapsed_ms = (mb_serial_posix_get_time_us() - start_us) / 1000;
+        if (elapsed_ms >= mb_sync->timeout_ms) return NULL;
+        uint32_t poll_timeout_ms = mb_sync->timeout_ms - elapsed_ms;
+        uint32_t transport_timeout_ms = mb_transport_get_next_timeout_ms(mb_sync->transport);
+        if (transport_timeout_ms < poll_timeout_ms){
+            poll_timeout_ms = transport_timeout_ms;
+        }
+
+        // wait for serial port
+        struct pollfd pfd;
+        pfd.fd = mb_serial_posix_get_file_descriptor(mb_serial_posix_context);
+        pfd.events = POLLIN;
+        if (mb_serial_posix_write_active(mb_serial_posix_context)){
+            pfd.events |= POLLOUT;
+        }
+        pfd.revents = 0;
+        int res = poll(&pfd, 1, (int) poll_timeout_ms);
+        if ((res < 0) && (errno != EINTR)) return NULL;
+        if ((pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) return NULL;
+    }
+    return mb_sync->response;
+}
+
+bool mb_sync_bridge_supports_component(mb_sync_t * mb_sync, uint8_t component){
+    const mb_message_t * message = mb_sync_bridge_supported_components(mb_sync, 0);
+    if (message == NULL) return false;
+    const uint8_t * components = mb_message_bridge_supported_components_response_get_supported_components(message);
+    uint16_t num_components = mb_bridge_supported_components_response_get_supported_components_len(message->payload_len);
+    return memchr(components, component, num_components) != NULL;
+}
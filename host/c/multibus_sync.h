@@ -0,0 +1,86 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_SYNC_H
+#define MULTIBUS_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "multibus_transport.h"
+#include "multibus_serial_posix.h"
+
+// max payload of a response, larger responses are ignored
+#define MB_SYNC_MAX_PAYLOAD_LEN 1024
+
+/**
+ * MultiBus Synchronous Client for POSIX systems
+ *
+ * Sends a request and blocks in poll() on the serial port until the response has been received or the timeout
+ * expired. The generated multibus_sync_protocol.h provides mb_sync_<component>_<operation> wrappers.
+ */
+
+typedef struct {
+    mb_transport_t            * transport;
+    mb_serial_posix_context_t * mb_serial_posix_context;
+    uint32_t                    timeout_ms;
+    // expected response
+    uint8_t                     response_component;
+    uint8_t                     response_operation;
+    uint8_t                     response_tag;
+    const mb_message_t        * response;
+    mb_message_t                response_message;
+    // copy of response payload, the transport receive buffer is reused for following messages
+    uint8_t                     response_payload[MB_SYNC_MAX_PAYLOAD_LEN];
+} mb_sync_t;
+
+/**
+ * @brief Init synchronous client for transport on POSIX serial port
+ * @note registers callback handler with transport
+ * @param mb_sync
+ * @param transport
+ * @param mb_serial_posix_context
+ * @param timeout_ms for each request
+ */
+void mb_sync_init(mb_sync_t * mb_sync, mb_transport_t * transport, mb_serial_posix_context_t * mb_serial_posix_context,
+                  uint32_t timeout_ms);
+
+/**
+ * @brief Wait for response to request sent before
+ * @note Other messages, e.g. events or late responses to earlier requests, are ignored
+ * @note Message is valid until next request is sent
+ * @param mb_sync
+ * @param component of request
+ * @param operation of response
+ * @return message or NULL on timeout
+ */
+const mb_message_t * mb_sync_wait_for_response(mb_sync_t * mb_sync, uint8_t component, uint8_t operation);
+
+/**
+ * @brief Query list of supported components from bridge and check if component is supported
+ * @param mb_sync
+ * @param component
+ * @return true if bridge reported component as supported, false if not or on timeout
+ */
+bool mb_sync_bridge_supports_component(mb_sync_t * mb_sync, uint8_t component);
+
+#endif //MULTIBUS_SYNC_H
@@ -0,0 +1,243 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "multibus_tcp_posix.h"
+
+// TCP_NOPUSH is the BSD / macOS counterpart of TCP_CORK
+#if defined(TCP_CORK)
+#define MB_TCP_POSIX_CORK TCP_CORK
+#elif defined(TCP_NOPUSH)
+#define MB_TCP_POSIX_CORK TCP_NOPUSH
+#endif
+
+static void mb_tcp_posix_set_cork(mb_tcp_posix_context_t * mb_tcp_posix_context, bool corked){
+#ifdef MB_TCP_POSIX_CORK
+    if (mb_tcp_posix_context->local) return;
+    if (mb_tcp_posix_context->corked == corked) return;
+    int value = corked ? 1 : 0;
+    (void) setsockopt(mb_tcp_posix_context->stream.fd, IPPROTO_TCP, MB_TCP_POSIX_CORK, &value, sizeof(value));
+    mb_tcp_posix_context->corked = corked;
+#else
+    (void) mb_tcp_posix_context;
+    (void) corked;
+#endif
+}
+
+bool mb_tcp_posix_open(mb_tcp_posix_context_t * mb_tcp_posix_context, const char * host, uint16_t port){
+    assert(mb_tcp_posix_context != NULL);
+    memset(mb_tcp_posix_context, 0, sizeof(mb_tcp_posix_context_t));
+    mb_tcp_posix_context->stream.fd = -1;
+
+    // resolve host
+    char port_str[6];
+    snprintf(port_str, sizeof(port_str), "%u", port);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo * addresses;
+    int res = getaddrinfo(host, port_str, &hints, &addresses);
+    if (res != 0){
+        printf("Unable to resolve %s - %s\n", host, gai_strerror(res));
+        return false;
+    }
+
+    // start non-blocking connect with first usable address
+    int fd = -1;
+    struct addrinfo * address;
+    for (address = addresses; address != NULL; address = address->ai_next){
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) continue;
+        int flags = fcntl(fd, F_GETFL, 0);
+        (void) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        if ((connect(fd, address->ai_addr, address->ai_addrlen) == 0) || (errno == EINPROGRESS)) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addresses);
+    if (fd < 0){
+        printf("Unable to connect to %s:%u\n", host, port);
+        perror("Error");
+        return false;
+    }
+
+    // send single requests without delay
+    int value = 1;
+    (void) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+#ifdef SO_NOSIGPIPE
+    (void) setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &value, sizeof(value));
+#endif
+
+    mb_tcp_posix_context->stream.fd = fd;
+    mb_tcp_posix_context->state = MB_TCP_POSIX_CONNECTING;
+    return true;
+}
+
+bool mb_tcp_posix_open_unix(mb_tcp_posix_context_t * mb_tcp_posix_context, const char * socket_path){
+    assert(mb_tcp_posix_context != NULL);
+    memset(mb_tcp_posix_context, 0, sizeof(mb_tcp_posix_context_t));
+    mb_tcp_posix_context->stream.fd = -1;
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)){
+        printf("Socket path too long: %s\n", socket_path);
+        return false;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0){
+        perror("socket");
+        return false;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    (void) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    if (connect(fd, (struct sockaddr *) &address, sizeof(address)) < 0){
+        printf("Unable to connect to %s\n", socket_path);
+        perror("Error");
+        close(fd);
+        return false;
+    }
+#ifdef SO_NOSIGPIPE
+    int value = 1;
+    (void) setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &value, sizeof(value));
+#endif
+
+    // local connect completes right away, corking is not needed
+    mb_tcp_posix_context->stream.fd = fd;
+    mb_tcp_posix_context->state = MB_TCP_POSIX_CONNECTED;
+    mb_tcp_posix_context->local = true;
+    return true;
+}
+
+void mb_tcp_posix_close(mb_tcp_posix_context_t * mb_tcp_posix_context){
+    mb_serial_posix_close(&mb_tcp_posix_context->stream);
+}
+
+mb_tcp_posix_state_t mb_tcp_posix_get_state(mb_tcp_posix_context_t * mb_tcp_posix_context){
+    if (mb_tcp_posix_context->state != MB_TCP_POSIX_CONNECTING) return mb_tcp_posix_context->state;
+
+    // socket becomes writable when connect completes
+    struct pollfd pfd;
+    pfd.fd = mb_tcp_posix_context->stream.fd;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 0) <= 0) return MB_TCP_POSIX_CONNECTING;
+
+    // connect error is reported via SO_ERROR only once, e.g. to a failed write
+    struct sockaddr_storage peer;
+    socklen_t peer_len = sizeof(peer);
+    if (getpeername(mb_tcp_posix_context->stream.fd, (struct sockaddr *) &peer, &peer_len) < 0){
+        mb_tcp_posix_context->state = MB_TCP_POSIX_FAILED;
+    } else {
+        mb_tcp_posix_context->state = MB_TCP_POSIX_CONNECTED;
+    }
+    return mb_tcp_posix_context->state;
+}
+
+mb_serial_posix_context_t * mb_tcp_posix_get_stream(mb_tcp_posix_context_t * mb_tcp_posix_context){
+    return &mb_tcp_posix_context->stream;
+}
+
+// Driver interface, delegates to POSIX serial driver
+
+static void mb_tcp_posix_block_sent(void * context){
+    mb_tcp_posix_context_t * mb_tcp_posix_context = (mb_tcp_posix_context_t *) context;
+    // push out remaining partial segment
+    mb_tcp_posix_set_cork(mb_tcp_posix_context, false);
+    if (mb_tcp_posix_context->block_sent_callback != NULL){
+        mb_tcp_posix_context->block_sent_callback(mb_tcp_posix_context->block_sent_context);
+    }
+}
+
+static void mb_tcp_posix_driver_set_block_received(void * driver_context, void (*block_handler)(void * context), void * callback_context){
+    mb_serial_posix_get_driver()->set_block_received(driver_context, block_handler, callback_context);
+}
+
+static void mb_tcp_posix_driver_set_block_sent(void * driver_context, void (*block_handler)(void * context), void * callback_context){
+    mb_tcp_posix_context_t * mb_tcp_posix_context = (mb_tcp_posix_context_t *) driver_context;
+    mb_tcp_posix_context->block_sent_callback = block_handler;
+    mb_tcp_posix_context->block_sent_context  = callback_context;
+    mb_serial_posix_get_driver()->set_block_sent(driver_context, &mb_tcp_posix_block_sent, mb_tcp_posix_context);
+}
+
+static void mb_tcp_posix_driver_set_bytes_received(void * driver_context, void (*bytes_handler)(void * context, uint16_t num_bytes), void * callback_context){
+    mb_serial_posix_get_driver()->set_bytes_received(driver_context, bytes_handler, callback_context);
+}
+
+static void mb_tcp_posix_driver_receive_block(void * driver_context, uint8_t *buffer, uint16_t length){
+    mb_serial_posix_get_driver()->receive_block(driver_context, buffer, length);
+}
+
+static void mb_tcp_posix_driver_receive_bytes(void * driver_context, uint8_t *buffer, uint16_t max_length){
+    mb_serial_posix_get_driver()->receive_bytes(driver_context, buffer, max_length);
+}
+
+static void mb_tcp_posix_driver_send_blocks(void * driver_context, const mb_driver_block_t * blocks, uint8_t num_blocks){
+    mb_tcp_posix_context_t * mb_tcp_posix_context = (mb_tcp_posix_context_t *) driver_context;
+    uint32_t len = 0;
+    uint8_t i;
+    for (i = 0; i < num_blocks; i++){
+        len += blocks[i].len;
+    }
+    // batch of requests: send full segments only
+    if (len > MB_TCP_POSIX_CORK_THRESHOLD){
+        mb_tcp_posix_set_cork(mb_tcp_posix_context, true);
+    }
+    mb_serial_posix_get_driver()->send_blocks(driver_context, blocks, num_blocks);
+}
+
+static void mb_tcp_posix_driver_send_block(void * driver_context, const uint8_t *buffer, uint16_t length){
+    mb_driver_block_t block;
+    block.data = buffer;
+    block.len  = length;
+    mb_tcp_posix_driver_send_blocks(driver_context, &block, 1);
+}
+
+static const mb_driver_t mb_tcp_posix_driver_interface = {
+        .set_block_received = &mb_tcp_posix_driver_set_block_received,
+        .set_block_sent     = &mb_tcp_posix_driver_set_block_sent,
+        .receive_block      = &mb_tcp_posix_driver_receive_block,
+        .send_block         = &mb_tcp_posix_driver_send_block,
+        .set_bytes_received = &mb_tcp_posix_driver_set_bytes_received,
+        .receive_bytes      = &mb_tcp_posix_driver_receive_bytes,
+        .send_blocks        = &mb_tcp_posix_driver_send_blocks
+};
+
+const mb_driver_t * mb_tcp_posix_get_driver(void){
+    return &mb_tcp_posix_driver_interface;
+}
@@ -0,0 +1,111 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_TCP_POSIX_H
+#define MULTIBUS_TCP_POSIX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "multibus_driver.h"
+#include "multibus_serial_posix.h"
+
+/**
+ * MultiBus TCP Transport for POSIX systems
+ *
+ * Connects to a bridge via TCP. Reads and writes are handled by the POSIX serial driver on the socket, so the
+ * embedded stream context can be used with mb_serial_posix_process_read/process_write, the run loop, the io_uring
+ * backend, the I/O thread and the synchronous client.
+ * TCP_NODELAY sends single requests immediately. If more than MB_TCP_POSIX_CORK_THRESHOLD bytes are sent at once,
+ * e.g. many requests queued by a pipelined transport, the socket is corked until they have been written to send
+ * full segments.
+ * Alternatively, a Unix domain socket can be used, e.g. to share a bridge via multibusd.
+ * Writes to a closed connection raise SIGPIPE on Linux, applications should ignore it.
+ */
+
+#ifndef MB_TCP_POSIX_CORK_THRESHOLD
+#define MB_TCP_POSIX_CORK_THRESHOLD 1460
+#endif
+
+typedef enum {
+    MB_TCP_POSIX_CONNECTING,
+    MB_TCP_POSIX_CONNECTED,
+    MB_TCP_POSIX_FAILED,
+} mb_tcp_posix_state_t;
+
+typedef struct {
+    // socket as stream, needs to be first member
+    mb_serial_posix_context_t stream;
+    mb_tcp_posix_state_t state;
+    bool corked;
+    // Unix domain socket, e.g. to multibusd
+    bool local;
+    // block sent callback of transport
+    void (*block_sent_callback)(void *context);
+    void *block_sent_context;
+} mb_tcp_posix_context_t;
+
+/**
+ * @brief Start non-blocking connect to bridge
+ * @note requests can be sent right away, they are written once the connection has been established
+ * @param mb_tcp_posix_context
+ * @param host name or address
+ * @param port
+ * @return true if connect has been started
+ */
+bool mb_tcp_posix_open(mb_tcp_posix_context_t * mb_tcp_posix_context, const char * host, uint16_t port);
+
+/**
+ * @brief Connect to Unix domain socket, e.g. of the multibusd bridge-sharing daemon
+ * @param mb_tcp_posix_context
+ * @param socket_path
+ * @return true if connected
+ */
+bool mb_tcp_posix_open_unix(mb_tcp_posix_context_t * mb_tcp_posix_context, const char * socket_path);
+
+/**
+ * @brief Close connection
+ * @param mb_tcp_posix_context
+ */
+void mb_tcp_posix_close(mb_tcp_posix_context_t * mb_tcp_posix_context);
+
+/**
+ * @brief Check if non-blocking connect has completed
+ * @param mb_tcp_posix_context
+ * @return state
+ */
+mb_tcp_posix_state_t mb_tcp_posix_get_state(mb_tcp_posix_context_t * mb_tcp_posix_context);
+
+/**
+ * @brief Get stream context for event loop integration
+ * @param mb_tcp_posix_context
+ * @return serial context of socket
+ */
+mb_serial_posix_context_t * mb_tcp_posix_get_stream(mb_tcp_posix_context_t * mb_tcp_posix_context);
+
+/**
+ * Provide driver implementation
+ * @return mb_driver_t implementation
+ */
+const mb_driver_t * mb_tcp_posix_get_driver(void);
+
+#endif //MULTIBUS_TCP_POSIX_H
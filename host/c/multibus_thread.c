@@ -0,0 +1,303 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "multibus_thread.h"
+#include "multibus_protocol.h"
+
+#define MB_THREAD_QUEUE_MASK (MB_THREAD_QUEUE_SIZE - 1)
+
+static bool mb_thread_open_pipe(int * fds){
+    if (pipe(fds) < 0){
+        fds[0] = -1;
+        fds[1] = -1;
+        return false;
+    }
+    (void) fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    (void) fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+static void mb_thread_close_pipe(int * fds){
+    if (fds[0] >= 0){
+        close(fds[0]);
+        close(fds[1]);
+        fds[0] = -1;
+        fds[1] = -1;
+    }
+}
+
+// write to pipe only if not already signalled
+static void mb_thread_signal(int * fds, atomic_bool * wakeup_pending){
+    if (atomic_exchange(wakeup_pending, true)) return;
+    uint8_t value = 0;
+    (void) write(fds[1], &value, 1);
+}
+
+// clear signal before checking queues again
+static void mb_thread_clear_signal(int * fds, atomic_bool * wakeup_pending){
+    uint8_t buffer[16];
+    while (read(fds[0], buffer, sizeof(buffer)) > 0){
+    }
+    atomic_store(wakeup_pending, false);
+}
+
+// I/O thread
+
+static void mb_thread_complete(mb_thread_slot_t * slot, mb_thread_completion_type_t type, const mb_message_t * message){
+    mb_thread_client_t * client = slot->client;
+    slot->active = false;
+    client->in_flight--;
+
+    // space is reserved for each request in flight
+    unsigned tail = atomic_load_explicit(&client->completion_tail, memory_order_relaxed);
+    mb_thread_completion_t * completion = &client->completions[tail & MB_THREAD_QUEUE_MASK];
+    completion->tag  = slot->tag;
+    completion->type = type;
+    memset(&completion->message, 0, sizeof(mb_message_t));
+    if (message != NULL){
+        completion->message = *message;
+        if (message->payload_len > 0){
+            memcpy(completion->payload, message->payload_data, message->payload_len);
+        }
+    }
+    completion->message.payload_data = completion->payload;
+
+    if (client->completion_callback != NULL){
+        client->completion_callback(client->completion_context, completion);
+        return;
+    }
+    atomic_store_explicit(&client->completion_tail, tail + 1, memory_order_release);
+    mb_thread_signal(client->wakeup_pipe, &client->wakeup_pending);
+}
+
+static void mb_thread_response_handler(void * context, const mb_message_t * message){
+    mb_thread_slot_t * slot = (mb_thread_slot_t *) context;
+    if (message->payload_len > MB_THREAD_MAX_MESSAGE_LEN){
+        mb_message_t header_only = *message;
+        header_only.payload_len = 0;
+        mb_thread_complete(slot, MB_THREAD_COMPLETION_RESPONSE_TOO_LONG, &header_only);
+        return;
+    }
+    mb_thread_complete(slot, MB_THREAD_COMPLETION_RESPONSE, message);
+}
+
+static void mb_thread_transport_handler(void * context, const mb_message_t * message){
+    mb_thread_t * mb_thread = (mb_thread_t *) context;
+    (void) message;
+    mb_thread->num_unsolicited_messages++;
+}
+
+void mb_thread_handle_timeout(void * context, const mb_transport_request_t * request){
+    (void) context;
+    if (request->callback_handler != &mb_thread_response_handler) return;
+    mb_thread_complete((mb_thread_slot_t *) request->callback_context, MB_THREAD_COMPLETION_TIMEOUT, NULL);
+}
+
+static mb_thread_slot_t * mb_thread_get_free_slot(mb_thread_t * mb_thread){
+    uint16_t i;
+    for (i = 0; i < MB_THREAD_MAX_REQUESTS; i++){
+        if (mb_thread->slots[i].active == false) return &mb_thread->slots[i];
+    }
+    return NULL;
+}
+
+// pass queued requests to transport, returns false if transport or slots are exhausted
+static bool mb_thread_submit_requests(mb_thread_t * mb_thread, mb_thread_client_t * client){
+    unsigned head = atomic_load_explicit(&client->request_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&client->request_tail, memory_order_acquire);
+    while (head != tail){
+        // reserve completion entry
+        if (client->completion_callback == NULL){
+            unsigned completions_queued = atomic_load_explicit(&client->completion_tail, memory_order_relaxed) -
+                                          atomic_load_explicit(&client->completion_head, memory_order_acquire);
+            if ((completions_queued + client->in_flight) >= MB_THREAD_QUEUE_SIZE) break;
+        }
+        mb_thread_slot_t * slot = mb_thread_get_free_slot(mb_thread);
+        if (slot == NULL) return false;
+        const mb_thread_request_t * request = &client->requests[head & MB_THREAD_QUEUE_MASK];
+        slot->client = client;
+        slot->tag    = request->tag;
+        if (mb_transport_send_request(mb_thread->transport, request->data, request->len,
+                                      &mb_thread_response_handler, slot) == false) return false;
+        slot->active = true;
+        client->in_flight++;
+        head++;
+        atomic_store_explicit(&client->request_head, head, memory_order_release);
+    }
+    return true;
+}
+
+static void * mb_thread_main(void * context){
+    mb_thread_t * mb_thread = (mb_thread_t *) context;
+    mb_serial_posix_context_t * mb_serial_posix_context = mb_thread->mb_serial_posix_context;
+    while (atomic_load(&mb_thread->done) == false){
+        // process all available data
+        (void) mb_serial_posix_process_write(mb_serial_posix_context);
+        while (mb_serial_posix_process_read(mb_serial_posix_context) > 0){
+        }
+        mb_transport_process_timeouts(mb_thread->transport);
+
+        // collect new requests from all clients
+        mb_thread_client_t * client;
+        for (client = atomic_load(&mb_thread->clients); client != NULL; client = client->next){
+            if (mb_thread_submit_requests(mb_thread, client) == false) break;
+        }
+
+        // wait for serial port, new requests or next timeout
+        int poll_timeout_ms = -1;
+        uint32_t transport_timeout_ms = mb_transport_get_next_timeout_ms(mb_thread->transport);
+        if (transport_timeout_ms != MB_TRANSPORT_NO_TIMEOUT){
+            poll_timeout_ms = (int) transport_timeout_ms;
+        }
+        struct pollfd pfds[2];
+        pfds[0].fd = mb_serial_posix_get_file_descriptor(mb_serial_posix_context);
+        pfds[0].events = POLLIN;
+        if (mb_serial_posix_write_active(mb_serial_posix_context)){
+            pfds[0].events |= POLLOUT;
+        }
+        pfds[0].revents = 0;
+        pfds[1].fd = mb_thread->wakeup_pipe[0];
+        pfds[1].events = POLLIN;
+        pfds[1].revents = 0;
+        int res = poll(pfds, 2, poll_timeout_ms);
+        if ((res < 0) && (errno != EINTR)) break;
+        if ((pfds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) break;
+        if ((pfds[1].revents & POLLIN) != 0){
+            mb_thread_clear_signal(mb_thread->wakeup_pipe, &mb_thread->wakeup_pending);
+        }
+    }
+    return NULL;
+}
+
+bool mb_thread_init(mb_thread_t * mb_thread, mb_transport_t * transport, mb_serial_posix_context_t * mb_serial_posix_context){
+    assert(mb_thread != NULL);
+    assert(transport != NULL);
+    assert(transport->requests != NULL);
+    memset(mb_thread, 0, sizeof(mb_thread_t));
+    mb_thread->transport = transport;
+    mb_thread->mb_serial_posix_context = mb_serial_posix_context;
+    atomic_init(&mb_thread->done, false);
+    atomic_init(&mb_thread->clients, NULL);
+    atomic_init(&mb_thread->wakeup_pending, false);
+    mb_transport_register_callback(transport, &mb_thread_transport_handler, mb_thread);
+    return mb_thread_open_pipe(mb_thread->wakeup_pipe);
+}
+
+bool mb_thread_start(mb_thread_t * mb_thread){
+    atomic_store(&mb_thread->done, false);
+    return pthread_create(&mb_thread->thread, NULL, &mb_thread_main, mb_thread) == 0;
+}
+
+void mb_thread_stop(mb_thread_t * mb_thread){
+    atomic_store(&mb_thread->done, true);
+    mb_thread_signal(mb_thread->wakeup_pipe, &mb_thread->wakeup_pending);
+    (void) pthread_join(mb_thread->thread, NULL);
+    mb_thread_close_pipe(mb_thread->wakeup_pipe);
+    mb_thread_client_t * client;
+    for (client = atomic_load(&mb_thread->clients); client != NULL; client = client->next){
+        mb_thread_close_pipe(client->wakeup_pipe);
+    }
+}
+
+// Application threads
+
+bool mb_thread_add_client(mb_thread_t * mb_thread, mb_thread_client_t * client,
+                          void (*completion_callback)(void * context, const mb_thread_completion_t * completion),
+                          void * completion_context){
+    assert(client != NULL);
+    memset(client, 0, sizeof(mb_thread_client_t));
+    client->mb_thread = mb_thread;
+    client->completion_callback = completion_callback;
+    client->completion_context  = completion_context;
+    atomic_init(&client->request_head, 0);
+    atomic_init(&client->request_tail, 0);
+    atomic_init(&client->completion_head, 0);
+    atomic_init(&client->completion_tail, 0);
+    atomic_init(&client->wakeup_pending, false);
+    if (mb_thread_open_pipe(client->wakeup_pipe) == false) return false;
+
+    mb_thread_client_t * head = atomic_load(&mb_thread->clients);
+    do {
+        client->next = head;
+    } while (atomic_compare_exchange_weak(&mb_thread->clients, &head, client) == false);
+    return true;
+}
+
+bool mb_thread_client_submit(mb_thread_client_t * client, const uint8_t * request, uint16_t request_len, uint32_t tag){
+    assert(request_len >= MB_HEADER_SIZE);
+    if (request_len > MB_THREAD_MAX_MESSAGE_LEN) return false;
+    unsigned tail = atomic_load_explicit(&client->request_tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&client->request_head, memory_order_acquire);
+    if ((tail - head) >= MB_THREAD_QUEUE_SIZE) return false;
+    mb_thread_request_t * entry = &client->requests[tail & MB_THREAD_QUEUE_MASK];
+    entry->tag = tag;
+    entry->len = request_len;
+    memcpy(entry->data, request, request_len);
+    atomic_store_explicit(&client->request_tail, tail + 1, memory_order_release);
+    mb_thread_signal(client->mb_thread->wakeup_pipe, &client->mb_thread->wakeup_pending);
+    return true;
+}
+
+const mb_thread_completion_t * mb_thread_client_peek_completion(mb_thread_client_t * client){
+    unsigned head = atomic_load_explicit(&client->completion_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&client->completion_tail, memory_order_acquire);
+    if (head == tail) return NULL;
+    return &client->completions[head & MB_THREAD_QUEUE_MASK];
+}
+
+void mb_thread_client_release_completion(mb_thread_client_t * client){
+    unsigned head = atomic_load_explicit(&client->completion_head, memory_order_relaxed);
+    atomic_store_explicit(&client->completion_head, head + 1, memory_order_release);
+    // queued requests might wait for a free completion entry
+    if (atomic_load_explicit(&client->request_tail, memory_order_relaxed) !=
+        atomic_load_explicit(&client->request_head, memory_order_acquire)){
+        mb_thread_signal(client->mb_thread->wakeup_pipe, &client->mb_thread->wakeup_pending);
+    }
+}
+
+const mb_thread_completion_t * mb_thread_client_wait_completion(mb_thread_client_t * client, uint32_t timeout_ms){
+    uint32_t start_us = mb_serial_posix_get_time_us();
+    while (true){
+        const mb_thread_completion_t * completion = mb_thread_client_peek_completion(client);
+        if (completion != NULL) return completion;
+
+        uint32_t elapsed_ms = (mb_serial_posix_get_time_us() - start_us) / 1000;
+        if (elapsed_ms >= timeout_ms) return NULL;
+
+        struct pollfd pfd;
+        pfd.fd = client->wakeup_pipe[0];
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        int res = poll(&pfd, 1, (int) (timeout_ms - elapsed_ms));
+        if ((res < 0) && (errno != EINTR)) return NULL;
+        if ((pfd.revents & POLLIN) != 0){
+            mb_thread_clear_signal(client->wakeup_pipe, &client->wakeup_pending);
+        }
+    }
+}
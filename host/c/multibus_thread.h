@@ -0,0 +1,197 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTIBUS_THREAD_H
+#define MULTIBUS_THREAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "multibus_transport.h"
+#include "multibus_serial_posix.h"
+
+/**
+ * MultiBus I/O Thread for POSIX systems
+ *
+ * A dedicated I/O thread owns the transport and the serial port. Application threads submit requests via their own
+ * mb_thread_client_t, which has lock-free single-producer / single-consumer queues for requests and completions.
+ * Completions are either passed to a callback on the I/O thread or queued for the application thread, which can
+ * block in mb_thread_client_wait_completion.
+ * The transport needs to use pipelining. To report timeouts, enable timeouts with mb_thread_handle_timeout as
+ * handler and the mb_thread_t as context.
+ */
+
+#ifndef MB_THREAD_MAX_MESSAGE_LEN
+#define MB_THREAD_MAX_MESSAGE_LEN 300
+#endif
+
+// number of entries in request and completion queue, power of two
+#ifndef MB_THREAD_QUEUE_SIZE
+#define MB_THREAD_QUEUE_SIZE 16
+#endif
+
+// max number of requests in flight for all clients
+#ifndef MB_THREAD_MAX_REQUESTS
+#define MB_THREAD_MAX_REQUESTS 32
+#endif
+
+typedef enum {
+    MB_THREAD_COMPLETION_RESPONSE,
+    MB_THREAD_COMPLETION_TIMEOUT,
+    // response payload larger than MB_THREAD_MAX_MESSAGE_LEN, message contains header fields only
+    MB_THREAD_COMPLETION_RESPONSE_TOO_LONG,
+} mb_thread_completion_type_t;
+
+typedef struct {
+    uint32_t tag;
+    uint16_t len;
+    uint8_t  data[MB_THREAD_MAX_MESSAGE_LEN];
+} mb_thread_request_t;
+
+typedef struct {
+    uint32_t tag;
+    mb_thread_completion_type_t type;
+    // response, payload_data points into payload
+    mb_message_t message;
+    uint8_t  payload[MB_THREAD_MAX_MESSAGE_LEN];
+} mb_thread_completion_t;
+
+typedef struct mb_thread_client {
+    struct mb_thread_client * next;
+    struct mb_thread * mb_thread;
+    // requests: produced by application thread, consumed by I/O thread
+    mb_thread_request_t requests[MB_THREAD_QUEUE_SIZE];
+    atomic_uint request_head;
+    atomic_uint request_tail;
+    // completions: produced by I/O thread, consumed by application thread
+    mb_thread_completion_t completions[MB_THREAD_QUEUE_SIZE];
+    atomic_uint completion_head;
+    atomic_uint completion_tail;
+    // completion callback on I/O thread, NULL queues completions
+    void (*completion_callback)(void * context, const mb_thread_completion_t * completion);
+    void *completion_context;
+    // owned by I/O thread: requests in flight, limited by free completion entries
+    uint16_t in_flight;
+    // wake up application thread waiting for completions
+    int wakeup_pipe[2];
+    atomic_bool wakeup_pending;
+} mb_thread_client_t;
+
+// request in flight
+typedef struct {
+    mb_thread_client_t * client;
+    uint32_t tag;
+    bool     active;
+} mb_thread_slot_t;
+
+typedef struct mb_thread {
+    mb_transport_t * transport;
+    mb_serial_posix_context_t * mb_serial_posix_context;
+    pthread_t thread;
+    atomic_bool done;
+    // registered clients, lock-free push
+    _Atomic(mb_thread_client_t *) clients;
+    // wake up I/O thread after new requests
+    int wakeup_pipe[2];
+    atomic_bool wakeup_pending;
+    // owned by I/O thread
+    mb_thread_slot_t slots[MB_THREAD_MAX_REQUESTS];
+    uint32_t num_unsolicited_messages;
+} mb_thread_t;
+
+/**
+ * @brief Init I/O thread for transport on POSIX serial port
+ * @note registers callback handler with transport. Transport is only accessed by I/O thread after start
+ * @param mb_thread
+ * @param transport with pipelining enabled
+ * @param mb_serial_posix_context
+ * @return true if successful
+ */
+bool mb_thread_init(mb_thread_t * mb_thread, mb_transport_t * transport, mb_serial_posix_context_t * mb_serial_posix_context);
+
+/**
+ * @brief Start I/O thread
+ * @param mb_thread
+ * @return true if successful
+ */
+bool mb_thread_start(mb_thread_t * mb_thread);
+
+/**
+ * @brief Stop and join I/O thread, close pipes of I/O thread and all clients
+ * @param mb_thread
+ */
+void mb_thread_stop(mb_thread_t * mb_thread);
+
+/**
+ * @brief Timeout handler to be used with mb_transport_enable_timeouts, reports timeout completion to client
+ * @param context mb_thread_t
+ * @param request
+ */
+void mb_thread_handle_timeout(void * context, const mb_transport_request_t * request);
+
+/**
+ * @brief Add client for use by a single application thread
+ * @note can be called before or after start from any thread, clients cannot be removed
+ * @param mb_thread
+ * @param client
+ * @param completion_callback called on I/O thread, or NULL to queue completions
+ * @param completion_context
+ * @return true if successful
+ */
+bool mb_thread_add_client(mb_thread_t * mb_thread, mb_thread_client_t * client,
+                          void (*completion_callback)(void * context, const mb_thread_completion_t * completion),
+                          void * completion_context);
+
+/**
+ * @brief Submit request
+ * @param client
+ * @param request including header
+ * @param request_len
+ * @param tag reported in completion
+ * @return true if successful, false if request queue is full
+ */
+bool mb_thread_client_submit(mb_thread_client_t * client, const uint8_t * request, uint16_t request_len, uint32_t tag);
+
+/**
+ * @brief Get oldest queued completion
+ * @param client
+ * @return completion or NULL, valid until mb_thread_client_release_completion
+ */
+const mb_thread_completion_t * mb_thread_client_peek_completion(mb_thread_client_t * client);
+
+/**
+ * @brief Remove completion returned by peek
+ * @param client
+ */
+void mb_thread_client_release_completion(mb_thread_client_t * client);
+
+/**
+ * @brief Wait for queued completion
+ * @param client
+ * @param timeout_ms
+ * @return completion or NULL on timeout, valid until mb_thread_client_release_completion
+ */
+const mb_thread_completion_t * mb_thread_client_wait_completion(mb_thread_client_t * client, uint32_t timeout_ms);
+
+#endif //MULTIBUS_THREAD_H
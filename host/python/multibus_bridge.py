@@ -43,7 +43,7 @@ class MultibusBridge:
         self.multibus_connection = multibus_connection
 
     def get_protocol_version(self):
-        message = multibus_protocol.mb_bridge_protocol_version_request_setup(self.MB_BRIDGE_CHANNEL)
+        message = multibus_protocol.mb_bridge_protocol_version_request_setup(self.MB_BRIDGE_CHANNEL, 0)
 
         self.multibus_connection.send_multibus_message(message)
 
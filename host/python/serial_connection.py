@@ -35,13 +35,22 @@ class MultibusSerialConnection(MultibusConnection):
         self.connection.write(message)
 
     def receive_multibus_message(self):
-        header = self.connection.read(self.MB_HEADER_LEN)
-        if len(header) < self.MB_HEADER_LEN:
-            raise Exception("Received invalid message. TODO")
-
-        (subsystem, opcode, channel, payload_len) = struct.unpack(">BBBH", header)
-        if payload_len > 0:
-            payload = self.connection.read(payload_len)
-            return header, payload
-        else:
-            return header
+        # bindings are generated on import of the component modules
+        from generated import multibus_protocol
+
+        while True:
+            header = self.connection.read(self.MB_HEADER_LEN)
+            if len(header) < self.MB_HEADER_LEN:
+                raise Exception("Received invalid message. TODO")
+
+            (subsystem, opcode, channel, payload_len) = struct.unpack(">BBBH", header)
+            payload = self.connection.read(payload_len) if payload_len > 0 else b''
+
+            # events, e.g. sampler samples, are not a response to the current request
+            if multibus_protocol.mb_message_is_event(subsystem, opcode):
+                continue
+
+            if payload_len > 0:
+                return header, payload
+            else:
+                return header
@@ -0,0 +1,68 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+
+#include "multibus_batch.h"
+
+void mb_batch_iterator_init(mb_batch_iterator_t * iterator, const uint8_t * data, uint16_t len){
+    assert(iterator != NULL);
+    iterator->data   = data;
+    iterator->len    = len;
+    iterator->offset = 0;
+}
+
+bool mb_batch_iterator_next(mb_batch_iterator_t * iterator, mb_message_t * message){
+    assert(iterator != NULL);
+    assert(message != NULL);
+    uint16_t bytes_remaining = iterator->len - iterator->offset;
+    if (bytes_remaining < MB_HEADER_SIZE) return false;
+    const uint8_t * header = &iterator->data[iterator->offset];
+    uint16_t payload_len = mb_header_get_length(header);
+    if (payload_len > (bytes_remaining - MB_HEADER_SIZE)) return false;
+    message->component    = mb_header_get_component(header);
+    message->operation    = mb_header_get_operation(header);
+    message->channel      = mb_header_get_channel(header);
+    message->payload_len  = payload_len;
+    message->payload_data = &header[MB_HEADER_SIZE];
+    iterator->offset += MB_HEADER_SIZE + payload_len;
+    return true;
+}
+
+bool mb_batch_iterator_done(const mb_batch_iterator_t * iterator){
+    assert(iterator != NULL);
+    return iterator->offset == iterator->len;
+}
+
+bool mb_batch_requests_valid(const uint8_t * requests, uint16_t requests_len){
+    mb_batch_iterator_t iterator;
+    mb_message_t message;
+    mb_batch_iterator_init(&iterator, requests, requests_len);
+    while (mb_batch_iterator_next(&iterator, &message)){
+        if (message.component == MB_COMPONENT_BATCH) return false;
+        if (message.component != MB_COMPONENT_BRIDGE) continue;
+        // these change how following messages are transferred
+        if (message.operation == MB_OPERATION_BRIDGE_FRAMING_REQUEST) return false;
+        if (message.operation == MB_OPERATION_BRIDGE_PROTOCOL_VERSION_REQUEST) return false;
+    }
+    return mb_batch_iterator_done(&iterator);
+}
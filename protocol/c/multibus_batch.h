@@ -0,0 +1,85 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * MultiBus Batch
+ *
+ * A batch execute_request carries a list of complete request messages (header and payload, without trailer).
+ * The bridge executes them in order and returns the concatenated responses in a single execute_response.
+ * Sub-requests are built with the generated setup functions at increasing offsets of a buffer, and the
+ * iterator below splits both request and response lists into messages.
+ */
+
+#ifndef MULTIBUS_BATCH_H
+#define MULTIBUS_BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "multibus_protocol.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const uint8_t * data;
+    uint16_t        len;
+    uint16_t        offset;
+} mb_batch_iterator_t;
+
+/**
+ * @brief Init iterator for list of messages
+ * @param iterator
+ * @param data
+ * @param len
+ */
+void mb_batch_iterator_init(mb_batch_iterator_t * iterator, const uint8_t * data, uint16_t len);
+
+/**
+ * @brief Get next message
+ * @param iterator
+ * @param message points into list
+ * @return false at end of list or if the remaining data is not a complete message
+ */
+bool mb_batch_iterator_next(mb_batch_iterator_t * iterator, mb_message_t * message);
+
+/**
+ * @brief Check if all messages have been returned
+ * @param iterator
+ * @return true if end of list has been reached, false if list ended with an incomplete message
+ */
+bool mb_batch_iterator_done(const mb_batch_iterator_t * iterator);
+
+/**
+ * @brief Check if list of requests can be executed as batch
+ * @param requests
+ * @param requests_len
+ * @return true if list consists of complete messages without batch, framing, and protocol version requests
+ */
+bool mb_batch_requests_valid(const uint8_t * requests, uint16_t requests_len);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif //MULTIBUS_BATCH_H
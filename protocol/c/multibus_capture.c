@@ -0,0 +1,138 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "multibus_capture.h"
+
+static void mb_capture_store(mb_capture_t * capture, const uint8_t * data, uint32_t len){
+    uint32_t offset = capture->read + capture->used;
+    if (offset >= capture->size){
+        offset -= capture->size;
+    }
+    uint32_t bytes_to_end = capture->size - offset;
+    if (len <= bytes_to_end){
+        memcpy(&capture->storage[offset], data, len);
+    } else {
+        memcpy(&capture->storage[offset], data, bytes_to_end);
+        memcpy(capture->storage, &data[bytes_to_end], len - bytes_to_end);
+    }
+    capture->used += len;
+}
+
+static void mb_capture_store_record_header(mb_capture_t * capture, uint32_t timestamp_us, mb_capture_type_t type, uint16_t len){
+    uint8_t record_header[MB_CAPTURE_RECORD_HEADER_SIZE];
+    record_header[0] = timestamp_us >> 24;
+    record_header[1] = timestamp_us >> 16;
+    record_header[2] = timestamp_us >> 8;
+    record_header[3] = timestamp_us & 0xff;
+    record_header[4] = (uint8_t) type;
+    record_header[5] = len >> 8;
+    record_header[6] = len & 0xff;
+    mb_capture_store(capture, record_header, sizeof(record_header));
+}
+
+void mb_capture_init(mb_capture_t * capture, uint8_t * storage, uint32_t size){
+    assert(capture != NULL);
+    assert(storage != NULL);
+    capture->storage = storage;
+    capture->size    = size;
+    capture->read    = 0;
+    capture->used    = 0;
+    capture->dropped_pending = 0;
+    capture->num_records = 0;
+    capture->num_dropped = 0;
+}
+
+bool mb_capture_record(mb_capture_t * capture, uint32_t timestamp_us, mb_capture_type_t type,
+                       const mb_driver_block_t * blocks, uint8_t num_blocks){
+    assert(capture != NULL);
+    uint32_t len = 0;
+    uint8_t i;
+    for (i = 0; i < num_blocks; i++){
+        len += blocks[i].len;
+    }
+    assert(len <= UINT16_MAX);
+
+    // report dropped records first
+    uint32_t required = MB_CAPTURE_RECORD_HEADER_SIZE + len;
+    if (capture->dropped_pending > 0){
+        required += MB_CAPTURE_RECORD_HEADER_SIZE + 4;
+    }
+    if ((capture->size - capture->used) < required){
+        capture->dropped_pending++;
+        capture->num_dropped++;
+        return false;
+    }
+    if (capture->dropped_pending > 0){
+        uint8_t num_dropped[4];
+        num_dropped[0] = capture->dropped_pending >> 24;
+        num_dropped[1] = capture->dropped_pending >> 16;
+        num_dropped[2] = capture->dropped_pending >> 8;
+        num_dropped[3] = capture->dropped_pending & 0xff;
+        mb_capture_store_record_header(capture, timestamp_us, MB_CAPTURE_TYPE_DROPPED, sizeof(num_dropped));
+        mb_capture_store(capture, num_dropped, sizeof(num_dropped));
+        capture->dropped_pending = 0;
+    }
+
+    mb_capture_store_record_header(capture, timestamp_us, type, (uint16_t) len);
+    for (i = 0; i < num_blocks; i++){
+        mb_capture_store(capture, blocks[i].data, blocks[i].len);
+    }
+    capture->num_records++;
+    return true;
+}
+
+bool mb_capture_write_file_header(FILE * file){
+    const uint8_t file_header[MB_CAPTURE_FILE_HEADER_SIZE] = { 'M', 'B', 'C', 'P', MB_CAPTURE_FORMAT_VERSION };
+    return fwrite(file_header, 1, sizeof(file_header), file) == sizeof(file_header);
+}
+
+uint32_t mb_capture_flush(mb_capture_t * capture, FILE * file){
+    assert(capture != NULL);
+    uint32_t bytes_written = 0;
+    while (capture->used > 0){
+        // write contiguous part
+        uint32_t len = capture->size - capture->read;
+        if (len > capture->used){
+            len = capture->used;
+        }
+        size_t written = fwrite(&capture->storage[capture->read], 1, len, file);
+        capture->read += (uint32_t) written;
+        if (capture->read == capture->size){
+            capture->read = 0;
+        }
+        capture->used -= (uint32_t) written;
+        bytes_written += (uint32_t) written;
+        if (written < len) break;
+    }
+    if (capture->used == 0){
+        capture->read = 0;
+    }
+    return bytes_written;
+}
+
+uint32_t mb_capture_get_num_dropped(mb_capture_t * capture){
+    assert(capture != NULL);
+    return capture->num_dropped;
+}
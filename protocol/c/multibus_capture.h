@@ -0,0 +1,119 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * MultiBus Capture
+ *
+ * Records timestamped frames into a preallocated ring, which can be written to a capture file later, e.g. when the
+ * event loop is idle. Recording only copies the frame, so it can stay enabled while debugging timing problems.
+ *
+ * Capture file format, all values are big endian:
+ * - file header: 'M', 'B', 'C', 'P', format version (u8)
+ * - records:     timestamp_us (u32), type (u8), len (u16), data[len]
+ *
+ * A record of type MB_CAPTURE_TYPE_DROPPED contains the number of dropped records (u32) since the previous record.
+ * protocol/capture-decoder.py shows the frames in a capture file using protocol/multibus.yml.
+ */
+
+#ifndef MULTIBUS_CAPTURE_H
+#define MULTIBUS_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "multibus_driver.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#define MB_CAPTURE_FORMAT_VERSION 1
+#define MB_CAPTURE_FILE_HEADER_SIZE 5
+#define MB_CAPTURE_RECORD_HEADER_SIZE 7
+
+typedef enum {
+    MB_CAPTURE_TYPE_SENT     = 0x00,
+    MB_CAPTURE_TYPE_RECEIVED = 0x01,
+    MB_CAPTURE_TYPE_DROPPED  = 0x02,
+} mb_capture_type_t;
+
+typedef struct {
+    uint8_t * storage;
+    uint32_t  size;
+    uint32_t  read;
+    uint32_t  used;
+    // records dropped since last record
+    uint32_t  dropped_pending;
+    // stats
+    uint32_t  num_records;
+    uint32_t  num_dropped;
+} mb_capture_t;
+
+/**
+ * @brief Init capture with ring storage
+ * @param capture
+ * @param storage
+ * @param size
+ */
+void mb_capture_init(mb_capture_t * capture, uint8_t * storage, uint32_t size);
+
+/**
+ * @brief Record frame provided as list of blocks
+ * @note If the ring is full, the record is dropped and counted
+ * @param capture
+ * @param timestamp_us
+ * @param type
+ * @param blocks
+ * @param num_blocks
+ * @return true if recorded
+ */
+bool mb_capture_record(mb_capture_t * capture, uint32_t timestamp_us, mb_capture_type_t type,
+                       const mb_driver_block_t * blocks, uint8_t num_blocks);
+
+/**
+ * @brief Write capture file header
+ * @param file
+ * @return true if successful
+ */
+bool mb_capture_write_file_header(FILE * file);
+
+/**
+ * @brief Write recorded data to capture file and free ring
+ * @param capture
+ * @param file
+ * @return number of bytes written
+ */
+uint32_t mb_capture_flush(mb_capture_t * capture, FILE * file);
+
+/**
+ * @brief Get number of dropped records
+ * @param capture
+ * @return num dropped
+ */
+uint32_t mb_capture_get_num_dropped(mb_capture_t * capture);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif //MULTIBUS_CAPTURE_H
@@ -23,6 +23,7 @@
 /**
  * MultiBus Driver Abstraction
  * Driver allows to send / receive a block of data over some transport interface
+ * Optionally, the driver can provide all bytes that are available instead of a fixed-size block
  */
 
 #ifndef C_TEST_MULTIBUS_DRIVER_H
@@ -35,6 +36,14 @@
 extern "C" {
 #endif
 
+// max number of blocks for send_blocks
+#define MB_DRIVER_MAX_BLOCKS 4
+
+typedef struct {
+    const uint8_t * data;
+    uint16_t        len;
+} mb_driver_block_t;
+
 typedef struct {
 
     /**
@@ -69,6 +78,34 @@ typedef struct {
      */
     void (*send_block)(void * driver_context, const uint8_t *buffer, uint16_t length);
 
+    /**
+     * set callback for bytes received by receive_bytes. NULL disables callback
+     * @note optional, NULL if not supported
+     * @param driver_context
+     * @param callback_handler
+     * @param callback_context
+     */
+    void (*set_bytes_received)(void * driver_context, void (*callback_handler)(void *context, uint16_t num_bytes), void * callback_context);
+
+    /**
+     * receive up to max_length bytes, callback reports number of bytes received
+     * @note optional, NULL if not supported
+     * @param driver_context
+     * @param buffer
+     * @param max_length
+     */
+    void (*receive_bytes)(void * driver_context, uint8_t *buffer, uint16_t max_length);
+
+    /**
+     * send list of blocks, set callback for sent is called after all blocks have been sent
+     * @note optional, NULL if not supported
+     * @note list of blocks is copied, data needs to stay valid until sent
+     * @param driver_context
+     * @param blocks
+     * @param num_blocks, max MB_DRIVER_MAX_BLOCKS
+     */
+    void (*send_blocks)(void * driver_context, const mb_driver_block_t * blocks, uint8_t num_blocks);
+
 } mb_driver_t;
 
 #if defined __cplusplus
@@ -0,0 +1,133 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+
+#include "multibus_framing.h"
+#include "multibus_protocol.h"
+
+uint16_t mb_framing_crc16(const uint8_t * data, uint16_t len){
+    uint16_t crc = 0xffff;
+    uint16_t i;
+    for (i = 0; i < len; i++){
+        crc ^= (uint16_t) data[i] << 8;
+        uint8_t bit;
+        for (bit = 0; bit < 8; bit++){
+            crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ 0x1021) : (uint16_t) (crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint16_t mb_framing_encode(const uint8_t * message, uint16_t message_len, uint8_t * frame, uint16_t frame_size){
+    assert(message != NULL);
+    assert(frame != NULL);
+    if (frame_size < MB_FRAMING_MAX_FRAME_LEN(message_len)) return 0;
+
+    uint16_t crc = mb_framing_crc16(message, message_len);
+    uint8_t  trailer[MB_FRAMING_CRC_SIZE];
+    trailer[0] = (uint8_t) (crc >> 8);
+    trailer[1] = (uint8_t) crc;
+
+    // COBS: each code byte holds the distance to the next 0x00, 0xff marks a run of 254 non-zero bytes
+    uint16_t code_pos = 0;
+    uint16_t pos      = 1;
+    uint8_t  code     = 1;
+    uint16_t input_len = message_len + MB_FRAMING_CRC_SIZE;
+    uint16_t i;
+    for (i = 0; i < input_len; i++){
+        uint8_t byte = (i < message_len) ? message[i] : trailer[i - message_len];
+        if (byte != 0){
+            frame[pos++] = byte;
+            code++;
+        }
+        if ((byte == 0) || (code == 0xff)){
+            frame[code_pos] = code;
+            code_pos = pos++;
+            code = 1;
+        }
+    }
+    frame[code_pos] = code;
+    frame[pos++] = MB_FRAMING_DELIMITER;
+    return pos;
+}
+
+uint16_t mb_framing_decode(uint8_t * frame, uint16_t frame_len){
+    assert(frame != NULL);
+
+    // output never overtakes input
+    uint16_t read_pos  = 0;
+    uint16_t write_pos = 0;
+    while (read_pos < frame_len){
+        uint8_t code = frame[read_pos++];
+        if (code == 0) return 0;
+        if ((uint16_t) (read_pos + code - 1) > frame_len) return 0;
+        uint8_t i;
+        for (i = 1; i < code; i++){
+            frame[write_pos++] = frame[read_pos++];
+        }
+        if ((code < 0xff) && (read_pos < frame_len)){
+            frame[write_pos++] = 0;
+        }
+    }
+
+    // check CRC and length field
+    if (write_pos < (MB_HEADER_SIZE + MB_FRAMING_CRC_SIZE)) return 0;
+    uint16_t message_len = write_pos - MB_FRAMING_CRC_SIZE;
+    uint16_t crc = ((uint16_t) frame[message_len] << 8) | frame[message_len + 1];
+    if (mb_framing_crc16(frame, message_len) != crc) return 0;
+    if ((MB_HEADER_SIZE + mb_header_get_length(frame)) != message_len) return 0;
+    return message_len;
+}
+
+void mb_framing_decoder_init(mb_framing_decoder_t * decoder, uint8_t * buffer, uint16_t size){
+    assert(decoder != NULL);
+    assert(buffer != NULL);
+    decoder->buffer     = buffer;
+    decoder->size       = size;
+    decoder->len        = 0;
+    decoder->overflow   = false;
+    decoder->num_errors = 0;
+}
+
+uint16_t mb_framing_decoder_put(mb_framing_decoder_t * decoder, uint8_t byte){
+    if (byte != MB_FRAMING_DELIMITER){
+        if (decoder->len < decoder->size){
+            decoder->buffer[decoder->len++] = byte;
+        } else {
+            decoder->overflow = true;
+        }
+        return 0;
+    }
+
+    // delimiter: ignore empty frames, e.g. used to flush the receiver
+    uint16_t frame_len = decoder->len;
+    bool     overflow  = decoder->overflow;
+    decoder->len      = 0;
+    decoder->overflow = false;
+    if ((frame_len == 0) && !overflow) return 0;
+    uint16_t message_len = overflow ? 0 : mb_framing_decode(decoder->buffer, frame_len);
+    if (message_len == 0){
+        decoder->num_errors++;
+    }
+    return message_len;
+}
@@ -0,0 +1,105 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * MultiBus Framing
+ *
+ * Optional self-synchronizing link framing, enabled with bridge framing_request after connect.
+ *
+ * In COBS_CRC16 mode, each message is followed by a CRC-16/CCITT-FALSE (big endian), the result is COBS encoded
+ * and terminated by a 0x00 delimiter. As 0x00 does not occur inside a frame, a receiver that lost sync (e.g. after
+ * a dropped or corrupted byte) discards the current frame at the next delimiter and decodes the following frame
+ * correctly. Frames with invalid encoding, CRC or header length are dropped and counted.
+ */
+
+#ifndef MULTIBUS_FRAMING_H
+#define MULTIBUS_FRAMING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#define MB_FRAMING_CRC_SIZE 2
+#define MB_FRAMING_DELIMITER 0x00
+
+// max frame size incl. CRC, COBS overhead and delimiter for message of given length
+#define MB_FRAMING_MAX_FRAME_LEN(message_len) ((message_len) + MB_FRAMING_CRC_SIZE + (((message_len) + MB_FRAMING_CRC_SIZE) / 254) + 2)
+
+typedef struct {
+    uint8_t * buffer;
+    uint16_t  size;
+    uint16_t  len;
+    bool      overflow;
+    // stats
+    uint32_t  num_errors;
+} mb_framing_decoder_t;
+
+/**
+ * @brief Calculate CRC-16/CCITT-FALSE
+ * @param data
+ * @param len
+ * @return crc
+ */
+uint16_t mb_framing_crc16(const uint8_t * data, uint16_t len);
+
+/**
+ * @brief Encode message into frame incl. delimiter
+ * @param message
+ * @param message_len
+ * @param frame
+ * @param frame_size, at least MB_FRAMING_MAX_FRAME_LEN(message_len)
+ * @return frame len, 0 if frame does not fit
+ */
+uint16_t mb_framing_encode(const uint8_t * message, uint16_t message_len, uint8_t * frame, uint16_t frame_size);
+
+/**
+ * @brief Decode frame in place
+ * @param frame without delimiter, contains message afterwards
+ * @param frame_len
+ * @return message len, 0 if frame is invalid
+ */
+uint16_t mb_framing_decode(uint8_t * frame, uint16_t frame_len);
+
+/**
+ * @brief Init decoder for byte-wise input, e.g. from an UART
+ * @param decoder
+ * @param buffer for frame and decoded message
+ * @param size, frames that do not fit are dropped
+ */
+void mb_framing_decoder_init(mb_framing_decoder_t * decoder, uint8_t * buffer, uint16_t size);
+
+/**
+ * @brief Process received byte
+ * @param decoder
+ * @param byte
+ * @return message len if a valid frame is complete, message is stored at start of buffer, 0 otherwise
+ */
+uint16_t mb_framing_decoder_put(mb_framing_decoder_t * decoder, uint8_t byte);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif //MULTIBUS_FRAMING_H
@@ -0,0 +1,187 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "multibus_sampler.h"
+
+// returns true if time a is at or after time b, handles wrap-around
+static inline bool mb_sampler_time_reached(uint32_t a, uint32_t b){
+    return (int32_t) (a - b) >= 0;
+}
+
+static mb_sampler_job_t * mb_sampler_get_job(mb_sampler_t * sampler, uint8_t job_id){
+    uint8_t i;
+    for (i = 0; i < MB_SAMPLER_MAX_JOBS; i++){
+        if (sampler->jobs[i].active && (sampler->jobs[i].job_id == job_id)) return &sampler->jobs[i];
+    }
+    return NULL;
+}
+
+void mb_sampler_init(mb_sampler_t * sampler, const mb_sequencer_bus_t * bus,
+                     void * (*get_bus_context)(void * context, uint8_t channel), void * context){
+    assert(sampler != NULL);
+    assert(bus != NULL);
+    memset(sampler, 0, sizeof(mb_sampler_t));
+    sampler->bus = bus;
+    sampler->get_bus_context = get_bus_context;
+    sampler->context = context;
+}
+
+mb_status_t mb_sampler_add_job(mb_sampler_t * sampler, uint8_t job_id, uint8_t channel, uint16_t period_ms,
+                               uint16_t max_latency_ms, const uint8_t * program, uint16_t program_len, uint32_t now_us){
+    if (period_ms == 0) return MB_STATUS_INVALID_ARGUMENTS;
+    if (program_len > MB_SAMPLER_MAX_PROGRAM_LEN) return MB_STATUS_SAMPLER_NO_RESOURCES;
+    if (mb_sequencer_verify(program, program_len) == false) return MB_STATUS_INVALID_ARGUMENTS;
+
+    mb_sampler_job_t * job = mb_sampler_get_job(sampler, job_id);
+    uint8_t i;
+    for (i = 0; (job == NULL) && (i < MB_SAMPLER_MAX_JOBS); i++){
+        if (sampler->jobs[i].active == false){
+            job = &sampler->jobs[i];
+        }
+    }
+    if (job == NULL) return MB_STATUS_SAMPLER_NO_RESOURCES;
+
+    job->active         = true;
+    job->job_id         = job_id;
+    job->channel        = channel;
+    job->period_us      = (uint32_t) period_ms * 1000;
+    job->max_latency_us = (uint32_t) max_latency_ms * 1000;
+    job->next_us        = now_us;
+    memcpy(job->program, program, program_len);
+    job->program_len    = program_len;
+    return MB_STATUS_OK;
+}
+
+mb_status_t mb_sampler_remove_job(mb_sampler_t * sampler, uint8_t job_id){
+    mb_sampler_job_t * job = mb_sampler_get_job(sampler, job_id);
+    if (job == NULL) return MB_STATUS_SAMPLER_UNKNOWN_JOB;
+    job->active = false;
+    return MB_STATUS_OK;
+}
+
+void mb_sampler_remove_all_jobs(mb_sampler_t * sampler){
+    uint16_t i;
+    for (i = 0; i < MB_SAMPLER_MAX_JOBS; i++){
+        sampler->jobs[i].active = false;
+    }
+    sampler->samples_len = 0;
+}
+
+static void mb_sampler_run_job(mb_sampler_t * sampler, mb_sampler_job_t * job, uint32_t now_us){
+    uint8_t * sample = &sampler->samples[sampler->samples_len];
+    void * bus_context = NULL;
+    if (sampler->get_bus_context != NULL){
+        bus_context = sampler->get_bus_context(sampler->context, job->channel);
+    }
+    uint16_t data_len;
+    mb_status_t status = mb_sequencer_run(sampler->bus, bus_context, job->program, job->program_len,
+                                          &sample[MB_SAMPLER_SAMPLE_HEADER_SIZE], MB_SAMPLER_MAX_DATA_LEN, &data_len);
+    sample[0] = job->job_id;
+    sample[1] = (uint8_t) status;
+    sample[2] = (uint8_t) (now_us >> 24);
+    sample[3] = (uint8_t) (now_us >> 16);
+    sample[4] = (uint8_t) (now_us >> 8);
+    sample[5] = (uint8_t) now_us;
+    sample[6] = (uint8_t) data_len;
+
+    // send samples when the first one reaches its max latency, or earlier if a later one requires it
+    uint32_t send_us = now_us + job->max_latency_us;
+    if ((sampler->samples_len == 0) || mb_sampler_time_reached(sampler->send_us, send_us)){
+        sampler->send_us = send_us;
+    }
+    sampler->samples_len += MB_SAMPLER_SAMPLE_HEADER_SIZE + data_len;
+    sampler->num_samples++;
+
+    // skip missed periods
+    job->next_us += job->period_us;
+    if (mb_sampler_time_reached(now_us, job->next_us)){
+        job->next_us = now_us + job->period_us;
+        sampler->num_overruns++;
+    }
+}
+
+static uint16_t mb_sampler_setup_event(mb_sampler_t * sampler, uint8_t * event, uint16_t event_size){
+    uint16_t event_len = mb_sampler_samples_event_setup(event, event_size, 0, sampler->samples_len, sampler->samples);
+    sampler->samples_len = 0;
+    return event_len;
+}
+
+uint16_t mb_sampler_process(mb_sampler_t * sampler, uint32_t now_us, uint8_t * event, uint16_t event_size){
+    uint8_t i;
+    for (i = 0; i < MB_SAMPLER_MAX_JOBS; i++){
+        mb_sampler_job_t * job = &sampler->jobs[i];
+        if (job->active == false) continue;
+        if (mb_sampler_time_reached(now_us, job->next_us) == false) continue;
+        // send collected samples first if the next sample might not fit
+        if ((sampler->samples_len + MB_SAMPLER_SAMPLE_HEADER_SIZE + MB_SAMPLER_MAX_DATA_LEN) > MB_SAMPLER_MAX_SAMPLES_LEN){
+            return mb_sampler_setup_event(sampler, event, event_size);
+        }
+        mb_sampler_run_job(sampler, job, now_us);
+    }
+    if ((sampler->samples_len > 0) && mb_sampler_time_reached(now_us, sampler->send_us)){
+        return mb_sampler_setup_event(sampler, event, event_size);
+    }
+    return 0;
+}
+
+uint32_t mb_sampler_get_timeout_us(const mb_sampler_t * sampler, uint32_t now_us){
+    uint32_t timeout_us = UINT32_MAX;
+    uint8_t i;
+    if (sampler->samples_len > 0){
+        timeout_us = mb_sampler_time_reached(now_us, sampler->send_us) ? 0 : (sampler->send_us - now_us);
+    }
+    for (i = 0; i < MB_SAMPLER_MAX_JOBS; i++){
+        const mb_sampler_job_t * job = &sampler->jobs[i];
+        if (job->active == false) continue;
+        uint32_t job_timeout_us = mb_sampler_time_reached(now_us, job->next_us) ? 0 : (job->next_us - now_us);
+        if (job_timeout_us < timeout_us){
+            timeout_us = job_timeout_us;
+        }
+    }
+    return timeout_us;
+}
+
+void mb_sampler_iterator_init(mb_sampler_iterator_t * iterator, const uint8_t * samples, uint16_t samples_len){
+    assert(iterator != NULL);
+    iterator->samples     = samples;
+    iterator->samples_len = samples_len;
+    iterator->offset      = 0;
+}
+
+bool mb_sampler_iterator_next(mb_sampler_iterator_t * iterator, mb_sampler_sample_t * sample){
+    uint16_t bytes_remaining = iterator->samples_len - iterator->offset;
+    if (bytes_remaining < MB_SAMPLER_SAMPLE_HEADER_SIZE) return false;
+    const uint8_t * data = &iterator->samples[iterator->offset];
+    uint8_t data_len = data[6];
+    if (bytes_remaining < (MB_SAMPLER_SAMPLE_HEADER_SIZE + data_len)) return false;
+    sample->job_id       = data[0];
+    sample->status       = (mb_status_t) data[1];
+    sample->timestamp_us = ((uint32_t) data[2] << 24) | ((uint32_t) data[3] << 16) | ((uint32_t) data[4] << 8) | data[5];
+    sample->data_len     = data_len;
+    sample->data         = &data[MB_SAMPLER_SAMPLE_HEADER_SIZE];
+    iterator->offset += MB_SAMPLER_SAMPLE_HEADER_SIZE + data_len;
+    return true;
+}
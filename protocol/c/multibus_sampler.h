@@ -0,0 +1,174 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * MultiBus Sampler
+ *
+ * A sampler job runs a sequencer program periodically on the bridge. The data appended by the program is stored as a
+ * sample together with job id, sequencer status and bridge time in microseconds. Samples are collected and sent in
+ * a single samples event when the oldest sample reached the max latency of its job, or when the next sample might not
+ * fit into the event.
+ *
+ * Sample format: job_id:u8 status:u8 timestamp_us:u32 data_len:u8 data[data_len], multi-byte fields are big endian.
+ *
+ * Bridges call mb_sampler_process regularly and send the returned event, hosts use the sample iterator.
+ */
+
+#ifndef MULTIBUS_SAMPLER_H
+#define MULTIBUS_SAMPLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "multibus_protocol.h"
+#include "multibus_sequencer.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#define MB_SAMPLER_MAX_JOBS         8
+#define MB_SAMPLER_MAX_PROGRAM_LEN  64
+#define MB_SAMPLER_MAX_DATA_LEN     MB_SEQUENCER_NUM_REGISTERS
+#define MB_SAMPLER_SAMPLE_HEADER_SIZE 7
+// max len of samples field in samples event
+#define MB_SAMPLER_MAX_SAMPLES_LEN  256
+
+typedef struct {
+    bool     active;
+    uint8_t  job_id;
+    uint8_t  channel;
+    uint32_t period_us;
+    uint32_t max_latency_us;
+    uint32_t next_us;
+    uint8_t  program[MB_SAMPLER_MAX_PROGRAM_LEN];
+    uint16_t program_len;
+} mb_sampler_job_t;
+
+typedef struct {
+    // bus access for jobs
+    const mb_sequencer_bus_t * bus;
+    void * (*get_bus_context)(void * context, uint8_t channel);
+    void * context;
+    mb_sampler_job_t jobs[MB_SAMPLER_MAX_JOBS];
+    // collected samples and deadline for sending them
+    uint8_t  samples[MB_SAMPLER_MAX_SAMPLES_LEN];
+    uint16_t samples_len;
+    uint32_t send_us;
+    // stats
+    uint32_t num_samples;
+    uint32_t num_overruns;
+} mb_sampler_t;
+
+typedef struct {
+    uint8_t  job_id;
+    mb_status_t status;
+    uint32_t timestamp_us;
+    uint8_t  data_len;
+    const uint8_t * data;
+} mb_sampler_sample_t;
+
+typedef struct {
+    const uint8_t * samples;
+    uint16_t samples_len;
+    uint16_t offset;
+} mb_sampler_iterator_t;
+
+/**
+ * @brief Init sampler without jobs
+ * @param sampler
+ * @param bus used to run job programs
+ * @param get_bus_context returns bus context for channel of job
+ * @param context for get_bus_context
+ */
+void mb_sampler_init(mb_sampler_t * sampler, const mb_sequencer_bus_t * bus,
+                     void * (*get_bus_context)(void * context, uint8_t channel), void * context);
+
+/**
+ * @brief Add job or replace job with same id, first sample is taken at now_us
+ * @param sampler
+ * @param job_id
+ * @param channel passed to get_bus_context
+ * @param period_ms
+ * @param max_latency_ms
+ * @param program sequencer program
+ * @param program_len
+ * @param now_us
+ * @return MB_STATUS_OK, MB_STATUS_INVALID_ARGUMENTS for invalid program or period, MB_STATUS_SAMPLER_NO_RESOURCES
+ */
+mb_status_t mb_sampler_add_job(mb_sampler_t * sampler, uint8_t job_id, uint8_t channel, uint16_t period_ms,
+                               uint16_t max_latency_ms, const uint8_t * program, uint16_t program_len, uint32_t now_us);
+
+/**
+ * @brief Remove job, samples already taken are still sent
+ * @param sampler
+ * @param job_id
+ * @return MB_STATUS_OK or MB_STATUS_SAMPLER_UNKNOWN_JOB
+ */
+mb_status_t mb_sampler_remove_job(mb_sampler_t * sampler, uint8_t job_id);
+
+/**
+ * @brief Remove all jobs and drop samples not sent yet, e.g. when a host starts a new session
+ * @param sampler
+ */
+void mb_sampler_remove_all_jobs(mb_sampler_t * sampler);
+
+/**
+ * @brief Run due jobs and set up samples event if it should be sent
+ * @note call again after an event has been sent, as more jobs may be due
+ * @param sampler
+ * @param now_us
+ * @param event buffer for samples event
+ * @param event_size
+ * @return len of samples event, 0 if nothing to send
+ */
+uint16_t mb_sampler_process(mb_sampler_t * sampler, uint32_t now_us, uint8_t * event, uint16_t event_size);
+
+/**
+ * @brief Get time until mb_sampler_process needs to be called
+ * @param sampler
+ * @param now_us
+ * @return time in us, UINT32_MAX if there are no jobs and no samples
+ */
+uint32_t mb_sampler_get_timeout_us(const mb_sampler_t * sampler, uint32_t now_us);
+
+/**
+ * @brief Init iterator over samples of samples event
+ * @param iterator
+ * @param samples
+ * @param samples_len
+ */
+void mb_sampler_iterator_init(mb_sampler_iterator_t * iterator, const uint8_t * samples, uint16_t samples_len);
+
+/**
+ * @brief Get next sample
+ * @param iterator
+ * @param sample
+ * @return false if no more samples or sample is incomplete
+ */
+bool mb_sampler_iterator_next(mb_sampler_iterator_t * iterator, mb_sampler_sample_t * sample);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif //MULTIBUS_SAMPLER_H
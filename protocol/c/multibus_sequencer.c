@@ -0,0 +1,378 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "multibus_sequencer.h"
+
+#define MB_SEQUENCER_NO_LOOP 0xffff
+
+static uint16_t mb_sequencer_get_u16(const uint8_t * data){
+    return (uint16_t) ((data[0] << 8) | data[1]);
+}
+
+// returns instruction len, 0 if opcode is unknown or instruction is incomplete
+static uint16_t mb_sequencer_instruction_len(const uint8_t * program, uint16_t program_len, uint16_t pc){
+    uint16_t bytes_remaining = program_len - pc;
+    uint16_t len;
+    switch ((mb_sequencer_op_t) program[pc]){
+        case MB_SEQUENCER_OP_END:
+        case MB_SEQUENCER_OP_LOOP_END:
+            len = 1;
+            break;
+        case MB_SEQUENCER_OP_LOOP:
+            len = 2;
+            break;
+        case MB_SEQUENCER_OP_DELAY:
+        case MB_SEQUENCER_OP_APPEND:
+        case MB_SEQUENCER_OP_SPI_READ:
+            len = 3;
+            break;
+        case MB_SEQUENCER_OP_I2C_READ:
+            len = 4;
+            break;
+        case MB_SEQUENCER_OP_SPI_WRITE:
+        case MB_SEQUENCER_OP_SPI_TRANSFER:
+            if (bytes_remaining < 3) return 0;
+            len = 3 + program[pc + 2];
+            break;
+        case MB_SEQUENCER_OP_I2C_WRITE:
+            if (bytes_remaining < 4) return 0;
+            len = 4 + program[pc + 3];
+            break;
+        case MB_SEQUENCER_OP_BRANCH_IF_EQUAL:
+        case MB_SEQUENCER_OP_BRANCH_IF_NOT_EQUAL:
+            len = 6;
+            break;
+        default:
+            return 0;
+    }
+    if (len > bytes_remaining) return 0;
+    return len;
+}
+
+// get innermost loop at offset, returns false if offset is not the start of an instruction or the end of the program
+static bool mb_sequencer_get_loop(const uint8_t * program, uint16_t program_len, uint16_t offset, uint16_t * loop){
+    uint16_t loops[MB_SEQUENCER_MAX_LOOP_DEPTH];
+    uint8_t  depth = 0;
+    uint16_t pc = 0;
+    while (pc < offset){
+        uint16_t len = mb_sequencer_instruction_len(program, program_len, pc);
+        if (len == 0) return false;
+        switch (program[pc]){
+            case MB_SEQUENCER_OP_LOOP:
+                if (depth == MB_SEQUENCER_MAX_LOOP_DEPTH) return false;
+                loops[depth++] = pc;
+                break;
+            case MB_SEQUENCER_OP_LOOP_END:
+                if (depth == 0) return false;
+                depth--;
+                break;
+            default:
+                break;
+        }
+        pc += len;
+    }
+    if (pc != offset) return false;
+    *loop = (depth > 0) ? loops[depth - 1] : MB_SEQUENCER_NO_LOOP;
+    return true;
+}
+
+bool mb_sequencer_verify(const uint8_t * program, uint16_t program_len){
+    uint16_t loops[MB_SEQUENCER_MAX_LOOP_DEPTH];
+    // number of executions at each loop depth, capped as any further delay would exceed the limit
+    uint32_t loop_factors[MB_SEQUENCER_MAX_LOOP_DEPTH + 1];
+    uint32_t total_delay_ms = 0;
+    uint8_t  depth = 0;
+    uint16_t pc = 0;
+    loop_factors[0] = 1;
+    while (pc < program_len){
+        uint16_t len = mb_sequencer_instruction_len(program, program_len, pc);
+        if (len == 0) return false;
+        const uint8_t * operands = &program[pc + 1];
+        uint16_t loop;
+        switch (program[pc]){
+            case MB_SEQUENCER_OP_I2C_READ:
+                if (operands[2] > MB_SEQUENCER_NUM_REGISTERS) return false;
+                break;
+            case MB_SEQUENCER_OP_SPI_READ:
+            case MB_SEQUENCER_OP_SPI_TRANSFER:
+                if (operands[1] > MB_SEQUENCER_NUM_REGISTERS) return false;
+                break;
+            case MB_SEQUENCER_OP_DELAY:
+                total_delay_ms += mb_sequencer_get_u16(operands) * loop_factors[depth];
+                if (total_delay_ms > MB_SEQUENCER_MAX_TOTAL_DELAY_MS) return false;
+                break;
+            case MB_SEQUENCER_OP_LOOP:
+                if (depth == MB_SEQUENCER_MAX_LOOP_DEPTH) return false;
+                if (operands[0] == 0) return false;
+                loop_factors[depth + 1] = loop_factors[depth] * operands[0];
+                if (loop_factors[depth + 1] > (MB_SEQUENCER_MAX_TOTAL_DELAY_MS + 1)){
+                    loop_factors[depth + 1] = MB_SEQUENCER_MAX_TOTAL_DELAY_MS + 1;
+                }
+                loops[depth++] = pc;
+                break;
+            case MB_SEQUENCER_OP_LOOP_END:
+                if (depth == 0) return false;
+                depth--;
+                break;
+            case MB_SEQUENCER_OP_BRANCH_IF_EQUAL:
+            case MB_SEQUENCER_OP_BRANCH_IF_NOT_EQUAL:
+                if (operands[0] >= MB_SEQUENCER_NUM_REGISTERS) return false;
+                if (mb_sequencer_get_loop(program, program_len, mb_sequencer_get_u16(&operands[3]), &loop) == false) return false;
+                if (loop != ((depth > 0) ? loops[depth - 1] : MB_SEQUENCER_NO_LOOP)) return false;
+                break;
+            case MB_SEQUENCER_OP_APPEND:
+                if ((operands[0] + operands[1]) > MB_SEQUENCER_NUM_REGISTERS) return false;
+                break;
+            default:
+                break;
+        }
+        pc += len;
+    }
+    return depth == 0;
+}
+
+mb_status_t mb_sequencer_run(const mb_sequencer_bus_t * bus, void * bus_context, const uint8_t * program, uint16_t program_len,
+                             uint8_t * data, uint16_t data_size, uint16_t * data_len){
+    assert(bus != NULL);
+    assert(data_len != NULL);
+    *data_len = 0;
+    if (mb_sequencer_verify(program, program_len) == false) return MB_STATUS_SEQUENCER_INVALID_PROGRAM;
+
+    uint8_t  registers[MB_SEQUENCER_NUM_REGISTERS];
+    uint16_t loop_starts[MB_SEQUENCER_MAX_LOOP_DEPTH];
+    uint8_t  loop_counts[MB_SEQUENCER_MAX_LOOP_DEPTH];
+    uint8_t  depth = 0;
+    uint32_t steps = 0;
+    uint32_t total_delay_ms = 0;
+    uint16_t pc = 0;
+    memset(registers, 0, sizeof(registers));
+    while (pc < program_len){
+        if (++steps > MB_SEQUENCER_MAX_STEPS) return MB_STATUS_SEQUENCER_STEP_LIMIT;
+        uint16_t len = mb_sequencer_instruction_len(program, program_len, pc);
+        const uint8_t * operands = &program[pc + 1];
+        bool ok = true;
+        bool condition;
+        switch ((mb_sequencer_op_t) program[pc]){
+            case MB_SEQUENCER_OP_END:
+                return MB_STATUS_OK;
+            case MB_SEQUENCER_OP_I2C_WRITE:
+                ok = bus->i2c_write(bus_context, mb_sequencer_get_u16(operands), &operands[3], operands[2]);
+                break;
+            case MB_SEQUENCER_OP_I2C_READ:
+                ok = bus->i2c_read(bus_context, mb_sequencer_get_u16(operands), registers, operands[2]);
+                break;
+            case MB_SEQUENCER_OP_SPI_WRITE:
+                ok = bus->spi_transfer(bus_context, operands[0], &operands[2], NULL, operands[1]);
+                break;
+            case MB_SEQUENCER_OP_SPI_READ:
+                ok = bus->spi_transfer(bus_context, operands[0], NULL, registers, operands[1]);
+                break;
+            case MB_SEQUENCER_OP_SPI_TRANSFER:
+                ok = bus->spi_transfer(bus_context, operands[0], &operands[2], registers, operands[1]);
+                break;
+            case MB_SEQUENCER_OP_DELAY:
+                // delays repeated by backward branches are not covered by mb_sequencer_verify
+                total_delay_ms += mb_sequencer_get_u16(operands);
+                if (total_delay_ms > MB_SEQUENCER_MAX_TOTAL_DELAY_MS) return MB_STATUS_SEQUENCER_DELAY_LIMIT;
+                if (bus->delay_ms != NULL){
+                    bus->delay_ms(bus_context, mb_sequencer_get_u16(operands));
+                }
+                break;
+            case MB_SEQUENCER_OP_LOOP:
+                loop_starts[depth] = pc + len;
+                loop_counts[depth] = operands[0];
+                depth++;
+                break;
+            case MB_SEQUENCER_OP_LOOP_END:
+                if (--loop_counts[depth - 1] > 0){
+                    pc = loop_starts[depth - 1];
+                    continue;
+                }
+                depth--;
+                break;
+            case MB_SEQUENCER_OP_BRANCH_IF_EQUAL:
+            case MB_SEQUENCER_OP_BRANCH_IF_NOT_EQUAL:
+                condition = (registers[operands[0]] & operands[1]) == operands[2];
+                if (program[pc] == MB_SEQUENCER_OP_BRANCH_IF_NOT_EQUAL){
+                    condition = !condition;
+                }
+                if (condition){
+                    pc = mb_sequencer_get_u16(&operands[3]);
+                    continue;
+                }
+                break;
+            case MB_SEQUENCER_OP_APPEND:
+                if ((*data_len + operands[1]) > data_size) return MB_STATUS_SEQUENCER_DATA_OVERFLOW;
+                memcpy(&data[*data_len], &registers[operands[0]], operands[1]);
+                *data_len += operands[1];
+                break;
+            default:
+                // rejected by mb_sequencer_verify
+                return MB_STATUS_SEQUENCER_INVALID_PROGRAM;
+        }
+        if (ok == false) return MB_STATUS_SEQUENCER_BUS_ERROR;
+        pc += len;
+    }
+    return MB_STATUS_OK;
+}
+
+// Program builder
+
+static uint8_t * mb_sequencer_program_reserve(mb_sequencer_program_t * program, uint16_t len){
+    if (program->overflow || ((program->len + len) > program->size)){
+        program->overflow = true;
+        return NULL;
+    }
+    uint8_t * instruction = &program->buffer[program->len];
+    program->len += len;
+    return instruction;
+}
+
+void mb_sequencer_program_init(mb_sequencer_program_t * program, uint8_t * buffer, uint16_t size){
+    assert(program != NULL);
+    program->buffer   = buffer;
+    program->size     = size;
+    program->len      = 0;
+    program->overflow = false;
+}
+
+uint16_t mb_sequencer_program_get_len(const mb_sequencer_program_t * program){
+    return program->overflow ? 0 : program->len;
+}
+
+static void mb_sequencer_program_add_i2c(mb_sequencer_program_t * program, mb_sequencer_op_t op, uint16_t address,
+                                         uint8_t len, const uint8_t * data){
+    uint8_t data_len = (data != NULL) ? len : 0;
+    uint8_t * instruction = mb_sequencer_program_reserve(program, 4 + data_len);
+    if (instruction == NULL) return;
+    instruction[0] = (uint8_t) op;
+    instruction[1] = (uint8_t) (address >> 8);
+    instruction[2] = (uint8_t) address;
+    instruction[3] = len;
+    if (data_len > 0){
+        memcpy(&instruction[4], data, data_len);
+    }
+}
+
+static void mb_sequencer_program_add_spi(mb_sequencer_program_t * program, mb_sequencer_op_t op, uint8_t chip_select_gpio,
+                                         uint8_t len, const uint8_t * data){
+    uint8_t data_len = (data != NULL) ? len : 0;
+    uint8_t * instruction = mb_sequencer_program_reserve(program, 3 + data_len);
+    if (instruction == NULL) return;
+    instruction[0] = (uint8_t) op;
+    instruction[1] = chip_select_gpio;
+    instruction[2] = len;
+    if (data_len > 0){
+        memcpy(&instruction[3], data, data_len);
+    }
+}
+
+void mb_sequencer_program_i2c_write(mb_sequencer_program_t * program, uint16_t address, uint8_t len, const uint8_t * data){
+    assert(data != NULL);
+    mb_sequencer_program_add_i2c(program, MB_SEQUENCER_OP_I2C_WRITE, address, len, data);
+}
+
+void mb_sequencer_program_i2c_read(mb_sequencer_program_t * program, uint16_t address, uint8_t len){
+    mb_sequencer_program_add_i2c(program, MB_SEQUENCER_OP_I2C_READ, address, len, NULL);
+}
+
+void mb_sequencer_program_spi_write(mb_sequencer_program_t * program, uint8_t chip_select_gpio, uint8_t len, const uint8_t * data){
+    assert(data != NULL);
+    mb_sequencer_program_add_spi(program, MB_SEQUENCER_OP_SPI_WRITE, chip_select_gpio, len, data);
+}
+
+void mb_sequencer_program_spi_read(mb_sequencer_program_t * program, uint8_t chip_select_gpio, uint8_t len){
+    mb_sequencer_program_add_spi(program, MB_SEQUENCER_OP_SPI_READ, chip_select_gpio, len, NULL);
+}
+
+void mb_sequencer_program_spi_transfer(mb_sequencer_program_t * program, uint8_t chip_select_gpio, uint8_t len, const uint8_t * data){
+    assert(data != NULL);
+    mb_sequencer_program_add_spi(program, MB_SEQUENCER_OP_SPI_TRANSFER, chip_select_gpio, len, data);
+}
+
+void mb_sequencer_program_delay(mb_sequencer_program_t * program, uint16_t ms){
+    uint8_t * instruction = mb_sequencer_program_reserve(program, 3);
+    if (instruction == NULL) return;
+    instruction[0] = MB_SEQUENCER_OP_DELAY;
+    instruction[1] = (uint8_t) (ms >> 8);
+    instruction[2] = (uint8_t) ms;
+}
+
+void mb_sequencer_program_loop(mb_sequencer_program_t * program, uint8_t count){
+    uint8_t * instruction = mb_sequencer_program_reserve(program, 2);
+    if (instruction == NULL) return;
+    instruction[0] = MB_SEQUENCER_OP_LOOP;
+    instruction[1] = count;
+}
+
+void mb_sequencer_program_loop_end(mb_sequencer_program_t * program){
+    uint8_t * instruction = mb_sequencer_program_reserve(program, 1);
+    if (instruction == NULL) return;
+    instruction[0] = MB_SEQUENCER_OP_LOOP_END;
+}
+
+void mb_sequencer_program_append(mb_sequencer_program_t * program, uint8_t reg, uint8_t len){
+    uint8_t * instruction = mb_sequencer_program_reserve(program, 3);
+    if (instruction == NULL) return;
+    instruction[0] = MB_SEQUENCER_OP_APPEND;
+    instruction[1] = reg;
+    instruction[2] = len;
+}
+
+void mb_sequencer_program_end(mb_sequencer_program_t * program){
+    uint8_t * instruction = mb_sequencer_program_reserve(program, 1);
+    if (instruction == NULL) return;
+    instruction[0] = MB_SEQUENCER_OP_END;
+}
+
+static uint16_t mb_sequencer_program_add_branch(mb_sequencer_program_t * program, mb_sequencer_op_t op, uint8_t reg,
+                                                uint8_t mask, uint8_t value, uint16_t target){
+    uint16_t branch = program->len;
+    uint8_t * instruction = mb_sequencer_program_reserve(program, 6);
+    if (instruction == NULL) return branch;
+    instruction[0] = (uint8_t) op;
+    instruction[1] = reg;
+    instruction[2] = mask;
+    instruction[3] = value;
+    instruction[4] = (uint8_t) (target >> 8);
+    instruction[5] = (uint8_t) target;
+    return branch;
+}
+
+uint16_t mb_sequencer_program_branch_if_equal(mb_sequencer_program_t * program, uint8_t reg, uint8_t mask, uint8_t value, uint16_t target){
+    return mb_sequencer_program_add_branch(program, MB_SEQUENCER_OP_BRANCH_IF_EQUAL, reg, mask, value, target);
+}
+
+uint16_t mb_sequencer_program_branch_if_not_equal(mb_sequencer_program_t * program, uint8_t reg, uint8_t mask, uint8_t value, uint16_t target){
+    return mb_sequencer_program_add_branch(program, MB_SEQUENCER_OP_BRANCH_IF_NOT_EQUAL, reg, mask, value, target);
+}
+
+void mb_sequencer_program_set_branch_target(mb_sequencer_program_t * program, uint16_t branch, uint16_t target){
+    if (program->overflow) return;
+    assert((branch + 6) <= program->len);
+    program->buffer[branch + 4] = (uint8_t) (target >> 8);
+    program->buffer[branch + 5] = (uint8_t) target;
+}
@@ -0,0 +1,162 @@
+/**
+ *
+ * Copyright 2022 Matthias Ringwald
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ * disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * MultiBus Sequencer
+ *
+ * Interpreter for small programs sent with a sequencer run_request, so that a complete device transaction (e.g.
+ * configure, wait, read) costs a single round trip. The same code is used by all bridges, buses are accessed via
+ * mb_sequencer_bus_t. Programs are verified before they are executed.
+ *
+ * Instructions start with an opcode, multi-byte operands are big endian. Data read from a device is stored in the
+ * register file at offset 0. Branches compare a register with a value after applying a mask and jump to an absolute
+ * program offset. Loops repeat the instructions up to the matching LOOP_END count times and can be nested.
+ * A branch target has to be the start of an instruction (or the end of the program) in the same loop as the branch.
+ * The number of executed instructions is limited by MB_SEQUENCER_MAX_STEPS. The sum of all delays, multiplied by the
+ * counts of the enclosing loops, is limited by MB_SEQUENCER_MAX_TOTAL_DELAY_MS during verification. As backward branches
+ * can repeat delays, the limit is checked again during execution.
+ */
+
+#ifndef MULTIBUS_SEQUENCER_H
+#define MULTIBUS_SEQUENCER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "multibus_protocol.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#define MB_SEQUENCER_NUM_REGISTERS  32
+#define MB_SEQUENCER_MAX_LOOP_DEPTH 4
+#define MB_SEQUENCER_MAX_STEPS      10000
+// below default timeout of host sync API
+#define MB_SEQUENCER_MAX_TOTAL_DELAY_MS 500
+
+typedef enum {
+    MB_SEQUENCER_OP_END                 = 0x00, // -
+    MB_SEQUENCER_OP_I2C_WRITE           = 0x01, // address:u16 len:u8 data[len]
+    MB_SEQUENCER_OP_I2C_READ            = 0x02, // address:u16 len:u8
+    MB_SEQUENCER_OP_SPI_WRITE           = 0x03, // chip_select_gpio:u8 len:u8 data[len]
+    MB_SEQUENCER_OP_SPI_READ            = 0x04, // chip_select_gpio:u8 len:u8
+    MB_SEQUENCER_OP_SPI_TRANSFER        = 0x05, // chip_select_gpio:u8 len:u8 data[len]
+    MB_SEQUENCER_OP_DELAY               = 0x06, // ms:u16
+    MB_SEQUENCER_OP_LOOP                = 0x07, // count:u8
+    MB_SEQUENCER_OP_LOOP_END            = 0x08, // -
+    MB_SEQUENCER_OP_BRANCH_IF_EQUAL     = 0x09, // register:u8 mask:u8 value:u8 target:u16
+    MB_SEQUENCER_OP_BRANCH_IF_NOT_EQUAL = 0x0a, // register:u8 mask:u8 value:u8 target:u16
+    MB_SEQUENCER_OP_APPEND              = 0x0b, // register:u8 len:u8, append registers to response data
+} mb_sequencer_op_t;
+
+typedef struct {
+    // return false if device does not acknowledge
+    bool (*i2c_write)(void * context, uint16_t address, const uint8_t * data, uint16_t len);
+    bool (*i2c_read)(void * context, uint16_t address, uint8_t * data, uint16_t len);
+    // full-duplex transfer with chip select active, tx_data or rx_data can be NULL
+    bool (*spi_transfer)(void * context, uint8_t chip_select_gpio, const uint8_t * tx_data, uint8_t * rx_data, uint16_t len);
+    // optional
+    void (*delay_ms)(void * context, uint32_t ms);
+} mb_sequencer_bus_t;
+
+typedef struct {
+    uint8_t * buffer;
+    uint16_t  size;
+    uint16_t  len;
+    bool      overflow;
+} mb_sequencer_program_t;
+
+/**
+ * @brief Verify program
+ * @param program
+ * @param program_len
+ * @return true if all instructions are complete and valid, loops are balanced, branch targets are valid, and the total
+ *         delay does not exceed MB_SEQUENCER_MAX_TOTAL_DELAY_MS
+ */
+bool mb_sequencer_verify(const uint8_t * program, uint16_t program_len);
+
+/**
+ * @brief Verify and execute program
+ * @param bus
+ * @param bus_context
+ * @param program
+ * @param program_len
+ * @param data buffer for appended registers
+ * @param data_size
+ * @param data_len of appended registers, also on error
+ * @return MB_STATUS_OK or MB_STATUS_SEQUENCER_* error
+ */
+mb_status_t mb_sequencer_run(const mb_sequencer_bus_t * bus, void * bus_context, const uint8_t * program, uint16_t program_len,
+                             uint8_t * data, uint16_t data_size, uint16_t * data_len);
+
+/**
+ * @brief Init program builder
+ * @param program
+ * @param buffer
+ * @param size
+ */
+void mb_sequencer_program_init(mb_sequencer_program_t * program, uint8_t * buffer, uint16_t size);
+
+/**
+ * @brief Get program len
+ * @param program
+ * @return len, 0 if the program did not fit into the buffer
+ */
+uint16_t mb_sequencer_program_get_len(const mb_sequencer_program_t * program);
+
+void mb_sequencer_program_i2c_write(mb_sequencer_program_t * program, uint16_t address, uint8_t len, const uint8_t * data);
+void mb_sequencer_program_i2c_read(mb_sequencer_program_t * program, uint16_t address, uint8_t len);
+void mb_sequencer_program_spi_write(mb_sequencer_program_t * program, uint8_t chip_select_gpio, uint8_t len, const uint8_t * data);
+void mb_sequencer_program_spi_read(mb_sequencer_program_t * program, uint8_t chip_select_gpio, uint8_t len);
+void mb_sequencer_program_spi_transfer(mb_sequencer_program_t * program, uint8_t chip_select_gpio, uint8_t len, const uint8_t * data);
+void mb_sequencer_program_delay(mb_sequencer_program_t * program, uint16_t ms);
+void mb_sequencer_program_loop(mb_sequencer_program_t * program, uint8_t count);
+void mb_sequencer_program_loop_end(mb_sequencer_program_t * program);
+void mb_sequencer_program_append(mb_sequencer_program_t * program, uint8_t reg, uint8_t len);
+void mb_sequencer_program_end(mb_sequencer_program_t * program);
+
+/**
+ * @brief Add branch, jumps to target if (registers[reg] & mask) == value, or != for branch_if_not_equal
+ * @param program
+ * @param reg
+ * @param mask
+ * @param value
+ * @param target offset of instruction, e.g. current len, see mb_sequencer_program_set_branch_target for forward branches
+ * @return offset of branch instruction
+ */
+uint16_t mb_sequencer_program_branch_if_equal(mb_sequencer_program_t * program, uint8_t reg, uint8_t mask, uint8_t value, uint16_t target);
+uint16_t mb_sequencer_program_branch_if_not_equal(mb_sequencer_program_t * program, uint8_t reg, uint8_t mask, uint8_t value, uint16_t target);
+
+/**
+ * @brief Update target of branch
+ * @param program
+ * @param branch offset returned by mb_sequencer_program_branch_if_*
+ * @param target
+ */
+void mb_sequencer_program_set_branch_target(mb_sequencer_program_t * program, uint16_t branch, uint16_t target);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif //MULTIBUS_SEQUENCER_H
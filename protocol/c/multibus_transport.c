@@ -27,6 +27,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include "multibus_transport.h"
@@ -56,47 +57,446 @@ int nibble_for_char(char c){
 }
 
 void printf_hexdump(const void * data, int size){
-    char buffer[4];
-    buffer[2] = ' ';
-    buffer[3] =  0;
+    // format up to 32 bytes per printf
+    char buffer[32 * 3 + 1];
     const uint8_t * ptr = (const uint8_t *) data;
+    int pos = 0;
     while (size > 0){
         uint8_t byte = *ptr++;
-        buffer[0] = char_for_high_nibble(byte);
-        buffer[1] = char_for_low_nibble(byte);
-        printf("%s", buffer);
+        buffer[pos++] = char_for_high_nibble(byte);
+        buffer[pos++] = char_for_low_nibble(byte);
+        buffer[pos++] = ' ';
         size--;
+        if ((pos == (int) (sizeof(buffer) - 1)) || (size == 0)){
+            buffer[pos] = 0;
+            printf("%s", buffer);
+            pos = 0;
+        }
     }
     printf("\n");
 }
 
+static void mb_transport_capture(mb_transport_t * transport, mb_capture_type_t type,
+                                 const mb_driver_block_t * blocks, uint8_t num_blocks){
+    if (transport->capture == NULL) return;
+    uint32_t timestamp_us = (transport->get_time_us != NULL) ? transport->get_time_us() : 0;
+    (void) mb_capture_record(transport->capture, timestamp_us, type, blocks, num_blocks);
+}
+
+static void mb_transport_log_request(mb_transport_t * transport, const uint8_t * buffer, uint16_t size){
+    if (transport->capture != NULL){
+        mb_driver_block_t block;
+        block.data = buffer;
+        block.len  = size;
+        mb_transport_capture(transport, MB_CAPTURE_TYPE_SENT, &block, 1);
+    }
+    if (transport->dump_messages ) {
+        printf("Serial-Request:\n");
+        printf("- Header: ");
+        printf_hexdump(buffer, MB_HEADER_SIZE);
+        printf("- Payload: ");
+        printf_hexdump(&buffer[MB_HEADER_SIZE], size - MB_HEADER_SIZE);
+    }
+}
+
+// Statistics
+
+static mb_transport_operation_stats_t * mb_transport_stats_for_operation(mb_transport_t * transport, uint8_t component, uint8_t operation){
+    uint8_t operation_id = operation & 0x7f;
+    if (component >= MB_COMPONENT_ID_LIMIT) return NULL;
+    if (operation_id >= MB_OPERATION_ID_LIMIT) return NULL;
+    return &transport->stats->operations[component][operation_id];
+}
+
+static uint16_t mb_transport_send_queue_used(mb_transport_t * transport){
+    if (transport->send_queue_wrap == 0){
+        return transport->send_queue_tail - transport->send_queue_head;
+    }
+    return (transport->send_queue_wrap - transport->send_queue_head) + transport->send_queue_tail;
+}
+
+static void mb_transport_stats_request(mb_transport_t * transport, const uint8_t * header, uint16_t size){
+    mb_transport_stats_t * stats = transport->stats;
+    if (stats == NULL) return;
+    stats->messages_sent++;
+    stats->bytes_sent += size;
+    mb_transport_operation_stats_t * operation_stats =
+            mb_transport_stats_for_operation(transport, mb_header_get_component(header), mb_header_get_operation(header));
+    if (operation_stats != NULL){
+        operation_stats->requests++;
+        operation_stats->bytes_sent += size;
+    }
+    if (transport->requests != NULL){
+        if (transport->requests_count > stats->pending_requests_max){
+            stats->pending_requests_max = transport->requests_count;
+        }
+        uint16_t send_queue_used = mb_transport_send_queue_used(transport);
+        if (send_queue_used > stats->send_queue_used_max){
+            stats->send_queue_used_max = send_queue_used;
+        }
+    }
+}
+
+static void mb_transport_stats_response(mb_transport_t * transport, const mb_message_t * message, bool rtt_valid, uint32_t sent_us){
+    mb_transport_stats_t * stats = transport->stats;
+    if (stats == NULL) return;
+    uint16_t size = MB_HEADER_SIZE + message->payload_len;
+    stats->messages_received++;
+    stats->bytes_received += size;
+    mb_transport_operation_stats_t * operation_stats =
+            mb_transport_stats_for_operation(transport, message->component, message->operation);
+    uint8_t status;
+    bool error = mb_message_get_status(message, &status) && (status != MB_STATUS_OK);
+    if (error){
+        stats->status_errors[status]++;
+    }
+    if (operation_stats == NULL) return;
+    operation_stats->responses++;
+    operation_stats->bytes_received += size;
+    if (error){
+        operation_stats->errors++;
+    }
+    if (rtt_valid && (transport->get_time_us != NULL)){
+        // log2 bucket
+        uint32_t rtt_us = transport->get_time_us() - sent_us;
+        uint8_t bucket = 0;
+        while ((rtt_us > 1) && (bucket < (MB_TRANSPORT_STATS_RTT_BUCKETS - 1))){
+            rtt_us >>= 1;
+            bucket++;
+        }
+        operation_stats->rtt_histogram[bucket]++;
+    }
+}
+
+static void mb_transport_stats_timeout(mb_transport_t * transport, const mb_transport_request_t * request, bool retry){
+    mb_transport_stats_t * stats = transport->stats;
+    if (stats == NULL) return;
+    if (retry){
+        stats->retries++;
+        return;
+    }
+    stats->timeouts++;
+    mb_transport_operation_stats_t * operation_stats =
+            mb_transport_stats_for_operation(transport, request->component, request->operation);
+    if (operation_stats != NULL){
+        operation_stats->timeouts++;
+    }
+}
+
+static uint32_t mb_transport_get_send_time(mb_transport_t * transport){
+    if (transport->get_time_us == NULL) return 0;
+    if (transport->stats == NULL) return 0;
+    return transport->get_time_us();
+}
+
+// per-request timeout, set by mb_transport_set_next_request_timeout for the next request only
+static uint32_t mb_transport_take_request_timeout(mb_transport_t * transport){
+    uint32_t timeout_us = transport->timeout_us;
+    if (transport->next_timeout_us > 0){
+        timeout_us = transport->next_timeout_us;
+        transport->next_timeout_us = 0;
+    }
+    return timeout_us;
+}
+
+// Pipelining: send queue
+
+static uint8_t * mb_transport_send_queue_reserve(mb_transport_t * transport, uint16_t size){
+    uint16_t offset;
+    if (transport->send_queue_wrap == 0){
+        // not wrapped: data in [head, tail)
+        if ((transport->send_queue_size - transport->send_queue_tail) >= size){
+            offset = transport->send_queue_tail;
+        } else if (size <= transport->send_queue_head){
+            offset = 0;
+        } else {
+            return NULL;
+        }
+    } else {
+        // wrapped: data in [head, wrap) and [0, tail)
+        if ((transport->send_queue_head - transport->send_queue_tail) >= size){
+            offset = transport->send_queue_tail;
+        } else {
+            return NULL;
+        }
+    }
+    return &transport->send_queue_storage[offset];
+}
+
+static void mb_transport_send_queue_commit(mb_transport_t * transport, const uint8_t * buffer, uint16_t size){
+    uint16_t offset = (uint16_t) (buffer - transport->send_queue_storage);
+    if ((offset == 0) && (transport->send_queue_tail > 0) && (transport->send_queue_wrap == 0)){
+        transport->send_queue_wrap = transport->send_queue_tail;
+    }
+    transport->send_queue_tail = offset + size;
+}
+
+static void mb_transport_send_queue_free(mb_transport_t * transport, const mb_transport_request_t * request){
+    if (request->queue_len == 0) return;
+    transport->send_queue_head = request->queue_offset + request->queue_len;
+    if (transport->send_queue_head == transport->send_queue_wrap){
+        transport->send_queue_head = 0;
+        transport->send_queue_wrap = 0;
+    }
+    // queue empty, start at offset 0 again, also if requests without queue data are still pending
+    if ((transport->send_queue_wrap == 0) && (transport->send_queue_head == transport->send_queue_tail)){
+        transport->send_queue_head = 0;
+        transport->send_queue_tail = 0;
+    }
+}
+
+// Pipelining: request table
+
+static void mb_transport_retire_requests(mb_transport_t * transport){
+    // free completed requests in order of submission
+    uint16_t num_done = 0;
+    while ((num_done < transport->requests_count) && (transport->requests[num_done].state == MB_TRANSPORT_REQUEST_DONE)){
+        mb_transport_send_queue_free(transport, &transport->requests[num_done]);
+        num_done++;
+    }
+    if (num_done == 0) return;
+    transport->requests_count -= num_done;
+    memmove(&transport->requests[0], &transport->requests[num_done], transport->requests_count * sizeof(mb_transport_request_t));
+    if (transport->requests_count == 0){
+        transport->send_queue_head = 0;
+        transport->send_queue_tail = 0;
+        transport->send_queue_wrap = 0;
+    }
+}
+
+static uint16_t mb_transport_trailer_size(mb_transport_t * transport){
+    return (transport->protocol_version >= MB_TRAILER_VERSION) ? MB_TRAILER_SIZE : 0;
+}
+
+static uint8_t mb_transport_next_tag(mb_transport_t * transport){
+    // skip tag 0, which is used for unsolicited messages, and tags of pending requests
+    while (true){
+        transport->next_tag++;
+        if (transport->next_tag == 0) continue;
+        uint16_t i;
+        for (i = 0; i < transport->requests_count; i++){
+            if (transport->requests[i].tag == transport->next_tag) break;
+        }
+        if (i == transport->requests_count) return transport->next_tag;
+    }
+}
+
+static mb_transport_request_t * mb_transport_find_request(mb_transport_t * transport, uint8_t component, uint8_t operation,
+                                                          bool tagged, uint8_t tag){
+    uint16_t i;
+    if (tagged && (tag == 0)) return NULL;
+    for (i = 0; i < transport->requests_count; i++){
+        mb_transport_request_t * request = &transport->requests[i];
+        if ((request->state != MB_TRANSPORT_REQUEST_SENDING) && (request->state != MB_TRANSPORT_REQUEST_SENT)) continue;
+        if (tagged && (request->tag != tag)) continue;
+        if (request->component != component) continue;
+        // response operation = request operation | 0x80
+        if ((request->operation | 0x80) != operation) continue;
+        return request;
+    }
+    return NULL;
+}
+
+static void mb_transport_send_next(mb_transport_t * transport){
+    if (transport->tx_state != MB_TRANSPORT_TX_IDLE) return;
+    if (transport->send_queue_corked) return;
+
+    // find first queued request
+    uint16_t i;
+    for (i = 0; i < transport->requests_count; i++){
+        if (transport->requests[i].state == MB_TRANSPORT_REQUEST_QUEUED) break;
+    }
+    if (i == transport->requests_count) return;
+
+    // collect consecutive queued requests that are stored back-to-back
+    uint32_t sent_us = mb_transport_get_send_time(transport);
+    uint16_t offset = transport->requests[i].queue_offset;
+    uint16_t len    = 0;
+    for (; i < transport->requests_count; i++){
+        mb_transport_request_t * request = &transport->requests[i];
+        if (request->state != MB_TRANSPORT_REQUEST_QUEUED) break;
+        if (request->queue_offset != (offset + len)) break;
+        // framed requests are logged on commit
+        if (transport->framing_mode == MB_BRIDGE_FRAMING_REQUEST_MODE_NONE){
+            mb_transport_log_request(transport, &transport->send_queue_storage[request->queue_offset], request->queue_len);
+        }
+        request->state   = MB_TRANSPORT_REQUEST_SENDING;
+        request->sent_us = sent_us;
+        len += request->queue_len;
+    }
+
+    transport->tx_state = MB_TRANSPORT_TX_BUSY;
+    transport->driver_impl->send_block(transport->driver_context, &transport->send_queue_storage[offset], len);
+}
+
 static inline void mb_transport_block_sent(void * context){
     mb_transport_t * transport = (mb_transport_t *) context;
     assert(transport->tx_state == MB_TRANSPORT_TX_BUSY);
     transport->tx_state = MB_TRANSPORT_TX_IDLE;
+    if (transport->requests == NULL) return;
+    uint32_t now_us = 0;
+    if (transport->timeout_us > 0){
+        now_us = transport->get_time_us();
+    }
+    uint16_t i;
+    for (i = 0; i < transport->requests_count; i++){
+        mb_transport_request_t * request = &transport->requests[i];
+        if (request->state == MB_TRANSPORT_REQUEST_SENDING){
+            request->state = MB_TRANSPORT_REQUEST_SENT;
+            request->deadline_us = (transport->timeout_us > 0) ? (now_us + request->timeout_us) : 0;
+        }
+    }
+    mb_transport_send_next(transport);
 }
 
 static void mb_transport_start_reading(mb_transport_t * transport){
+    if (transport->receive_ring_storage != NULL){
+        transport->driver_impl->receive_bytes(transport->driver_context,
+                                              &transport->receive_ring_storage[transport->receive_ring_write],
+                                              transport->receive_ring_size - transport->receive_ring_write);
+        return;
+    }
     transport->rx_state = MB_TRANSPORT_RX_W4_HEADER;
     transport->driver_impl->receive_block(transport->driver_context, transport->receive_header, MB_HEADER_SIZE);
 }
 
-static void mb_transport_message_received(mb_transport_t * transport){
+static void mb_transport_message_received(mb_transport_t * transport, const uint8_t * header, const uint8_t * payload){
     assert(transport->callback_handler != NULL);
     mb_message_t message;
-    message.channel      = mb_header_get_channel(transport->receive_header);
-    message.component    = mb_header_get_component(transport->receive_header);
-    message.operation    = mb_header_get_operation(transport->receive_header);
-    message.payload_len  = mb_header_get_length(transport->receive_header);
-    message.payload_data = transport->receive_buffer_storage;
+    message.channel      = mb_header_get_channel(header);
+    message.component    = mb_header_get_component(header);
+    message.operation    = mb_header_get_operation(header);
+    message.payload_len  = mb_header_get_length(header);
+    message.payload_data = payload;
+    if (transport->capture != NULL){
+        mb_driver_block_t blocks[2];
+        blocks[0].data = header;
+        blocks[0].len  = MB_HEADER_SIZE;
+        blocks[1].data = payload;
+        blocks[1].len  = message.payload_len;
+        mb_transport_capture(transport, MB_CAPTURE_TYPE_RECEIVED, blocks, 2);
+    }
     if (transport->dump_messages ){
         printf("Serial-Response:\n");
         printf("- Header: ");
-        printf_hexdump(transport->receive_header, MB_HEADER_SIZE);
+        printf_hexdump(header, MB_HEADER_SIZE);
         printf("- Payload: ");
-        printf_hexdump(transport->receive_buffer_storage, message.payload_len);
+        printf_hexdump(payload, message.payload_len);
+    }
+
+    // strip trailer
+    uint16_t trailer_size = mb_transport_trailer_size(transport);
+    bool     tagged = false;
+    uint8_t  tag = 0;
+    if ((trailer_size > 0) && (message.payload_len >= trailer_size)){
+        message.payload_len -= trailer_size;
+        tag    = mb_trailer_get_tag(&payload[message.payload_len]);
+        tagged = true;
     }
-    transport->callback_handler(transport->callback_context, &message);
+
+    void (*callback_handler)(void * context, const mb_message_t * message) = transport->callback_handler;
+    void * callback_context = transport->callback_context;
+    bool     rtt_valid = false;
+    uint32_t sent_us   = 0;
+    if (mb_message_is_event(&message)){
+        // events are sent by the bridge without request
+        if (transport->stats != NULL){
+            transport->stats->events++;
+        }
+    } else if (transport->requests != NULL){
+        mb_transport_request_t * request = mb_transport_find_request(transport, message.component, message.operation, tagged, tag);
+        if (request != NULL){
+            if (request->callback_handler != NULL){
+                callback_handler = request->callback_handler;
+                callback_context = request->callback_context;
+            }
+            rtt_valid = true;
+            sent_us   = request->sent_us;
+            request->state = MB_TRANSPORT_REQUEST_DONE;
+            mb_transport_retire_requests(transport);
+        } else if (transport->stats != NULL){
+            transport->stats->unsolicited_messages++;
+        }
+    } else {
+        rtt_valid = true;
+        sent_us   = transport->send_time_us;
+    }
+    mb_transport_stats_response(transport, &message, rtt_valid, sent_us);
+    transport->receive_tag = tag;
+    callback_handler(callback_context, &message);
+}
+
+static void mb_transport_framing_error(mb_transport_t * transport){
+    if (transport->stats != NULL){
+        transport->stats->framing_errors++;
+    }
+}
+
+static void mb_transport_bytes_received(void * context, uint16_t num_bytes){
+    mb_transport_t * transport = (mb_transport_t *) context;
+    transport->receive_ring_write += num_bytes;
+
+    // deliver all complete frames, framing can be changed by the callback
+    while (true){
+        uint16_t bytes_available = transport->receive_ring_write - transport->receive_ring_read;
+        if (transport->framing_mode == MB_BRIDGE_FRAMING_REQUEST_MODE_COBS_CRC16){
+            uint8_t * frame = &transport->receive_ring_storage[transport->receive_ring_read];
+            uint8_t * delimiter = (uint8_t *) memchr(frame, MB_FRAMING_DELIMITER, bytes_available);
+            if (delimiter == NULL) break;
+            uint16_t frame_len = (uint16_t) (delimiter - frame);
+            transport->receive_ring_read += frame_len + 1;
+            if (transport->receive_ring_discarding){
+                // end of frame that did not fit into ring
+                transport->receive_ring_discarding = false;
+                mb_transport_framing_error(transport);
+                continue;
+            }
+            if (frame_len == 0) continue;
+            if (mb_framing_decode(frame, frame_len) == 0){
+                mb_transport_framing_error(transport);
+                continue;
+            }
+            mb_transport_message_received(transport, frame, &frame[MB_HEADER_SIZE]);
+            continue;
+        }
+        if (transport->receive_ring_skip > 0){
+            // drop rest of message that did not fit into ring
+            uint16_t bytes_to_skip = bytes_available;
+            if (bytes_to_skip > transport->receive_ring_skip){
+                bytes_to_skip = (uint16_t) transport->receive_ring_skip;
+            }
+            transport->receive_ring_read += bytes_to_skip;
+            transport->receive_ring_skip -= bytes_to_skip;
+            if (transport->receive_ring_skip > 0) break;
+            continue;
+        }
+        if (bytes_available < MB_HEADER_SIZE) break;
+        const uint8_t * header = &transport->receive_ring_storage[transport->receive_ring_read];
+        uint32_t frame_len = MB_HEADER_SIZE + (uint32_t) mb_header_get_length(header);
+        if (frame_len > transport->receive_ring_size){
+            // message can never be delivered, skip it to stay in sync with the stream
+            mb_transport_framing_error(transport);
+            transport->receive_ring_skip = frame_len;
+            continue;
+        }
+        if (bytes_available < frame_len) break;
+        transport->receive_ring_read += (uint16_t) frame_len;
+        mb_transport_message_received(transport, header, &header[MB_HEADER_SIZE]);
+    }
+
+    // move partial frame to start of ring, drop frame without delimiter if ring is full
+    uint16_t bytes_remaining = transport->receive_ring_write - transport->receive_ring_read;
+    if ((transport->framing_mode != MB_BRIDGE_FRAMING_REQUEST_MODE_NONE) && (bytes_remaining == transport->receive_ring_size)){
+        transport->receive_ring_discarding = true;
+        bytes_remaining = 0;
+    }
+    if (bytes_remaining > 0){
+        memmove(transport->receive_ring_storage, &transport->receive_ring_storage[transport->receive_ring_read], bytes_remaining);
+    }
+    transport->receive_ring_read  = 0;
+    transport->receive_ring_write = bytes_remaining;
+
+    mb_transport_start_reading(transport);
 }
 
 static inline void mb_transport_block_received(void * context){
@@ -108,7 +508,7 @@ static inline void mb_transport_block_received(void * context){
         case MB_TRANSPORT_RX_W4_HEADER:
             payload_len = mb_header_get_length(transport->receive_header);
             if (payload_len == 0){
-                mb_transport_message_received(transport);
+                mb_transport_message_received(transport, transport->receive_header, transport->receive_buffer_storage);
                 mb_transport_start_reading(transport);
             } else {
                 transport->rx_state = MB_TRANSPORT_WX_W4_PAYLOAD;
@@ -118,7 +518,7 @@ static inline void mb_transport_block_received(void * context){
             }
             break;
         case MB_TRANSPORT_WX_W4_PAYLOAD:
-            mb_transport_message_received(transport);
+            mb_transport_message_received(transport, transport->receive_header, transport->receive_buffer_storage);
             mb_transport_start_reading(transport);
             break;
         default:
@@ -149,11 +549,36 @@ void mb_transport_create(mb_transport_t * transport, const mb_driver_t * driver_
     transport->send_buffer_storage    = send_buffer_storage;
     transport->receive_buffer_size    = receive_buffer_size;
     transport->receive_buffer_storage = receive_buffer_storage;
+    transport->receive_ring_storage   = NULL;
+    transport->receive_ring_size      = 0;
+    transport->framing_mode           = MB_BRIDGE_FRAMING_REQUEST_MODE_NONE;
+    transport->protocol_version       = 0;
+    transport->next_tag               = 0;
+    transport->receive_tag            = 0;
 
     // state
     transport->tx_state = MB_TRANSPORT_TX_IDLE;
     transport->rx_state = MB_TRANSPORT_RX_IDLE;
 
+    // pipelining disabled
+    transport->requests           = NULL;
+    transport->requests_max       = 0;
+    transport->requests_count     = 0;
+    transport->send_queue_storage = NULL;
+    transport->send_queue_size    = 0;
+
+    // timeouts disabled
+    transport->get_time_us     = NULL;
+    transport->timeout_us      = 0;
+    transport->next_timeout_us = 0;
+    transport->timeout_retries = 0;
+    transport->timeout_handler = NULL;
+
+    // statistics disabled
+    transport->stats        = NULL;
+    transport->send_time_us = 0;
+
+    transport->capture       = NULL;
     transport->dump_messages = false;
 
     // register with driver
@@ -165,6 +590,160 @@ void mb_transport_enable_logging(mb_transport_t * transport){
     transport->dump_messages = true;
 }
 
+void mb_transport_enable_pipelining(mb_transport_t * transport,
+                                    mb_transport_request_t * request_storage, uint16_t max_requests,
+                                    uint8_t * send_queue_storage, uint16_t send_queue_size){
+    assert(transport != NULL);
+    assert(request_storage != NULL);
+    assert(max_requests > 0);
+    assert(send_queue_storage != NULL);
+    assert(transport->tx_state == MB_TRANSPORT_TX_IDLE);
+    transport->requests           = request_storage;
+    transport->requests_max       = max_requests;
+    transport->requests_count     = 0;
+    transport->send_queue_storage = send_queue_storage;
+    transport->send_queue_size    = send_queue_size;
+    transport->send_queue_head    = 0;
+    transport->send_queue_tail    = 0;
+    transport->send_queue_wrap    = 0;
+    transport->send_queue_reserved = 0;
+    transport->send_queue_corked  = false;
+}
+
+void mb_transport_enable_receive_ring(mb_transport_t * transport, uint8_t * receive_ring_storage, uint16_t receive_ring_size){
+    assert(transport != NULL);
+    assert(receive_ring_storage != NULL);
+    assert(receive_ring_size >= MB_HEADER_SIZE);
+    assert(transport->driver_impl->receive_bytes != NULL);
+    assert(transport->driver_impl->set_bytes_received != NULL);
+    transport->receive_ring_storage = receive_ring_storage;
+    transport->receive_ring_size    = receive_ring_size;
+    transport->receive_ring_read    = 0;
+    transport->receive_ring_write   = 0;
+    transport->receive_ring_discarding = false;
+    transport->receive_ring_skip    = 0;
+    transport->driver_impl->set_bytes_received(transport->driver_context, &mb_transport_bytes_received, transport);
+}
+
+void mb_transport_set_framing(mb_transport_t * transport, mb_bridge_framing_request_mode_t framing_mode){
+    assert(transport != NULL);
+    assert(transport->requests != NULL);
+    assert(transport->receive_ring_storage != NULL);
+    assert(transport->requests_count == 0);
+    transport->framing_mode = framing_mode;
+    transport->receive_ring_discarding = false;
+    transport->receive_ring_skip = 0;
+}
+
+void mb_transport_set_protocol_version(mb_transport_t * transport, uint16_t protocol_version){
+    assert(transport != NULL);
+    assert(transport->requests != NULL);
+    assert(transport->requests_max < 255);
+    assert(transport->requests_count == 0);
+    transport->protocol_version = protocol_version;
+    transport->next_tag = 0;
+}
+
+uint8_t mb_transport_get_request_tag(mb_transport_t * transport){
+    assert(transport != NULL);
+    if (mb_transport_trailer_size(transport) == 0) return 0;
+    return transport->next_tag;
+}
+
+uint8_t mb_transport_get_receive_tag(mb_transport_t * transport){
+    assert(transport != NULL);
+    return transport->receive_tag;
+}
+
+void mb_transport_set_time_source(mb_transport_t * transport, uint32_t (*get_time_us)(void)){
+    assert(transport != NULL);
+    transport->get_time_us = get_time_us;
+}
+
+void mb_transport_enable_timeouts(mb_transport_t * transport, uint32_t timeout_ms, uint8_t num_retries,
+                                  void (*timeout_handler)(void * context, const mb_transport_request_t * request),
+                                  void * timeout_context){
+    assert(transport != NULL);
+    assert(transport->requests != NULL);
+    assert(transport->get_time_us != NULL);
+    assert(timeout_ms > 0);
+    assert(timeout_ms <= (INT32_MAX / 1000));
+    transport->timeout_us      = timeout_ms * 1000;
+    transport->timeout_retries = num_retries;
+    transport->timeout_handler = timeout_handler;
+    transport->timeout_context = timeout_context;
+}
+
+void mb_transport_set_next_request_timeout(mb_transport_t * transport, uint32_t timeout_ms){
+    assert(transport != NULL);
+    assert(transport->timeout_us > 0);
+    assert(timeout_ms > 0);
+    assert(timeout_ms <= (INT32_MAX / 1000));
+    transport->next_timeout_us = timeout_ms * 1000;
+}
+
+uint32_t mb_transport_get_next_timeout_ms(mb_transport_t * transport){
+    assert(transport != NULL);
+    if (transport->timeout_us == 0) return MB_TRANSPORT_NO_TIMEOUT;
+
+    // find earliest deadline
+    uint32_t now_us = transport->get_time_us();
+    int32_t  next_us = INT32_MAX;
+    bool     found = false;
+    uint16_t i;
+    for (i = 0; i < transport->requests_count; i++){
+        const mb_transport_request_t * request = &transport->requests[i];
+        if (request->state != MB_TRANSPORT_REQUEST_SENT) continue;
+        int32_t remaining_us = (int32_t) (request->deadline_us - now_us);
+        if (remaining_us < next_us){
+            next_us = remaining_us;
+        }
+        found = true;
+    }
+    if (found == false) return MB_TRANSPORT_NO_TIMEOUT;
+    if (next_us <= 0) return 0;
+    // round up
+    return ((uint32_t) next_us + 999) / 1000;
+}
+
+void mb_transport_process_timeouts(mb_transport_t * transport){
+    assert(transport != NULL);
+    if (transport->timeout_us == 0) return;
+
+    uint32_t now_us = transport->get_time_us();
+    bool     retry = false;
+    uint16_t i = 0;
+    while (i < transport->requests_count){
+        mb_transport_request_t * request = &transport->requests[i];
+        if ((request->state != MB_TRANSPORT_REQUEST_SENT) || ((int32_t) (request->deadline_us - now_us) > 0)){
+            i++;
+            continue;
+        }
+        // retry if request is stored in send queue
+        if ((request->retries_left > 0) && (request->queue_len > 0)){
+            request->retries_left--;
+            request->state = MB_TRANSPORT_REQUEST_QUEUED;
+            mb_transport_stats_timeout(transport, request, true);
+            retry = true;
+            i++;
+            continue;
+        }
+        // drop request
+        mb_transport_request_t expired_request = *request;
+        request->state = MB_TRANSPORT_REQUEST_DONE;
+        mb_transport_retire_requests(transport);
+        mb_transport_stats_timeout(transport, &expired_request, false);
+        if (transport->timeout_handler != NULL){
+            transport->timeout_handler(transport->timeout_context, &expired_request);
+        }
+        // request table might have changed, start over
+        i = 0;
+    }
+    if (retry){
+        mb_transport_send_next(transport);
+    }
+}
+
 // Async Interface
 
 void mb_transport_register_callback(mb_transport_t * transport,
@@ -188,15 +767,261 @@ bool  mb_transport_send(mb_transport_t * transport, const uint8_t * buffer, uint
     assert(buffer != NULL);
     assert(size >= MB_HEADER_SIZE);
     assert(transport != NULL);
-    assert(transport->tx_state == MB_TRANSPORT_TX_IDLE);
-    if (transport->dump_messages ) {
-        printf("Serial-Request:\n");
-        printf("- Header: ");
-        printf_hexdump(buffer, MB_HEADER_SIZE);
-        printf("- Payload: ");
-        printf_hexdump(&buffer[MB_HEADER_SIZE], size - MB_HEADER_SIZE);
+    if (transport->requests != NULL){
+        return mb_transport_send_request(transport, buffer, size, NULL, NULL);
     }
+    assert(transport->tx_state == MB_TRANSPORT_TX_IDLE);
+    mb_transport_log_request(transport, buffer, size);
+    mb_transport_stats_request(transport, buffer, size);
+    transport->send_time_us = mb_transport_get_send_time(transport);
     transport->tx_state = MB_TRANSPORT_TX_BUSY;
     transport->driver_impl->send_block(transport->driver_context, buffer, size);
     return true;
 }
+
+/**
+ * @brief Queue request and register callback for its response
+ * @note requires pipelining
+ * @param transport
+ * @param buffer
+ * @param size
+ * @param callback_handler for response, NULL uses transport callback
+ * @param callback_context
+ * @return ok, false if send queue or request table is full
+ */
+bool  mb_transport_send_request(mb_transport_t * transport, const uint8_t * buffer, uint16_t size,
+                                void (*callback_handler)(void * context, const mb_message_t * message),
+                                void * callback_context){
+    assert(buffer != NULL);
+    assert(size >= MB_HEADER_SIZE);
+    assert(transport != NULL);
+    assert(transport->requests != NULL);
+
+    uint8_t * queue_buffer = mb_transport_reserve(transport, size);
+    if (queue_buffer == NULL) return false;
+    memcpy(queue_buffer, buffer, size);
+    return mb_transport_commit_request(transport, size, callback_handler, callback_context);
+}
+
+static bool mb_transport_send_blocks_ready(mb_transport_t * transport){
+    if (transport->driver_impl->send_blocks == NULL) return false;
+    if (transport->tx_state != MB_TRANSPORT_TX_IDLE) return false;
+    // logging requires contiguous request
+    if (transport->dump_messages) return false;
+    // framing requires contiguous request
+    if (transport->framing_mode != MB_BRIDGE_FRAMING_REQUEST_MODE_NONE) return false;
+    if (transport->requests == NULL) return true;
+    if (transport->send_queue_corked) return false;
+    if (transport->requests_count >= transport->requests_max) return false;
+    uint16_t i;
+    for (i = 0; i < transport->requests_count; i++){
+        if (transport->requests[i].state == MB_TRANSPORT_REQUEST_QUEUED) return false;
+    }
+    return true;
+}
+
+bool  mb_transport_send_blocks(mb_transport_t * transport, const mb_driver_block_t * blocks, uint8_t num_blocks){
+    assert(transport != NULL);
+    assert(blocks != NULL);
+    assert(num_blocks > 0);
+    assert(num_blocks <= MB_DRIVER_MAX_BLOCKS);
+    assert(blocks[0].len >= MB_HEADER_SIZE);
+
+    uint32_t size = 0;
+    uint8_t i;
+    for (i = 0; i < num_blocks; i++){
+        size += blocks[i].len;
+    }
+    assert(size <= UINT16_MAX);
+
+    uint16_t trailer_size = mb_transport_trailer_size(transport);
+    if (mb_transport_send_blocks_ready(transport) && (blocks[0].len <= transport->send_buffer_size) &&
+        ((trailer_size == 0) || (num_blocks < MB_DRIVER_MAX_BLOCKS))){
+        // copy first block into send buffer, send others in place
+        mb_driver_block_t driver_blocks[MB_DRIVER_MAX_BLOCKS];
+        uint8_t num_driver_blocks = num_blocks;
+        memcpy(transport->send_buffer_storage, blocks[0].data, blocks[0].len);
+        driver_blocks[0].data = transport->send_buffer_storage;
+        driver_blocks[0].len  = blocks[0].len;
+        for (i = 1; i < num_blocks; i++){
+            driver_blocks[i] = blocks[i];
+        }
+        // add trailer as separate block and update length in header copy
+        uint8_t tag = 0;
+        if (trailer_size > 0){
+            tag = mb_transport_next_tag(transport);
+            mb_header_setup(transport->send_buffer_storage, (mb_component_t) mb_header_get_component(blocks[0].data),
+                            mb_header_get_operation(blocks[0].data), mb_header_get_channel(blocks[0].data),
+                            mb_header_get_length(blocks[0].data) + trailer_size);
+            mb_trailer_setup(transport->send_trailer, tag);
+            driver_blocks[num_driver_blocks].data = transport->send_trailer;
+            driver_blocks[num_driver_blocks].len  = trailer_size;
+            num_driver_blocks++;
+            size += trailer_size;
+        }
+        if (transport->requests != NULL){
+            // request is not stored in send queue
+            mb_transport_request_t * request = &transport->requests[transport->requests_count++];
+            request->component        = mb_header_get_component(blocks[0].data);
+            request->operation        = mb_header_get_operation(blocks[0].data);
+            request->tag              = tag;
+            request->state            = MB_TRANSPORT_REQUEST_SENDING;
+            request->queue_offset     = 0;
+            request->queue_len        = 0;
+            request->sent_us          = mb_transport_get_send_time(transport);
+            request->deadline_us      = 0;
+            request->timeout_us       = mb_transport_take_request_timeout(transport);
+            request->retries_left     = 0;
+            request->callback_handler = NULL;
+            request->callback_context = NULL;
+        } else {
+            transport->send_time_us = mb_transport_get_send_time(transport);
+        }
+        mb_transport_stats_request(transport, blocks[0].data, (uint16_t) size);
+        mb_transport_capture(transport, MB_CAPTURE_TYPE_SENT, driver_blocks, num_driver_blocks);
+        transport->tx_state = MB_TRANSPORT_TX_BUSY;
+        transport->driver_impl->send_blocks(transport->driver_context, driver_blocks, num_driver_blocks);
+        return true;
+    }
+
+    // copy blocks into send queue / send buffer
+    uint8_t * buffer = mb_transport_reserve(transport, (uint16_t) size);
+    if (buffer == NULL) return false;
+    uint16_t offset = 0;
+    for (i = 0; i < num_blocks; i++){
+        memcpy(&buffer[offset], blocks[i].data, blocks[i].len);
+        offset += blocks[i].len;
+    }
+    return mb_transport_commit(transport, (uint16_t) size);
+}
+
+uint8_t * mb_transport_reserve(mb_transport_t * transport, uint16_t size){
+    assert(transport != NULL);
+    assert(size >= MB_HEADER_SIZE);
+    if (transport->requests == NULL){
+        if (transport->tx_state != MB_TRANSPORT_TX_IDLE) return NULL;
+        if (size > transport->send_buffer_size) return NULL;
+        return transport->send_buffer_storage;
+    }
+    if (transport->requests_count >= transport->requests_max) return NULL;
+    // reserve space for trailer
+    uint16_t message_size = size + mb_transport_trailer_size(transport);
+    if (transport->framing_mode != MB_BRIDGE_FRAMING_REQUEST_MODE_NONE){
+        // request is set up in send buffer and encoded into the send queue on commit
+        if (message_size > transport->send_buffer_size) return NULL;
+        uint16_t frame_size = MB_FRAMING_MAX_FRAME_LEN(message_size);
+        if (mb_transport_send_queue_reserve(transport, frame_size) == NULL) return NULL;
+        transport->send_queue_reserved = frame_size;
+        return transport->send_buffer_storage;
+    }
+    uint8_t * queue_buffer = mb_transport_send_queue_reserve(transport, message_size);
+    if (queue_buffer == NULL) return NULL;
+    transport->send_queue_reserved = message_size;
+    return queue_buffer;
+}
+
+bool  mb_transport_commit(mb_transport_t * transport, uint16_t size){
+    assert(transport != NULL);
+    if (transport->requests == NULL){
+        return mb_transport_send(transport, transport->send_buffer_storage, size);
+    }
+    return mb_transport_commit_request(transport, size, NULL, NULL);
+}
+
+bool  mb_transport_commit_request(mb_transport_t * transport, uint16_t size,
+                                  void (*callback_handler)(void * context, const mb_message_t * message),
+                                  void * callback_context){
+    assert(transport != NULL);
+    assert(transport->requests != NULL);
+    assert(size >= MB_HEADER_SIZE);
+    assert(size <= transport->send_queue_reserved);
+
+    // reserved buffer is located at tail, or at the start of the queue if it did not fit
+    uint8_t * queue_buffer = mb_transport_send_queue_reserve(transport, transport->send_queue_reserved);
+    assert(queue_buffer != NULL);
+    uint8_t * message = queue_buffer;
+    if (transport->framing_mode != MB_BRIDGE_FRAMING_REQUEST_MODE_NONE){
+        message = transport->send_buffer_storage;
+    }
+    uint8_t tag = 0;
+    if (mb_transport_trailer_size(transport) > 0){
+        tag  = mb_transport_next_tag(transport);
+        size = mb_message_append_trailer(message, size, tag);
+    }
+    uint16_t queue_len = size;
+    if (transport->framing_mode != MB_BRIDGE_FRAMING_REQUEST_MODE_NONE){
+        queue_len = mb_framing_encode(message, size, queue_buffer, transport->send_queue_reserved);
+        assert(queue_len > 0);
+        mb_transport_log_request(transport, message, size);
+    }
+    transport->send_queue_reserved = 0;
+    mb_transport_send_queue_commit(transport, queue_buffer, queue_len);
+
+    mb_transport_request_t * request = &transport->requests[transport->requests_count++];
+    request->component        = mb_header_get_component(message);
+    request->operation        = mb_header_get_operation(message);
+    request->tag              = tag;
+    request->state            = MB_TRANSPORT_REQUEST_QUEUED;
+    request->queue_offset     = (uint16_t) (queue_buffer - transport->send_queue_storage);
+    request->queue_len        = queue_len;
+    request->sent_us          = 0;
+    request->deadline_us      = 0;
+    request->timeout_us       = mb_transport_take_request_timeout(transport);
+    request->retries_left     = transport->timeout_retries;
+    request->callback_handler = callback_handler;
+    request->callback_context = callback_context;
+    mb_transport_stats_request(transport, message, size);
+
+    mb_transport_send_next(transport);
+    return true;
+}
+
+void mb_transport_cork(mb_transport_t * transport){
+    assert(transport != NULL);
+    assert(transport->requests != NULL);
+    transport->send_queue_corked = true;
+}
+
+void mb_transport_uncork(mb_transport_t * transport){
+    assert(transport != NULL);
+    if (transport->requests == NULL) return;
+    transport->send_queue_corked = false;
+    mb_transport_send_next(transport);
+}
+
+uint16_t mb_transport_get_num_pending_requests(mb_transport_t * transport){
+    assert(transport != NULL);
+    return transport->requests_count;
+}
+
+void mb_transport_enable_capture(mb_transport_t * transport, mb_capture_t * capture){
+    assert(transport != NULL);
+    transport->capture = capture;
+}
+
+void mb_transport_enable_stats(mb_transport_t * transport, mb_transport_stats_t * stats){
+    assert(transport != NULL);
+    assert(stats != NULL);
+    transport->stats = stats;
+    mb_transport_reset_stats(transport);
+}
+
+void mb_transport_get_stats(mb_transport_t * transport, mb_transport_stats_t * snapshot){
+    assert(transport != NULL);
+    assert(transport->stats != NULL);
+    assert(snapshot != NULL);
+    *snapshot = *transport->stats;
+    if (transport->requests != NULL){
+        snapshot->pending_requests = transport->requests_count;
+        snapshot->send_queue_used  = mb_transport_send_queue_used(transport);
+    } else {
+        snapshot->pending_requests = (transport->tx_state == MB_TRANSPORT_TX_BUSY) ? 1 : 0;
+        snapshot->send_queue_used  = 0;
+    }
+}
+
+void mb_transport_reset_stats(mb_transport_t * transport){
+    assert(transport != NULL);
+    assert(transport->stats != NULL);
+    memset(transport->stats, 0, sizeof(mb_transport_stats_t));
+}
@@ -30,13 +30,18 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "multibus_capture.h"
 #include "multibus_driver.h"
+#include "multibus_framing.h"
 #include "multibus_protocol.h"
 
 #if defined __cplusplus
 extern "C" {
 #endif
 
+// no timeout pending
+#define MB_TRANSPORT_NO_TIMEOUT UINT32_MAX
+
 typedef enum {
     MB_TRANSPORT_RX_IDLE,
     MB_TRANSPORT_RX_W4_HEADER,
@@ -48,6 +53,69 @@ typedef enum {
     MB_TRANSPORT_TX_IDLE,
 } mb_transport_tx_state_t;
 
+typedef enum {
+    MB_TRANSPORT_REQUEST_QUEUED,
+    MB_TRANSPORT_REQUEST_SENDING,
+    MB_TRANSPORT_REQUEST_SENT,
+    MB_TRANSPORT_REQUEST_DONE,
+} mb_transport_request_state_t;
+
+// pipelining: outstanding request
+typedef struct {
+    uint8_t  component;
+    uint8_t  operation;
+    // protocol version 1: tag echoed in response
+    uint8_t  tag;
+    mb_transport_request_state_t state;
+    // location of message in send queue
+    uint16_t queue_offset;
+    uint16_t queue_len;
+    // round-trip time and timeout handling
+    uint32_t sent_us;
+    uint32_t deadline_us;
+    uint32_t timeout_us;
+    uint8_t  retries_left;
+    // response callback, NULL uses transport callback
+    void (*callback_handler)(void * context, const mb_message_t * message);
+    void * callback_context;
+} mb_transport_request_t;
+
+// number of log2 buckets for round-trip times in microseconds, bucket i counts [2^i, 2^(i+1)) us
+#define MB_TRANSPORT_STATS_RTT_BUCKETS 24
+
+typedef struct {
+    uint32_t requests;
+    uint32_t responses;
+    uint32_t bytes_sent;
+    uint32_t bytes_received;
+    uint32_t errors;
+    uint32_t timeouts;
+    uint32_t rtt_histogram[MB_TRANSPORT_STATS_RTT_BUCKETS];
+} mb_transport_operation_stats_t;
+
+typedef struct {
+    // per component id and request id
+    mb_transport_operation_stats_t operations[MB_COMPONENT_ID_LIMIT][MB_OPERATION_ID_LIMIT];
+    // totals
+    uint32_t messages_sent;
+    uint32_t messages_received;
+    uint32_t bytes_sent;
+    uint32_t bytes_received;
+    uint32_t unsolicited_messages;
+    uint32_t events;
+    uint32_t retries;
+    uint32_t timeouts;
+    // frames dropped due to invalid encoding, CRC or length
+    uint32_t framing_errors;
+    // responses per status code != OK
+    uint32_t status_errors[256];
+    // queue depths, current values are only valid in snapshot
+    uint16_t pending_requests;
+    uint16_t pending_requests_max;
+    uint16_t send_queue_used;
+    uint16_t send_queue_used_max;
+} mb_transport_stats_t;
+
 typedef struct {
     // driver implementation and context
     const mb_driver_t *driver_impl;
@@ -66,10 +134,59 @@ typedef struct {
     uint8_t  * receive_buffer_storage;
     uint16_t   receive_buffer_size;
 
+    // receive ring: complete frames are delivered in place
+    uint8_t  * receive_ring_storage;
+    uint16_t   receive_ring_size;
+    uint16_t   receive_ring_read;
+    uint16_t   receive_ring_write;
+    bool       receive_ring_discarding;
+    // unframed: remaining bytes of a message that does not fit into the ring
+    uint32_t   receive_ring_skip;
+
+    // link framing
+    mb_bridge_framing_request_mode_t framing_mode;
+
+    // protocol version, requests are tagged since MB_TRAILER_VERSION
+    uint16_t   protocol_version;
+    uint8_t    next_tag;
+    uint8_t    receive_tag;
+    uint8_t    send_trailer[MB_TRAILER_SIZE];
+
     // state
     mb_transport_rx_state_t rx_state;
     mb_transport_tx_state_t tx_state;
 
+    // pipelining: outstanding requests in order of submission
+    mb_transport_request_t * requests;
+    uint16_t   requests_max;
+    uint16_t   requests_count;
+
+    // pipelining: send queue, messages are stored in order of submission
+    uint8_t  * send_queue_storage;
+    uint16_t   send_queue_size;
+    uint16_t   send_queue_head;
+    uint16_t   send_queue_tail;
+    uint16_t   send_queue_wrap;
+    uint16_t   send_queue_reserved;
+    bool       send_queue_corked;
+
+    // time source in microseconds
+    uint32_t (*get_time_us)(void);
+
+    // timeouts
+    uint32_t   timeout_us;
+    uint32_t   next_timeout_us;
+    uint8_t    timeout_retries;
+    void (*timeout_handler)(void * context, const mb_transport_request_t * request);
+    void * timeout_context;
+
+    // statistics
+    mb_transport_stats_t * stats;
+    uint32_t   send_time_us;
+
+    // capture
+    mb_capture_t * capture;
+
     // logging
     bool dump_messages;
 } mb_transport_t;
@@ -94,10 +211,116 @@ void mb_transport_create(mb_transport_t * transport, const mb_driver_t * driver_
  */
 void mb_transport_enable_logging(mb_transport_t * transport);
 
+/**
+ * Enable pipelining: allow up to max_requests outstanding requests
+ * @note requests are stored in the send queue, responses are matched to requests by component and operation
+ * @note consecutive queued requests are passed to the driver as a single block
+ * @param transport
+ * @param request_storage
+ * @param max_requests
+ * @param send_queue_storage
+ * @param send_queue_size
+ */
+void mb_transport_enable_pipelining(mb_transport_t * transport,
+                                    mb_transport_request_t * request_storage, uint16_t max_requests,
+                                    uint8_t * send_queue_storage, uint16_t send_queue_size);
+
+/**
+ * Enable receive ring: driver provides all available bytes and all complete frames are delivered without copying
+ * @note requires driver support for receive_bytes, needs to be called before mb_transport_register_callback
+ * @note ring needs to be larger than the largest expected message. Partial frames are moved to the start of the ring
+ * @param transport
+ * @param receive_ring_storage
+ * @param receive_ring_size
+ */
+void mb_transport_enable_receive_ring(mb_transport_t * transport, uint8_t * receive_ring_storage, uint16_t receive_ring_size);
+
+/**
+ * Set link framing, e.g. from the callback of a successful bridge framing request
+ * @note requires pipelining and receive ring, no other request may be pending
+ * @note in COBS_CRC16 mode, requests are encoded when committed and corrupted responses are dropped and counted
+ *       in framing_errors. Use timeouts with retries to recover from dropped responses.
+ * @param transport
+ * @param framing_mode
+ */
+void mb_transport_set_framing(mb_transport_t * transport, mb_bridge_framing_request_mode_t framing_mode);
+
+/**
+ * Set protocol version, e.g. from the callback of a protocol version request that selected this version
+ * @note requires pipelining, no other request may be pending
+ * @note Since MB_TRAILER_VERSION, each request gets a tag, which the bridge echoes in the response. Responses are
+ *       matched by tag and can arrive in any order. Messages with tag 0 are passed to the transport callback.
+ * @param transport
+ * @param protocol_version
+ */
+void mb_transport_set_protocol_version(mb_transport_t * transport, uint16_t protocol_version);
+
+/**
+ * Get tag of the most recently submitted request
+ * @param transport
+ * @return tag, or 0 if requests are not tagged
+ */
+uint8_t mb_transport_get_request_tag(mb_transport_t * transport);
+
+/**
+ * Get tag of the message currently passed to a callback handler
+ * @note only valid during callback
+ * @param transport
+ * @return tag, or 0 if message was not tagged
+ */
+uint8_t mb_transport_get_receive_tag(mb_transport_t * transport);
+
+/**
+ * Set time source, e.g. a monotonic clock
+ * @param transport
+ * @param get_time_us returns current time in microseconds
+ */
+void mb_transport_set_time_source(mb_transport_t * transport, uint32_t (*get_time_us)(void));
+
+/**
+ * Enable timeouts for requests
+ * @note requires pipelining and time source
+ * @note After a timeout, the request is sent again up to num_retries times. Requests sent with
+ *       mb_transport_send_blocks without copying are not sent again. If no response has been received after the
+ *       last attempt, the request is dropped and the timeout handler is called. A late response is passed to the
+ *       transport callback.
+ * @param transport
+ * @param timeout_ms
+ * @param num_retries
+ * @param timeout_handler
+ * @param timeout_context
+ */
+void mb_transport_enable_timeouts(mb_transport_t * transport, uint32_t timeout_ms, uint8_t num_retries,
+                                  void (*timeout_handler)(void * context, const mb_transport_request_t * request),
+                                  void * timeout_context);
+
+/**
+ * Set timeout for the next request, e.g. for a delay request that takes longer than the default timeout
+ * @note requires timeouts, applies to the next request passed to mb_transport_send_request or
+ *       mb_transport_send_blocks only, later requests use the timeout from mb_transport_enable_timeouts again
+ * @param transport
+ * @param timeout_ms
+ */
+void mb_transport_set_next_request_timeout(mb_transport_t * transport, uint32_t timeout_ms);
+
+/**
+ * Get time until next request times out, e.g. as timeout for poll() or to arm a timer
+ * @param transport
+ * @return timeout in ms, 0 if timeout expired, or MB_TRANSPORT_NO_TIMEOUT
+ */
+uint32_t mb_transport_get_next_timeout_ms(mb_transport_t * transport);
+
+/**
+ * Handle expired requests, i.e. retry or drop them
+ * @param transport
+ */
+void mb_transport_process_timeouts(mb_transport_t * transport);
+
 // Asynchronous Interface
 
 /**
  * @brief Register callback
+ * @note receives responses without request callback and events, see mb_message_is_event
  * @param context for transport instance
  * @param callback_handler
  * @param callback_context
@@ -116,6 +339,111 @@ void mb_transport_register_callback(mb_transport_t * transport,
  */
 bool  mb_transport_send(mb_transport_t * transport, const uint8_t * buffer, uint16_t size);
 
+/**
+ * @brief Queue request and register callback for its response
+ * @note requires pipelining
+ * @param transport
+ * @param buffer
+ * @param size
+ * @param callback_handler for response, NULL uses transport callback
+ * @param callback_context
+ * @return ok, false if send queue or request table is full
+ */
+bool  mb_transport_send_request(mb_transport_t * transport, const uint8_t * buffer, uint16_t size,
+                                void (*callback_handler)(void * context, const mb_message_t * message),
+                                void * callback_context);
+
+/**
+ * @brief Send request provided as list of blocks, e.g. header and caller-owned payload
+ * @note If the driver supports send_blocks and no other request is queued, the first block is copied into the send
+ *       buffer and all other blocks are sent without copying. They need to stay valid until the response has been
+ *       received. Otherwise, all blocks are copied into the send queue / send buffer.
+ * @param transport
+ * @param blocks
+ * @param num_blocks, max MB_DRIVER_MAX_BLOCKS
+ * @return ok
+ */
+bool  mb_transport_send_blocks(mb_transport_t * transport, const mb_driver_block_t * blocks, uint8_t num_blocks);
+
+/**
+ * @brief Reserve buffer to set up the next request in place
+ * @note without pipelining, the send buffer is returned if no request is being sent
+ * @param transport
+ * @param size of request
+ * @return buffer or NULL if no space is available
+ */
+uint8_t * mb_transport_reserve(mb_transport_t * transport, uint16_t size);
+
+/**
+ * @brief Send request that was set up in the reserved buffer
+ * @param transport
+ * @param size of request, must not exceed reserved size
+ * @return ok
+ */
+bool  mb_transport_commit(mb_transport_t * transport, uint16_t size);
+
+/**
+ * @brief Send request that was set up in the reserved buffer and register callback for its response
+ * @note requires pipelining
+ * @param transport
+ * @param size of request, must not exceed reserved size
+ * @param callback_handler for response, NULL uses transport callback
+ * @param callback_context
+ * @return ok
+ */
+bool  mb_transport_commit_request(mb_transport_t * transport, uint16_t size,
+                                  void (*callback_handler)(void * context, const mb_message_t * message),
+                                  void * callback_context);
+
+/**
+ * @brief Hold back queued requests, e.g. while issuing a burst of requests
+ * @note requires pipelining
+ * @param transport
+ */
+void mb_transport_cork(mb_transport_t * transport);
+
+/**
+ * @brief Send all queued requests, consecutive requests are passed to the driver as a single block
+ * @param transport
+ */
+void mb_transport_uncork(mb_transport_t * transport);
+
+/**
+ * @brief Get number of requests that have not received a response yet
+ * @param transport
+ * @return num requests
+ */
+uint16_t mb_transport_get_num_pending_requests(mb_transport_t * transport);
+
+/**
+ * Enable capture of all sent and received messages
+ * @note timestamps require time source
+ * @param transport
+ * @param capture initialized with mb_capture_init
+ */
+void mb_transport_enable_capture(mb_transport_t * transport, mb_capture_t * capture);
+
+/**
+ * Enable statistics: messages and bytes per operation, errors per status code, queue depths and round-trip times
+ * @note round-trip times require time source
+ * @param transport
+ * @param stats storage
+ */
+void mb_transport_enable_stats(mb_transport_t * transport, mb_transport_stats_t * stats);
+
+/**
+ * Get snapshot of statistics
+ * @param transport
+ * @param snapshot
+ */
+void mb_transport_get_stats(mb_transport_t * transport, mb_transport_stats_t * snapshot);
+
+/**
+ * Reset statistics
+ * @param transport
+ */
+void mb_transport_reset_stats(mb_transport_t * transport);
+
 #if defined __cplusplus
 }
 #endif
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+
+# Copyright 2022 Matthias Ringwald
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+# disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+# following disclaimer in the documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+# INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+# USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+# Decode MultiBus capture file written by multibus_capture.c
+
+import os
+import struct
+import sys
+import parser
+
+program_info = '''Capture Decoder for MultiBus
+Copyright 2022, MultiBus
+'''
+
+capture_magic = b'MBCP'
+capture_format_version = 1
+
+record_types = { 0x00: 'SENT', 0x01: 'RECEIVED', 0x02: 'DROPPED' }
+
+field_sizes = {'bool': 1, 'u8': 1, 'u16': 2, 'u32': 4, 'enum': 1}
+
+def enum_value_name(values, value):
+    for (value_name, enum_value) in values.items():
+        if type(enum_value) is str:
+            enum_value = int(enum_value, 0)
+        if enum_value == value:
+            return value_name
+    return '0x%02x' % value
+
+def enum_values(component, field, general_enums, components):
+    # component level values first, the parser also adds them to the general enum qualified by component name
+    values = dict(component.get('enums', {}).get(field, {}))
+    qualifiers = tuple([component_name + '_' for component_name in components.keys()])
+    for (value_name, value) in general_enums.get(field, {}).items():
+        if not value_name.startswith(qualifiers):
+            values[value_name] = value
+    return values
+
+def decode_fields(component, operation_fields, payload, general_enums, components):
+    decoded = []
+    offset = 0
+    for (field, mb_type) in operation_fields.items():
+        if type(mb_type) is dict:
+            value = payload[offset]
+            decoded.append('%s=%s' % (field, enum_value_name(mb_type, value)))
+            offset += 1
+            continue
+        if mb_type in ['string', 'u8[]']:
+            data = payload[offset:]
+            if mb_type == 'string':
+                decoded.append("%s='%s'" % (field, data.decode('utf-8', errors='replace')))
+            else:
+                decoded.append('%s=[%s]' % (field, data.hex(' ')))
+            offset = len(payload)
+            continue
+        size = field_sizes[mb_type]
+        if offset + size > len(payload):
+            decoded.append('%s=<truncated>' % field)
+            break
+        value = int.from_bytes(payload[offset:offset+size], 'big')
+        if mb_type == 'enum':
+            decoded.append('%s=%s' % (field, enum_value_name(enum_values(component, field, general_enums, components), value)))
+        elif mb_type == 'bool':
+            decoded.append('%s=%s' % (field, 'true' if value else 'false'))
+        else:
+            decoded.append('%s=%u' % (field, value))
+        offset += size
+    return ', '.join(decoded)
+
+def find_operation(components, component_id, operation_id):
+    for (component_name, component) in components.items():
+        if component['id'] != component_id:
+            continue
+        for (operation_name, operation) in component['operations'].items():
+            if operation['id'] == operation_id:
+                return (component_name, component, operation_name, operation)
+    return None
+
+def decode_message(frame, components, general_enums, trailer_size):
+    if len(frame) < 5:
+        return 'invalid frame: ' + frame.hex(' ')
+    (component_id, operation_id, channel, length) = struct.unpack('>BBBH', frame[0:5])
+    payload = frame[5:5+length]
+    # strip trailer
+    tag_info = ''
+    if trailer_size > 0 and len(payload) >= trailer_size:
+        tag_info = ', tag=%u' % payload[len(payload) - trailer_size]
+        payload = payload[:len(payload) - trailer_size]
+    found = find_operation(components, component_id, operation_id)
+    if found is None:
+        return 'component 0x%02x, operation 0x%02x, channel %u%s: %s' % (component_id, operation_id, channel, tag_info,
+                                                                          payload.hex(' '))
+    (component_name, component, operation_name, operation) = found
+    operation_fields = operation['fields']
+    if operation_fields is None:
+        operation_fields = {}
+    return '%s.%s(channel=%u%s) %s' % (component_name, operation_name, channel, tag_info,
+                                       decode_fields(component, operation_fields, payload, general_enums, components))
+
+def decode_capture(capture_path, components, general_enums, trailer):
+    with open(capture_path, 'rb') as fin:
+        data = fin.read()
+    if data[0:4] != capture_magic:
+        print('%s is not a MultiBus capture file' % capture_path)
+        sys.exit(10)
+    if data[4] != capture_format_version:
+        print('Unsupported capture format version %u' % data[4])
+        sys.exit(10)
+    trailer_version = trailer.get('version', None)
+    trailer_size = sum([field_sizes[mb_type] for mb_type in trailer.get('fields', {}).values()])
+    # session protocol version, selected by protocol version request once the bridge confirmed it in its response
+    session_version = 0
+    requested_version = None
+    offset = 5
+    start_us = None
+    while offset + 7 <= len(data):
+        (timestamp_us, record_type, length) = struct.unpack('>IBH', data[offset:offset+7])
+        offset += 7
+        record = data[offset:offset+length]
+        offset += length
+        if start_us is None:
+            start_us = timestamp_us
+        time_ms = ((timestamp_us - start_us) & 0xffffffff) / 1000.0
+        type_name = record_types.get(record_type, 'TYPE_0x%02x' % record_type)
+        if record_type == 0x02:
+            print('%10.3f %-8s %u records' % (time_ms, type_name, int.from_bytes(record, 'big')))
+            continue
+        current_trailer_size = trailer_size if (trailer_version is not None and session_version >= trailer_version) else 0
+        print('%10.3f %-8s %s' % (time_ms, type_name, decode_message(record, components, general_enums, current_trailer_size)))
+        # track protocol version
+        if len(record) >= 7 and record[0] == components['bridge']['id']:
+            operations = components['bridge']['operations']
+            version = int.from_bytes(record[5:7], 'big')
+            if record_type == 0x00 and record[1] == operations['protocol_version_request']['id']:
+                requested_version = version
+            elif record_type == 0x01 and record[1] == operations['protocol_version_response']['id']:
+                # bridge switches to requested version if it supports it
+                if requested_version is not None and requested_version <= version:
+                    session_version = requested_version
+                requested_version = None
+
+# main
+
+if len(sys.argv) < 2:
+    print(program_info)
+    print('Usage: %s <capture file>' % sys.argv[0])
+    sys.exit(10)
+
+multibus_root = os.path.abspath(os.path.dirname(sys.argv[0]) + '/..')
+protocol_path = multibus_root+'/protocol/multibus.yml'
+result = parser.load_protocol_description(protocol_path)
+
+decode_capture(sys.argv[1], result['components'], result['general_enums'], result['trailer'])
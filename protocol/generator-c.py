@@ -27,6 +27,7 @@ import parser
 ## Collected data
 protocol_version = 0
 header = {}
+trailer = {}
 components = {}
 general_enums = {}
 field_enums = {}
@@ -171,12 +172,52 @@ def c_message_getter(fn_name, field_name, c_type, mb_type, offset, argument_name
         accessor = c_buffer_accessor[mb_type].format(buffer=argument_name+'->payload_data', offset=offset)
     return c_message_getter_template.format(fn_type=c_type, fn_name=fn_name, accessor=accessor, argument_name=argument_name)
 
+def c_payload_len(operation_fields):
+    # returns size of fixed fields and expression for variable length field
+    fixed_len = 0
+    variable_len = None
+    for (field, mb_type) in operation_fields.items():
+        if type(mb_type) is dict:
+            mb_type = 'enum'
+        if mb_type == 'u8[]':
+            variable_len = field + '_len'
+        elif mb_type == 'string':
+            variable_len = 'strlen(%s)' % field
+        else:
+            fixed_len += c_size[mb_type]
+    return (fixed_len, variable_len)
+
+def c_fixed_fields(fields):
+    # returns fields without trailing u8[] field, or None if there's none
+    (field, mb_type) = fields[-1]
+    if mb_type != 'u8[]':
+        return None
+    return fields[:-1]
+
 def c_arguments(fields):
     arguments = []
     for (field_name, mb_type) in fields:
         arguments.append((c_type_for_field(field_name, mb_type), field_name))
     return ", ".join(["%s %s" % (field_type, field_name) for (field_type, field_name) in arguments])
 
+def c_fields_setup(fields):
+    # returns statements that store the fields in buffer
+    body = ''
+    offset = 0
+    for (field, mb_type) in fields:
+        if mb_type == 'u8':
+            body += '    buffer[{offset}] = {field};\n'.format(field=field, offset=offset)
+            offset += 1
+        elif mb_type == 'u16':
+            body += '    buffer[{offset}] = {field} >> 8;\n'.format(field=field, offset=offset)
+            body += '    buffer[{offset}] = {field} & 0xff;\n'.format(field=field, offset=offset+1)
+            offset += 2
+        elif mb_type == 'enum':
+            c_type = c_type_for_enum_name(field)
+            body += '    buffer[{offset}] = ({c_type}) {field};\n'.format(field=field, c_type = c_type, offset=offset)
+            offset += 1
+    return body
+
 def c_write_enum(fout, enum_name, values):
     c_type = c_type_for_enum_name(enum_name)
     fout.write("typedef enum {\n")
@@ -227,6 +268,14 @@ def c_generate_header(gen_path):
             c_write_enum(fout, 'operation_' + component_name, operation_enum)
             fout.write("\n")
 
+        # generate limits for lookup tables indexed by component id and request id
+        component_id_limit = max([component['id'] for component in components.values()]) + 1
+        operation_id_limit = max([operation['id'] & 0x7f for component in components.values() for operation in component['operations'].values()]) + 1
+        fout.write("// Limits for lookup tables indexed by component id and request id\n")
+        fout.write("#define MB_COMPONENT_ID_LIMIT %u\n" % component_id_limit)
+        fout.write("#define MB_OPERATION_ID_LIMIT %u\n" % operation_id_limit)
+        fout.write("\n")
+
         # generate general enums
         fout.write("// General Enumerations\n")
         for (enum_name, enum_values) in general_enums.items():
@@ -257,6 +306,28 @@ def c_generate_header(gen_path):
         fout.write(c_arguments(header.items()))
         fout.write(");\n\n")
 
+        # generate getters and builder for trailer
+        if len(trailer) > 0:
+            trailer_fields = trailer['fields']
+            fout.write("// MultiBus Protocol Trailer, used since protocol version MB_TRAILER_VERSION\n")
+            fout.write("#define MB_TRAILER_VERSION %u\n" % trailer['version'])
+            fout.write("#define MB_TRAILER_SIZE %u\n" % sum([c_size[mb_type] for mb_type in trailer_fields.values()]))
+            offset = 0
+            for (field, mb_type) in trailer_fields.items():
+                fout.write(c_payload_getter('mb_trailer_get_' + field, field, c_types[mb_type], mb_type, offset, 'trailer'))
+                offset += c_size[mb_type]
+            fout.write("void mb_trailer_setup(uint8_t * buffer, %s);\n" % c_arguments(trailer_fields.items()))
+            fout.write("// Append trailer to message and add it to the length field, returns new message len\n")
+            fout.write("uint16_t mb_message_append_trailer(uint8_t * message, uint16_t message_len, %s);\n\n" % c_arguments(trailer_fields.items()))
+
+        # generate status getter
+        fout.write("// Get status of message, returns false if message does not have a status field\n")
+        fout.write("bool mb_message_get_status(const mb_message_t * message, uint8_t * status);\n\n")
+
+        # generate event check
+        fout.write("// Check if message is an event, i.e. sent by the bridge without request\n")
+        fout.write("bool mb_message_is_event(const mb_message_t * message);\n\n")
+
         # generate getter and builder for each component operation
         for (component_name, component) in components.items():
 
@@ -309,6 +380,12 @@ def c_generate_header(gen_path):
                 fout.write("uint16_t " + fn_name + "(" + c_arguments(fields) + ");\n")
                 fout.write('\n')
 
+                # message builder without u8[] field, which can be sent separately
+                fixed_fields = c_fixed_fields(fields)
+                if fixed_fields is not None:
+                    fout.write("uint16_t " + fn_name + "_fixed(" + c_arguments(fixed_fields) + ");\n")
+                    fout.write('\n')
+
         fout.write(c_header_end)
 
 def c_generate_code(gen_path):
@@ -322,24 +399,32 @@ def c_generate_code(gen_path):
         fout.write("void mb_header_setup(uint8_t * buffer, ")
         fout.write(c_arguments(header.items()))
         fout.write("){\n")
-        offset = 0
+        fout.write(c_fields_setup(header.items()))
+        fout.write('}\n\n')
 
-        # calc payload_offset
+        # calc payload_offset and offset of length field
         payload_offset = 0
+        length_offset = 0
         for (field, mb_type) in header.items():
+            if field == 'length':
+                length_offset = payload_offset
             payload_offset += c_size[mb_type]
-            if mb_type == 'u8':
-                fout.write('    buffer[{offset}] = {field};\n'.format(field=field, offset=offset))
-                offset += 1
-            elif mb_type == 'u16':
-                fout.write('    buffer[{offset}] = {field} >> 8;\n'.format(field=field, offset=offset))
-                fout.write('    buffer[{offset}] = {field} & 0xff;\n'.format(field=field, offset=offset+1))
-                offset += 2
-            elif mb_type == 'enum':
-                c_type = c_type_for_enum_name(field)
-                fout.write( '    buffer[{offset}] = ({c_type}) {field};\n'.format(field=field, c_type = c_type, offset=offset))
-                offset += 1
-        fout.write('}\n\n')
+
+        # generate trailer builder
+        if len(trailer) > 0:
+            trailer_fields = trailer['fields']
+            fout.write("// MultiBus Trailer Builder\n")
+            fout.write("void mb_trailer_setup(uint8_t * buffer, %s){\n" % c_arguments(trailer_fields.items()))
+            fout.write(c_fields_setup(trailer_fields.items()))
+            fout.write('}\n\n')
+            fout.write("uint16_t mb_message_append_trailer(uint8_t * message, uint16_t message_len, %s){\n" % c_arguments(trailer_fields.items()))
+            fout.write("    assert(message_len >= MB_HEADER_SIZE);\n")
+            fout.write("    mb_trailer_setup(&message[message_len], %s);\n" % ", ".join(trailer_fields.keys()))
+            fout.write("    uint16_t payload_len = mb_header_get_length(message) + MB_TRAILER_SIZE;\n")
+            fout.write("    message[%u] = payload_len >> 8;\n" % length_offset)
+            fout.write("    message[%u] = payload_len & 0xff;\n" % (length_offset + 1))
+            fout.write("    return message_len + MB_TRAILER_SIZE;\n")
+            fout.write('}\n\n')
 
         # generate getter and builder for each component operation
         for (component_name, component) in components.items():
@@ -420,6 +505,21 @@ def c_generate_code(gen_path):
                 fout.write("}\n")
                 fout.write('\n')
 
+                # message builder without u8[] field
+                fixed_fields = c_fixed_fields(fields)
+                if fixed_fields is not None:
+                    fixed_body = "".join([line for line in body.splitlines(True) if 'memcpy' not in line])
+                    fout.write("uint16_t " + setup_fn_name + "_fixed(" + c_arguments(fixed_fields) + "){\n")
+                    fout.write('    uint32_t payload_len = {offset} + {var_len};\n'.format(offset=offset-payload_offset, var_len=variable_field_len))
+                    fout.write('    uint32_t fixed_len = {offset};\n'.format(offset=offset))
+                    fout.write("    assert(buffer_len >= fixed_len);\n")
+                    fout.write("    mb_header_setup(buffer_data, {component_id}, (uint8_t) {opcode}, channel, payload_len);\n".format(
+                        component_id='MB_COMPONENT_' + component_name.upper(), opcode='MB_OPERATION_'+ component_name.upper() + "_" + operation_name.upper()))
+                    fout.write(fixed_body)
+                    fout.write('    return fixed_len;\n')
+                    fout.write("}\n")
+                    fout.write('\n')
+
             # is_event
             fn_name = "mb_" + component_name + "_is_event"
             switch_body = "\n".join([("        case %s:\n" % event_id) for event_id in event_ids])
@@ -428,9 +528,83 @@ def c_generate_code(gen_path):
             fout.write(c_is_event_code_template.format(fn_name=fn_name,switch_body=switch_body))
             fout.write('\n')
 
+        # event check
+        fout.write("// Check if message is an event\n")
+        fout.write("bool mb_message_is_event(const mb_message_t * message){\n")
+        fout.write("    switch (message->component){\n")
+        for (component_name, component) in components.items():
+            fout.write("        case MB_COMPONENT_%s:\n" % component_name.upper())
+            fout.write("            return mb_%s_is_event(message->operation);\n" % component_name)
+        fout.write("        default:\n")
+        fout.write("            return false;\n")
+        fout.write("    }\n")
+        fout.write("}\n\n")
+
+        # status getter
+        fout.write("// Get status of message\n")
+        fout.write("bool mb_message_get_status(const mb_message_t * message, uint8_t * status){\n")
+        fout.write("    uint16_t offset;\n")
+        fout.write("    switch (message->component){\n")
+        for (component_name, component) in components.items():
+            cases = ""
+            for (operation_name, operation) in component['operations'].items():
+                operation_fields = operation['fields']
+                if operation_fields is None:
+                    continue
+                offset = 0
+                for (field, mb_type) in operation_fields.items():
+                    if type(mb_type) is dict:
+                        mb_type = 'enum'
+                    if field == 'status':
+                        cases += "                case MB_OPERATION_%s_%s:\n" % (component_name.upper(), operation_name.upper())
+                        cases += "                    offset = %u;\n" % offset
+                        cases += "                    break;\n"
+                        break
+                    offset += c_size[mb_type]
+            if cases == "":
+                continue
+            fout.write("        case MB_COMPONENT_%s:\n" % component_name.upper())
+            fout.write("            switch (message->operation){\n")
+            fout.write(cases)
+            fout.write("                default:\n")
+            fout.write("                    return false;\n")
+            fout.write("            }\n")
+            fout.write("            break;\n")
+        fout.write("        default:\n")
+        fout.write("            return false;\n")
+        fout.write("    }\n")
+        fout.write("    if (message->payload_len <= offset) return false;\n")
+        fout.write("    *status = message->payload_data[offset];\n")
+        fout.write("    return true;\n")
+        fout.write("}\n")
 
         fout.write(c_code_end)
 
+c_sync_start = '''
+#ifndef MULTIBUS_PROTOCOL_SYNC_H_
+#define MULTIBUS_PROTOCOL_SYNC_H_
+
+// Generated from protocol/multibus.yml
+
+#include "multibus_protocol.h"
+#include "multibus_transport_protocol.h"
+#include "multibus_sync.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+'''
+
+c_sync_end = '''
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // MULTIBUS_PROTOCOL_SYNC_H_
+'''
+
 def c_generate_transport_helper(gen_path):
 
     with open(gen_path, 'wt') as fout:
@@ -457,17 +631,303 @@ def c_generate_transport_helper(gen_path):
                     if mb_type == "u8[]":
                         fields.append((field+"_len", 'u16'))
                     fields.append((field, mb_type))
-                body = ""
-                variable_field_len = None
-
-                fout.write("static inline void " + fn_name + "(mb_transport_t * transport, " + c_arguments(fields) + "){\n")
-                fout.write("    uint16_t request_len = " + setup_fn + "(transport->send_buffer_storage, transport->send_buffer_size," + ",".join([name for (name,_) in fields]) + ');\n')
-                fout.write("    mb_transport_send(transport, transport->send_buffer_storage, request_len);\n")
+                (fixed_len, variable_len) = c_payload_len(operation_fields)
+                request_len = 'MB_HEADER_SIZE + %u' % fixed_len
+                if variable_len is not None:
+                    request_len += ' + ' + variable_len
+
+                fout.write("static inline bool " + fn_name + "(mb_transport_t * transport, " + c_arguments(fields) + "){\n")
+                fout.write("    uint16_t request_len = " + request_len + ";\n")
+                fout.write("    uint8_t * request_buffer = mb_transport_reserve(transport, request_len);\n")
+                fout.write("    if (request_buffer == NULL) return false;\n")
+                fout.write("    (void) " + setup_fn + "(request_buffer, request_len, " + ", ".join([name for (name,_) in fields]) + ');\n')
+                fout.write("    return mb_transport_commit(transport, request_len);\n")
                 fout.write("}\n")
                 fout.write('\n')
 
+                # send u8[] field without copying
+                fixed_fields = c_fixed_fields(fields)
+                if fixed_fields is not None:
+                    (data_field, _) = fields[-1]
+                    fout.write("static inline bool " + fn_name + "_blocks(mb_transport_t * transport, " + c_arguments(fields) + "){\n")
+                    fout.write("    uint8_t request_fixed[MB_HEADER_SIZE + %u];\n" % fixed_len)
+                    fout.write("    mb_driver_block_t blocks[2];\n")
+                    fout.write("    blocks[0].data = request_fixed;\n")
+                    fout.write("    blocks[0].len  = " + setup_fn + "_fixed(request_fixed, sizeof(request_fixed), " + ", ".join([name for (name,_) in fixed_fields]) + ');\n')
+                    fout.write("    blocks[1].data = %s;\n" % data_field)
+                    fout.write("    blocks[1].len  = %s_len;\n" % data_field)
+                    fout.write("    return mb_transport_send_blocks(transport, blocks, 2);\n")
+                    fout.write("}\n")
+                    fout.write('\n')
+
         fout.write(c_transport_end)
 
+def c_generate_sync_helper(gen_path):
+
+    with open(gen_path, 'wt') as fout:
+
+        fout.write(c_sync_start)
+
+        # generate blocking call for each request
+        for (component_name, component) in components.items():
+            for (operation_name, operation) in component['operations'].items():
+                if not operation_name.endswith('_request'):
+                    continue
+                fout.write("// Component: %s, Operation: %s\n" % (component_name, operation_name))
+
+                operation_fields = operation['fields']
+                if operation_fields is None:
+                    operation_fields = {}
+
+                fn_name   = "mb_sync_" + component_name + "_" + operation_name[:-len('_request')]
+                send_fn   = "mb_transport_" + component_name + "_" + operation_name + '_send'
+                fields = [('channel','u8') ]
+                for (field, mb_type) in operation_fields.items():
+                    if type(mb_type) is dict:
+                        field = component_name + "_" + operation_name + '_' + field
+                        mb_type = 'enum'
+                    if mb_type == "u8[]":
+                        fields.append((field+"_len", 'u16'))
+                    fields.append((field, mb_type))
+
+                fout.write("static inline const mb_message_t * " + fn_name + "(mb_sync_t * mb_sync, " + c_arguments(fields) + "){\n")
+                fout.write("    if (" + send_fn + "(mb_sync->transport, " + ", ".join([name for (name,_) in fields]) + ") == false) return NULL;\n")
+                response_name = operation_name[:-len('_request')] + '_response'
+                component_id  = "MB_COMPONENT_" + component_name.upper()
+                if response_name in component['operations']:
+                    response_id = "(uint8_t) MB_OPERATION_" + component_name.upper() + "_" + response_name.upper()
+                else:
+                    response_id = "(uint8_t) MB_OPERATION_" + component_name.upper() + "_" + operation_name.upper() + " | 0x80"
+                fout.write("    return mb_sync_wait_for_response(mb_sync, " + component_id + ", " + response_id + ");\n")
+                fout.write("}\n")
+                fout.write('\n')
+
+        fout.write(c_sync_end)
+
+cpp_header_start = """
+#ifndef MULTIBUS_PROTOCOL_HPP_
+#define MULTIBUS_PROTOCOL_HPP_
+
+// Generated from protocol/multibus.yml
+
+// C++20 views and builders for all messages. Field offsets and sizes are constexpr, builders for std::array buffers
+// check the capacity for the fixed fields at compile time. Enums and ids are shared with multibus_protocol.h
+
+#include "multibus_protocol.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace mb {
+
+namespace detail {
+
+constexpr uint8_t get_u8(std::span<const uint8_t> buffer, std::size_t offset) {
+    return buffer[offset];
+}
+
+constexpr uint16_t get_u16(std::span<const uint8_t> buffer, std::size_t offset) {
+    return static_cast<uint16_t>((buffer[offset] << 8) | buffer[offset + 1]);
+}
+
+constexpr uint32_t get_u32(std::span<const uint8_t> buffer, std::size_t offset) {
+    return (static_cast<uint32_t>(buffer[offset]) << 24) | (static_cast<uint32_t>(buffer[offset + 1]) << 16) |
+           (static_cast<uint32_t>(buffer[offset + 2]) << 8) | buffer[offset + 3];
+}
+
+constexpr void set_u8(std::span<uint8_t> buffer, std::size_t offset, uint8_t value) {
+    buffer[offset] = value;
+}
+
+constexpr void set_u16(std::span<uint8_t> buffer, std::size_t offset, uint16_t value) {
+    buffer[offset] = static_cast<uint8_t>(value >> 8);
+    buffer[offset + 1] = static_cast<uint8_t>(value & 0xff);
+}
+
+constexpr void set_u32(std::span<uint8_t> buffer, std::size_t offset, uint32_t value) {
+    buffer[offset] = static_cast<uint8_t>(value >> 24);
+    buffer[offset + 1] = static_cast<uint8_t>((value >> 16) & 0xff);
+    buffer[offset + 2] = static_cast<uint8_t>((value >> 8) & 0xff);
+    buffer[offset + 3] = static_cast<uint8_t>(value & 0xff);
+}
+
+}  // namespace detail
+
+"""
+
+cpp_header_end = """
+}  // namespace mb
+
+#endif // MULTIBUS_PROTOCOL_HPP_
+"""
+
+cpp_getter = { 'bool' : 'detail::get_u8({buffer}, {offset}) != 0', 'u8' : 'detail::get_u8({buffer}, {offset})',
+               'u16' : 'detail::get_u16({buffer}, {offset})', 'u32' : 'detail::get_u32({buffer}, {offset})',
+               'enum' : 'static_cast<{c_type}>(detail::get_u8({buffer}, {offset}))',
+               'u8[]' : '{buffer}.subspan({offset})',
+               'string' : 'std::string_view(reinterpret_cast<const char *>({buffer}.data()) + {offset}, {buffer}.size() - {offset})' }
+
+cpp_setter = { 'bool' : 'detail::set_u8({buffer}, {offset}, {field} ? 1 : 0);', 'u8' : 'detail::set_u8({buffer}, {offset}, {field});',
+               'u16' : 'detail::set_u16({buffer}, {offset}, {field});', 'u32' : 'detail::set_u32({buffer}, {offset}, {field});',
+               'enum' : 'detail::set_u8({buffer}, {offset}, static_cast<uint8_t>({field}));',
+               'u8[]' : 'std::copy({field}.begin(), {field}.end(), {buffer}.begin() + {offset});',
+               'string' : 'std::copy({field}.begin(), {field}.end(), {buffer}.begin() + {offset});' }
+
+cpp_argument_types = { 'bool' : 'bool', 'u8' : 'uint8_t', 'u16' : 'uint16_t', 'u32' : 'uint32_t',
+                       'u8[]' : 'std::span<const uint8_t>', 'string' : 'std::string_view' }
+
+def cpp_fields(component_name, operation_name, operation_fields):
+    # returns list of (field, mb_type, c_type, payload offset), offset of variable field is its start
+    fields = []
+    offset = 0
+    for (field, mb_type) in operation_fields.items():
+        if type(mb_type) is dict:
+            mb_type = 'enum'
+            c_type = c_type_for_enum_name(component_name + "_" + operation_name + '_' + field)
+        elif mb_type == 'enum':
+            c_type = c_type_for_enum_name(field)
+        else:
+            c_type = cpp_argument_types[mb_type]
+        fields.append((field, mb_type, c_type, offset))
+        offset += c_size[mb_type]
+    return (fields, offset)
+
+def cpp_write_header_helpers(fout):
+    fout.write("// MultiBus Header\n")
+    offset = 0
+    for (field, mb_type) in header.items():
+        fout.write("constexpr std::size_t header_%s_offset = %u;\n" % (field, offset))
+        offset += c_size[mb_type]
+    fout.write("constexpr std::size_t header_size = MB_HEADER_SIZE;\n")
+    fout.write("static_assert(header_size == %u);\n\n" % offset)
+
+    # header builder
+    arguments = []
+    for (field, mb_type) in header.items():
+        c_type = c_type_for_enum_name(field) if mb_type == 'enum' else cpp_argument_types[mb_type]
+        arguments.append("%s %s" % (c_type, field))
+    fout.write("constexpr void header_setup(std::span<uint8_t> buffer, %s) {\n" % ", ".join(arguments))
+    for (field, mb_type) in header.items():
+        fout.write("    " + cpp_setter[mb_type].format(buffer='buffer', offset='header_%s_offset' % field, field=field) + "\n")
+    fout.write("}\n\n")
+
+    # message view
+    fout.write("// View of complete message without trailer\n")
+    fout.write("class message_view {\n")
+    fout.write(" public:\n")
+    fout.write("    constexpr explicit message_view(std::span<const uint8_t> message) : message_(message) {}\n\n")
+    fout.write("    // header is complete and payload matches length field\n")
+    fout.write("    constexpr bool valid() const {\n")
+    fout.write("        return message_.size() >= header_size && message_.size() >= header_size + length();\n")
+    fout.write("    }\n\n")
+    for (field, mb_type) in header.items():
+        c_type = c_type_for_enum_name(field) if mb_type == 'enum' else cpp_argument_types[mb_type]
+        accessor = cpp_getter[mb_type].format(buffer='message_', offset='header_%s_offset' % field, c_type=c_type)
+        fout.write("    constexpr %s %s() const { return %s; }\n" % (c_type, field, accessor))
+    fout.write("    constexpr std::span<const uint8_t> payload() const { return message_.subspan(header_size, length()); }\n\n")
+    fout.write("    template <typename OPERATION>\n")
+    fout.write("    constexpr bool is() const { return component() == OPERATION::component && operation() == OPERATION::operation; }\n\n")
+    fout.write(" private:\n")
+    fout.write("    std::span<const uint8_t> message_;\n")
+    fout.write("};\n\n")
+
+def cpp_write_operation(fout, component_name, operation_name, operation):
+    operation_fields = operation['fields']
+    if operation_fields is None:
+        operation_fields = {}
+    (fields, fixed_payload_size) = cpp_fields(component_name, operation_name, operation_fields)
+    variable_field = None
+    if len(fields) > 0 and fields[-1][1] in ['u8[]', 'string']:
+        variable_field = fields[-1]
+
+    fout.write("// Component: %s, Operation: %s\n" % (component_name, operation_name))
+    fout.write("struct %s {\n" % operation_name)
+    fout.write("    static constexpr mb_component_t component = MB_COMPONENT_%s;\n" % component_name.upper())
+    fout.write("    static constexpr uint8_t operation = MB_OPERATION_%s_%s;\n" % (component_name.upper(), operation_name.upper()))
+    fout.write("    static constexpr bool is_event = %s;\n\n" % ('true' if operation.get('type') == 'event' else 'false'))
+
+    # offsets and sizes
+    if len(fields) > 0:
+        fout.write("    // payload offsets, variable length field extends to end of payload\n")
+    for (field, mb_type, c_type, offset) in fields:
+        fout.write("    static constexpr std::size_t %s_offset = %u;\n" % (field, offset))
+    fout.write("    // payload and message size without variable length field\n")
+    fout.write("    static constexpr std::size_t fixed_payload_size = %u;\n" % fixed_payload_size)
+    fout.write("    static constexpr std::size_t fixed_size = header_size + fixed_payload_size;\n")
+    fout.write("    static constexpr bool has_variable_field = %s;\n\n" % ('true' if variable_field is not None else 'false'))
+
+    # view
+    fout.write("    class view {\n")
+    fout.write("     public:\n")
+    fout.write("        constexpr explicit view(std::span<const uint8_t> payload) : payload_(payload) {}\n\n")
+    fout.write("        // payload contains all fixed fields\n")
+    fout.write("        constexpr bool valid() const { return payload_.size() >= fixed_payload_size; }\n")
+    for (field, mb_type, c_type, offset) in fields:
+        accessor = cpp_getter[mb_type].format(buffer='payload_', offset=field + '_offset', c_type=c_type)
+        # string_view over bytes requires reinterpret_cast, which is not allowed in constant expressions
+        specifier = '' if mb_type == 'string' else 'constexpr '
+        fout.write("        %s%s %s() const { return %s; }\n" % (specifier, c_type, field, accessor))
+    fout.write("\n")
+    fout.write("     private:\n")
+    fout.write("        std::span<const uint8_t> payload_;\n")
+    fout.write("    };\n\n")
+
+    # builders
+    arguments = ", ".join(["uint8_t channel"] + ["%s %s" % (c_type, field) for (field, _, c_type, _) in fields])
+    names = ", ".join(["channel"] + [field for (field, _, _, _) in fields])
+    if variable_field is None:
+        payload_len = 'fixed_payload_size'
+    else:
+        payload_len = 'fixed_payload_size + %s.size()' % variable_field[0]
+    fout.write("    // returns message len, 0 if buffer is too small\n")
+    fout.write("    static constexpr uint16_t setup(std::span<uint8_t> buffer, %s) {\n" % arguments)
+    fout.write("        const std::size_t payload_len = %s;\n" % payload_len)
+    fout.write("        if (buffer.size() < header_size + payload_len) return 0;\n")
+    fout.write("        header_setup(buffer, component, operation, channel, static_cast<uint16_t>(payload_len));\n")
+    for (field, mb_type, c_type, offset) in fields:
+        fout.write("        " + cpp_setter[mb_type].format(buffer='buffer', offset='header_size + ' + field + '_offset', field=field) + "\n")
+    fout.write("        return static_cast<uint16_t>(header_size + payload_len);\n")
+    fout.write("    }\n\n")
+    fout.write("    template <std::size_t N>\n")
+    fout.write("    static constexpr uint16_t setup(std::array<uint8_t, N> & buffer, %s) {\n" % arguments)
+    fout.write("        static_assert(N >= fixed_size, \"buffer too small for %s %s\");\n" % (component_name, operation_name))
+    fout.write("        return setup(std::span<uint8_t>(buffer), %s);\n" % names)
+    fout.write("    }\n")
+
+    # builder without variable field, which is written by the caller at fixed_size
+    if variable_field is not None:
+        (var_name, _, _, _) = variable_field
+        fixed_arguments = ", ".join(["uint8_t channel"] + ["%s %s" % (c_type, field) for (field, _, c_type, _) in fields[:-1]] + ["uint16_t %s_len" % var_name])
+        fout.write("\n")
+        fout.write("    // setup without %s, which is stored at fixed_size by caller, returns fixed_size, 0 if buffer is too small\n" % var_name)
+        fout.write("    static constexpr uint16_t setup_fixed(std::span<uint8_t> buffer, %s) {\n" % fixed_arguments)
+        fout.write("        if (buffer.size() < fixed_size) return 0;\n")
+        fout.write("        header_setup(buffer, component, operation, channel, static_cast<uint16_t>(fixed_payload_size + %s_len));\n" % var_name)
+        for (field, mb_type, c_type, offset) in fields[:-1]:
+            fout.write("        " + cpp_setter[mb_type].format(buffer='buffer', offset='header_size + ' + field + '_offset', field=field) + "\n")
+        fout.write("        return fixed_size;\n")
+        fout.write("    }\n")
+    fout.write("};\n\n")
+
+def c_generate_cpp_header(gen_path):
+
+    with open(gen_path, 'wt') as fout:
+
+        fout.write(cpp_header_start)
+        cpp_write_header_helpers(fout)
+
+        for (component_name, component) in components.items():
+            fout.write("namespace %s {\n\n" % component_name)
+            for (operation_name, operation) in component['operations'].items():
+                cpp_write_operation(fout, component_name, operation_name, operation)
+            fout.write("}  // namespace %s\n\n" % component_name)
+
+        fout.write(cpp_header_end)
+
 # main
 
 ## get paths
@@ -483,11 +943,14 @@ else:
 c_generate_header_path    = gen_path + "/multibus_protocol.h"
 c_generate_code_path      = gen_path + "/multibus_protocol.c"
 c_generate_transport_path = gen_path + '/multibus_transport_protocol.h'
+c_generate_sync_path      = gen_path + '/multibus_sync_protocol.h'
+c_generate_cpp_path       = gen_path + '/multibus_protocol.hpp'
 
 result = parser.load_protocol_description(protocol_path)
 
 protocol_version = result['protocol_version']
 header           = result['header']
+trailer          = result['trailer']
 components       = result['components']
 general_enums    = result['general_enums']
 field_enums      = result['field_enums']
@@ -495,3 +958,5 @@ field_enums      = result['field_enums']
 c_generate_header(c_generate_header_path)
 c_generate_code(c_generate_code_path)
 c_generate_transport_helper(c_generate_transport_path)
+c_generate_sync_helper(c_generate_sync_path)
+c_generate_cpp_header(c_generate_cpp_path)
@@ -26,6 +26,7 @@ import parser
 # Collected data
 protocol_version = 0
 header = {}
+trailer = {}
 components = {}
 general_enums = {}
 field_enums = {}
@@ -33,7 +34,7 @@ field_enums = {}
 protocol_type_sizes = {'bool': 1, 'u8': 1, 'u16': 2, 'u32': 4, 'string': 0, 'u8[]': 0, 'enum': 1}
 
 py_is_event_code_template = '''def {fn_name}(opcode):
-    return False
+    return opcode in [{event_ids}]
 
 '''
 
@@ -60,12 +61,16 @@ def generate_python_bindings(py_generate_header_path):
 
         generate_header_setup_functions(out, payload_offset)
 
+        generate_trailer_functions(out)
+
         # Build request setup methods and response getters
         for (component_name, component) in components.items():
 
             # is_event
             fn_name = "mb_" + component_name + "_is_event"
-            out.write(py_is_event_code_template.format(fn_name=fn_name))
+            event_ids = ["0x%02x" % operation['id'] for operation in component['operations'].values()
+                         if operation.get('type') == 'event']
+            out.write(py_is_event_code_template.format(fn_name=fn_name, event_ids=", ".join(event_ids)))
             out.write('\n')
 
             for (operation_name, operation) in component['operations'].items():
@@ -82,6 +87,13 @@ def generate_python_bindings(py_generate_header_path):
                     create_request_message_functions(component, component_name, operation, operation_fields,
                                                      operation_name, out, payload_offset)
 
+        # is_event for any component
+        out.write("\ndef mb_message_is_event(component, opcode):\n")
+        for (component_name, component) in components.items():
+            out.write("    if component == MB_COMPONENT_ID_%s:\n" % component_name.upper())
+            out.write("        return mb_%s_is_event(opcode)\n" % component_name)
+        out.write("    return False\n")
+
 
 def create_request_message_functions(component, component_name, operation, operation_fields, operation_name, out,
                                      payload_offset):
@@ -207,6 +219,41 @@ def generate_header_setup_functions(out, payload_offset):
     out.write('\n\n')
 
 
+def generate_trailer_functions(out):
+    if len(trailer) == 0:
+        return
+    trailer_fields = trailer['fields']
+    pack_string = '>' + ''.join(['H' if mb_type == 'u16' else 'B' for mb_type in trailer_fields.values()])
+    length_offset = 0
+    for (field, mb_type) in header.items():
+        if field == 'length':
+            break
+        length_offset += protocol_type_sizes[mb_type]
+    out.write("# MultiBus Protocol Trailer, used since protocol version MB_TRAILER_VERSION\n")
+    out.write("MB_TRAILER_VERSION = %u\n" % trailer['version'])
+    out.write("MB_TRAILER_SIZE = %u\n" % sum([protocol_type_sizes[mb_type] for mb_type in trailer_fields.values()]))
+    out.write("\n")
+    # trailer builder
+    out.write("\n# MultiBus Trailer Builder\n")
+    out.write("def mb_trailer_setup(" + ', '.join(trailer_fields.keys()) + "):\n")
+    out.write("    return struct.pack('" + pack_string + "', " + ', '.join(trailer_fields.keys()) + ")\n")
+    out.write('\n\n')
+    # append trailer and update length field
+    out.write("# Append trailer to message and add it to the length field\n")
+    out.write("def mb_message_append_trailer(message, " + ', '.join(trailer_fields.keys()) + "):\n")
+    out.write("    length = struct.unpack_from('>H', message, %u)[0] + MB_TRAILER_SIZE\n" % length_offset)
+    out.write("    return message[:%u] + struct.pack('>H', length) + message[%u:] + mb_trailer_setup(%s)\n" %
+              (length_offset, length_offset + 2, ', '.join(trailer_fields.keys())))
+    out.write('\n\n')
+    # trailer getter
+    out.write("def mb_trailer(trailer):\n")
+    out.write("    " + ', '.join(trailer_fields.keys()) + " = struct.unpack('" + pack_string + "', trailer)\n")
+    out.write("    return " + ', '.join(trailer_fields.keys()))
+    if len(trailer_fields) == 1:
+        out.write("[0]")
+    out.write("\n\n\n")
+
+
 def get_payload_offset() -> int:
     payload_offset = 0
     for (field, mb_type) in header.items():
@@ -245,7 +292,7 @@ def generate_enums_and_constants(out):
 
 
 def main():
-    global protocol_version, header, components, general_enums, field_enums
+    global protocol_version, header, trailer, components, general_enums, field_enums
 
     multibus_root = os.path.abspath(os.path.dirname(sys.argv[0]) + '/..')
     protocol_path = multibus_root + '/protocol/multibus.yml'
@@ -262,6 +309,7 @@ def main():
 
     protocol_version = result['protocol_version']
     header = result['header']
+    trailer = result['trailer']
     components = result['components']
     general_enums = result['general_enums']
     field_enums = result['field_enums']
@@ -10,6 +10,8 @@ set (MULTIBUS_PROTOCOL_SRC
     ${CMAKE_CURRENT_BINARY_DIR}/multibus_protocol.h
     ${CMAKE_CURRENT_BINARY_DIR}/multibus_protocol.c
     ${CMAKE_CURRENT_BINARY_DIR}/multibus_transport_protocol.h
+    ${CMAKE_CURRENT_BINARY_DIR}/multibus_sync_protocol.h
+    ${CMAKE_CURRENT_BINARY_DIR}/multibus_protocol.hpp
 )
 
 # custom command to generate them in CMAKE_CURRENT_BINARY_DIR
@@ -38,6 +38,7 @@ Copyright 2022, MultiBus
 ## Collected data
 protocol_version = 0
 header = {}
+trailer = {}
 components = {}
 general_enums = {}
 field_enums = {}
@@ -47,6 +48,7 @@ def process_protocol_description(data):
     global protocol_version
     global components
     global header
+    global trailer
     global general_enums
     global field_enums
 
@@ -57,6 +59,10 @@ def process_protocol_description(data):
     message = data['message']
     header = message['fields']
 
+    # get message trailer, used since given protocol version
+    if 'trailer' in message:
+        trailer = message['trailer']
+
     # get components
     components = message['components']
 
@@ -96,6 +102,7 @@ def load_protocol_description(protocol_path):
             process_protocol_description(yaml.safe_load(stream))
             result['protocol_version'] = protocol_version
             result['header'] = header
+            result['trailer'] = trailer
             result['components'] = components
             result['general_enums'] = general_enums
             result['field_enums'] = field_enums